@@ -1,80 +1,417 @@
+/*! ****************************************************************************
+\file ISLWalker.hpp
+
+\brief
+Static-dispatch (CRTP) base for walkers over ISL code-generated ASTs.
+
+A walker derives from ISLWalker<Derived,T>, where Derived is the walker itself
+and T is the type every generic visit returns.
+The base owns the node-type, expression-type and operation-type switches, and
+forwards each case to the hook of the same name on Derived.
+Every call is resolved statically, so the compiler lowers the switches to jump
+tables and may inline the hooks directly into them.
+
+Derived walkers only need to define the hooks they care about.
+Hooks not defined by Derived fall back to these defaults:
+  visit_op_*   -> visit_op_unknown   -> T()
+  visit_expr_* -> visit_expr_unknown -> T()
+  visit_node_* -> visit_node_unknown -> T()
+
+Derived hooks may return any type convertible to T (e.g. SgExpression* for
+T = SgNode*), and may be protected if Derived befriends its ISLWalker base.
+
+Walkers that write each node as they reach it, rather than build a result
+from their children's, may instead traverse() the tree on an explicit work
+stack, so its depth costs no stack: Derived::enter is called on every node
+and expression in prefix order, and Derived::leave once its children are done.
+*******************************************************************************/
+
 #ifndef ISLWALKER_HPP
 #define ISLWALKER_HPP
 
-#include <list>
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include <cassert>
 #include "all_isl.hpp"
+#include "isl_handle.hpp"
 
-template<typename T>
+template<typename Derived, typename T>
 class ISLWalker {
   protected:
     int depth;
 
+    Derived* derived(){
+      return static_cast<Derived*>( this );
+    }
+
+    // Work item of traverse(): a node or an expression, entered or left
+    struct traversal_item {
+      isl_ast_node_handle node;
+      isl_ast_expr_handle expr;
+      bool leaving;
+    };
+
+    static traversal_item item( isl_ast_node* node ){
+      return traversal_item{ isl_ast_node_handle( node ), isl_ast_expr_handle(), false };
+    }
+
+    static traversal_item item( isl_ast_expr* expr ){
+      return traversal_item{ isl_ast_node_handle(), isl_ast_expr_handle( expr ), false };
+    }
+
+    // Appends the children of node in the order the visit_node_* hooks
+    // take them
+    static void push_children( isl_ast_node* node, std::vector<traversal_item>& items ){
+      switch( isl_ast_node_get_type(node) ){
+        case isl_ast_node_for:
+          items.push_back( item( isl_ast_node_for_get_iterator( node ) ) );
+          items.push_back( item( isl_ast_node_for_get_init( node ) ) );
+          items.push_back( item( isl_ast_node_for_get_cond( node ) ) );
+          items.push_back( item( isl_ast_node_for_get_inc( node ) ) );
+          items.push_back( item( isl_ast_node_for_get_body( node ) ) );
+          break;
+
+        case isl_ast_node_if:
+          items.push_back( item( isl_ast_node_if_get_cond( node ) ) );
+          items.push_back( item( isl_ast_node_if_get_then( node ) ) );
+          if( isl_ast_node_if_has_else( node ) ){
+            items.push_back( item( isl_ast_node_if_get_else( node ) ) );
+          }
+          break;
+
+        case isl_ast_node_block: {
+          isl_ast_node_list_handle list( isl_ast_node_block_get_children( node ) );
+          for( int i = 0; i < isl_ast_node_list_n_ast_node( list.get() ); i += 1 ){
+            items.push_back( item( isl_ast_node_list_get_ast_node( list.get(), i ) ) );
+          }
+          break;
+        }
+
+        case isl_ast_node_mark:
+          items.push_back( item( isl_ast_node_mark_get_node( node ) ) );
+          break;
+
+        case isl_ast_node_user:
+          items.push_back( item( isl_ast_node_user_get_expr( node ) ) );
+          break;
+
+        default:
+          break;
+      }
+    }
+
+    static void push_children( isl_ast_expr* expr, std::vector<traversal_item>& items ){
+      if( isl_ast_expr_get_type(expr) != isl_ast_expr_op ){
+        return;
+      }
+      for( int i = 0; i < isl_ast_expr_get_op_n_arg(expr); i += 1 ){
+        items.push_back( item( isl_ast_expr_get_op_arg( expr, i ) ) );
+      }
+    }
+
+    void traverse( traversal_item root ){
+      std::vector<traversal_item> stack;
+      stack.push_back( std::move( root ) );
+
+      while( ! stack.empty() ){
+        traversal_item current = std::move( stack.back() );
+        stack.pop_back();
+
+        isl_ast_node* node = current.node.get();
+        isl_ast_expr* expr = current.expr.get();
+        if( current.leaving ){
+          if( node != NULL ){
+            this->derived()->leave( node );
+          } else {
+            this->derived()->leave( expr );
+          }
+          continue;
+        }
+
+        bool descend = (node != NULL) ? this->derived()->enter( node ) : this->derived()->enter( expr );
+        current.leaving = true;
+        stack.push_back( std::move( current ) );
+        if( descend ){
+          // Pushed in reverse, so entered in order
+          std::size_t first = stack.size();
+          if( node != NULL ){
+            push_children( node, stack );
+          } else {
+            push_children( expr, stack );
+          }
+          std::reverse( stack.begin() + first, stack.end() );
+        }
+      }
+    }
+
   public:
 
-    ISLWalker();
+    ISLWalker(): depth(-1) {}
 
     // Generic visit switcher methods
-    T visit( isl_ast_expr* node );
-    T visit( isl_ast_node* node );
+    T visit( isl_ast_expr* node ){
+      switch( isl_ast_expr_get_type(node) ){
+        case isl_ast_expr_error:
+          return this->derived()->visit_expr_error( node );
+
+        case isl_ast_expr_op:
+          return this->derived()->visit_expr_op( node );
+
+        case isl_ast_expr_id:
+          return this->derived()->visit_expr_id( node );
+
+        case isl_ast_expr_int:
+          return this->derived()->visit_expr_int( node );
+
+        default:
+          return this->derived()->visit_expr_unknown( node );
+      }
+    }
+
+    T visit( isl_ast_node* node ){
+      switch( isl_ast_node_get_type(node) ){
+        case isl_ast_node_error:
+          return this->derived()->visit_node_error( node );
+
+        case isl_ast_node_for:
+          return this->derived()->visit_node_for( node );
+
+        case isl_ast_node_if:
+          return this->derived()->visit_node_if( node );
+
+        case isl_ast_node_block:
+          return this->derived()->visit_node_block( node );
+
+        case isl_ast_node_mark:
+          return this->derived()->visit_node_mark( node );
+
+        case isl_ast_node_user:
+          return this->derived()->visit_node_user( node );
+
+        default:
+          return this->derived()->visit_node_unknown( node );
+      }
+    }
+
+    // Explicit work stack traversals (see above)
+    void traverse( isl_ast_node* root ){
+      this->traverse( item( isl_ast_node_copy( root ) ) );
+    }
+
+    void traverse( isl_ast_expr* root ){
+      this->traverse( item( isl_ast_expr_copy( root ) ) );
+    }
+
+    // Called by traverse(); enter returns whether to go on to the children
+    bool enter( isl_ast_node* node ){ return true; }
+    bool enter( isl_ast_expr* node ){ return true; }
+    void leave( isl_ast_node* node ){}
+    void leave( isl_ast_expr* node ){}
+
+    // Name of an operation type, as in the visit_op_* hook it goes to
+    static const char* op_name( isl_ast_op_type type ){
+      switch( type ){
+        case isl_ast_op_error: return "error";
+        case isl_ast_op_and: return "and";
+        case isl_ast_op_and_then: return "and_then";
+        case isl_ast_op_or: return "or";
+        case isl_ast_op_or_else: return "or_else";
+        case isl_ast_op_max: return "max";
+        case isl_ast_op_min: return "min";
+        case isl_ast_op_minus: return "minus";
+        case isl_ast_op_add: return "add";
+        case isl_ast_op_sub: return "sub";
+        case isl_ast_op_mul: return "mul";
+        case isl_ast_op_div: return "div";
+        case isl_ast_op_fdiv_q: return "fdiv_q";
+        case isl_ast_op_pdiv_q: return "pdiv_q";
+        case isl_ast_op_pdiv_r: return "pdiv_r";
+        case isl_ast_op_zdiv_r: return "zdiv_r";
+        case isl_ast_op_cond: return "cond";
+        case isl_ast_op_select: return "select";
+        case isl_ast_op_eq: return "eq";
+        case isl_ast_op_le: return "le";
+        case isl_ast_op_lt: return "lt";
+        case isl_ast_op_ge: return "ge";
+        case isl_ast_op_gt: return "gt";
+        case isl_ast_op_call: return "call";
+        case isl_ast_op_access: return "access";
+        case isl_ast_op_member: return "member";
+        case isl_ast_op_address_of: return "address_of";
+        default: return "unknown";
+      }
+    }
 
     // Operation visit switch method
-    T visit_expr_op(isl_ast_expr* node);
+    T visit_expr_op(isl_ast_expr* node){
+      switch( isl_ast_expr_get_op_type(node) ){
+        case isl_ast_op_error:
+          return this->derived()->visit_op_error( node );
+
+        case isl_ast_op_and:
+          return this->derived()->visit_op_and( node );
+
+        case isl_ast_op_and_then:
+          return this->derived()->visit_op_and_then( node );
+
+        case isl_ast_op_or:
+          return this->derived()->visit_op_or( node );
+
+        case isl_ast_op_or_else:
+          return this->derived()->visit_op_or_else( node );
+
+        case isl_ast_op_max:
+          return this->derived()->visit_op_max( node );
+
+        case isl_ast_op_min:
+          return this->derived()->visit_op_min( node );
+
+        case isl_ast_op_minus:
+          return this->derived()->visit_op_minus( node );
+
+        case isl_ast_op_add:
+          return this->derived()->visit_op_add( node );
+
+        case isl_ast_op_sub:
+          return this->derived()->visit_op_sub( node );
+
+        case isl_ast_op_mul:
+          return this->derived()->visit_op_mul( node );
+
+        case isl_ast_op_div:
+          return this->derived()->visit_op_div( node );
+
+        case isl_ast_op_fdiv_q:
+          return this->derived()->visit_op_fdiv_q( node );
+
+        case isl_ast_op_pdiv_q:
+          return this->derived()->visit_op_pdiv_q( node );
+
+        case isl_ast_op_pdiv_r:
+          return this->derived()->visit_op_pdiv_r( node );
+
+        case isl_ast_op_zdiv_r:
+          return this->derived()->visit_op_zdiv_r( node );
+
+        case isl_ast_op_cond:
+          return this->derived()->visit_op_cond( node );
+
+        case isl_ast_op_select:
+          return this->derived()->visit_op_select( node );
+
+        case isl_ast_op_eq:
+          return this->derived()->visit_op_eq( node );
+
+        case isl_ast_op_le:
+          return this->derived()->visit_op_le( node );
+
+        case isl_ast_op_lt:
+          return this->derived()->visit_op_lt( node );
+
+        case isl_ast_op_ge:
+          return this->derived()->visit_op_ge( node );
+
+        case isl_ast_op_gt:
+          return this->derived()->visit_op_gt( node );
+
+        case isl_ast_op_call:
+          return this->derived()->visit_op_call( node );
+
+        case isl_ast_op_access:
+          return this->derived()->visit_op_access( node );
+
+        case isl_ast_op_member:
+          return this->derived()->visit_op_member( node );
+
+        case isl_ast_op_address_of:
+          return this->derived()->visit_op_address_of( node );
+
+        default:
+          return this->derived()->visit_op_unknown( node );
+      }
+    }
 
     // Operands visitor methods
-    std::list<T> visit_expr_operands(isl_ast_expr* node );
-    T visit_op_operand( isl_ast_expr* node, int pos );
-    T visit_op_lhs( isl_ast_expr* node );
-    T visit_op_rhs( isl_ast_expr* node );
-    T visit_op_unary_operand( isl_ast_expr* node );
+    std::vector<T> visit_expr_operands(isl_ast_expr* node ){
+      int n_arg = isl_ast_expr_get_op_n_arg(node);
+      std::vector<T> operands_list;
+      operands_list.reserve( n_arg );
+
+      for( int i = 0; i < n_arg; i += 1 ){
+        operands_list.push_back( this->derived()->visit_op_operand( node, i ) );
+      }
+
+      return operands_list;
+    }
+
+    T visit_op_operand( isl_ast_expr* node, int pos ){
+      assert( isl_ast_expr_get_op_n_arg(node) > pos );
+      isl_ast_expr_handle arg( isl_ast_expr_get_op_arg( node, pos ) );
+      return this->derived()->visit( arg.get() );
+    }
+
+    T visit_op_lhs( isl_ast_expr* node ){
+      return this->derived()->visit_op_operand( node, 0 );
+    }
+
+    T visit_op_rhs( isl_ast_expr* node ){
+      return this->derived()->visit_op_operand( node, 1 );
+    }
+
+    T visit_op_unary_operand( isl_ast_expr* node ){
+      return this->derived()->visit_op_operand( node, 0 );
+    }
 
     // Visit operation node methods
-    T visit_op_error(isl_ast_expr* node);
-    T visit_op_and(isl_ast_expr* node);
-    T visit_op_and_then(isl_ast_expr* node);
-    T visit_op_or(isl_ast_expr* node);
-    T visit_op_or_else(isl_ast_expr* node);
-    T visit_op_max(isl_ast_expr* node);
-    T visit_op_min(isl_ast_expr* node);
-    T visit_op_minus(isl_ast_expr* node);
-    T visit_op_add(isl_ast_expr* node);
-    T visit_op_sub(isl_ast_expr* node);
-    T visit_op_mul(isl_ast_expr* node);
-    T visit_op_div(isl_ast_expr* node);
-    T visit_op_fdiv_q(isl_ast_expr* node);
-    T visit_op_pdiv_q(isl_ast_expr* node);
-    T visit_op_pdiv_r(isl_ast_expr* node);
-    T visit_op_zdiv_r(isl_ast_expr* node);
-    T visit_op_cond(isl_ast_expr* node);
-    T visit_op_select(isl_ast_expr* node);
-    T visit_op_eq(isl_ast_expr* node);
-    T visit_op_le(isl_ast_expr* node);
-    T visit_op_lt(isl_ast_expr* node);
-    T visit_op_ge(isl_ast_expr* node);
-    T visit_op_gt(isl_ast_expr* node);
-    T visit_op_call(isl_ast_expr* node);
-    T visit_op_access(isl_ast_expr* node);
-    T visit_op_member(isl_ast_expr* node);
-    T visit_op_address_of(isl_ast_expr* node);
-
-    T visit_op_unknown(isl_ast_expr* node);
+    T visit_op_error(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_and(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_and_then(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_or(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_or_else(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_max(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_min(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_minus(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_add(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_sub(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_mul(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_div(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_fdiv_q(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_pdiv_q(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_pdiv_r(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_zdiv_r(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_cond(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_select(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_eq(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_le(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_lt(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_ge(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_gt(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_call(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_access(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_member(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+    T visit_op_address_of(isl_ast_expr* node){ return this->derived()->visit_op_unknown( node ); }
+
+    T visit_op_unknown(isl_ast_expr* node){ return T(); }
 
     // Visit literal expression methods
-    T visit_expr_id(isl_ast_expr* node);
-    T visit_expr_int(isl_ast_expr* node);
+    T visit_expr_id(isl_ast_expr* node){ return this->derived()->visit_expr_unknown( node ); }
+    T visit_expr_int(isl_ast_expr* node){ return this->derived()->visit_expr_unknown( node ); }
 
-    T visit_expr_unknown(isl_ast_expr* node);
-    T visit_expr_error(isl_ast_expr* node);
+    T visit_expr_unknown(isl_ast_expr* node){ return T(); }
+    T visit_expr_error(isl_ast_expr* node){ return this->derived()->visit_expr_unknown( node ); }
 
     // Visit statement node methods
-    T visit_node_for(isl_ast_node* node);
-    T visit_node_if(isl_ast_node* node);
-    T visit_node_block(isl_ast_node* node);
-    T visit_node_mark(isl_ast_node* node);
+    T visit_node_for(isl_ast_node* node){ return this->derived()->visit_node_unknown( node ); }
+    T visit_node_if(isl_ast_node* node){ return this->derived()->visit_node_unknown( node ); }
+    T visit_node_block(isl_ast_node* node){ return this->derived()->visit_node_unknown( node ); }
+    T visit_node_mark(isl_ast_node* node){ return this->derived()->visit_node_unknown( node ); }
 
-    T visit_node_user(isl_ast_node* node);
+    T visit_node_user(isl_ast_node* node){ return this->derived()->visit_node_unknown( node ); }
 
-    T visit_node_unknown(isl_ast_node* node);
-    T visit_node_error(isl_ast_node* node);
+    T visit_node_unknown(isl_ast_node* node){ return T(); }
+    T visit_node_error(isl_ast_node* node){ return this->derived()->visit_node_unknown( node ); }
 };
 
 #endif
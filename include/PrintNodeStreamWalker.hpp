@@ -0,0 +1,137 @@
+/*! ****************************************************************************
+\file PrintNodeStreamWalker.hpp
+
+\brief
+Streaming counterpart of PrintNodeWalker.
+
+Writes each node as it is visited straight to a caller supplied std::ostream or
+std::string, instead of returning and concatenating a string per subtree, so
+dumping costs time linear in the size of the tree. Indentation is copied from
+an indent table grown on demand rather than built per line. With iterative
+set, the tree is walked on an explicit work stack (ISLWalker::traverse), so
+the depth of the AST costs no stack.
+
+Two formats:
+  print_text   PrintNodeWalker's tree text, line for line (except that mark
+               nodes also print the node they mark)
+  print_json   one JSON object per node:
+                 {"kind":"for","children":[...]}
+                 {"kind":"op","op":"add","children":[...]}
+                 {"kind":"id","name":"c0"}
+                 {"kind":"int","value":5,"den":1}
+*******************************************************************************/
+
+#ifndef PRINTNODESTREAMWALKER_HPP
+#define PRINTNODESTREAMWALKER_HPP
+
+#include "ISLWalker.hpp"
+#include "all_isl.hpp"
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum print_format {
+  print_text,
+  print_json
+};
+
+// Every visit returns the number of nodes written
+class PrintNodeStreamWalker : public ISLWalker<PrintNodeStreamWalker, int> {
+  protected:
+    std::ostream* out;
+    std::string* buffer;
+    print_format format;
+    bool iterative;
+    // Nodes entered so far
+    int entered;
+    std::string indent;
+    // Per open JSON children array, whether an element was written yet
+    std::vector<bool> has_sibling;
+
+    void write( const char* text, std::size_t length );
+    void write( const char* text );
+    void write( const std::string& text );
+    void write_tab();
+    void write_json_string( const char* text );
+
+    // Starts a node; in JSON leaves the object open for fields
+    void open( const char* text_label, const char* kind, const char* text_detail = NULL );
+    // Opens the node's children (JSON only)
+    void open_children();
+    void close( bool had_children );
+
+    void open_op( isl_ast_expr* node, const char* name );
+    void open_id( isl_ast_expr* node );
+    void open_int( isl_ast_expr* node );
+    void open_mark( isl_ast_node* node );
+
+    int visit_op_named( isl_ast_expr* node, const char* name );
+    int visit_leaf_node( isl_ast_node* node, const char* text_label, const char* kind );
+    int visit_leaf_expr( isl_ast_expr* node, const char* text_label, const char* kind );
+
+  public:
+    PrintNodeStreamWalker( std::ostream& out, print_format format = print_text, bool iterative = false );
+    // Appends to buffer
+    PrintNodeStreamWalker( std::string& buffer, print_format format = print_text, bool iterative = false );
+
+    // Generic visit switcher methods, through traverse() when iterative
+    int visit( isl_ast_node* node );
+    int visit( isl_ast_expr* node );
+
+    // Write the start and the end of a node; also used by the visit methods
+    bool enter( isl_ast_node* node );
+    bool enter( isl_ast_expr* node );
+    void leave( isl_ast_node* node );
+    void leave( isl_ast_expr* node );
+
+    // Visit operation node methods
+    int visit_op_error(isl_ast_expr* node){ return this->visit_op_named( node, "error" ); }
+    int visit_op_and(isl_ast_expr* node){ return this->visit_op_named( node, "and" ); }
+    int visit_op_and_then(isl_ast_expr* node){ return this->visit_op_named( node, "and_then" ); }
+    int visit_op_or(isl_ast_expr* node){ return this->visit_op_named( node, "or" ); }
+    int visit_op_or_else(isl_ast_expr* node){ return this->visit_op_named( node, "or_else" ); }
+    int visit_op_max(isl_ast_expr* node){ return this->visit_op_named( node, "max" ); }
+    int visit_op_min(isl_ast_expr* node){ return this->visit_op_named( node, "min" ); }
+    int visit_op_minus(isl_ast_expr* node){ return this->visit_op_named( node, "minus" ); }
+    int visit_op_add(isl_ast_expr* node){ return this->visit_op_named( node, "add" ); }
+    int visit_op_sub(isl_ast_expr* node){ return this->visit_op_named( node, "sub" ); }
+    int visit_op_mul(isl_ast_expr* node){ return this->visit_op_named( node, "mul" ); }
+    int visit_op_div(isl_ast_expr* node){ return this->visit_op_named( node, "div" ); }
+    int visit_op_fdiv_q(isl_ast_expr* node){ return this->visit_op_named( node, "fdiv_q" ); }
+    int visit_op_pdiv_q(isl_ast_expr* node){ return this->visit_op_named( node, "pdiv_q" ); }
+    int visit_op_pdiv_r(isl_ast_expr* node){ return this->visit_op_named( node, "pdiv_r" ); }
+    int visit_op_zdiv_r(isl_ast_expr* node){ return this->visit_op_named( node, "zdiv_r" ); }
+    int visit_op_cond(isl_ast_expr* node){ return this->visit_op_named( node, "cond" ); }
+    int visit_op_select(isl_ast_expr* node){ return this->visit_op_named( node, "select" ); }
+    int visit_op_eq(isl_ast_expr* node){ return this->visit_op_named( node, "eq" ); }
+    int visit_op_le(isl_ast_expr* node){ return this->visit_op_named( node, "le" ); }
+    int visit_op_lt(isl_ast_expr* node){ return this->visit_op_named( node, "lt" ); }
+    int visit_op_ge(isl_ast_expr* node){ return this->visit_op_named( node, "ge" ); }
+    int visit_op_gt(isl_ast_expr* node){ return this->visit_op_named( node, "gt" ); }
+    int visit_op_call(isl_ast_expr* node){ return this->visit_op_named( node, "call" ); }
+    int visit_op_access(isl_ast_expr* node){ return this->visit_op_named( node, "access" ); }
+    int visit_op_member(isl_ast_expr* node){ return this->visit_op_named( node, "member" ); }
+    int visit_op_address_of(isl_ast_expr* node){ return this->visit_op_named( node, "address_of" ); }
+
+    int visit_op_unknown(isl_ast_expr* node){ return this->visit_op_named( node, "unknown" ); }
+
+    // Visit literal expression methods
+    int visit_expr_id(isl_ast_expr* node);
+    int visit_expr_int(isl_ast_expr* node);
+
+    int visit_expr_unknown(isl_ast_expr* node){ return this->visit_leaf_expr( node, "Expression unknown", "unknown" ); }
+    int visit_expr_error(isl_ast_expr* node){ return this->visit_leaf_expr( node, "Expression error", "error" ); }
+
+    // Visit statement node methods
+    int visit_node_for(isl_ast_node* node);
+    int visit_node_if(isl_ast_node* node);
+    int visit_node_block(isl_ast_node* node);
+    int visit_node_mark(isl_ast_node* node);
+
+    int visit_node_user(isl_ast_node* node);
+
+    int visit_node_unknown(isl_ast_node* node){ return this->visit_leaf_node( node, "Node unknown", "unknown" ); }
+    int visit_node_error(isl_ast_node* node){ return this->visit_leaf_node( node, "Node error", "error" ); }
+};
+
+#endif
@@ -1,32 +1,31 @@
 #ifndef PRINTNODEWALKER_HPP
 #define PRINTNODEWALKER_HPP
 
-// #include "ISLWalker.hpp"
+#include "ISLWalker.hpp"
 #include "all_isl.hpp"
-#include <list>
+#include <vector>
 #include <string>
 
-class PrintNodeWalker{
+class PrintNodeWalker : public ISLWalker<PrintNodeWalker, std::string> {
   protected:
-    int depth;
+    // Walk on an explicit work stack, writing into output
+    bool iterative;
+    std::string output;
+
     std::string getTab();
 
   public:
-    PrintNodeWalker();
+    explicit PrintNodeWalker( bool iterative = false );
 
-    // Generic visit switcher methods
-    std::string visit( isl_ast_expr* node );
+    // Generic visit switcher methods, through traverse() when iterative
     std::string visit( isl_ast_node* node );
+    std::string visit( isl_ast_expr* node );
 
-    // Operation visit switch method
-    std::string visit_expr_op(isl_ast_expr* node);
-
-    // Operands visitor methods
-    std::list<std::string> visit_expr_operands(isl_ast_expr* node );
-    std::string visit_op_operand( isl_ast_expr* node, int pos );
-    std::string visit_op_lhs( isl_ast_expr* node );
-    std::string visit_op_rhs( isl_ast_expr* node );
-    std::string visit_op_unary_operand( isl_ast_expr* node );
+    // Iterative mode: write the line of each node
+    bool enter( isl_ast_node* node );
+    bool enter( isl_ast_expr* node );
+    void leave( isl_ast_node* node );
+    void leave( isl_ast_expr* node );
 
     // Visit operation node methods
     std::string visit_op_error(isl_ast_expr* node);
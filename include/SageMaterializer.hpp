@@ -0,0 +1,103 @@
+/*! ****************************************************************************
+\file SageMaterializer.hpp
+
+\brief
+Builds Sage from a flat_ast (see flat_ast.hpp).
+
+The tree built, and the statement macros recorded, are those
+SageTransformationWalker builds from the isl AST the flat_ast was lowered
+from. Statements are visited on an explicit stack. Expressions, whose nodes
+are numbered in pre-order, are built in one sweep from the last node of their
+range to the first, so every operand is built before the operation using it.
+Neither recurses, whatever the depth of the AST.
+
+Iterators are bound by identifier number rather than by isl_id; other
+identifiers are looked up in the scopes enclosing the injection site.
+*******************************************************************************/
+
+#ifndef SAGEMATERIALIZER_HPP
+#define SAGEMATERIALIZER_HPP
+
+#include <cstdint>
+#include <vector>
+#include "flat_ast.hpp"
+#include "affine_builder.hpp"
+#include "arith_builder.hpp"
+#include "loop_builder.hpp"
+#include "mark_registry.hpp"
+#include "width_analysis.hpp"
+#include "SageTransformationWalker.hpp"
+#include "rose.h"
+
+class SageMaterializer {
+  protected:
+    struct symbol_binding {
+      std::uint32_t identifier;
+      SgVariableSymbol* previous;
+    };
+
+    // Statement in progress
+    struct statement_frame {
+      std::uint32_t node;
+      std::uint32_t state;
+      SgNode* partial[2];
+      // symbol_undo size before a loop bound its iterator
+      std::vector<symbol_binding>::size_type bindings;
+    };
+
+    const flat_ast* ast;
+    SgScopeStatement* injection_site;
+    SgGlobal* global;
+    arith_builder arith;
+    loop_builder loops;
+    affine_builder affine;
+    bool omp_parallel;
+    // Outermost loop annotated parallel being built, with omp_parallel
+    SgForStatement* parallel_loop;
+    const mark_registry* marks;
+    // Iterator types, if chosen
+    const width_analysis* widths;
+
+    std::vector<SgScopeStatement*> scopes;
+    // Symbol of each identifier, NULL until resolved
+    std::vector<SgVariableSymbol*> symbols;
+    std::vector<symbol_binding> symbol_undo;
+
+    // Sage node built for each flat node, while its expression is built
+    std::vector<SgNode*> built;
+    std::vector<statement_frame> stack;
+
+    std::vector<function_call_info> statement_macros;
+
+    SgVariableSymbol* get_symbol( std::uint32_t identifier );
+    void set_symbol( std::uint32_t identifier, SgVariableSymbol* symbol );
+
+    // Builds the expression rooted at n
+    SgNode* expression( std::uint32_t n );
+    SgExpression* operand( std::uint32_t n, std::uint32_t pos );
+    SgNode* operation( std::uint32_t n );
+    SgExpression* reference( std::uint32_t n );
+
+    SgForStatement* enter_for( statement_frame& frame );
+    SgNode* leave_for( statement_frame& frame, SgStatement* sg_stmt );
+    SgNode* leave_if( statement_frame& frame, SgStatement* then_node, SgStatement* else_node );
+
+  public:
+    SageMaterializer();
+    // Builds what a walker with options would; only intrinsics,
+    // strength_reduce, canonical_loops, hoist_invariants, fold_affine,
+    // omp_parallel, marks and unroll_limit have an effect
+    explicit SageMaterializer( const walker_options& options );
+
+    // Declares iterators with the types widths chose for the isl AST the
+    // flat_ast was lowered from, int if NULL; widths must outlive
+    // materialize()
+    void set_widths( const width_analysis* widths );
+
+    // Builds the tree rooted at root and appends it to injection_site
+    SgStatement* materialize( const flat_ast& ast, std::uint32_t root, SgScopeStatement* injection_site );
+
+    std::vector<function_call_info>* getStatementMacroNodes();
+};
+
+#endif
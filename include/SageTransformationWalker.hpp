@@ -2,10 +2,23 @@
 #define SAGETRANSFORMATIONWALKER_HPP
 
 #include "all_isl.hpp"
+#include "ISLWalker.hpp"
+#include "isl_handle.hpp"
+#include "isl_id_map.hpp"
+#include "walker_trace.hpp"
+#include "walker_stats.hpp"
+#include "affine_builder.hpp"
+#include "arith_builder.hpp"
+#include "expr_memo.hpp"
+#include "loop_builder.hpp"
+#include "mark_registry.hpp"
+#include "width_analysis.hpp"
+#include "work_pool.hpp"
 #include "rose.h"
 #include <list>
 #include <map>
 #include <deque>
+#include <memory>
 
 class function_call_info {
   public:
@@ -13,29 +26,167 @@ class function_call_info {
     SgName name;
     std::vector<SgExpression*> parameter_expressions;
 
-    function_call_info( SgExprStatement* expr_node, SgName name, std::vector<SgExpression*>& parameter_expressions );
+    function_call_info( SgExprStatement* expr_node, const SgName& name, const std::vector<SgExpression*>& parameter_expressions );
+
+    // Appends the statement macro calls under root to macros, in pre-order
+    static void collect( SgNode* root, std::vector<function_call_info>& macros );
 };
 
-class SageTransformationWalker{
+class walker_options {
+  public:
+    // Trace every node built; needs the library built with ISL_SAGE_TRACE
+    // (see walker_trace.hpp), otherwise a one-time note goes to cerr
+    bool verbose;
+    // Traverse with an explicit work stack instead of the native call stack.
+    // Produces the same Sage tree as the recursive mode with constant native
+    // stack use, for very deep loop nests and long operand chains. The
+    // printers take the same flag (PrintNodeWalker, PrintNodeStreamWalker).
+    bool iterative;
+    // Resolve every free identifier of the ISL AST against the enclosing
+    // scopes before translating, and fail up front listing any that are
+    // missing instead of at the first reference.
+    bool resolve_free_ids;
+    // Count calls, time and Sage nodes built per visit method, and symbol
+    // cache hits and misses (see walker_stats.hpp)
+    bool collect_stats;
+    // Copy the ISL AST into a flat_ast first and build Sage from that with
+    // SageMaterializer (see flat_ast.hpp). Builds the same tree; iterative,
+    // resolve_free_ids, verbose and collect_stats have no effect.
+    bool flat_ir;
+    // Threads lowering to the flat_ast with flat_ir (0 for one per hardware
+    // thread); Sage is always built on the calling thread. The code built
+    // does not depend on the number of threads.
+    unsigned lowering_threads;
+    // How max, min and floord are emitted (see arith_builder.hpp)
+    intrinsic_style intrinsics;
+    // Build divisions by power of two literals as shifts and masks, and
+    // floord by other literals as arithmetic (see arith_builder.hpp)
+    bool strength_reduce;
+    // Build loops in the canonical form vectorizers expect: one comparison
+    // against an invariant bound, ++c or c += k, unit strides (see
+    // loop_builder.hpp)
+    bool canonical_loops;
+    // Move the invariant parts of loop conditions into const locals declared
+    // before the loops, shared by equal expressions (see invariant_hoister.hpp)
+    bool hoist_invariants;
+    // Fold constants and build add, sub, mul and minus in affine form, long
+    // sums as balanced trees (see affine_builder.hpp)
+    bool fold_affine;
+    // Put #pragma omp parallel for on the outermost loop of each nest that is
+    // annotated parallel (see parallel_loops.hpp)
+    bool omp_parallel;
+    // Actions for the mark nodes of the ISL AST, by mark name; NULL for
+    // mark_registry::defaults(). Must outlive the translation.
+    const mark_registry* marks;
+    // Replace loops of at most this many iterations, whose init, bound and
+    // stride are constant, by copies of their body; 0 never unrolls (see
+    // loop_builder.hpp)
+    unsigned unroll_limit;
+    // Declare iterators int32_t where the ranges of values they and the
+    // expressions using them take fit in 32 bits, int64_t elsewhere, the
+    // parameters ranging over width_context, e.g. "[N] -> { : 0 <= N <=
+    // 100000 }" (see width_analysis.hpp). Literals outside 32 bits are long
+    // long whether or not this is set.
+    bool choose_widths;
+    std::string width_context;
+    // Translate each loop bound and guard that repeats with the same
+    // symbols in scope once, and copy the translation where it repeats (see
+    // expr_memo.hpp). Builds the same tree; no effect with flat_ir.
+    bool memoize_exprs;
+    // Trace events kept; older events are overwritten
+    std::size_t trace_capacity;
+    // Where each translation's trace is written, cout if empty
+    std::string trace_file;
+    trace_format trace_output_format;
+
+    walker_options();
+};
+
+class SageTransformationWalker : public ISLWalker<SageTransformationWalker, SgNode*> {
+  friend class ISLWalker<SageTransformationWalker, SgNode*>;
+
   protected:
     const bool VISIT_TO_NODE_NOT_IMPLEMENTED = false;
 
-    std::map<std::string,SgVariableSymbol*> symbol_maps;
+    // Symbols by interned isl_id, scoped along with scope_stack.
+    // Each binding made by set_symbol is logged with the symbol it replaced;
+    // popping a scope undoes the bindings made since it was pushed.
+    struct symbol_binding {
+      isl_id* id;
+      SgVariableSymbol* previous;
+    };
 
-    int depth;
+    isl_id_map<SgVariableSymbol*> symbol_cache;
+    std::vector<symbol_binding> symbol_undo;
+    // symbol_undo size when each scope on scope_stack was pushed
+    std::deque<std::vector<symbol_binding>::size_type> symbol_frames;
+
+    walker_options options;
     bool verbose;
+    walker_trace trace;
+    walker_stats stats;
     std::deque<SgScopeStatement*> scope_stack;
     isl_ast_node* isl_root;
 
-    std::vector<function_call_info*> statement_macros;
+    std::vector<function_call_info> statement_macros;
+    // Threads of flat_ir lowering, created on first use
+    std::unique_ptr<work_pool> lowering_pool;
     SgScopeStatement* injection_site;
     SgGlobal* global;
+    arith_builder arith;
+    loop_builder loops;
+    affine_builder affine;
+    // Outermost loop annotated parallel being built, with omp_parallel
+    SgForStatement* parallel_loop;
+    // Iterator types of the translation, with choose_widths
+    std::unique_ptr<width_analysis> widths;
+    // Operations of loop headers and guards translated, with memoize_exprs
+    expr_memo memo;
+
+    // Work stacks of the iterative drivers, kept between visits so their
+    // storage is reused
+    struct expr_frame {
+      isl_ast_expr_handle owned;
+      isl_ast_expr* expr;
+      int depth;
+      int next;
+      int n_args;
+      std::vector<SgNode*>::size_type base;
+    };
+
+    struct node_frame {
+      isl_ast_node_handle owned;
+      isl_ast_node* node;
+      int depth;
+      int state;
+      SgNode* partial[2];
+      isl_ast_node_list_handle children;
+    };
+
+    std::vector<expr_frame> expr_stack;
+    std::vector<SgNode*> expr_results;
+    std::vector<node_frame> node_stack;
+
+    // Operands already built by the iterative driver for the operation
+    // currently being visited; NULL while recursing.
+    std::vector<SgNode*>* ready_operands;
+    std::vector<SgNode*>::size_type ready_operands_base;
 
   public:
     SageTransformationWalker( isl_ast_node* isl_root, SgScopeStatement* injection_site );
     SageTransformationWalker( isl_ast_node* isl_root, SgScopeStatement* injection_site, bool verbose );
+    SageTransformationWalker( isl_ast_node* isl_root, SgScopeStatement* injection_site, const walker_options& options );
+    // Walker that translates nothing until translate() is called
+    explicit SageTransformationWalker( const walker_options& options );
+
+    // Translates isl_root and appends it to injection_site. May be called
+    // repeatedly; statement macros are those of the latest translation.
+    SgStatement* translate( isl_ast_node* isl_root, SgScopeStatement* injection_site );
 
-    std::vector<function_call_info*>* getStatementMacroNodes();
+    std::vector<function_call_info>* getStatementMacroNodes();
+    walker_trace& getTrace();
+    // Counts accumulate over every translation until cleared
+    walker_stats& getStats();
     SgScopeStatement* getInjectionRoot();
 
   protected:
@@ -48,23 +199,46 @@ class SageTransformationWalker{
     SgScopeStatement* pop_bottom();
     SgScopeStatement* get_global();
     void push( SgScopeStatement* scope );
+    // Push scope, which also owns the symbols bound since symbols_mark()
+    // returned bindings_mark (e.g. a loop iterator bound while the loop
+    // header was built)
+    void push( SgScopeStatement* scope, std::vector<symbol_binding>::size_type bindings_mark );
     void push_top( SgScopeStatement* scope );
     void push_bottom( SgScopeStatement* scope );
 
     // Symbol map manipulators
-    SgVariableSymbol* get_symbol( std::string symbol_name );
-    void set_symbol( std::string symbol_name, SgVariableSymbol* symbol );
+    SgVariableSymbol* get_symbol( isl_id* id );
+    // Bind id in the innermost scope
+    void set_symbol( isl_id* id, SgVariableSymbol* symbol );
+    // Remember the symbol id resolved to outside the translated code; kept
+    // until the end of the translation
+    void cache_symbol( isl_id* id, SgVariableSymbol* symbol );
+    std::vector<symbol_binding>::size_type symbols_mark();
 
+    // Identifiers referenced by the AST but not bound by one of its loops,
+    // in order of first reference
+    static void collect_free_ids( isl_ast_node* root, std::vector<isl_id*>& free_ids );
+    // Binds every free identifier to its symbol in one walk of the scope
+    // stack, returns the names of those not found
+    std::vector<std::string> resolve_free_ids();
 
-    // Generic visit switcher methods
+
+    // Generic visit switcher methods (depth tracking around ISLWalker's dispatch)
     SgNode* visit( isl_ast_node* node );
     SgNode* visit( isl_ast_expr* node );
 
+    // Explicit work stack drivers used in iterative mode
+    SgNode* visit_iterative( isl_ast_node* node );
+    SgNode* visit_iterative( isl_ast_expr* node );
+
+    // visit() for the expressions of loop headers and guards; with
+    // memoize_exprs, the whole expression is looked up in memo first
+    SgExpression* visit_memoized( isl_ast_expr* node );
+
     // Operation visit switch method
     SgNode* visit_expr_op(isl_ast_expr* node);
 
     // Operands visitor methods
-    std::list<SgNode*> visit_expr_operands(isl_ast_expr* node );
     SgExpression* visit_op_operand( isl_ast_expr* node, int pos );
     SgExpression* visit_op_lhs( isl_ast_expr* node );
     SgExpression* visit_op_rhs( isl_ast_expr* node );
@@ -106,7 +280,7 @@ class SageTransformationWalker{
 
     // Visit literal expression methods
     SgVarRefExp* visit_expr_id(isl_ast_expr* node);
-    SgIntVal* visit_expr_int(isl_ast_expr* node);
+    SgValueExp* visit_expr_int(isl_ast_expr* node);
 
     SgNode* visit_expr_unknown(isl_ast_expr* node);
     SgNode* visit_expr_error(isl_ast_expr* node);
@@ -115,7 +289,17 @@ class SageTransformationWalker{
     SgNode* visit_node_for(isl_ast_node* node);
     SgNode* visit_node_if(isl_ast_node* node);
     SgNode* visit_node_block(isl_ast_node* node);
+
+    // Statement node phases, shared by the recursive and iterative drivers.
+    // enter_* runs before the child statements are visited, leave_* after.
+    SgForStatement* enter_node_for(isl_ast_node* node);
+    SgNode* leave_node_for(isl_ast_node* node, SgForStatement* for_stmt, SgStatement* sg_stmt);
+    SgNode* leave_node_if(isl_ast_node* node, SgExpression* condition_node, SgStatement* then_node, SgStatement* else_node);
+    SgBasicBlock* enter_node_block(isl_ast_node* node);
+    void visited_block_child(SgBasicBlock* block, SgStatement* sg_stmt);
+    SgNode* leave_node_block(isl_ast_node* node, SgBasicBlock* block);
     SgNode* visit_node_mark(isl_ast_node* node);
+    SgNode* leave_node_mark(isl_ast_node* node, SgStatement* sg_stmt);
 
     SgNode* visit_node_user(isl_ast_node* node);
 
@@ -0,0 +1,71 @@
+/*! ****************************************************************************
+\file affine_builder.hpp
+
+\brief
+Builds the Sage expressions of isl's add, sub, mul and minus operations.
+
+By default they are the C operators, applied to the operands as isl gives
+them. With folding, each operation is built from the affine form of its
+operands: one integer constant plus a sum of coefficient * term, where a
+term is whatever is not a literal, a sum, a difference, a negation or a
+product by a literal (a variable, a call, a division, ...). Equal terms
+(compared structurally, see invariant_hoister.hpp) are merged and those
+left with a coefficient of 0 dropped, so
+  -1 + c           c - 1
+  1 * x, 0 + e     x, e
+  (e) - (-k)       e + k
+  2 * (c0 + 3)     2 * c0 + 6
+The form is written with the terms of positive coefficient first, in the
+order they first appear, then those of negative coefficient, subtracted, then
+the constant. A form of more than four parts is written as balanced trees
+rather than one chain, (a + b) + (c + d) - (e + f), so the additions do not
+all wait on each other.
+
+Operands are built bottom up, each already in its affine form. isl's
+expressions are mathematical integers; reassociating them does not change
+their value unless the original overflows. Constants that do not fit an int
+are long long literals.
+*******************************************************************************/
+
+#ifndef AFFINE_BUILDER_HPP
+#define AFFINE_BUILDER_HPP
+
+#include <vector>
+#include "rose.h"
+
+class affine_builder {
+  protected:
+    struct term {
+      long long coefficient;
+      SgExpression* expression;
+    };
+
+    struct affine_form {
+      long long constant;
+      std::vector<term> terms;
+    };
+
+    bool fold;
+
+    // Adds scale times expression to form, copying its terms
+    static void collect( SgExpression* expression, long long scale, affine_form& form );
+    // Builds form and frees lhs and rhs (which may be NULL), which it was
+    // collected from
+    static SgExpression* build( affine_form& form, SgExpression* lhs, SgExpression* rhs );
+    // Sum of expressions[first, last), balanced or left to right
+    static SgExpression* sum( const std::vector<SgExpression*>& expressions, std::size_t first, std::size_t last, bool balanced );
+    static SgExpression* literal( long long value );
+    // The value of an integer literal
+    static bool constant( SgExpression* expression, long long& value );
+
+  public:
+    explicit affine_builder( bool fold );
+
+    SgExpression* add( SgExpression* lhs, SgExpression* rhs );
+    SgExpression* sub( SgExpression* lhs, SgExpression* rhs );
+    SgExpression* mul( SgExpression* lhs, SgExpression* rhs );
+    // Unary minus
+    SgExpression* minus( SgExpression* operand );
+};
+
+#endif
@@ -0,0 +1,108 @@
+/*! ****************************************************************************
+\file arith_builder.hpp
+
+\brief
+Builds the Sage expressions of isl operations that have no C operator:
+max, min and fdiv_q (floord).
+
+How they are built is chosen by intrinsic_style:
+  intrinsic_calls        calls to max, min and floord, which the code they are
+                         compiled with must declare (e.g. as macros)
+  intrinsic_inline       calls to static inline definitions, added to the
+                         global scope the first time each is used, named
+                         isl_sage_<max|min|floord>_<type>
+  intrinsic_expressions  the bodies of those definitions, in place
+The definitions are selects and arithmetic, with no branches:
+  max( a, b )     a > b ? a : b
+  min( a, b )     a < b ? a : b
+  floord( n, d )  (n - (n < 0) * (d - 1)) / d
+floord relies on d being positive, which isl guarantees for fdiv_q. Operands
+used twice are copied; isl expressions have no side effects.
+
+isl's max and min take any number of operands. They are built as a balanced
+tree of the pairs above, max( max( a, b ), max( c, d ) ), whose depth is
+log2 of the number of operands rather than the number itself. Of the integer
+literals among the operands only the greatest (for max) or least (for min)
+is kept, and an operand structurally equal to an earlier one is dropped.
+
+Definitions are found through the global scope's symbol table, so several
+walkers translating into one file share a single set. They go ahead of
+everything in the file, includes too, so they are built from builtin types:
+int32_t and int64_t, the iterator types width_analysis chooses, are taken as
+int and long long.
+
+With strength reduction, divisions by a positive integer literal d = 2^k are
+built as shifts and masks, and fdiv_q by any other positive literal as the
+floord expression above, which compilers turn into a multiplication:
+  fdiv_q( e, 2^k )  e >> k            (shifts of negative e are arithmetic
+                                       on every compiler we target)
+  pdiv_q( e, 2^k )  e >> k            (isl guarantees e >= 0)
+  pdiv_r( e, 2^k )  e & (2^k - 1)     (likewise)
+  zdiv_r( e, 2^k )  e & (2^k - 1)     (isl only compares it to 0, and both
+                                       are 0 for the same e)
+  fdiv_q( e, d )    (e - (e < 0) * (d - 1)) / d
+Division by 1 leaves e, and the remainders 0. Other divisions are the C
+operators / and %, as before.
+*******************************************************************************/
+
+#ifndef ARITH_BUILDER_HPP
+#define ARITH_BUILDER_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "rose.h"
+
+enum intrinsic_style {
+  intrinsic_calls,
+  intrinsic_inline,
+  intrinsic_expressions
+};
+
+class arith_builder {
+  protected:
+    intrinsic_style style;
+    bool strength_reduce;
+    SgGlobal* global;
+
+    // Call to the intrinsic name for type, defining it first with inline
+    SgExpression* call( const std::string& name, SgExpression* lhs, SgExpression* rhs, SgType* type );
+    // Defining declaration of isl_sage_<name>_<type>
+    SgFunctionDeclaration* define( const std::string& name, SgType* type );
+    // The expression form of intrinsic name
+    static SgExpression* expand( const std::string& name, SgExpression* lhs, SgExpression* rhs );
+    // name ( max or min ) of operands[first, last), as a balanced tree
+    SgExpression* tree( const std::string& name, const std::vector<SgExpression*>& operands, std::size_t first, std::size_t last, SgType* type );
+    // tree() of operands less the dominated literals and repeated operands,
+    // which are freed
+    SgExpression* reduce( const std::string& name, const std::vector<SgExpression*>& operands, SgType* type );
+    // k if expression is the literal 2^k, -1 otherwise; divisor gets the
+    // value of any positive integer literal, 0 otherwise
+    static int power_of_two( SgExpression* expression, long& divisor );
+
+  public:
+    arith_builder( intrinsic_style style, bool strength_reduce );
+
+    // Global scope definitions are added to
+    void set_global( SgGlobal* global );
+
+    SgExpression* max( SgExpression* lhs, SgExpression* rhs, SgType* type );
+    SgExpression* min( SgExpression* lhs, SgExpression* rhs, SgType* type );
+    // n-ary max and min of isl, see above
+    SgExpression* max( const std::vector<SgExpression*>& operands, SgType* type );
+    SgExpression* min( const std::vector<SgExpression*>& operands, SgType* type );
+    // lhs / rhs rounded towards negative infinity, for positive rhs
+    SgExpression* floord( SgExpression* lhs, SgExpression* rhs, SgType* type );
+    // Quotient and remainder of non-negative lhs by positive rhs
+    SgExpression* pdiv_q( SgExpression* lhs, SgExpression* rhs );
+    SgExpression* pdiv_r( SgExpression* lhs, SgExpression* rhs );
+    // Remainder of lhs by rhs, only compared to 0
+    SgExpression* zdiv_r( SgExpression* lhs, SgExpression* rhs );
+
+    // Name of the inline definition of intrinsic name for type
+    static std::string inline_name( const std::string& name, SgType* type );
+    // The builtin type of type's width for int32_t and int64_t, else type
+    static SgType* builtin( SgType* type );
+};
+
+#endif
@@ -0,0 +1,62 @@
+/*! ****************************************************************************
+\file expr_memo.hpp
+
+\brief
+Sage translations of ISL expressions, looked up by the expressions' structure.
+
+isl repeats expressions throughout an AST: the bounds of every tile of a tiled
+nest, the guards of fused statements. key() encodes an isl_ast_expr as a
+string of its operators, literals and identifiers, each identifier as the
+symbol it stands for where the expression is used, so two expressions with
+the same key translate to equal Sage trees. key() walks the expression once on
+an explicit stack, so the depth of an expression costs no stack. find()
+returns a copy of the translation recorded under a key and record() keeps a
+copy of a new one.
+The copies kept are never attached to the tree, so rewrites of the
+translations once built (hoisting, unrolling) leave them as they were.
+
+Identifiers the walker has bound are keyed by their symbol, the others by
+their isl_id, which always resolves to the same symbol outside the translated
+code. Translations also depend on the walker's options and width analysis,
+so a memo must be cleared between translations, and whenever symbols a key
+may name are deleted, as unrolling a loop deletes its iterator's.
+*******************************************************************************/
+
+#ifndef EXPR_MEMO_HPP
+#define EXPR_MEMO_HPP
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include "all_isl.hpp"
+#include "isl_id_map.hpp"
+#include "rose.h"
+
+class expr_memo {
+  protected:
+    std::unordered_map<std::string, SgExpression*> translations;
+
+    // Appends expr itself, without its operands
+    static void append( std::string& key, isl_ast_expr* expr, isl_id_map<SgVariableSymbol*>& symbols );
+
+  public:
+    expr_memo();
+    ~expr_memo();
+    expr_memo( const expr_memo& ) = delete;
+    expr_memo& operator=( const expr_memo& ) = delete;
+
+    // Sets key to the key of expr, identifiers bound in symbols keyed by
+    // the symbol
+    static void key( isl_ast_expr* expr, isl_id_map<SgVariableSymbol*>& symbols, std::string& key );
+
+    // Copy of the translation recorded under key, or NULL
+    SgExpression* find( const std::string& key ) const;
+    // Keeps a copy of translation under key
+    void record( const std::string& key, SgExpression* translation );
+
+    std::size_t size() const;
+    // Deletes the copies kept
+    void clear();
+};
+
+#endif
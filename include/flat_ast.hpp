@@ -0,0 +1,205 @@
+/*! ****************************************************************************
+\file flat_ast.hpp
+
+\brief
+Compact, isl independent copy of an ISL AST, between isl and Sage construction.
+
+flat_ast::lower() copies an isl_ast_node tree in one pass into flat arrays,
+or lower_parallel() does so on several threads;
+SageMaterializer (SageMaterializer.hpp) builds the same Sage tree from it that
+SageTransformationWalker builds from the isl AST. Passes over the generated
+code can then read plain arrays instead of going through isl's accessors,
+which copy and reference count every node they return.
+
+Statements and expressions are both nodes, numbered in pre-order, so a
+node's subtree is the index range [n, end(n)) and every child has a higher
+index than its parent. Each node is one entry of the columns
+  kind   flat_kind
+  op     isl_ast_op_type of flat_op nodes; 1 for flat_for nodes annotated
+         parallel (see parallel_loops.hpp), else 0
+  count  number of children
+  first  position of the first child in the link array
+  end    one past the last node of the subtree
+and its children are count consecutive entries of the link array:
+  flat_for    iterator (a flat_id), init, cond, inc, body
+  flat_if     cond, then[, else]
+  flat_block  the statements, in order
+  flat_mark   the mark's name (a flat_id), the marked node
+  flat_user   the expression
+  flat_op     the operands; a call's first operand is the callee's flat_id
+Identifiers are interned: a flat_id's first is its index in the identifier
+table. Integer constants are stored in the node itself, split over first (low
+32 bits) and count (high 32 bits).
+
+The columns, the link array and the identifier names live in a bump arena
+freed as a whole, and child indices are 32 bits. Columns double when full;
+storage they outgrow is only released with the arena.
+*******************************************************************************/
+
+#ifndef FLAT_AST_HPP
+#define FLAT_AST_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "all_isl.hpp"
+
+class work_pool;
+
+enum flat_kind {
+  flat_for,
+  flat_if,
+  flat_block,
+  flat_mark,
+  flat_user,
+  flat_id,
+  flat_int,
+  flat_op
+};
+
+// Chunked bump allocator; everything allocated is freed at once
+class flat_arena {
+  protected:
+    std::vector<char*> chunks;
+    // Free space in the newest chunk
+    char* next;
+    char* limit;
+    std::size_t reserved;
+
+  public:
+    flat_arena();
+    ~flat_arena();
+
+    void* allocate( std::size_t bytes, std::size_t alignment );
+    // Frees every allocation
+    void clear();
+    // Bytes obtained from the system
+    std::size_t bytes() const { return this->reserved; }
+
+  private:
+    flat_arena( const flat_arena& );
+    flat_arena& operator=( const flat_arena& );
+};
+
+// Growable array in a flat_arena
+template<typename T>
+class flat_column {
+  protected:
+    T* items;
+    std::uint32_t used;
+    std::uint32_t capacity;
+
+  public:
+    flat_column(): items( NULL ), used( 0 ), capacity( 0 ) { }
+
+    std::uint32_t size() const { return this->used; }
+    T& operator[]( std::uint32_t i ){ return this->items[i]; }
+    const T& operator[]( std::uint32_t i ) const { return this->items[i]; }
+
+    // Appends n default entries, returns the position of the first
+    std::uint32_t extend( flat_arena& arena, std::uint32_t n ){
+      if( this->used + n > this->capacity ){
+        std::uint32_t capacity = (this->capacity == 0) ? 64 : this->capacity * 2;
+        while( capacity < this->used + n ){
+          capacity *= 2;
+        }
+        T* items = static_cast<T*>( arena.allocate( capacity * sizeof(T), alignof(T) ) );
+        if( this->used > 0 ){
+          std::memcpy( items, this->items, this->used * sizeof(T) );
+        }
+        this->items = items;
+        this->capacity = capacity;
+      }
+      std::uint32_t first = this->used;
+      for( std::uint32_t i = 0; i < n; i += 1 ){
+        this->items[first + i] = T();
+      }
+      this->used += n;
+      return first;
+    }
+
+    // Forgets the entries; the storage is the arena's
+    void reset(){
+      this->items = NULL;
+      this->used = 0;
+      this->capacity = 0;
+    }
+};
+
+class flat_ast {
+  protected:
+    flat_arena arena;
+
+    flat_column<std::uint8_t> kinds;
+    flat_column<std::uint8_t> ops;
+    flat_column<std::uint32_t> counts;
+    flat_column<std::uint32_t> firsts;
+    flat_column<std::uint32_t> ends;
+    flat_column<std::uint32_t> links;
+
+    // Identifier names, NUL terminated, in the arena
+    flat_column<const char*> names;
+    std::unordered_map<std::string, std::uint32_t> interned;
+
+    std::uint32_t append( flat_kind kind, std::uint32_t children );
+    std::uint32_t intern( const char* name );
+    // Subtree already lowered into another flat_ast
+    struct lowered_tree {
+      const flat_ast* ast;
+      std::uint32_t root;
+    };
+
+    // lower(), copying the subtrees in lowered from where they were lowered
+    std::uint32_t lower( isl_ast_node* root, const std::unordered_map<isl_ast_node*, lowered_tree>* lowered );
+
+  public:
+    static const std::uint32_t none = 0xffffffff;
+
+    flat_ast();
+
+    // Copies the tree rooted at root after the nodes already lowered and
+    // returns the index of its root
+    std::uint32_t lower( isl_ast_node* root );
+    // Same nodes as lower(), with the statements of the outermost block
+    // of more than one statement lowered by pool's threads, each thread into
+    // a flat_ast (and arena) of its own, then copied in order. The isl AST
+    // must not be changed meanwhile.
+    std::uint32_t lower_parallel( isl_ast_node* root, work_pool& pool );
+    // Copies the subtree of other rooted at root after the nodes already
+    // lowered and returns the index of its copy
+    std::uint32_t append_tree( const flat_ast& other, std::uint32_t root );
+    // Forgets every node and identifier
+    void clear();
+
+    // Number of nodes
+    std::uint32_t size() const { return this->kinds.size(); }
+    flat_kind kind( std::uint32_t n ) const { return static_cast<flat_kind>( this->kinds[n] ); }
+    isl_ast_op_type op( std::uint32_t n ) const { return static_cast<isl_ast_op_type>( this->ops[n] ); }
+    // Whether a flat_for's loop is annotated parallel
+    bool parallel( std::uint32_t n ) const { return this->ops[n] != 0; }
+    std::uint32_t children( std::uint32_t n ) const { return (this->kinds[n] == flat_int) ? 0 : this->counts[n]; }
+    std::uint32_t child( std::uint32_t n, std::uint32_t i ) const { return this->links[this->firsts[n] + i]; }
+    std::uint32_t end( std::uint32_t n ) const { return this->ends[n]; }
+
+    // Value of a flat_int
+    std::int64_t value( std::uint32_t n ) const {
+      return static_cast<std::int64_t>( (static_cast<std::uint64_t>( this->counts[n] ) << 32) | this->firsts[n] );
+    }
+    // Identifier of a flat_id
+    std::uint32_t identifier( std::uint32_t n ) const { return this->firsts[n]; }
+
+    std::uint32_t identifiers() const { return this->names.size(); }
+    const char* name( std::uint32_t identifier ) const { return this->names[identifier]; }
+
+    // Bytes held in the arena
+    std::size_t bytes() const { return this->arena.bytes(); }
+
+  private:
+    flat_ast( const flat_ast& );
+    flat_ast& operator=( const flat_ast& );
+};
+
+#endif
@@ -0,0 +1,106 @@
+/*! ****************************************************************************
+\file invariant_hoister.hpp
+
+\brief
+Moves the parts of a loop's condition that do not change while it runs into
+const locals declared just before the loop, shared between loops.
+
+For a loop about to be built, hoist():
+  1. finds the subexpressions of the condition and of the iterator's initial
+     value that do not refer to the loop's variables and are more than a
+     variable or literal, and gives each one that occurs twice, or equals the
+     value of a local already declared in a scope still open, a local of its
+     own (the outermost such subexpressions; their parts are not looked at)
+  2. gives every remaining outermost such subexpression of the condition a
+     local, or the equal one already declared
+and puts references to the locals in their place. The condition of
+  for( int c1 = 32 * c0; c1 <= min( N - 1, 32 * c0 + 31 ); ++c1 )
+becomes c1 <= c1_h0, after
+  const int c1_h0 = min( N - 1, 32 * c0 + 31 );
+Each local has the type its value is computed in, as
+width_analysis::operation_type() gives it: int64_t when the value uses an
+iterator width_analysis made wide or a long long literal, int otherwise. The
+iterator's type would not do, as a part of a narrow iterator's bounds can
+still leave 32 bits.
+The locals go at the end of the block the loop is about to be added to, named
+<iterator>_h<k>. isl's expressions have no side effects and only divide by
+positive literals, so evaluating them ahead of the loop, or of a guard the
+loop is under, is safe.
+
+Expressions are compared structurally: the same operators, literals, variable
+and function symbols and types, in the same shape. Locals are forgotten when
+the scope they are declared in is closed.
+*******************************************************************************/
+
+#ifndef INVARIANT_HOISTER_HPP
+#define INVARIANT_HOISTER_HPP
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "rose.h"
+#include "width_analysis.hpp"
+
+// Structural hash and equality of Sage expressions
+std::size_t sage_hash( SgExpression* expression );
+bool sage_equal( SgExpression* a, SgExpression* b );
+
+class invariant_hoister {
+  protected:
+    struct hoisted {
+      // The local's initial value, in its declaration
+      SgExpression* value;
+      SgVariableSymbol* local;
+    };
+
+    struct declared {
+      std::size_t hash;
+      SgVariableSymbol* local;
+      SgScopeStatement* scope;
+    };
+
+    std::unordered_multimap<std::size_t, hoisted> locals;
+    // Every local in locals, in order of declaration
+    std::vector<declared> declarations;
+    unsigned next_local;
+
+    // State of the hoist() in progress
+    const std::vector<SgVariableSymbol*>* loop_variables;
+    std::unordered_map<std::size_t, std::vector<SgExpression*> > occurrences;
+    // Candidates with an equal one elsewhere in the condition or initial value
+    std::unordered_set<SgExpression*> repeated;
+    SgBasicBlock* block;
+    const width_analysis* widths;
+    std::string prefix;
+
+    // Whether expression is more than a variable or literal and refers to
+    // none of the loop variables
+    bool candidate( SgExpression* expression );
+    void count( SgExpression* expression );
+    // Fills repeated from occurrences, before any expression is replaced
+    void find_repeated();
+    SgVariableSymbol* find( SgExpression* expression, std::size_t hash );
+    // Replaces expression by a reference to a local holding its value
+    void replace( SgExpression* expression, std::size_t hash );
+    // Step 1 and step 2 of hoist() below expression
+    void share( SgExpression* expression );
+    void lift( SgExpression* expression );
+
+  public:
+    invariant_hoister();
+
+    // Hoists from test, the loop's condition, and init, the iterator's initial
+    // value, into block; both must have parents. Locals are typed with
+    // widths, which may be NULL.
+    void hoist( SgExprStatement* test, SgExpression* init, const std::vector<SgVariableSymbol*>& loop_variables,
+                SgBasicBlock* block, const width_analysis* widths, const std::string& iterator );
+
+    // Forgets the locals declared in scope, the innermost scope still open
+    void close_scope( SgScopeStatement* scope );
+    // Forgets every local
+    void clear();
+};
+
+#endif
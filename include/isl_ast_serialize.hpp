@@ -0,0 +1,71 @@
+/*! ****************************************************************************
+\file isl_ast_serialize.hpp
+
+\brief
+Compact binary encoding of ISL ASTs, so a generated isl_ast_node can be cached
+and loaded again without re-running isl codegen.
+
+Layout (all integers are LEB128 varints, signed ones zigzag encoded):
+  header    "ISLAST" and a version byte
+  strings   count, then per string its length and bytes; every isl_id name
+            (iterators, callees, symbolic constants, marks) appears once
+  tree      the root node, pre-order:
+              for    ast_for, iterator string, degenerate flag, init,
+                     [cond, inc unless degenerate], body
+              if     ast_if, cond, then, has_else flag, [else]
+              block  ast_block, child count, children
+              mark   ast_mark, mark string, marked node
+              user   ast_user, expression
+            expressions:
+              id     ast_id, string
+              int    ast_int, signed value
+              int    ast_int_text, decimal string (values that do not fit long)
+              op     ast_op, isl_ast_op_type, argument count, arguments
+
+Op types are stored as isl's own enumerators, so a file is only valid for the
+isl version it was written with (the vendored isl-0.15); the version byte is
+bumped whenever the layout changes.
+Ids are restored by name only: user pointers and node annotations are not
+stored.
+*******************************************************************************/
+
+#ifndef ISL_AST_SERIALIZE_HPP
+#define ISL_AST_SERIALIZE_HPP
+
+#include <cstddef>
+#include <string>
+#include "all_isl.hpp"
+
+// Appends the encoding of root to out. Returns false if root could not be
+// encoded (NULL, or an error node or expression).
+bool isl_ast_serialize( isl_ast_node* root, std::string& out );
+// Writes the encoding of root to the file at path.
+bool isl_ast_serialize_file( isl_ast_node* root, const std::string& path );
+
+// Rebuilds the tree encoded in data[0, size) in ctx. Returns NULL if the data
+// is not a complete encoding.
+isl_ast_node* isl_ast_deserialize( isl_ctx* ctx, const char* data, std::size_t size );
+// Maps the file at path and rebuilds the tree it holds.
+isl_ast_node* isl_ast_deserialize_file( isl_ctx* ctx, const std::string& path );
+
+// Read only memory map of a whole file, unmapped on destruction
+class mapped_file {
+  protected:
+    const char* bytes;
+    std::size_t length;
+
+  public:
+    explicit mapped_file( const std::string& path );
+    ~mapped_file();
+
+    // False if the file could not be opened or mapped
+    bool is_open() const { return this->bytes != NULL; }
+    const char* data() const { return this->bytes; }
+    std::size_t size() const { return this->length; }
+
+  private:
+    mapped_file( const mapped_file& );
+    mapped_file& operator=( const mapped_file& );
+};
+
+#endif
@@ -0,0 +1,110 @@
+/*! ****************************************************************************
+\file isl_handle.hpp
+
+\brief
+Move-only owning handles for isl objects.
+
+Most isl accessors (isl_ast_expr_get_op_arg, isl_ast_node_for_get_body,
+isl_ast_expr_get_id, ...) return a new reference the caller must free.
+Wrapping those results in an isl_handle frees them when the handle goes out of
+scope:
+
+  isl_ast_expr_handle arg( isl_ast_expr_get_op_arg( node, 0 ) );
+  this->visit( arg.get() );
+
+Handles only own __isl_give results; __isl_keep arguments (e.g. the node being
+visited) stay raw pointers.
+*******************************************************************************/
+
+#ifndef ISL_HANDLE_HPP
+#define ISL_HANDLE_HPP
+
+#include <cstddef>
+#include "all_isl.hpp"
+
+// Free and copy functions per isl type
+template<typename T>
+struct isl_handle_traits;
+
+#define ISL_HANDLE_TRAITS( TYPE ) \
+  template<> \
+  struct isl_handle_traits<TYPE> { \
+    static void free( TYPE* ptr ){ TYPE##_free( ptr ); } \
+    static TYPE* copy( TYPE* ptr ){ return TYPE##_copy( ptr ); } \
+  };
+
+ISL_HANDLE_TRAITS( isl_ast_expr )
+ISL_HANDLE_TRAITS( isl_ast_node )
+ISL_HANDLE_TRAITS( isl_ast_node_list )
+ISL_HANDLE_TRAITS( isl_id )
+ISL_HANDLE_TRAITS( isl_val )
+
+#undef ISL_HANDLE_TRAITS
+
+// isl_ctx is not reference counted, so cannot be copied
+template<>
+struct isl_handle_traits<isl_ctx> {
+  static void free( isl_ctx* ptr ){ isl_ctx_free( ptr ); }
+};
+
+template<typename T>
+class isl_handle {
+  protected:
+    T* ptr;
+
+  public:
+    isl_handle(): ptr( NULL ) {}
+    explicit isl_handle( T* ptr ): ptr( ptr ) {}
+
+    isl_handle( isl_handle&& other ) noexcept : ptr( other.release() ) {}
+
+    isl_handle& operator=( isl_handle&& other ) noexcept {
+      this->reset( other.release() );
+      return *this;
+    }
+
+    isl_handle( const isl_handle& ) = delete;
+    isl_handle& operator=( const isl_handle& ) = delete;
+
+    ~isl_handle(){
+      this->reset();
+    }
+
+    // Borrow the object; the handle keeps ownership
+    T* get() const {
+      return this->ptr;
+    }
+
+    // Give up ownership without freeing
+    T* release(){
+      T* ret = this->ptr;
+      this->ptr = NULL;
+      return ret;
+    }
+
+    // Free the current object (if any) and take ownership of ptr
+    void reset( T* ptr = NULL ){
+      if( this->ptr != NULL ){
+        isl_handle_traits<T>::free( this->ptr );
+      }
+      this->ptr = ptr;
+    }
+
+    // New handle on another reference to the same object
+    isl_handle copy() const {
+      return isl_handle( this->ptr == NULL ? NULL : isl_handle_traits<T>::copy( this->ptr ) );
+    }
+
+    explicit operator bool() const {
+      return this->ptr != NULL;
+    }
+};
+
+typedef isl_handle<isl_ast_expr> isl_ast_expr_handle;
+typedef isl_handle<isl_ast_node> isl_ast_node_handle;
+typedef isl_handle<isl_ast_node_list> isl_ast_node_list_handle;
+typedef isl_handle<isl_id> isl_id_handle;
+typedef isl_handle<isl_val> isl_val_handle;
+typedef isl_handle<isl_ctx> isl_ctx_handle;
+
+#endif
@@ -0,0 +1,147 @@
+/*! ****************************************************************************
+\file isl_id_map.hpp
+
+\brief
+Flat open-addressing hash map keyed by isl_id pointer.
+
+isl interns ids per isl_ctx: every isl_id with the same name (and user
+pointer) in one context is the same object. The pointer itself is therefore a
+complete key, and lookups neither build strings nor compare names.
+
+Slots are stored in one contiguous array probed linearly, with backward-shift
+deletion so no tombstones build up. The map does not take references on its
+keys; each id must stay alive (e.g. held by the AST being walked) for as long
+as it is in the map.
+*******************************************************************************/
+
+#ifndef ISL_ID_MAP_HPP
+#define ISL_ID_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "all_isl.hpp"
+
+template<typename V>
+class isl_id_map {
+  protected:
+    struct slot {
+      isl_id* key;
+      V value;
+    };
+
+    std::vector<slot> slots;
+    std::size_t count;
+
+    std::size_t mask() const {
+      return this->slots.size() - 1;
+    }
+
+    // Pointer mixing; isl objects are at least 8-byte aligned so the low
+    // bits carry no information on their own
+    static std::size_t hash( isl_id* key ){
+      std::uint64_t h = static_cast<std::uint64_t>( reinterpret_cast<std::uintptr_t>( key ) );
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      return static_cast<std::size_t>( h );
+    }
+
+    // Slot holding key, or the empty slot where it would be inserted
+    std::size_t probe( isl_id* key ) const {
+      std::size_t pos = hash( key ) & this->mask();
+      while( this->slots[pos].key != NULL && this->slots[pos].key != key ){
+        pos = (pos + 1) & this->mask();
+      }
+      return pos;
+    }
+
+    void grow(){
+      std::vector<slot> old( this->slots.size() * 2, slot{ NULL, V() } );
+      old.swap( this->slots );
+      this->count = 0;
+      for( typename std::vector<slot>::iterator it = old.begin(); it != old.end(); ++it ){
+        if( it->key != NULL ){
+          (*this)[ it->key ] = it->value;
+        }
+      }
+    }
+
+  public:
+    // capacity is rounded up to a power of two
+    explicit isl_id_map( std::size_t capacity = 16 ): slots(), count( 0 ) {
+      std::size_t size = 4;
+      while( size < capacity ){
+        size *= 2;
+      }
+      this->slots.assign( size, slot{ NULL, V() } );
+    }
+
+    std::size_t size() const {
+      return this->count;
+    }
+
+    bool empty() const {
+      return this->count == 0;
+    }
+
+    // Value stored for key, or NULL
+    V* find( isl_id* key ){
+      slot& s = this->slots[ this->probe( key ) ];
+      return s.key == NULL ? NULL : &s.value;
+    }
+
+    // Value stored for key, default-inserted if absent
+    V& operator[]( isl_id* key ){
+      std::size_t pos = this->probe( key );
+      if( this->slots[pos].key == NULL ){
+        // Keep load factor at most 1/2
+        if( (this->count + 1) * 2 > this->slots.size() ){
+          this->grow();
+          pos = this->probe( key );
+        }
+        this->slots[pos].key = key;
+        this->slots[pos].value = V();
+        this->count += 1;
+      }
+      return this->slots[pos].value;
+    }
+
+    // Remove key, returns whether it was present
+    bool erase( isl_id* key ){
+      std::size_t pos = this->probe( key );
+      if( this->slots[pos].key == NULL ){
+        return false;
+      }
+
+      // Shift following entries of the run back over the hole so that every
+      // entry stays reachable from its home slot
+      std::size_t hole = pos;
+      std::size_t next = (hole + 1) & this->mask();
+      while( this->slots[next].key != NULL ){
+        std::size_t home = hash( this->slots[next].key ) & this->mask();
+        // Entry may move into the hole unless its home lies cyclically in (hole, next]
+        bool stays = (hole <= next) ? (hole < home && home <= next)
+                                    : (hole < home || home <= next);
+        if( !stays ){
+          this->slots[hole] = this->slots[next];
+          hole = next;
+        }
+        next = (next + 1) & this->mask();
+      }
+      this->slots[hole].key = NULL;
+      this->slots[hole].value = V();
+      this->count -= 1;
+      return true;
+    }
+
+    // Remove every entry, keeping the slot array
+    void clear(){
+      if( this->count != 0 ){
+        this->slots.assign( this->slots.size(), slot{ NULL, V() } );
+        this->count = 0;
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,99 @@
+/*! ****************************************************************************
+\file loop_builder.hpp
+
+\brief
+Builds the SgForStatement of an isl for node from its translated parts.
+
+By default loops keep isl's form:
+  for( int c = init; cond; c = c + (inc) )
+With canonical loops they take the form vectorizers recognize:
+  - the condition is one comparison of the iterator against a bound that
+    does not depend on it: isl's ge and gt are turned around, and a
+    conjunction of upper bounds becomes c <= min( ... )
+  - the increment is ++c for a stride of 1, and c += inc otherwise
+  - a literal stride s > 1 with such a condition is normalized to a unit
+    stride counter, the iterator being recomputed at the top of the body:
+      for( int c_n = 0; c_n <= floord( bound - init, s ); ++c_n ){
+        int c = init + s * c_n;
+        ...
+      }
+    (for c < bound, bound - 1 is used)
+A condition that cannot be put in that form is kept as it is, and its loop is
+not normalized. min and floord are built by the arith_builder given.
+
+With hoisting, the invariant parts of each condition are moved into const
+locals declared before the loop, in the block it is built in, by an
+invariant_hoister (see invariant_hoister.hpp), typed with the width_analysis
+given to set_widths(). The scopes the loops are built in must then be
+reported to close_scope() as they are closed.
+
+With an unroll limit, a loop whose init, bound and stride are constant and
+which runs at most that many iterations is built in isl's form, and replaced
+by unroll() once its body is set: by a block of copies of the body, the
+iterator replaced in each by its value, or by the body itself for a single
+iteration.
+*******************************************************************************/
+
+#ifndef LOOP_BUILDER_HPP
+#define LOOP_BUILDER_HPP
+
+#include <unordered_map>
+#include "arith_builder.hpp"
+#include "invariant_hoister.hpp"
+#include "rose.h"
+
+class loop_builder {
+  protected:
+    arith_builder& arith;
+    bool canonical;
+    bool hoist;
+    unsigned unroll_limit;
+    invariant_hoister hoister;
+    const width_analysis* widths;
+
+    // Iterations of a loop to be unrolled
+    struct unrolling {
+      SgVariableSymbol* iterator;
+      long long first;
+      long long step;
+      long long count;
+    };
+    std::unordered_map<SgForStatement*, unrolling> unrollings;
+
+    // Inclusive upper bound of iterator if cond compares it to one, else NULL;
+    // cond is left as it is in that case, and used up otherwise
+    SgExpression* upper_bound( SgExpression* cond, SgVariableSymbol* iterator );
+
+  public:
+    loop_builder( arith_builder& arith, bool canonical, bool hoist, unsigned unroll_limit );
+
+    // Widths of the translation the loops are built for, or NULL
+    void set_widths( const width_analysis* widths );
+
+    // Loop over the iterator declared, with its initializer, by iterator.
+    // cond and inc were built referencing its symbol. The body is an empty
+    // block, or holds the recomputed iterator of a normalized loop; either
+    // way the loop's statements go in with set_body.
+    SgForStatement* build( SgVariableDeclaration* iterator, SgExpression* cond, SgExpression* inc, SgScopeStatement* scope );
+
+    // Makes statement the body of loop, or appends it to what the body
+    // already holds; a block's statements are moved rather than nested
+    static void set_body( SgForStatement* loop, SgStatement* statement );
+
+    // Whether loop, built by build(), is to be unrolled
+    bool unrolls( SgForStatement* loop ) const;
+    // The statement replacing loop, whose body is set: loop itself unless it
+    // is to be unrolled
+    SgStatement* unroll( SgForStatement* loop );
+
+    // Block of loop after a #pragma omp parallel for, whose private clause
+    // lists the variables loop assigns that are declared outside it
+    static SgStatement* parallelize( SgForStatement* loop );
+
+    // Forgets the locals hoisted into scope, which is being closed
+    void close_scope( SgScopeStatement* scope );
+    // Forgets every local hoisted, at the end of a translation
+    void clear();
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*! ****************************************************************************
+\file mark_registry.hpp
+
+\brief
+Translates the mark nodes of an ISL AST into Sage-level actions.
+
+A mark node is how a schedule tree annotates a band: isl passes the mark's id
+through to the AST, above the code generated for what it marks. The name of
+the id selects an action, and whatever follows its first ':' is the action's
+argument, e.g. "unroll:4". The action is given the statement built for the
+marked node and returns the statement to put in its place.
+
+The default registry knows
+  simd       #pragma omp simd
+  parallel   #pragma omp parallel for
+  unroll:N   #pragma GCC unroll N
+  ivdep      #pragma GCC ivdep
+each put right before the outermost loop of the marked statement. An OpenMP
+loop directive must come right before its loop, with no other pragma next to
+it, so a loop walker_options::omp_parallel already put one before keeps it
+alone: a parallel mark adds nothing, simd makes it omp parallel for simd, and
+the other pragmas are not put. Marks with no action registered are dropped,
+leaving the marked statement as it is.
+Other actions, a user hook working on the marked subtree for instance, are
+added with set().
+*******************************************************************************/
+
+#ifndef MARK_REGISTRY_HPP
+#define MARK_REGISTRY_HPP
+
+#include <functional>
+#include <map>
+#include <string>
+#include "rose.h"
+
+// Statement to put in place of marked, given the mark's argument
+typedef std::function<SgStatement*( SgStatement* marked, const std::string& argument )> mark_action;
+
+class mark_registry {
+  protected:
+    std::map<std::string, mark_action> actions;
+
+  public:
+    // With the default actions
+    mark_registry();
+
+    // Registers action for the marks named name, replacing any other
+    void set( const std::string& name, const mark_action& action );
+    void remove( const std::string& name );
+
+    // marked after the action registered for mark
+    SgStatement* apply( const std::string& mark, SgStatement* marked ) const;
+
+    // Action putting #pragma text, followed by the argument if any, before
+    // the outermost loop of the marked statement, unless an OpenMP loop
+    // directive is there already
+    static mark_action pragma( const std::string& text );
+
+    // Registry used when walker_options::marks is NULL
+    static const mark_registry& defaults();
+};
+
+#endif
@@ -0,0 +1,52 @@
+/*! ****************************************************************************
+\file parallel_loops.hpp
+
+\brief
+Annotates the for nodes of an ISL AST whose iterations can run in parallel.
+
+isl does not know the dependences of the statements it generates code for,
+so the user gives them: a union map from each statement instance to the
+instances that must run after it. parallel_loops::annotate() sets a
+before_each_for callback on an isl_ast_build which gives every for node it
+generates an annotation, an isl_id named "parallel" or "serial". A loop is
+parallel when no dependence between two of its iterations is left that the
+loops enclosing it do not already carry: the distance of every dependence,
+under the schedule of the loops down to this one, is 0 in this loop's
+dimension wherever it is 0 in all the outer ones.
+
+With walker_options::omp_parallel, the outermost loop of each nest annotated
+parallel gets a #pragma omp parallel for (see loop_builder::parallelize).
+*******************************************************************************/
+
+#ifndef PARALLEL_LOOPS_HPP
+#define PARALLEL_LOOPS_HPP
+
+#include "all_isl.hpp"
+
+class parallel_loops {
+  protected:
+    isl_union_map* dependences;
+
+    static isl_id* before_each_for( isl_ast_build* build, void* user );
+    // Whether the innermost dimension of build's schedule carries none of
+    // the dependences
+    bool parallel( isl_ast_build* build );
+
+  public:
+    // Takes dependences
+    explicit parallel_loops( isl_union_map* dependences );
+    ~parallel_loops();
+
+    // Makes build annotate its loops; this must outlive the AST generation
+    isl_ast_build* annotate( isl_ast_build* build );
+
+    // Whether annotation, or node's annotation, marks a loop parallel
+    static bool is_parallel( isl_id* annotation );
+    static bool is_parallel( isl_ast_node* node );
+
+  private:
+    parallel_loops( const parallel_loops& );
+    parallel_loops& operator=( const parallel_loops& );
+};
+
+#endif
@@ -0,0 +1,110 @@
+/*! ****************************************************************************
+\file phase_profiler.hpp
+
+\brief
+Coarse, pipeline level profiling: where the wall clock time of a run goes
+between ROSE's frontend, schedule construction, isl codegen, the walker,
+unparsing and so on.
+
+A phase is opened and closed by a phase_scope; phases nest. For each phase the
+profiler records its wall time, the process CPU time and the change in
+resident set size. The library marks its own phases
+(SageTransformationWalker::translate, isl_ast_serialize, ...), and callers
+mark theirs the same way:
+
+  phase_profiler::global().start();
+  {
+    phase_scope phase( "frontend" );
+    project = frontend( argv );
+  }
+  phase_profiler::global().write_chrome_trace( "phases.json" );
+
+Nothing is recorded until start() is called, so library markers cost one test
+of a flag when profiling is off. Phases are meant to be coarse: opening one
+reads the clocks and /proc/self/statm.
+
+The Chrome trace (chrome://tracing, Perfetto) has one complete event per phase
+with its CPU time and RSS change as arguments, and an RSS counter track.
+*******************************************************************************/
+
+#ifndef PHASE_PROFILER_HPP
+#define PHASE_PROFILER_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class phase_record {
+  public:
+    std::string name;
+    // Phases open around this one
+    int depth;
+    // Nanoseconds since the profiler was created
+    std::uint64_t start_ns;
+    std::uint64_t wall_ns;
+    std::uint64_t cpu_ns;
+    // Resident set size when the phase was opened and closed, in KiB
+    long rss_start_kb;
+    long rss_end_kb;
+};
+
+class phase_profiler {
+  protected:
+    bool active;
+    std::uint64_t origin;
+    // Closed and open phases, in the order they were opened
+    std::vector<phase_record> records;
+    // Index in records of every open phase, innermost last
+    std::vector<std::vector<phase_record>::size_type> open;
+    // CPU time each open phase started at
+    std::vector<std::uint64_t> open_cpu;
+
+  public:
+    phase_profiler();
+
+    // Profiler the library's own phase markers report to
+    static phase_profiler& global();
+
+    // Phases are only recorded between start() and stop()
+    void start();
+    void stop();
+    bool enabled() const { return this->active; }
+    // Forget every recorded phase; must not be called with phases open
+    void clear();
+
+    // Opens a phase; returns false, and records nothing, if not started
+    bool begin( const char* name );
+    // Closes the innermost open phase
+    void end();
+
+    const std::vector<phase_record>& phases() const;
+
+    // Chrome trace JSON of every closed phase. Returns false if the output
+    // could not be written.
+    bool write_chrome_trace( std::ostream& out ) const;
+    bool write_chrome_trace( const std::string& path ) const;
+    // Indented table of closed phases: wall, CPU, RSS change
+    void write_summary( std::ostream& out ) const;
+
+    // Current resident set size of the process in KiB, 0 if unknown
+    static long resident_kb();
+    // CPU time used by the process so far
+    static std::uint64_t cpu_ns();
+};
+
+// Phase open for the lifetime of the scope
+class phase_scope {
+  protected:
+    phase_profiler* profiler;
+
+  public:
+    explicit phase_scope( const char* name, phase_profiler& profiler = phase_profiler::global() );
+    ~phase_scope();
+
+  private:
+    phase_scope( const phase_scope& );
+    phase_scope& operator=( const phase_scope& );
+};
+
+#endif
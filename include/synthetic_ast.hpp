@@ -0,0 +1,52 @@
+/*! ****************************************************************************
+\file synthetic_ast.hpp
+
+\brief
+Generates ISL domains and schedules of a chosen shape, and the ISL ASTs built
+from them, for benchmarks and stress tests.
+
+Every statement S<k> is a loop nest over i0 ... i<nest_depth - 1>:
+  - each iterator is bounded below by fan_in parameters L<j>_<d> and above by
+    fan_in parameters U<j>_<d>, which isl turns into max( ... ) and min( ... )
+    bounds once fan_in > 1. Without parametric bounds the first lower and
+    upper bound are the constants 0 and constant_bound instead.
+  - odd statements only execute when the innermost iterator is a multiple of
+    modulo (when modulo > 1), giving strided loops or guards.
+  - the schedule runs statements one nest after another, or fused into one
+    nest; with tile_size > 0 every dimension is tiled by tile_size.
+*******************************************************************************/
+
+#ifndef SYNTHETIC_AST_HPP
+#define SYNTHETIC_AST_HPP
+
+#include <string>
+#include <vector>
+#include "all_isl.hpp"
+
+class synthetic_options {
+  public:
+    int nest_depth;
+    int statements;
+    int fan_in;
+    int modulo;
+    int tile_size;
+    bool fused;
+    bool parametric;
+    int constant_bound;
+
+    // A 2 deep nest of one statement with parametric bounds
+    synthetic_options();
+};
+
+// ISL domain and schedule strings of the shape
+std::string synthetic_domain( const synthetic_options& options );
+std::string synthetic_schedule( const synthetic_options& options );
+
+// Parameters the domain is bounded by, which must be in scope when the AST is
+// translated
+std::vector<std::string> synthetic_parameters( const synthetic_options& options );
+
+// Builds the AST of the shape with isl_ast_build_node_from_schedule_map
+isl_ast_node* synthetic_ast( isl_ctx* ctx, const synthetic_options& options );
+
+#endif
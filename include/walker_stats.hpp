@@ -0,0 +1,148 @@
+/*! ****************************************************************************
+\file walker_stats.hpp
+
+\brief
+Per visit method counters for SageTransformationWalker.
+
+With walker_options::collect_stats set, the walker brackets every visit_node_*,
+visit_expr_* and visit_op_* call with enter() and leave(), in the recursive and
+the iterative drivers alike. For each method walker_stats keeps:
+  calls         number of calls
+  inclusive_ns  time spent in the calls, including the visits they made
+  exclusive_ns  inclusive time less the time of nested visits
+  sage_nodes    Sage nodes reachable from the node returned that are not part
+                of a node returned by a nested visit, i.e. those the method
+                built itself
+along with how many identifier references the walker's symbol cache answered
+(hits) and how many symbols were looked up in the enclosing scopes (misses),
+and, with walker_options::memoize_exprs, how many expressions were copied from
+an earlier translation (memo hits) and how many were translated (memo misses).
+The symbol and memo counts are kept whether or not collect_stats is set.
+
+Counting sage_nodes walks the nodes each visit built, so collecting stats
+slows the translation down; leave collect_stats off when timing it.
+*******************************************************************************/
+
+#ifndef WALKER_STATS_HPP
+#define WALKER_STATS_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "all_isl.hpp"
+#include "rose.h"
+
+enum visit_method {
+  stats_node_for,
+  stats_node_if,
+  stats_node_block,
+  stats_node_mark,
+  stats_node_user,
+  stats_node_error,
+  stats_node_unknown,
+
+  stats_expr_id,
+  stats_expr_int,
+  stats_expr_error,
+  stats_expr_unknown,
+
+  stats_op_and,
+  stats_op_and_then,
+  stats_op_or,
+  stats_op_or_else,
+  stats_op_max,
+  stats_op_min,
+  stats_op_minus,
+  stats_op_add,
+  stats_op_sub,
+  stats_op_mul,
+  stats_op_div,
+  stats_op_fdiv_q,
+  stats_op_pdiv_q,
+  stats_op_pdiv_r,
+  stats_op_zdiv_r,
+  stats_op_cond,
+  stats_op_select,
+  stats_op_eq,
+  stats_op_le,
+  stats_op_lt,
+  stats_op_ge,
+  stats_op_gt,
+  stats_op_call,
+  stats_op_access,
+  stats_op_member,
+  stats_op_address_of,
+  stats_op_error,
+  stats_op_unknown,
+
+  visit_methods
+};
+
+class visit_counter {
+  public:
+    unsigned long calls;
+    std::uint64_t inclusive_ns;
+    std::uint64_t exclusive_ns;
+    unsigned long sage_nodes;
+
+    visit_counter();
+};
+
+class walker_stats {
+  protected:
+    // One per visit in progress
+    struct frame {
+      visit_method method;
+      std::uint64_t start;
+      std::uint64_t nested_ns;
+      // Start of this visit's nested results in nested_results
+      std::vector<SgNode*>::size_type results_base;
+    };
+
+    std::vector<frame> frames;
+    // Nodes returned by finished visits whose caller is still in progress
+    std::vector<SgNode*> nested_results;
+    std::vector<SgNode*> count_stack;
+    // The nested results count_built() stops at
+    std::unordered_set<SgNode*> count_nested;
+
+    unsigned long count_built( SgNode* result, std::vector<SgNode*>::size_type results_base );
+
+  public:
+    visit_counter counters[visit_methods];
+    unsigned long symbol_hits;
+    unsigned long symbol_misses;
+    unsigned long memo_hits;
+    unsigned long memo_misses;
+
+    walker_stats();
+
+    // Method a node or expression is dispatched to
+    static visit_method method_of( isl_ast_node* node );
+    static visit_method method_of( isl_ast_expr* expr );
+    // Name of the method, e.g. "visit_op_add"
+    static const char* name( visit_method method );
+
+    void enter( visit_method method );
+    // Ends the innermost visit, which returned result
+    void leave( SgNode* result );
+
+    // memo_hits over memo hits and misses, 0 without either
+    double memo_hit_rate() const;
+
+    // Forget every count; must not be called during a visit
+    void clear();
+
+    // Writes every method called at least once, the symbol cache and the
+    // memo counts:
+    //   {"visits":{"visit_node_for":{"calls":...,"inclusive_ns":...,
+    //     "exclusive_ns":...,"sage_nodes":...},...},
+    //    "symbol_cache":{"hits":...,"misses":...},
+    //    "expr_memo":{"hits":...,"misses":...,"hit_rate":...}}
+    void dump_json( std::ostream& out ) const;
+    std::string to_json() const;
+};
+
+#endif
@@ -0,0 +1,135 @@
+/*! ****************************************************************************
+\file walker_trace.hpp
+
+\brief
+Compile-time tracing policies for SageTransformationWalker.
+
+The walker records one event per Sage node it builds (and per symbol it binds
+or looks up) through its walker_trace member. Which policy walker_trace is
+is fixed when the library is built:
+
+  null_trace   default; every record call is an empty inline function, so
+               tracing costs nothing. Starting it (walker_options::verbose)
+               only prints a one-time note on cerr that tracing is
+               compiled out.
+  ring_trace   with ISL_SAGE_TRACE defined (make TRACE=1); events go into a
+               ring buffer preallocated when tracing starts, and are drained to a
+               file or stream in one write, as indented text or as Chrome
+               trace JSON (chrome://tracing, Perfetto).
+
+ISL_SAGE_TRACE must be the same for the library and its users, as it changes
+the walker's layout.
+*******************************************************************************/
+
+#ifndef WALKER_TRACE_HPP
+#define WALKER_TRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "all_isl.hpp"
+
+enum trace_format {
+  trace_text,
+  trace_chrome
+};
+
+class trace_event {
+  public:
+    // Static string naming the event, e.g. "for" or "Operation add"
+    const char* kind;
+    int depth;
+    // Sage node built (or symbol bound)
+    const void* sage;
+    // Integer payload, e.g. the value of an integer literal
+    long value;
+    bool has_value;
+    // Nanoseconds since the trace was created
+    std::uint64_t time;
+    // Symbol or identifier name, truncated
+    char detail[24];
+};
+
+class null_trace {
+  public:
+    static const bool enabled = false;
+
+    explicit null_trace( std::size_t capacity = 0 ){}
+
+    // Nothing is traced; notes on cerr, once per process, that tracing
+    // needs make TRACE=1
+    void start();
+    void stop(){}
+    void clear(){}
+
+    void record( const char* kind, int depth, const void* sage ){}
+    void record_value( const char* kind, int depth, const void* sage, long value ){}
+    void record_id( const char* kind, int depth, const void* sage, isl_id* id ){}
+
+    std::size_t size() const { return 0; }
+    std::size_t dropped() const { return 0; }
+
+    bool drain( std::ostream& out, trace_format format ){ return true; }
+    bool drain( const std::string& path, trace_format format ){ return true; }
+};
+
+class ring_trace {
+  protected:
+    std::vector<trace_event> events;
+    std::size_t capacity;
+    // Next slot written, and number of valid events ending there
+    std::size_t head;
+    std::size_t count;
+    std::size_t lost;
+    bool active;
+    std::uint64_t origin;
+
+    trace_event* next( const char* kind, int depth, const void* sage );
+
+  public:
+    static const bool enabled = true;
+
+    explicit ring_trace( std::size_t capacity = 1 << 16 );
+
+    // Events are only recorded between start() and stop(); the buffer of
+    // capacity events is allocated by the first start()
+    void start();
+    void stop();
+    // Forget every recorded event
+    void clear();
+
+    void record( const char* kind, int depth, const void* sage ){
+      if( this->active ){
+        this->next( kind, depth, sage );
+      }
+    }
+
+    void record_value( const char* kind, int depth, const void* sage, long value ){
+      if( this->active ){
+        trace_event* event = this->next( kind, depth, sage );
+        event->value = value;
+        event->has_value = true;
+      }
+    }
+
+    void record_id( const char* kind, int depth, const void* sage, isl_id* id );
+
+    // Events currently held, and events overwritten since the last clear()
+    std::size_t size() const;
+    std::size_t dropped() const;
+
+    // Write every held event, oldest first, then clear. Returns false if the
+    // output could not be written.
+    bool drain( std::ostream& out, trace_format format );
+    bool drain( const std::string& path, trace_format format );
+};
+
+#ifdef ISL_SAGE_TRACE
+typedef ring_trace walker_trace;
+#else
+typedef null_trace walker_trace;
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+/*! ****************************************************************************
+\file width_analysis.hpp
+
+\brief
+Chooses the integer type of each iterator of an ISL AST from the range of
+values it and the expressions using it can take.
+
+The ranges of the parameters come from a context, an isl set over them such
+as "[N] -> { : 0 <= N <= 100000 }", which isl bounds each parameter with;
+a parameter the context leaves unbounded, or does not name, can take any
+value. The ranges of every expression of the AST are then computed as
+intervals, each loop's iterator ranging from the least value of its init to
+the greatest its condition allows.
+
+An iterator is narrow, declared int32_t, when its range and the range of
+every expression it appears in fit in 32 bits; it is wide, declared int64_t,
+otherwise, so the expressions computing with it are evaluated in 64 bits.
+Iterators are known by name: loops of the same name in sibling nests get the
+same type, the widest either needs. Arithmetic on parameters alone is left in
+the type the user declared them with.
+*******************************************************************************/
+
+#ifndef WIDTH_ANALYSIS_HPP
+#define WIDTH_ANALYSIS_HPP
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "all_isl.hpp"
+#include "rose.h"
+
+class width_analysis {
+  protected:
+    // Inclusive bounds; LLONG_MIN and LLONG_MAX stand for no bound
+    struct interval {
+      long long low;
+      long long high;
+    };
+
+    std::map<std::string, interval> parameters;
+    std::map<std::string, interval> iterators;
+    std::set<std::string> wide_iterators;
+
+    void bound_parameters( isl_set* context );
+    // Range of expr; iterators in the arithmetic of expr that leaves 32 bits
+    // are made wide
+    interval evaluate( isl_ast_expr* expr );
+    // Greatest value cond lets iterator take
+    long long upper_bound( isl_ast_expr* cond, const char* iterator );
+    void widen( isl_ast_expr* expr );
+
+    static bool narrow( const interval& range );
+
+  public:
+    // context is read with root's isl_ctx; empty for no bounds on parameters
+    width_analysis( isl_ast_node* root, const std::string& context );
+
+    bool wide( const std::string& iterator ) const;
+    // int32_t or int64_t, as opaque types declared in scope
+    SgType* type( const std::string& iterator, SgScopeStatement* scope ) const;
+
+    // Type max, min and floord compute operands in, so their definitions do
+    // not truncate: int64_t when an operand uses a wide iterator or a long
+    // long literal, int otherwise or when widths is NULL. arith_builder
+    // defines them with long long for int64_t.
+    static SgType* operation_type( const width_analysis* widths, const std::vector<SgExpression*>& operands, SgScopeStatement* scope );
+};
+
+#endif
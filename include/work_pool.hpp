@@ -0,0 +1,73 @@
+/*! ****************************************************************************
+\file work_pool.hpp
+
+\brief
+Fixed set of worker threads running numbered tasks, with work stealing.
+
+run( tasks, body ) calls body( i, worker ) once for every i in [0, tasks),
+where worker is the number of the worker making the call, and returns when all
+calls have returned. Each worker starts with a contiguous share of
+the tasks in its own queue and takes them from the front; a worker whose queue
+is empty takes tasks from the back of the others'. The calling thread works
+too, as worker 0, so a pool of one thread runs everything on the caller.
+
+Which thread runs a task is not deterministic; callers that need a
+deterministic result record each task's output by task number and combine the
+outputs in task order afterwards. Per worker state, indexed by worker, needs
+no locking.
+
+Only one run() may be in progress at a time.
+*******************************************************************************/
+
+#ifndef WORK_POOL_HPP
+#define WORK_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class work_pool {
+  protected:
+    struct task_queue {
+      std::mutex lock;
+      std::deque<std::size_t> tasks;
+    };
+
+    std::vector<std::thread> threads;
+    // One per worker; the calling thread is worker 0
+    std::vector<task_queue*> queues;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(std::size_t, unsigned)>* body;
+    // Incremented by every run(), so workers can tell a new run from a spurious wakeup
+    unsigned long generation;
+    // Workers other than the caller still in the current run
+    unsigned working;
+    bool stopping;
+
+    bool take( unsigned worker, std::size_t& task );
+    void work( unsigned worker );
+    void worker_main( unsigned worker );
+
+  public:
+    // threads == 0 uses one thread per hardware thread
+    explicit work_pool( unsigned threads );
+    ~work_pool();
+
+    // Number of workers, counting the calling thread
+    unsigned size() const { return this->queues.size(); }
+
+    void run( std::size_t tasks, const std::function<void(std::size_t, unsigned)>& body );
+
+  private:
+    work_pool( const work_pool& );
+    work_pool& operator=( const work_pool& );
+};
+
+#endif
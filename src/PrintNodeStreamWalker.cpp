@@ -0,0 +1,300 @@
+#include <cstdio>
+#include <cstring>
+
+#include "PrintNodeStreamWalker.hpp"
+
+using namespace std;
+
+PrintNodeStreamWalker::PrintNodeStreamWalker( ostream& out, print_format format, bool iterative ): ISLWalker(), out( &out ), buffer( NULL ), format( format ), iterative( iterative ), entered( 0 ), indent( 64, ' ' ), has_sibling() {}
+
+PrintNodeStreamWalker::PrintNodeStreamWalker( string& buffer, print_format format, bool iterative ): ISLWalker(), out( NULL ), buffer( &buffer ), format( format ), iterative( iterative ), entered( 0 ), indent( 64, ' ' ), has_sibling() {}
+
+void PrintNodeStreamWalker::write( const char* text, size_t length ){
+  if( this->buffer != NULL ){
+    this->buffer->append( text, length );
+  } else {
+    this->out->write( text, length );
+  }
+}
+
+void PrintNodeStreamWalker::write( const char* text ){
+  this->write( text, strlen( text ) );
+}
+
+void PrintNodeStreamWalker::write( const string& text ){
+  this->write( text.data(), text.size() );
+}
+
+void PrintNodeStreamWalker::write_tab(){
+  size_t width = this->depth * 2;
+  if( width > this->indent.size() ){
+    this->indent.resize( width * 2, ' ' );
+  }
+  this->write( this->indent.data(), width );
+}
+
+void PrintNodeStreamWalker::write_json_string( const char* text ){
+  this->write( "\"", 1 );
+  const char* run = text;
+  for( const char* c = text; *c != '\0'; ++c ){
+    if( *c == '"' || *c == '\\' ){
+      this->write( run, c - run );
+      this->write( "\\", 1 );
+      run = c;
+    }
+  }
+  this->write( run );
+  this->write( "\"", 1 );
+}
+
+void PrintNodeStreamWalker::open( const char* text_label, const char* kind, const char* text_detail ){
+  this->depth += 1;
+
+  if( this->format == print_text ){
+    this->write_tab();
+    this->write( text_label );
+    if( text_detail != NULL ){
+      this->write( text_detail );
+    }
+    this->write( "\n", 1 );
+  } else {
+    if( ! this->has_sibling.empty() ){
+      if( this->has_sibling.back() ){
+        this->write( ",", 1 );
+      }
+      this->has_sibling.back() = true;
+    }
+    this->write( "{\"kind\":\"" );
+    this->write( kind );
+    this->write( "\"", 1 );
+  }
+}
+
+void PrintNodeStreamWalker::open_children(){
+  if( this->format == print_json ){
+    this->write( ",\"children\":[" );
+    this->has_sibling.push_back( false );
+  }
+}
+
+void PrintNodeStreamWalker::close( bool had_children ){
+  if( this->format == print_json ){
+    if( had_children ){
+      this->write( "]", 1 );
+      this->has_sibling.pop_back();
+    }
+    this->write( "}", 1 );
+    // Root is done
+    if( this->depth == 0 ){
+      this->write( "\n", 1 );
+    }
+  }
+
+  this->depth -= 1;
+}
+
+void PrintNodeStreamWalker::open_op( isl_ast_expr* node, const char* name ){
+  this->open( "Operation ", "op", name );
+
+  if( this->format == print_json ){
+    this->write( ",\"op\":\"" );
+    this->write( name );
+    this->write( "\"", 1 );
+  }
+
+  this->open_children();
+}
+
+void PrintNodeStreamWalker::open_id( isl_ast_expr* node ){
+  isl_id_handle isl_ident( isl_ast_expr_get_id(node) );
+  const char* name = isl_id_get_name( isl_ident.get() );
+
+  this->open( "Expression id: ", "id", name );
+  if( this->format == print_json ){
+    this->write( ",\"name\":" );
+    this->write_json_string( name );
+  }
+}
+
+void PrintNodeStreamWalker::open_int( isl_ast_expr* node ){
+  isl_val_handle isl_value( isl_ast_expr_get_val( node ) );
+  long value = isl_val_get_num_si( isl_value.get() );
+  long den = isl_val_get_den_si( isl_value.get() );
+
+  char text[64];
+  if( this->format == print_text ){
+    snprintf( text, sizeof(text), "%ld / %ld", value, den );
+    this->open( "Expression int: ", "int", text );
+  } else {
+    this->open( NULL, "int" );
+    snprintf( text, sizeof(text), ",\"value\":%ld,\"den\":%ld", value, den );
+    this->write( text );
+  }
+}
+
+void PrintNodeStreamWalker::open_mark( isl_ast_node* node ){
+  this->open( "Node mark", "mark" );
+
+  if( this->format == print_json ){
+    isl_id_handle mark( isl_ast_node_mark_get_id( node ) );
+    this->write( ",\"name\":" );
+    this->write_json_string( isl_id_get_name( mark.get() ) );
+  }
+}
+
+int PrintNodeStreamWalker::visit( isl_ast_node* node ){
+  if( ! this->iterative ){
+    return ISLWalker::visit( node );
+  }
+  int before = this->entered;
+  this->traverse( node );
+  return this->entered - before;
+}
+
+int PrintNodeStreamWalker::visit( isl_ast_expr* node ){
+  if( ! this->iterative ){
+    return ISLWalker::visit( node );
+  }
+  int before = this->entered;
+  this->traverse( node );
+  return this->entered - before;
+}
+
+bool PrintNodeStreamWalker::enter( isl_ast_node* node ){
+  this->entered += 1;
+  switch( isl_ast_node_get_type(node) ){
+    case isl_ast_node_for: this->open( "Node for", "for" ); break;
+    case isl_ast_node_if: this->open( "Node if", "if" ); break;
+    case isl_ast_node_block: this->open( "Node Block", "block" ); break;
+    case isl_ast_node_mark: this->open_mark( node ); break;
+    case isl_ast_node_user: this->open( "Node user", "user" ); break;
+    case isl_ast_node_error: this->open( "Node error", "error" ); return true;
+    default: this->open( "Node unknown", "unknown" ); return true;
+  }
+  this->open_children();
+  return true;
+}
+
+bool PrintNodeStreamWalker::enter( isl_ast_expr* node ){
+  this->entered += 1;
+  switch( isl_ast_expr_get_type(node) ){
+    case isl_ast_expr_op: this->open_op( node, op_name( isl_ast_expr_get_op_type(node) ) ); break;
+    case isl_ast_expr_id: this->open_id( node ); break;
+    case isl_ast_expr_int: this->open_int( node ); break;
+    case isl_ast_expr_error: this->open( "Expression error", "error" ); break;
+    default: this->open( "Expression unknown", "unknown" ); break;
+  }
+  return true;
+}
+
+void PrintNodeStreamWalker::leave( isl_ast_node* node ){
+  switch( isl_ast_node_get_type(node) ){
+    case isl_ast_node_for:
+    case isl_ast_node_if:
+    case isl_ast_node_block:
+    case isl_ast_node_mark:
+    case isl_ast_node_user:
+      this->close( true );
+      break;
+
+    default:
+      this->close( false );
+      break;
+  }
+}
+
+void PrintNodeStreamWalker::leave( isl_ast_expr* node ){
+  this->close( isl_ast_expr_get_type(node) == isl_ast_expr_op );
+}
+
+int PrintNodeStreamWalker::visit_op_named( isl_ast_expr* node, const char* name ){
+  this->open_op( node, name );
+
+  int count = 1;
+  for( int i = 0; i < isl_ast_expr_get_op_n_arg(node); i += 1 ){
+    count += this->visit_op_operand( node, i );
+  }
+  this->close( true );
+
+  return count;
+}
+
+int PrintNodeStreamWalker::visit_leaf_node( isl_ast_node* node, const char* text_label, const char* kind ){
+  this->open( text_label, kind );
+  this->close( false );
+  return 1;
+}
+
+int PrintNodeStreamWalker::visit_leaf_expr( isl_ast_expr* node, const char* text_label, const char* kind ){
+  this->open( text_label, kind );
+  this->close( false );
+  return 1;
+}
+
+int PrintNodeStreamWalker::visit_expr_id( isl_ast_expr* node ){
+  this->open_id( node );
+  this->close( false );
+  return 1;
+}
+
+int PrintNodeStreamWalker::visit_expr_int( isl_ast_expr* node ){
+  this->open_int( node );
+  this->close( false );
+  return 1;
+}
+
+int PrintNodeStreamWalker::visit_node_for( isl_ast_node* node ){
+  this->enter( node );
+
+  int count = 1;
+  count += this->visit( isl_ast_expr_handle( isl_ast_node_for_get_iterator( node ) ).get() );
+  count += this->visit( isl_ast_expr_handle( isl_ast_node_for_get_init( node ) ).get() );
+  count += this->visit( isl_ast_expr_handle( isl_ast_node_for_get_cond( node ) ).get() );
+  count += this->visit( isl_ast_expr_handle( isl_ast_node_for_get_inc( node ) ).get() );
+  count += this->visit( isl_ast_node_handle( isl_ast_node_for_get_body( node ) ).get() );
+
+  this->leave( node );
+  return count;
+}
+
+int PrintNodeStreamWalker::visit_node_if( isl_ast_node* node ){
+  this->enter( node );
+
+  int count = 1;
+  count += this->visit( isl_ast_expr_handle( isl_ast_node_if_get_cond(node) ).get() );
+  count += this->visit( isl_ast_node_handle( isl_ast_node_if_get_then(node) ).get() );
+  if( isl_ast_node_if_has_else( node ) ){
+    count += this->visit( isl_ast_node_handle( isl_ast_node_if_get_else(node) ).get() );
+  }
+
+  this->leave( node );
+  return count;
+}
+
+int PrintNodeStreamWalker::visit_node_block( isl_ast_node* node ){
+  this->enter( node );
+
+  int count = 1;
+  isl_ast_node_list_handle list( isl_ast_node_block_get_children(node) );
+  for( int i = 0; i < isl_ast_node_list_n_ast_node(list.get()); i += 1 ){
+    isl_ast_node_handle child( isl_ast_node_list_get_ast_node(list.get(), i) );
+    count += this->visit( child.get() );
+  }
+
+  this->leave( node );
+  return count;
+}
+
+int PrintNodeStreamWalker::visit_node_mark( isl_ast_node* node ){
+  this->enter( node );
+  int count = 1 + this->visit( isl_ast_node_handle( isl_ast_node_mark_get_node( node ) ).get() );
+  this->leave( node );
+  return count;
+}
+
+int PrintNodeStreamWalker::visit_node_user( isl_ast_node* node ){
+  this->enter( node );
+  int count = 1 + this->visit( isl_ast_expr_handle( isl_ast_node_user_get_expr(node) ).get() );
+  this->leave( node );
+  return count;
+}
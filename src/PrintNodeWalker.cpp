@@ -8,175 +8,94 @@
 
 using namespace std;
 
-PrintNodeWalker::PrintNodeWalker(): depth(-1){}
+PrintNodeWalker::PrintNodeWalker( bool iterative ): ISLWalker(), iterative( iterative ), output() {}
 
 string PrintNodeWalker::getTab(){
   return string(this->depth*2, ' ');
 }
 
-string PrintNodeWalker::visit( isl_ast_expr* node ){
-  switch( isl_ast_expr_get_type(node) ){
-    case isl_ast_expr_error:
-      return this->visit_expr_error( node );
-
-    case isl_ast_expr_op:
-      return this->visit_expr_op( node );
-
-    case isl_ast_expr_id:
-      return this->visit_expr_id( node );
-
-    case isl_ast_expr_int:
-      return this->visit_expr_int( node );
+string PrintNodeWalker::visit( isl_ast_node* node ){
+  if( ! this->iterative ){
+    return ISLWalker::visit( node );
+  }
+  this->traverse( node );
+  string result;
+  result.swap( this->output );
+  return result;
+}
 
-    default:
-      return this->visit_expr_unknown( node );
+string PrintNodeWalker::visit( isl_ast_expr* node ){
+  if( ! this->iterative ){
+    return ISLWalker::visit( node );
   }
+  this->traverse( node );
+  string result;
+  result.swap( this->output );
+  return result;
 }
 
-string PrintNodeWalker::visit( isl_ast_node* node ){
+// The same lines as the visit_node_* methods
+bool PrintNodeWalker::enter( isl_ast_node* node ){
+  this->depth += 1;
+  this->output += this->getTab();
   switch( isl_ast_node_get_type(node) ){
-    case isl_ast_node_error:
-      return this->visit_node_error( node );
-
-    case isl_ast_node_for:
-      return this->visit_node_for( node );
-
-    case isl_ast_node_if:
-      return this->visit_node_if( node );
-
-    case isl_ast_node_block:
-      return this->visit_node_block( node );
-
-    case isl_ast_node_mark:
-      return this->visit_node_mark( node );
-
-    case isl_ast_node_user:
-      return this->visit_node_user( node );
-
-    default:
-      return this->visit_node_unknown( node );
+    case isl_ast_node_error: this->output += "Node error\n"; break;
+    case isl_ast_node_for: this->output += "Node for\n"; break;
+    case isl_ast_node_if: this->output += "Node if\n"; break;
+    case isl_ast_node_block: this->output += "Node Block\n"; break;
+    // The marked node is not printed
+    case isl_ast_node_mark: this->output += "Node mark\n"; return false;
+    case isl_ast_node_user: this->output += "Node user\n"; break;
+    default: this->output += "Node unknown\n"; break;
   }
+  return true;
 }
 
-string PrintNodeWalker::visit_expr_op(isl_ast_expr* node){
-  switch( isl_ast_expr_get_op_type(node) ){
-    case isl_ast_op_error:
-      return this->visit_op_error( node );
-
-    case isl_ast_op_and:
-      return this->visit_op_and( node );
-
-    case isl_ast_op_and_then:
-      return this->visit_op_and_then( node );
-
-    case isl_ast_op_or:
-      return this->visit_op_or( node );
-
-    case isl_ast_op_or_else:
-      return this->visit_op_or_else( node );
-
-    case isl_ast_op_max:
-      return this->visit_op_max( node );
-
-    case isl_ast_op_min:
-      return this->visit_op_min( node );
-
-    case isl_ast_op_minus:
-      return this->visit_op_minus( node );
-
-    case isl_ast_op_add:
-      return this->visit_op_add( node );
-
-    case isl_ast_op_sub:
-      return this->visit_op_sub( node );
-
-    case isl_ast_op_mul:
-      return this->visit_op_mul( node );
-
-    case isl_ast_op_div:
-      return this->visit_op_div( node );
-
-    case isl_ast_op_fdiv_q:
-      return this->visit_op_fdiv_q( node );
-
-    case isl_ast_op_pdiv_q:
-      return this->visit_op_pdiv_q( node );
-
-    case isl_ast_op_pdiv_r:
-      return this->visit_op_pdiv_r( node );
-
-    case isl_ast_op_zdiv_r:
-      return this->visit_op_zdiv_r( node );
-
-    case isl_ast_op_cond:
-      return this->visit_op_cond( node );
-
-    case isl_ast_op_select:
-      return this->visit_op_select( node );
-
-    case isl_ast_op_eq:
-      return this->visit_op_eq( node );
-
-    case isl_ast_op_le:
-      return this->visit_op_le( node );
-
-    case isl_ast_op_lt:
-      return this->visit_op_lt( node );
-
-    case isl_ast_op_ge:
-      return this->visit_op_ge( node );
-
-    case isl_ast_op_gt:
-      return this->visit_op_gt( node );
-
-    case isl_ast_op_call:
-      return this->visit_op_call( node );
-
-    case isl_ast_op_access:
-      return this->visit_op_access( node );
-
-    case isl_ast_op_member:
-      return this->visit_op_member( node );
+// The same lines as the visit_expr_* and visit_op_* methods
+bool PrintNodeWalker::enter( isl_ast_expr* node ){
+  this->depth += 1;
+  this->output += this->getTab();
+  switch( isl_ast_expr_get_type(node) ){
+    case isl_ast_expr_error:
+      this->output += "Expression error\n";
+      break;
 
-    case isl_ast_op_address_of:
-      return this->visit_op_address_of( node );
+    case isl_ast_expr_op:
+      this->output += string( "Operation " ) + op_name( isl_ast_expr_get_op_type(node) ) + "\n";
+      break;
+
+    case isl_ast_expr_id: {
+      isl_id_handle isl_ident( isl_ast_expr_get_id(node) );
+      this->output += string( "Expression id: " ) + isl_id_get_name( isl_ident.get() ) + "\n";
+      break;
+    }
+
+    case isl_ast_expr_int: {
+      isl_val_handle isl_value( isl_ast_expr_get_val( node ) );
+      this->output += string( "Expression int: " ) + to_string( isl_val_get_num_si( isl_value.get() ) ) + " / "
+                      + to_string( isl_val_get_den_si( isl_value.get() ) ) + "\n";
+      break;
+    }
 
     default:
-      return this->visit_op_unknown( node );
+      this->output += "Expression unknown\n";
+      break;
   }
+  return true;
 }
 
-list<string> PrintNodeWalker::visit_expr_operands(isl_ast_expr* node ){
-  list<string> operands_list;
-
-  for( int i = 0; i < isl_ast_expr_get_op_n_arg(node); i += 1 ){
-    operands_list.push_back( this->visit_op_operand( node, i ) );
-  }
-
-  return operands_list;
-}
-
-string PrintNodeWalker::visit_op_operand( isl_ast_expr* node, int pos ){
-  assert( isl_ast_expr_get_op_n_arg(node) > pos );
-  return this->visit( isl_ast_expr_get_op_arg( node, pos ) );
-}
-
-string PrintNodeWalker::visit_op_lhs( isl_ast_expr* node ){
-  return visit_op_operand(node, 0);
-}
-
-string PrintNodeWalker::visit_op_rhs( isl_ast_expr* node ){
-  return visit_op_operand(node, 1);
+void PrintNodeWalker::leave( isl_ast_node* node ){
+  this->depth -= 1;
 }
 
-string PrintNodeWalker::visit_op_unary_operand( isl_ast_expr* node ){
-  return visit_op_operand(node, 0);
+void PrintNodeWalker::leave( isl_ast_expr* node ){
+  this->depth -= 1;
 }
 
 string PrintNodeWalker::visit_op_error(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation error\n")+ string_stream.str();
   this->depth -= 1;
@@ -186,7 +105,7 @@ string PrintNodeWalker::visit_op_error(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_and(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation and\n")+ string_stream.str();
   this->depth -= 1;
@@ -196,7 +115,7 @@ string PrintNodeWalker::visit_op_and(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_and_then(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation and_then\n")+ string_stream.str();
   this->depth -= 1;
@@ -206,7 +125,7 @@ string PrintNodeWalker::visit_op_and_then(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_or(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation or\n")+ string_stream.str();
   this->depth -= 1;
@@ -216,7 +135,7 @@ string PrintNodeWalker::visit_op_or(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_or_else(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation or_else\n")+ string_stream.str();
   this->depth -= 1;
@@ -226,7 +145,7 @@ string PrintNodeWalker::visit_op_or_else(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_max(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation max\n")+ string_stream.str();
   this->depth -= 1;
@@ -236,7 +155,7 @@ string PrintNodeWalker::visit_op_max(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_min(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation min\n")+ string_stream.str();
   this->depth -= 1;
@@ -246,7 +165,7 @@ string PrintNodeWalker::visit_op_min(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_minus(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation minus\n")+ string_stream.str();
   this->depth -= 1;
@@ -256,7 +175,7 @@ string PrintNodeWalker::visit_op_minus(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_add(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation add\n")+ string_stream.str();
   this->depth -= 1;
@@ -266,7 +185,7 @@ string PrintNodeWalker::visit_op_add(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_sub(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation sub\n")+ string_stream.str();
   this->depth -= 1;
@@ -276,7 +195,7 @@ string PrintNodeWalker::visit_op_sub(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_mul(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation mul\n")+ string_stream.str();
   this->depth -= 1;
@@ -286,7 +205,7 @@ string PrintNodeWalker::visit_op_mul(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_div(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation div\n")+ string_stream.str();
   this->depth -= 1;
@@ -296,7 +215,7 @@ string PrintNodeWalker::visit_op_div(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_fdiv_q(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation fdiv_q\n")+ string_stream.str();
   this->depth -= 1;
@@ -306,7 +225,7 @@ string PrintNodeWalker::visit_op_fdiv_q(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_pdiv_q(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation pdiv_q\n")+ string_stream.str();
   this->depth -= 1;
@@ -316,7 +235,7 @@ string PrintNodeWalker::visit_op_pdiv_q(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_pdiv_r(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation pdiv_r\n")+ string_stream.str();
   this->depth -= 1;
@@ -326,7 +245,7 @@ string PrintNodeWalker::visit_op_pdiv_r(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_zdiv_r(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation zdiv_r\n")+ string_stream.str();
   this->depth -= 1;
@@ -336,7 +255,7 @@ string PrintNodeWalker::visit_op_zdiv_r(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_cond(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation cond\n")+ string_stream.str();
   this->depth -= 1;
@@ -346,7 +265,7 @@ string PrintNodeWalker::visit_op_cond(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_select(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation select\n")+ string_stream.str();
   this->depth -= 1;
@@ -356,7 +275,7 @@ string PrintNodeWalker::visit_op_select(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_eq(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation eq\n")+ string_stream.str();
   this->depth -= 1;
@@ -366,7 +285,7 @@ string PrintNodeWalker::visit_op_eq(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_le(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation le\n")+ string_stream.str();
   this->depth -= 1;
@@ -376,7 +295,7 @@ string PrintNodeWalker::visit_op_le(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_lt(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation lt\n")+ string_stream.str();
   this->depth -= 1;
@@ -386,7 +305,7 @@ string PrintNodeWalker::visit_op_lt(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_ge(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation ge\n")+ string_stream.str();
   this->depth -= 1;
@@ -396,7 +315,7 @@ string PrintNodeWalker::visit_op_ge(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_gt(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation gt\n")+ string_stream.str();
   this->depth -= 1;
@@ -406,7 +325,7 @@ string PrintNodeWalker::visit_op_gt(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_call(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation call\n")+ string_stream.str();
   this->depth -= 1;
@@ -416,7 +335,7 @@ string PrintNodeWalker::visit_op_call(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_access(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation access\n")+ string_stream.str();
   this->depth -= 1;
@@ -426,7 +345,7 @@ string PrintNodeWalker::visit_op_access(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_member(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation member\n")+ string_stream.str();
   this->depth -= 1;
@@ -436,7 +355,7 @@ string PrintNodeWalker::visit_op_member(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_address_of(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation address_of\n")+ string_stream.str();
   this->depth -= 1;
@@ -446,7 +365,7 @@ string PrintNodeWalker::visit_op_address_of(isl_ast_expr* node){
 string PrintNodeWalker::visit_op_unknown(isl_ast_expr* node){
   this->depth += 1;
   ostringstream string_stream;
-  list<string> children = this->visit_expr_operands(node);
+  vector<string> children = this->visit_expr_operands(node);
   copy(children.begin(), children.end(), ostream_iterator<string>(string_stream,""));
   string result = this->getTab() + string("Operation unknown\n")+ string_stream.str();
   this->depth -= 1;
@@ -463,17 +382,17 @@ string PrintNodeWalker::visit_expr_error(isl_ast_expr* node){
 
 string PrintNodeWalker::visit_expr_id(isl_ast_expr* node){
   this->depth += 1;
-  isl_id* isl_ident = isl_ast_expr_get_id(node);
-  string result = this->getTab() + string( "Expression id: " ) + string( isl_id_get_name( isl_ident ) ) + string("\n");
+  isl_id_handle isl_ident( isl_ast_expr_get_id(node) );
+  string result = this->getTab() + string( "Expression id: " ) + string( isl_id_get_name( isl_ident.get() ) ) + string("\n");
   this->depth -= 1;
   return result;
 }
 
 string PrintNodeWalker::visit_expr_int(isl_ast_expr* node){
   this->depth += 1;
-  isl_val* isl_value = isl_ast_expr_get_val( node );
-  long value = isl_val_get_num_si( isl_value );
-  long den = isl_val_get_den_si( isl_value );
+  isl_val_handle isl_value( isl_ast_expr_get_val( node ) );
+  long value = isl_val_get_num_si( isl_value.get() );
+  long den = isl_val_get_den_si( isl_value.get() );
   string result = this->getTab() + string( "Expression int: " ) + to_string( value ) + string( " / " ) + to_string( den ) + string("\n");
   this->depth -= 1;
   return result;
@@ -498,11 +417,11 @@ string PrintNodeWalker::visit_node_for(isl_ast_node* node){
   this->depth += 1;
 
   string result = this->getTab() + string("Node for\n");
-  result += this->visit( isl_ast_node_for_get_iterator( node ) );
-  result += this->visit( isl_ast_node_for_get_init( node ) );
-  result += this->visit( isl_ast_node_for_get_cond( node) );
-  result += this->visit( isl_ast_node_for_get_inc( node ) );
-  result += this->visit( isl_ast_node_for_get_body( node ) );
+  result += this->visit( isl_ast_expr_handle( isl_ast_node_for_get_iterator( node ) ).get() );
+  result += this->visit( isl_ast_expr_handle( isl_ast_node_for_get_init( node ) ).get() );
+  result += this->visit( isl_ast_expr_handle( isl_ast_node_for_get_cond( node) ).get() );
+  result += this->visit( isl_ast_expr_handle( isl_ast_node_for_get_inc( node ) ).get() );
+  result += this->visit( isl_ast_node_handle( isl_ast_node_for_get_body( node ) ).get() );
 
   this->depth -= 1;
   return result;
@@ -511,10 +430,10 @@ string PrintNodeWalker::visit_node_for(isl_ast_node* node){
 string PrintNodeWalker::visit_node_if(isl_ast_node* node){
   this->depth += 1;
   string result = this->getTab() + string( "Node if\n" );
-  result += this->visit( isl_ast_node_if_get_cond(node) );
-  result += this->visit( isl_ast_node_if_get_then(node) );
+  result += this->visit( isl_ast_expr_handle( isl_ast_node_if_get_cond(node) ).get() );
+  result += this->visit( isl_ast_node_handle( isl_ast_node_if_get_then(node) ).get() );
   if( isl_ast_node_if_has_else( node ) )
-    result += this->visit( isl_ast_node_if_get_else(node) );
+    result += this->visit( isl_ast_node_handle( isl_ast_node_if_get_else(node) ).get() );
 
   this->depth -= 1;
   return result;
@@ -525,10 +444,10 @@ string PrintNodeWalker::visit_node_block(isl_ast_node* node){
 
   string result = this->getTab() + string("Node Block\n");
 
-  isl_ast_node_list* list = isl_ast_node_block_get_children(node);
-  for( int i = 0; i < isl_ast_node_list_n_ast_node(list); i += 1 ){
-    isl_ast_node* node = isl_ast_node_list_get_ast_node(list, i);
-    result += this->visit( node );
+  isl_ast_node_list_handle list( isl_ast_node_block_get_children(node) );
+  for( int i = 0; i < isl_ast_node_list_n_ast_node(list.get()); i += 1 ){
+    isl_ast_node_handle child( isl_ast_node_list_get_ast_node(list.get(), i) );
+    result += this->visit( child.get() );
   }
 
   this->depth -= 1;
@@ -545,7 +464,7 @@ string PrintNodeWalker::visit_node_mark(isl_ast_node* node){
 string PrintNodeWalker::visit_node_user(isl_ast_node* node){
   this->depth += 1;
   string result = this->getTab() + string( "Node user\n" );
-  result += this->visit( isl_ast_node_user_get_expr(node) );
+  result += this->visit( isl_ast_expr_handle( isl_ast_node_user_get_expr(node) ).get() );
   this->depth -= 1;
   return result;
 }
@@ -0,0 +1,445 @@
+#include <cassert>
+#include <vector>
+
+#include "phase_profiler.hpp"
+#include "SageMaterializer.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+SageMaterializer::SageMaterializer(): SageMaterializer( walker_options() )
+{}
+
+SageMaterializer::SageMaterializer( const walker_options& options ): ast( NULL ), injection_site( NULL ), global( NULL ), arith( options.intrinsics, options.strength_reduce ), loops( arith, options.canonical_loops, options.hoist_invariants, options.unroll_limit ), affine( options.fold_affine ), omp_parallel( options.omp_parallel ), parallel_loop( NULL ), marks( options.marks != NULL ? options.marks : &mark_registry::defaults() ), widths( NULL ), scopes(), symbols(), symbol_undo(), built(), stack(), statement_macros()
+{}
+
+void SageMaterializer::set_widths( const width_analysis* widths ){
+  this->widths = widths;
+  this->loops.set_widths( widths );
+}
+
+vector<function_call_info>* SageMaterializer::getStatementMacroNodes(){
+  return &(this->statement_macros);
+}
+
+SgStatement* SageMaterializer::materialize( const flat_ast& ast, uint32_t root, SgScopeStatement* injection_site ){
+  phase_scope phase( "SageMaterializer::materialize" );
+
+  this->ast = &ast;
+  this->injection_site = injection_site;
+  this->global = getGlobalScope( injection_site );
+  this->arith.set_global( this->global );
+  this->statement_macros.clear();
+
+  this->scopes.assign( 1, injection_site );
+  this->symbols.assign( ast.identifiers(), NULL );
+  this->symbol_undo.clear();
+  this->built.assign( ast.size(), NULL );
+
+  SgNode* last = NULL;
+  this->stack.push_back( statement_frame{ root, 0, { NULL, NULL }, 0 } );
+
+  while( ! this->stack.empty() ){
+    statement_frame& frame = this->stack.back();
+    uint32_t n = frame.node;
+    // Child statement to visit next, if any
+    uint32_t child = flat_ast::none;
+
+    switch( ast.kind( n ) ){
+      case flat_for:
+        if( frame.state == 0 ){
+          frame.partial[0] = this->enter_for( frame );
+          frame.state = 1;
+          child = ast.child( n, 4 );
+        } else {
+          last = this->leave_for( frame, isSgStatement( last ) );
+          this->stack.pop_back();
+        }
+        break;
+
+      case flat_if:
+        if( frame.state == 0 ){
+          frame.partial[0] = this->expression( ast.child( n, 0 ) );
+          frame.state = 1;
+          child = ast.child( n, 1 );
+        } else if( frame.state == 1 && ast.children( n ) == 3 ){
+          frame.partial[1] = last;
+          frame.state = 2;
+          child = ast.child( n, 2 );
+        } else {
+          SgNode* then_node = ( frame.state == 1 ) ? last : frame.partial[1];
+          SgNode* else_node = ( frame.state == 1 ) ? NULL : last;
+          last = this->leave_if( frame, isSgStatement( then_node ), isSgStatement( else_node ) );
+          this->stack.pop_back();
+        }
+        break;
+
+      case flat_block:
+        if( frame.state == 0 ){
+          SgBasicBlock* block = buildBasicBlock();
+          this->scopes.push_back( block );
+          frame.partial[0] = block;
+        } else {
+          assert( isSgStatement( last ) != NULL );
+          appendStatement( isSgStatement( last ), isSgBasicBlock( frame.partial[0] ) );
+        }
+
+        // state counts the children visited so far
+        if( frame.state < ast.children( n ) ){
+          child = ast.child( n, frame.state );
+          frame.state += 1;
+        } else {
+          this->loops.close_scope( this->scopes.back() );
+          this->scopes.pop_back();
+          last = frame.partial[0];
+          this->stack.pop_back();
+        }
+        break;
+
+      case flat_user:
+        last = this->expression( ast.child( n, 0 ) );
+        this->stack.pop_back();
+        break;
+
+      case flat_mark:
+        if( frame.state == 0 ){
+          frame.state = 1;
+          child = ast.child( n, 1 );
+        } else {
+          assert( isSgStatement( last ) != NULL );
+          last = this->marks->apply( ast.name( ast.identifier( ast.child( n, 0 ) ) ), isSgStatement( last ) );
+          this->stack.pop_back();
+        }
+        break;
+
+      default:
+        assert( false && "flat_ast node not implemented" );
+        this->stack.pop_back();
+        break;
+    }
+
+    if( child != flat_ast::none ){
+      this->stack.push_back( statement_frame{ child, 0, { NULL, NULL }, 0 } );
+    }
+  }
+
+  SgStatement* result = isSgStatement( last );
+  assert( result != NULL );
+
+  appendStatement( result, injection_site );
+
+  assert( this->symbol_undo.empty() );
+  this->scopes.clear();
+  this->loops.clear();
+  this->ast = NULL;
+
+  return result;
+}
+
+SgVariableSymbol* SageMaterializer::get_symbol( uint32_t identifier ){
+  SgVariableSymbol* symbol = this->symbols[identifier];
+
+  // Get symbol from parent scope
+  if( symbol == NULL ){
+    symbol = lookupVariableSymbolInParentScopes( SgName( this->ast->name( identifier ) ), this->injection_site );
+    assert( symbol != NULL );
+    this->symbols[identifier] = symbol;
+  }
+
+  return symbol;
+}
+
+void SageMaterializer::set_symbol( uint32_t identifier, SgVariableSymbol* symbol ){
+  assert( symbol != NULL );
+
+  this->symbol_undo.push_back( symbol_binding{ identifier, this->symbols[identifier] } );
+  this->symbols[identifier] = symbol;
+}
+
+SgExpression* SageMaterializer::reference( uint32_t n ){
+  return buildVarRefExp( this->get_symbol( this->ast->identifier( n ) ) );
+}
+
+SgNode* SageMaterializer::expression( uint32_t n ){
+  const flat_ast& ast = *this->ast;
+
+  // Operands have higher numbers than their operations. Identifiers are
+  // left to the operation using them, as a call's callee is not a variable.
+  for( uint32_t i = ast.end( n ); i > n; i -= 1 ){
+    uint32_t j = i - 1;
+    switch( ast.kind( j ) ){
+      case flat_int: {
+        // Literals outside 32 bits are long long
+        int64_t num = ast.value( j );
+        int int_value = (int) num;
+        if( ((int64_t) int_value) == num ){
+          this->built[j] = buildIntVal( int_value );
+        } else {
+          this->built[j] = buildLongLongIntVal( num );
+        }
+        break;
+      }
+
+      case flat_op:
+        this->built[j] = this->operation( j );
+        break;
+
+      case flat_id:
+        break;
+
+      default:
+        assert( false && "statement inside an expression" );
+        break;
+    }
+  }
+
+  if( ast.kind( n ) == flat_id ){
+    this->built[n] = this->reference( n );
+  }
+
+  return this->built[n];
+}
+
+SgExpression* SageMaterializer::operand( uint32_t n, uint32_t pos ){
+  assert( this->ast->children( n ) > pos );
+
+  uint32_t j = this->ast->child( n, pos );
+  if( this->built[j] == NULL && this->ast->kind( j ) == flat_id ){
+    this->built[j] = this->reference( j );
+  }
+
+  SgExpression* sg_expr = isSgExpression( this->built[j] );
+  assert( sg_expr != NULL );
+  return sg_expr;
+}
+
+SgNode* SageMaterializer::operation( uint32_t n ){
+  const flat_ast& ast = *this->ast;
+  uint32_t n_args = ast.children( n );
+
+  switch( ast.op( n ) ){
+    case isl_ast_op_and:
+    case isl_ast_op_and_then:
+      assert( n_args == 2 );
+      return buildBinaryExpression<SgAndOp>( this->operand( n, 0 ), this->operand( n, 1 ) );
+
+    case isl_ast_op_or:
+    case isl_ast_op_or_else:
+      assert( n_args == 2 );
+      return buildBinaryExpression<SgOrOp>( this->operand( n, 0 ), this->operand( n, 1 ) );
+
+    case isl_ast_op_max:
+    case isl_ast_op_min: {
+      assert( n_args >= 2 );
+      bool is_max = ast.op( n ) == isl_ast_op_max;
+
+      vector<SgExpression*> operands;
+      operands.reserve( n_args );
+      for( uint32_t i = 0; i < n_args; i += 1 ){
+        operands.push_back( this->operand( n, i ) );
+      }
+      SgType* type = width_analysis::operation_type( this->widths, operands, this->global );
+      return is_max ? this->arith.max( operands, type ) : this->arith.min( operands, type );
+    }
+
+    case isl_ast_op_minus:
+      assert( n_args == 1 );
+      return this->affine.minus( this->operand( n, 0 ) );
+
+    case isl_ast_op_add:
+      assert( n_args == 2 );
+      return this->affine.add( this->operand( n, 0 ), this->operand( n, 1 ) );
+
+    case isl_ast_op_sub:
+      assert( n_args == 2 );
+      return this->affine.sub( this->operand( n, 0 ), this->operand( n, 1 ) );
+
+    case isl_ast_op_mul:
+      assert( n_args == 2 );
+      return this->affine.mul( this->operand( n, 0 ), this->operand( n, 1 ) );
+
+    case isl_ast_op_div:
+      assert( n_args == 2 );
+      return buildBinaryExpression<SgDivideOp>( this->operand( n, 0 ), this->operand( n, 1 ) );
+
+    case isl_ast_op_pdiv_q:
+      assert( n_args == 2 );
+      return this->arith.pdiv_q( this->operand( n, 0 ), this->operand( n, 1 ) );
+
+    case isl_ast_op_fdiv_q: {
+      assert( n_args == 2 );
+      SgExpression* lhs = this->operand( n, 0 );
+      SgExpression* rhs = this->operand( n, 1 );
+      return this->arith.floord( lhs, rhs, width_analysis::operation_type( this->widths, { lhs, rhs }, this->global ) );
+    }
+
+    case isl_ast_op_pdiv_r:
+      assert( n_args == 2 );
+      return this->arith.pdiv_r( this->operand( n, 0 ), this->operand( n, 1 ) );
+
+    case isl_ast_op_zdiv_r:
+      assert( n_args == 2 );
+      return this->arith.zdiv_r( this->operand( n, 0 ), this->operand( n, 1 ) );
+
+    case isl_ast_op_cond:
+    case isl_ast_op_select:
+      assert( n_args == 3 );
+      return buildConditionalExp( this->operand( n, 0 ), this->operand( n, 1 ), this->operand( n, 2 ) );
+
+    case isl_ast_op_eq:
+      assert( n_args == 2 );
+      return buildBinaryExpression<SgEqualityOp>( this->operand( n, 0 ), this->operand( n, 1 ) );
+
+    case isl_ast_op_le:
+      assert( n_args == 2 );
+      return buildBinaryExpression<SgLessOrEqualOp>( this->operand( n, 0 ), this->operand( n, 1 ) );
+
+    case isl_ast_op_lt:
+      assert( n_args == 2 );
+      return buildBinaryExpression<SgLessThanOp>( this->operand( n, 0 ), this->operand( n, 1 ) );
+
+    case isl_ast_op_ge:
+      assert( n_args == 2 );
+      return buildBinaryExpression<SgGreaterOrEqualOp>( this->operand( n, 0 ), this->operand( n, 1 ) );
+
+    case isl_ast_op_gt:
+      assert( n_args == 2 );
+      return buildBinaryExpression<SgGreaterThanOp>( this->operand( n, 0 ), this->operand( n, 1 ) );
+
+    case isl_ast_op_call: {
+      assert( n_args >= 1 );
+      uint32_t callee = ast.child( n, 0 );
+      assert( ast.kind( callee ) == flat_id );
+      SgName name( ast.name( ast.identifier( callee ) ) );
+
+      vector<SgExpression*> parameter_expressions;
+      parameter_expressions.reserve( n_args - 1 );
+      for( uint32_t i = 1; i < n_args; i += 1 ){
+        parameter_expressions.push_back( this->operand( n, i ) );
+      }
+
+      SgExprListExp* parameters = buildExprListExp( parameter_expressions );
+      SgExprStatement* call = buildFunctionCallStmt( name, buildVoidType(), parameters, this->global );
+      this->statement_macros.push_back( function_call_info( call, name, parameter_expressions ) );
+      return call;
+    }
+
+    case isl_ast_op_access: {
+      assert( n_args >= 2 );
+      SgExpression* head = this->operand( n, 0 );
+      for( uint32_t i = 1; i < n_args; i += 1 ){
+        head = buildBinaryExpression<SgPntrArrRefExp>( head, this->operand( n, i ) );
+      }
+      return head;
+    }
+
+    case isl_ast_op_member:
+      assert( n_args == 2 );
+      return buildBinaryExpression<SgDotExp>( this->operand( n, 0 ), this->operand( n, 1 ) );
+
+    case isl_ast_op_address_of:
+      assert( n_args == 1 );
+      return buildUnaryExpression<SgAddressOfOp>( this->operand( n, 0 ) );
+
+    default:
+      assert( false && "isl_ast_op_type not implemented" );
+      return NULL;
+  }
+}
+
+SgForStatement* SageMaterializer::enter_for( statement_frame& frame ){
+  const flat_ast& ast = *this->ast;
+  uint32_t n = frame.node;
+  uint32_t iterator = ast.identifier( ast.child( n, 0 ) );
+
+  // The iterator binding belongs to the loop, undone when it is left
+  frame.bindings = this->symbol_undo.size();
+
+  // The initialization is in the scope around the loop
+  SgExpression* init_exp = isSgExpression( this->expression( ast.child( n, 1 ) ) );
+  assert( init_exp != NULL );
+
+  SgType* type = this->widths != NULL ? this->widths->type( ast.name( iterator ), this->global ) : buildIntType();
+  SgAssignInitializer* initalizer = buildAssignInitializer( init_exp, type );
+  SgVariableDeclaration* var_decl = buildVariableDeclaration( SgName( ast.name( iterator ) ), type, initalizer, this->scopes.back() );
+
+  SgVariableSymbol* symbol = getFirstVarSym( var_decl );
+  this->set_symbol( iterator, symbol );
+
+  SgExpression* cond_exp = isSgExpression( this->expression( ast.child( n, 2 ) ) );
+  assert( cond_exp != NULL );
+
+  SgExpression* increment_exp = isSgExpression( this->expression( ast.child( n, 3 ) ) );
+  assert( increment_exp != NULL );
+
+  SgForStatement* for_stmt = this->loops.build( var_decl, cond_exp, increment_exp, this->scopes.back() );
+
+  // The outermost loop of a nest annotated parallel runs on OpenMP threads
+  if( this->omp_parallel && this->parallel_loop == NULL && ast.parallel( n ) && ! this->loops.unrolls( for_stmt ) ){
+    this->parallel_loop = for_stmt;
+  }
+
+  this->scopes.push_back( for_stmt );
+  this->scopes.push_back( isSgScopeStatement( getLoopBody( for_stmt ) ) );
+
+  return for_stmt;
+}
+
+SgNode* SageMaterializer::leave_for( statement_frame& frame, SgStatement* sg_stmt ){
+  SgForStatement* for_stmt = isSgForStatement( frame.partial[0] );
+
+  this->loops.close_scope( this->scopes.back() );
+  this->scopes.pop_back();
+  this->loops.close_scope( this->scopes.back() );
+  this->scopes.pop_back();
+
+  while( this->symbol_undo.size() > frame.bindings ){
+    symbol_binding& binding = this->symbol_undo.back();
+    this->symbols[binding.identifier] = binding.previous;
+    this->symbol_undo.pop_back();
+  }
+
+  loop_builder::set_body( for_stmt, sg_stmt );
+
+  if( for_stmt == this->parallel_loop ){
+    this->parallel_loop = NULL;
+    return loop_builder::parallelize( for_stmt );
+  }
+
+  if( ! this->loops.unrolls( for_stmt ) ){
+    return for_stmt;
+  }
+
+  // As in SageTransformationWalker::leave_node_for
+  vector<function_call_info>::size_type first = this->statement_macros.size();
+  while( first > 0 && isAncestor( for_stmt, this->statement_macros[first - 1].expr_node ) ){
+    first -= 1;
+  }
+  this->statement_macros.erase( this->statement_macros.begin() + first, this->statement_macros.end() );
+  SgStatement* unrolled = this->loops.unroll( for_stmt );
+  function_call_info::collect( unrolled, this->statement_macros );
+  return unrolled;
+}
+
+SgNode* SageMaterializer::leave_if( statement_frame& frame, SgStatement* then_node, SgStatement* else_node ){
+  SgExpression* condition_node = isSgExpression( frame.partial[0] );
+  assert( condition_node != NULL );
+  assert( then_node != NULL );
+
+  // Always wrap statements as blocks
+  if( !isSgBasicBlock(then_node) ){
+    then_node = buildBasicBlock( then_node );
+  }
+
+  // Wrapped exactly as SageTransformationWalker::leave_node_if does
+  if( this->ast->children( frame.node ) == 3 ){
+    assert( else_node != NULL );
+
+    if( isSgBasicBlock( else_node ) ){
+      else_node = buildBasicBlock( else_node );
+    }
+  }
+
+  return buildIfStmt( condition_node, then_node, else_node );
+}
@@ -1,5 +1,7 @@
 #include <iostream>
+#include <climits>
 #include <cstdio>
+#include <cstdlib>
 #include <vector>
 #include <numeric>
 #include <string>
@@ -8,22 +10,91 @@
 #include <deque>
 
 #include "util.hpp"
+#include "phase_profiler.hpp"
+#include "flat_ast.hpp"
+#include "parallel_loops.hpp"
+#include "SageMaterializer.hpp"
 #include "SageTransformationWalker.hpp"
 
 using namespace std;
 using namespace SageBuilder;
 using namespace SageInterface;
 
-function_call_info::function_call_info( SgExprStatement* expr_node, SgName name, vector<SgExpression*>& parameter_expressions ): expr_node(expr_node), name(name), parameter_expressions(parameter_expressions)
+function_call_info::function_call_info( SgExprStatement* expr_node, const SgName& name, const vector<SgExpression*>& parameter_expressions ): expr_node(expr_node), name(name), parameter_expressions(parameter_expressions)
 {}
 
-SageTransformationWalker::SageTransformationWalker( isl_ast_node* isl_root, SgScopeStatement* injection_site ): SageTransformationWalker(isl_root, injection_site, false){ }
+void function_call_info::collect( SgNode* root, vector<function_call_info>& macros ){
+  Rose_STL_Container<SgNode*> statements = NodeQuery::querySubTree( root, V_SgExprStatement );
+  for( Rose_STL_Container<SgNode*>::iterator it = statements.begin(); it != statements.end(); ++it ){
+    SgExprStatement* statement = isSgExprStatement( *it );
+    SgFunctionCallExp* call = isSgFunctionCallExp( statement->get_expression() );
+    if( call != NULL ){
+      SgExpressionPtrList& args = call->get_args()->get_expressions();
+      macros.push_back( function_call_info( statement, call->getAssociatedFunctionSymbol()->get_name(), vector<SgExpression*>( args.begin(), args.end() ) ) );
+    }
+  }
+}
+
+walker_options::walker_options(): verbose(false), iterative(false), resolve_free_ids(false), collect_stats(false), flat_ir(false), lowering_threads(1), intrinsics(intrinsic_calls), strength_reduce(false), canonical_loops(false), hoist_invariants(false), fold_affine(false), omp_parallel(false), marks(NULL), unroll_limit(0), choose_widths(false), width_context(), memoize_exprs(false), trace_capacity(1 << 16), trace_file(), trace_output_format(trace_text)
+{}
+
+static walker_options verbose_options( bool verbose ){
+  walker_options options;
+  options.verbose = verbose;
+  return options;
+}
+
+SageTransformationWalker::SageTransformationWalker( isl_ast_node* isl_root, SgScopeStatement* injection_site ): SageTransformationWalker(isl_root, injection_site, walker_options()){ }
+
+SageTransformationWalker::SageTransformationWalker( isl_ast_node* isl_root, SgScopeStatement* injection_site, bool verbose ): SageTransformationWalker(isl_root, injection_site, verbose_options(verbose)){ }
 
-SageTransformationWalker::SageTransformationWalker( isl_ast_node* isl_root, SgScopeStatement* injection_site, bool verbose ): depth( -1 ), verbose( verbose ), scope_stack(), isl_root( isl_root ), statement_macros(), injection_site( injection_site ), global( getGlobalScope(injection_site) ) {
-  if( verbose ){
-    cout << "Injection site: "<< static_cast<void*>( injection_site ) << endl
-         << "Global: " << static_cast<void*>( this->get_global() ) << endl;
+SageTransformationWalker::SageTransformationWalker( isl_ast_node* isl_root, SgScopeStatement* injection_site, const walker_options& options ): SageTransformationWalker( options ) {
+  this->translate( isl_root, injection_site );
+}
+
+SageTransformationWalker::SageTransformationWalker( const walker_options& options ): ISLWalker(), symbol_cache(), symbol_undo(), symbol_frames(), options( options ), verbose( options.verbose ), trace( options.trace_capacity ), stats(), scope_stack(), isl_root( NULL ), statement_macros(), lowering_pool(), injection_site( NULL ), global( NULL ), arith( options.intrinsics, options.strength_reduce ), loops( arith, options.canonical_loops, options.hoist_invariants, options.unroll_limit ), affine( options.fold_affine ), parallel_loop( NULL ), widths(), memo(), expr_stack(), expr_results(), node_stack(), ready_operands( NULL ), ready_operands_base( 0 ) { }
+
+SgStatement* SageTransformationWalker::translate( isl_ast_node* isl_root, SgScopeStatement* injection_site ){
+  phase_scope phase( "SageTransformationWalker::translate" );
+
+  this->isl_root = isl_root;
+  this->injection_site = injection_site;
+  this->global = getGlobalScope( injection_site );
+  this->arith.set_global( this->global );
+  this->statement_macros.clear();
+
+  if( this->options.choose_widths ){
+    this->widths.reset( new width_analysis( isl_root, this->options.width_context ) );
+  } else {
+    this->widths.reset();
   }
+  this->loops.set_widths( this->widths.get() );
+  this->memo.clear();
+
+  if( this->options.flat_ir ){
+    flat_ast ir;
+    uint32_t root = 0;
+    if( this->options.lowering_threads == 1 ){
+      root = ir.lower( isl_root );
+    } else {
+      if( ! this->lowering_pool ){
+        this->lowering_pool.reset( new work_pool( this->options.lowering_threads ) );
+      }
+      root = ir.lower_parallel( isl_root, *this->lowering_pool );
+    }
+
+    SageMaterializer materializer( this->options );
+    materializer.set_widths( this->widths.get() );
+    SgStatement* result = materializer.materialize( ir, root, injection_site );
+    this->statement_macros = *materializer.getStatementMacroNodes();
+    return result;
+  }
+
+  if( this->verbose ){
+    this->trace.start();
+  }
+  this->trace.record( "Injection site", this->depth, injection_site );
+  this->trace.record( "Global", this->depth, this->get_global() );
 
   // Form the initial scope stack in bottom-up order (in reverse order they will appear on the stack)
   // Start with injection site, as it is inner most
@@ -31,12 +102,25 @@ SageTransformationWalker::SageTransformationWalker( isl_ast_node* isl_root, SgSc
   // As long as we havent already encountered the global scope, push next enclosing scope
   while( this->bottom() != this->get_global() ){
     this->push_bottom( getEnclosingScope( this->bottom() ) );
-    if( verbose ) cout << "Pushing scope " << static_cast<void*>( this->bottom() ) << endl;
+    this->trace.record( "Pushing scope", this->depth, this->bottom() );
   }
 
   assert( this->top() == injection_site );
   assert( this->bottom() == this->get_global() );
 
+  if( options.resolve_free_ids ){
+    phase_scope resolve_phase( "SageTransformationWalker::resolve_free_ids" );
+    vector<string> unresolved = this->resolve_free_ids();
+    if( ! unresolved.empty() ){
+      cerr << "No symbol in scope for ISL identifier(s):";
+      for( vector<string>::iterator it = unresolved.begin(); it != unresolved.end(); ++it ){
+        cerr << " " << *it;
+      }
+      cerr << endl;
+    }
+    assert( unresolved.empty() );
+  }
+
   SgStatement* result = isSgStatement( this->visit( this->isl_root ) );
   assert( result != NULL );
 
@@ -46,6 +130,22 @@ SageTransformationWalker::SageTransformationWalker( isl_ast_node* isl_root, SgSc
     this->pop();
   }
 
+  // Every binding has been undone, only symbols cached from the enclosing
+  // scopes remain. Their keys are borrowed from isl_root.
+  assert( this->symbol_undo.empty() );
+  this->symbol_cache.clear();
+  this->loops.clear();
+
+  if( this->verbose ){
+    this->trace.stop();
+    if( this->options.trace_file.empty() ){
+      this->trace.drain( cout, this->options.trace_output_format );
+    } else {
+      this->trace.drain( this->options.trace_file, this->options.trace_output_format );
+    }
+  }
+
+  return result;
 }
 
 bool SageTransformationWalker::empty(){
@@ -67,12 +167,34 @@ SgScopeStatement* SageTransformationWalker::pop(){
 SgScopeStatement* SageTransformationWalker::pop_top(){
   SgScopeStatement* ret = this->top();
   this->scope_stack.pop_back();
+  this->loops.close_scope( ret );
+
+  // Undo the bindings made in this scope, innermost last
+  vector<symbol_binding>::size_type mark = this->symbol_frames.back();
+  this->symbol_frames.pop_back();
+  while( this->symbol_undo.size() > mark ){
+    symbol_binding& binding = this->symbol_undo.back();
+    if( binding.previous == NULL ){
+      this->symbol_cache.erase( binding.id );
+    } else {
+      this->symbol_cache[binding.id] = binding.previous;
+    }
+    this->symbol_undo.pop_back();
+  }
+
   return ret;
 }
 
 SgScopeStatement* SageTransformationWalker::pop_bottom(){
   SgScopeStatement* ret = this->bottom();
   this->scope_stack.pop_front();
+
+  // Bindings of the outermost scope pass to the next one
+  this->symbol_frames.pop_front();
+  if( ! this->symbol_frames.empty() ){
+    this->symbol_frames.front() = 0;
+  }
+
   return ret;
 }
 
@@ -84,244 +206,496 @@ void SageTransformationWalker::push( SgScopeStatement* scope ){
   this->push_top( scope );
 }
 
+void SageTransformationWalker::push( SgScopeStatement* scope, vector<symbol_binding>::size_type bindings_mark ){
+  assert( bindings_mark <= this->symbol_undo.size() );
+  assert( this->symbol_frames.empty() || this->symbol_frames.back() <= bindings_mark );
+  this->scope_stack.push_back( scope );
+  this->symbol_frames.push_back( bindings_mark );
+}
+
 void SageTransformationWalker::push_top( SgScopeStatement* scope ){
   this->scope_stack.push_back( scope );
+  this->symbol_frames.push_back( this->symbol_undo.size() );
 }
 
 void SageTransformationWalker::push_bottom( SgScopeStatement* scope ){
+  // Only outside of any binding, i.e. while forming the initial stack
+  assert( this->symbol_undo.empty() );
   this->scope_stack.push_front( scope );
+  this->symbol_frames.push_front( 0 );
 }
 
-SgVariableSymbol* SageTransformationWalker::get_symbol( std::string symbol_name ){
-  SgVariableSymbol* symbol = this->symbol_maps[symbol_name];
+SgVariableSymbol* SageTransformationWalker::get_symbol( isl_id* id ){
+  SgVariableSymbol** found = this->symbol_cache.find( id );
+  SgVariableSymbol* symbol = (found == NULL) ? NULL : *found;
 
-  if( verbose ){
-    std::cout << std::string(this->depth*2, ' ') << "map[" << symbol_name << "] ---> " << static_cast<void*>(symbol) << endl;
-  }
+  this->trace.record_id( "map --->", this->depth, symbol, id );
 
   return symbol;
 }
 
-void SageTransformationWalker::set_symbol( std::string symbol_name, SgVariableSymbol* symbol ){
-  this->symbol_maps[symbol_name] = symbol;
-  if( this->verbose ){
-    std::cout << std::string(this->depth*2, ' ') << "map[" << symbol_name << "] <--- " << static_cast<void*>(this->symbol_maps[symbol_name]) << endl;
-  }
-}
+void SageTransformationWalker::set_symbol( isl_id* id, SgVariableSymbol* symbol ){
+  assert( symbol != NULL );
+  assert( ! this->symbol_frames.empty() );
 
-vector<function_call_info*>* SageTransformationWalker::getStatementMacroNodes(){
-  return &(this->statement_macros);
+  SgVariableSymbol*& bound = this->symbol_cache[id];
+  this->symbol_undo.push_back( symbol_binding{ id, bound } );
+  bound = symbol;
+
+  this->trace.record_id( "map <---", this->depth, symbol, id );
 }
 
-SgScopeStatement* SageTransformationWalker::getInjectionRoot(){
-  return this->injection_site;
+void SageTransformationWalker::cache_symbol( isl_id* id, SgVariableSymbol* symbol ){
+  assert( symbol != NULL );
+  // Must not hide a binding, or popping its scope would restore the wrong symbol
+  assert( this->symbol_cache.find( id ) == NULL );
+
+  this->symbol_cache[id] = symbol;
+
+  this->trace.record_id( "map <--- (cached)", this->depth, symbol, id );
 }
 
+vector<SageTransformationWalker::symbol_binding>::size_type SageTransformationWalker::symbols_mark(){
+  return this->symbol_undo.size();
+}
 
-SgNode* SageTransformationWalker::visit( isl_ast_expr* node ){
-  this->depth += 1;
-  SgNode* result = NULL;
+void SageTransformationWalker::collect_free_ids( isl_ast_node* root, vector<isl_id*>& free_ids ){
+  // Work item: a node, an expression, or a change to how many enclosing
+  // loops bind an iterator
+  struct item {
+    isl_ast_node_handle node;
+    isl_ast_expr_handle expr;
+    isl_id* iterator;
+    int bind;
+  };
 
-  switch( isl_ast_expr_get_type(node) ){
-    case isl_ast_expr_error:
-      result = this->visit_expr_error( node );
-      break;
+  isl_id_map<int> bound;
+  isl_id_map<bool> seen;
+  vector<item> stack;
 
-    case isl_ast_expr_op:
-      result = this->visit_expr_op( node );
-      break;
+  stack.push_back( item{ isl_ast_node_handle( isl_ast_node_copy( root ) ), isl_ast_expr_handle(), NULL, 0 } );
 
-    case isl_ast_expr_id:
-      result = this->visit_expr_id( node );
-      break;
+  while( ! stack.empty() ){
+    item current = std::move( stack.back() );
+    stack.pop_back();
 
-    case isl_ast_expr_int:
-      result = this->visit_expr_int( node );
-      break;
+    if( current.iterator != NULL ){
+      bound[current.iterator] += current.bind;
+    }
+    else if( current.expr ){
+      isl_ast_expr* expr = current.expr.get();
+      switch( isl_ast_expr_get_type( expr ) ){
+        case isl_ast_expr_id: {
+          isl_id_handle id( isl_ast_expr_get_id( expr ) );
+          int* depth = bound.find( id.get() );
+          if( (depth == NULL || *depth == 0) && seen.find( id.get() ) == NULL ){
+            seen[id.get()] = true;
+            free_ids.push_back( id.get() );
+          }
+          break;
+        }
+
+        case isl_ast_expr_op: {
+          // The callee of a call is a statement macro, not a variable
+          int first = (isl_ast_expr_get_op_type( expr ) == isl_ast_op_call) ? 1 : 0;
+          for( int i = isl_ast_expr_get_op_n_arg( expr ) - 1; i >= first; i -= 1 ){
+            stack.push_back( item{ isl_ast_node_handle(), isl_ast_expr_handle( isl_ast_expr_get_op_arg( expr, i ) ), NULL, 0 } );
+          }
+          break;
+        }
+
+        default:
+          break;
+      }
+    }
+    else {
+      isl_ast_node* node = current.node.get();
+      // Pushed in reverse, so popped in source order
+      switch( isl_ast_node_get_type( node ) ){
+        case isl_ast_node_for: {
+          isl_ast_expr_handle iterator( isl_ast_node_for_get_iterator( node ) );
+          isl_id* id = isl_id_handle( isl_ast_expr_get_id( iterator.get() ) ).get();
+          // The AST keeps the id alive after the handle frees its reference
+          stack.push_back( item{ isl_ast_node_handle(), isl_ast_expr_handle(), id, -1 } );
+          stack.push_back( item{ isl_ast_node_handle( isl_ast_node_for_get_body( node ) ), isl_ast_expr_handle(), NULL, 0 } );
+          stack.push_back( item{ isl_ast_node_handle(), isl_ast_expr_handle( isl_ast_node_for_get_inc( node ) ), NULL, 0 } );
+          stack.push_back( item{ isl_ast_node_handle(), isl_ast_expr_handle( isl_ast_node_for_get_cond( node ) ), NULL, 0 } );
+          stack.push_back( item{ isl_ast_node_handle(), isl_ast_expr_handle(), id, 1 } );
+          stack.push_back( item{ isl_ast_node_handle(), isl_ast_expr_handle( isl_ast_node_for_get_init( node ) ), NULL, 0 } );
+          break;
+        }
+
+        case isl_ast_node_if:
+          if( isl_ast_node_if_has_else( node ) ){
+            stack.push_back( item{ isl_ast_node_handle( isl_ast_node_if_get_else( node ) ), isl_ast_expr_handle(), NULL, 0 } );
+          }
+          stack.push_back( item{ isl_ast_node_handle( isl_ast_node_if_get_then( node ) ), isl_ast_expr_handle(), NULL, 0 } );
+          stack.push_back( item{ isl_ast_node_handle(), isl_ast_expr_handle( isl_ast_node_if_get_cond( node ) ), NULL, 0 } );
+          break;
+
+        case isl_ast_node_block: {
+          isl_ast_node_list_handle children( isl_ast_node_block_get_children( node ) );
+          for( int i = isl_ast_node_list_n_ast_node( children.get() ) - 1; i >= 0; i -= 1 ){
+            stack.push_back( item{ isl_ast_node_handle( isl_ast_node_list_get_ast_node( children.get(), i ) ), isl_ast_expr_handle(), NULL, 0 } );
+          }
+          break;
+        }
+
+        case isl_ast_node_mark:
+          stack.push_back( item{ isl_ast_node_handle( isl_ast_node_mark_get_node( node ) ), isl_ast_expr_handle(), NULL, 0 } );
+          break;
+
+        case isl_ast_node_user:
+          stack.push_back( item{ isl_ast_node_handle(), isl_ast_expr_handle( isl_ast_node_user_get_expr( node ) ), NULL, 0 } );
+          break;
+
+        default:
+          break;
+      }
+    }
+  }
+}
 
-    default:
-      result = this->visit_expr_unknown( node );
-      break;
+vector<string> SageTransformationWalker::resolve_free_ids(){
+  vector<isl_id*> unresolved;
+  collect_free_ids( this->isl_root, unresolved );
+
+  // Innermost scope first, each scope's symbol table probed once for every
+  // identifier still unresolved
+  for( deque<SgScopeStatement*>::reverse_iterator scope = this->scope_stack.rbegin(); scope != this->scope_stack.rend() && ! unresolved.empty(); ++scope ){
+    vector<isl_id*>::size_type kept = 0;
+    for( vector<isl_id*>::size_type i = 0; i < unresolved.size(); i += 1 ){
+      SgVariableSymbol* symbol = (*scope)->lookup_variable_symbol( SgName( isl_id_get_name( unresolved[i] ) ) );
+      if( symbol != NULL ){
+        this->cache_symbol( unresolved[i], symbol );
+        this->stats.symbol_misses += 1;
+      }
+      else {
+        unresolved[kept] = unresolved[i];
+        kept += 1;
+      }
+    }
+    unresolved.resize( kept );
   }
 
-  this->depth -= 1;
-  return result;
+  vector<string> names;
+  for( vector<isl_id*>::iterator it = unresolved.begin(); it != unresolved.end(); ++it ){
+    names.push_back( isl_id_get_name( *it ) );
+  }
+  return names;
 }
 
-SgNode* SageTransformationWalker::visit( isl_ast_node* node ){
-  this->depth += 1;
-  SgNode* result = NULL;
-
-  switch( isl_ast_node_get_type(node) ){
-    case isl_ast_node_error:
-      result = this->visit_node_error( node );
-      break;
+vector<function_call_info>* SageTransformationWalker::getStatementMacroNodes(){
+  return &(this->statement_macros);
+}
 
-    case isl_ast_node_for:
-      result = this->visit_node_for( node );
-      break;
+walker_trace& SageTransformationWalker::getTrace(){
+  return this->trace;
+}
 
-    case isl_ast_node_if:
-      result = this->visit_node_if( node );
-      break;
+walker_stats& SageTransformationWalker::getStats(){
+  return this->stats;
+}
 
-    case isl_ast_node_block:
-      result = this->visit_node_block( node );
-      break;
+SgScopeStatement* SageTransformationWalker::getInjectionRoot(){
+  return this->injection_site;
+}
 
-    case isl_ast_node_mark:
-      result = this->visit_node_mark( node );
-      break;
 
-    case isl_ast_node_user:
-      result = this->visit_node_user( node );
-      break;
+SgNode* SageTransformationWalker::visit( isl_ast_expr* node ){
+  if( this->options.iterative ){
+    return this->visit_iterative( node );
+  }
 
-    default:
-      result = this->visit_node_unknown( node );
-      break;
+  if( this->options.collect_stats ){
+    this->stats.enter( walker_stats::method_of( node ) );
   }
 
+  this->depth += 1;
+  SgNode* result = ISLWalker::visit( node );
   this->depth -= 1;
+
+  if( this->options.collect_stats ){
+    this->stats.leave( result );
+  }
   return result;
 }
 
-SgNode* SageTransformationWalker::visit_expr_op(isl_ast_expr* node){
-  this->depth += 1;
-  SgNode* result = NULL;
+SgNode* SageTransformationWalker::visit( isl_ast_node* node ){
+  if( this->options.iterative ){
+    return this->visit_iterative( node );
+  }
 
-  switch( isl_ast_expr_get_op_type(node) ){
-    case isl_ast_op_error:
-      result = this->visit_op_error( node );
-      break;
+  if( this->options.collect_stats ){
+    this->stats.enter( walker_stats::method_of( node ) );
+  }
 
-    case isl_ast_op_and:
-      result = this->visit_op_and( node );
-      break;
+  this->depth += 1;
+  SgNode* result = ISLWalker::visit( node );
+  this->depth -= 1;
 
-    case isl_ast_op_and_then:
-      result = this->visit_op_and_then( node );
-      break;
+  if( this->options.collect_stats ){
+    this->stats.leave( result );
+  }
+  return result;
+}
 
-    case isl_ast_op_or:
-      result = this->visit_op_or( node );
-      break;
+SgExpression* SageTransformationWalker::visit_memoized( isl_ast_expr* node ){
+  // Identifiers and literals cost no more to build than to copy
+  if( ! this->options.memoize_exprs || isl_ast_expr_get_type( node ) != isl_ast_expr_op ){
+    return isSgExpression( this->visit( node ) );
+  }
 
-    case isl_ast_op_or_else:
-      result = this->visit_op_or_else( node );
-      break;
+  string key;
+  expr_memo::key( node, this->symbol_cache, key );
+  SgExpression* copy = this->memo.find( key );
+  if( copy != NULL ){
+    this->stats.memo_hits += 1;
+    this->trace.record( "memo hit", this->depth + 1, copy );
+    return copy;
+  }
+  this->stats.memo_misses += 1;
 
-    case isl_ast_op_max:
-      result = this->visit_op_max( node );
-      break;
+  // Only the whole expression is kept: its operations are built by the
+  // driver the options choose, and copied once
+  SgExpression* exp = isSgExpression( this->visit( node ) );
+  assert( exp != NULL );
+  this->memo.record( key, exp );
+  return exp;
+}
 
-    case isl_ast_op_min:
-      result = this->visit_op_min( node );
-      break;
+/*
+Post-order evaluation of an expression tree on an explicit stack.
+Operands of an operation are built first and parked on the results stack;
+the operation's visit_op_* method is then called as usual, and
+visit_op_operand hands it the parked operands instead of recursing.
+depth is set to the value the recursive walk would have at each point.
+*/
+SgNode* SageTransformationWalker::visit_iterative( isl_ast_expr* root ){
+  vector<expr_frame>& stack = this->expr_stack;
+  vector<SgNode*>& results = this->expr_results;
+
+  // Frames below these marks belong to an enclosing call
+  vector<expr_frame>::size_type stack_base = stack.size();
+  vector<SgNode*>::size_type results_base = results.size();
+
+  int saved_depth = this->depth;
+  vector<SgNode*>* saved_operands = this->ready_operands;
+  vector<SgNode*>::size_type saved_base = this->ready_operands_base;
+
+  expr_frame root_frame = { isl_ast_expr_handle(), root, this->depth + 1, 0, 0, 0 };
+  stack.push_back( std::move( root_frame ) );
+
+  while( stack.size() > stack_base ){
+    expr_frame& frame = stack.back();
+
+    if( isl_ast_expr_get_type( frame.expr ) != isl_ast_expr_op ){
+      // Leaves are visited directly
+      this->depth = frame.depth;
+      if( this->options.collect_stats ){
+        this->stats.enter( walker_stats::method_of( frame.expr ) );
+      }
+      SgNode* result = ISLWalker::visit( frame.expr );
+      if( this->options.collect_stats ){
+        this->stats.leave( result );
+      }
+      stack.pop_back();
+      results.push_back( result );
+      continue;
+    }
 
-    case isl_ast_op_minus:
-      result = this->visit_op_minus( node );
-      break;
+    if( frame.next == 0 && frame.n_args == 0 ){
+      frame.n_args = isl_ast_expr_get_op_n_arg( frame.expr );
+      frame.base = results.size();
+      if( this->options.collect_stats ){
+        this->stats.enter( walker_stats::method_of( frame.expr ) );
+      }
+    }
 
-    case isl_ast_op_add:
-      result = this->visit_op_add( node );
-      break;
+    if( frame.next < frame.n_args ){
+      int pos = frame.next;
+      frame.next += 1;
 
-    case isl_ast_op_sub:
-      result = this->visit_op_sub( node );
-      break;
+      // The first operand of a call is the function name, not a variable
+      if( pos == 0 && isl_ast_expr_get_op_type( frame.expr ) == isl_ast_op_call ){
+        results.push_back( NULL );
+        continue;
+      }
 
-    case isl_ast_op_mul:
-      result = this->visit_op_mul( node );
-      break;
+      isl_ast_expr* arg = isl_ast_expr_get_op_arg( frame.expr, pos );
+      expr_frame child = { isl_ast_expr_handle( arg ), arg, frame.depth + 2, 0, 0, 0 };
+      stack.push_back( std::move( child ) );
+      continue;
+    }
 
-    case isl_ast_op_div:
-      result = this->visit_op_div( node );
-      break;
+    // All operands built; construct the operation from them
+    vector<SgNode*>::size_type base = frame.base;
+    this->depth = frame.depth + 1;
+    this->ready_operands = &results;
+    this->ready_operands_base = base;
+    SgNode* result = ISLWalker::visit_expr_op( frame.expr );
+    this->ready_operands = NULL;
+    if( this->options.collect_stats ){
+      this->stats.leave( result );
+    }
 
-    case isl_ast_op_fdiv_q:
-      result = this->visit_op_fdiv_q( node );
-      break;
+    results.resize( base );
+    stack.pop_back();
+    results.push_back( result );
+  }
 
-    case isl_ast_op_pdiv_q:
-      result = this->visit_op_pdiv_q( node );
-      break;
+  this->depth = saved_depth;
+  this->ready_operands = saved_operands;
+  this->ready_operands_base = saved_base;
 
-    case isl_ast_op_pdiv_r:
-      result = this->visit_op_pdiv_r( node );
-      break;
+  assert( results.size() == results_base + 1 );
+  SgNode* result = results.back();
+  results.pop_back();
 
-    case isl_ast_op_zdiv_r:
-      result = this->visit_op_zdiv_r( node );
-      break;
+  return result;
+}
 
-    case isl_ast_op_cond:
-      result = this->visit_op_cond( node );
-      break;
+/*
+Statement traversal on an explicit stack.
+for, if and block nodes are split into the same enter and leave phases the
+recursive visit_node_* methods use, with their child statements pushed as
+frames in between. Expressions are handed to the expression driver, and the
+remaining node kinds have no child statements, so are visited directly.
+*/
+SgNode* SageTransformationWalker::visit_iterative( isl_ast_node* root ){
+  vector<node_frame>& stack = this->node_stack;
+  vector<node_frame>::size_type stack_base = stack.size();
+  SgNode* last = NULL;
 
-    case isl_ast_op_select:
-      result = this->visit_op_select( node );
-      break;
+  int saved_depth = this->depth;
 
-    case isl_ast_op_eq:
-      result = this->visit_op_eq( node );
-      break;
+  node_frame root_frame = { isl_ast_node_handle(), root, this->depth + 1, 0, { NULL, NULL }, isl_ast_node_list_handle() };
+  stack.push_back( std::move( root_frame ) );
 
-    case isl_ast_op_le:
-      result = this->visit_op_le( node );
-      break;
+  while( stack.size() > stack_base ){
+    node_frame& frame = stack.back();
+    this->depth = frame.depth;
 
-    case isl_ast_op_lt:
-      result = this->visit_op_lt( node );
-      break;
+    // Child statement to visit next, if any
+    isl_ast_node* child = NULL;
+    int child_depth = frame.depth + 1;
 
-    case isl_ast_op_ge:
-      result = this->visit_op_ge( node );
-      break;
+    // Every frame starts in state 0, and leaves it on its first step
+    vector<node_frame>::size_type frames = stack.size();
+    if( this->options.collect_stats && frame.state == 0 ){
+      this->stats.enter( walker_stats::method_of( frame.node ) );
+    }
 
-    case isl_ast_op_gt:
-      result = this->visit_op_gt( node );
-      break;
+    switch( isl_ast_node_get_type( frame.node ) ){
+      case isl_ast_node_for: {
+        if( frame.state == 0 ){
+          frame.partial[0] = this->enter_node_for( frame.node );
+          frame.state = 1;
+
+          child = isl_ast_node_for_get_body( frame.node );
+          child_depth = this->depth + 1;
+        } else {
+          this->depth += 1;
+          last = this->leave_node_for( frame.node, isSgForStatement( frame.partial[0] ), isSgStatement( last ) );
+          stack.pop_back();
+        }
+        break;
+      }
+
+      case isl_ast_node_if: {
+        if( frame.state == 0 ){
+          isl_ast_expr_handle cond( isl_ast_node_if_get_cond( frame.node ) );
+          frame.partial[0] = this->visit_memoized( cond.get() );
+          frame.state = 1;
+
+          child = isl_ast_node_if_get_then( frame.node );
+        } else if( frame.state == 1 && isl_ast_node_if_has_else( frame.node ) ){
+          frame.partial[1] = last;
+          frame.state = 2;
+
+          child = isl_ast_node_if_get_else( frame.node );
+        } else {
+          SgNode* then_node = ( frame.state == 1 ) ? last : frame.partial[1];
+          SgNode* else_node = ( frame.state == 1 ) ? NULL : last;
+          last = this->leave_node_if( frame.node, isSgExpression( frame.partial[0] ), isSgStatement( then_node ), isSgStatement( else_node ) );
+          stack.pop_back();
+        }
+        break;
+      }
+
+      case isl_ast_node_block: {
+        if( frame.state == 0 ){
+          frame.partial[0] = this->enter_node_block( frame.node );
+          frame.children.reset( isl_ast_node_block_get_children( frame.node ) );
+        } else {
+          this->visited_block_child( isSgBasicBlock( frame.partial[0] ), isSgStatement( last ) );
+        }
+
+        // state counts the children visited so far
+        if( frame.state < isl_ast_node_list_n_ast_node( frame.children.get() ) ){
+          child = isl_ast_node_list_get_ast_node( frame.children.get(), frame.state );
+          frame.state += 1;
+        } else {
+          last = this->leave_node_block( frame.node, isSgBasicBlock( frame.partial[0] ) );
+          stack.pop_back();
+        }
+        break;
+      }
+
+      case isl_ast_node_mark: {
+        if( frame.state == 0 ){
+          frame.state = 1;
+
+          child = isl_ast_node_mark_get_node( frame.node );
+        } else {
+          last = this->leave_node_mark( frame.node, isSgStatement( last ) );
+          stack.pop_back();
+        }
+        break;
+      }
+
+      default:
+        // No child statements
+        last = ISLWalker::visit( frame.node );
+        stack.pop_back();
+        break;
+    }
 
-    case isl_ast_op_call:
-      result = this->visit_op_call( node );
-      break;
+    if( this->options.collect_stats && stack.size() < frames ){
+      this->stats.leave( last );
+    }
 
-    case isl_ast_op_access:
-      result = this->visit_op_access( node );
-      break;
-
-    case isl_ast_op_member:
-      result = this->visit_op_member( node );
-      break;
+    if( child != NULL ){
+      node_frame child_frame = { isl_ast_node_handle( child ), child, child_depth, 0, { NULL, NULL }, isl_ast_node_list_handle() };
+      stack.push_back( std::move( child_frame ) );
+    }
+  }
 
-    case isl_ast_op_address_of:
-      result = this->visit_op_address_of( node );
-      break;
+  this->depth = saved_depth;
 
-    default:
-      result = this->visit_op_unknown( node );
-      break;
-  }
+  return last;
+}
 
+SgNode* SageTransformationWalker::visit_expr_op(isl_ast_expr* node){
+  this->depth += 1;
+  SgNode* result = ISLWalker::visit_expr_op( node );
   this->depth -= 1;
   return result;
 }
 
 
-list<SgNode*> SageTransformationWalker::visit_expr_operands(isl_ast_expr* node ){
-  list<SgNode*> operands_list;
+SgExpression* SageTransformationWalker::visit_op_operand( isl_ast_expr* node, int pos ){
+  assert( isl_ast_expr_get_op_n_arg(node) > pos );
 
-  for( int i = 0; i < isl_ast_expr_get_op_n_arg(node); i += 1 ){
-    operands_list.push_back( this->visit_op_operand( node, i ) );
+  // In iterative mode the operands have already been built
+  if( this->ready_operands != NULL ){
+    SgExpression* sg_expr = isSgExpression( (*this->ready_operands)[this->ready_operands_base + pos] );
+    assert( sg_expr != NULL );
+    return sg_expr;
   }
 
-  return operands_list;
-}
-
-SgExpression* SageTransformationWalker::visit_op_operand( isl_ast_expr* node, int pos ){
-  assert( isl_ast_expr_get_op_n_arg(node) > pos );
-  SgExpression* sg_expr = isSgExpression( this->visit( isl_ast_expr_get_op_arg( node, pos ) ) );
+  isl_ast_expr_handle arg( isl_ast_expr_get_op_arg( node, pos ) );
+  SgExpression* sg_expr = isSgExpression( this->visit( arg.get() ) );
 
   assert( sg_expr != NULL );
 
@@ -368,9 +742,7 @@ SgExpression*  SageTransformationWalker::visit_op_and( isl_ast_expr* node ){
   // Construct using templated buildBinaryExpression
   SgExpression* exp = buildBinaryExpression<SgAndOp>( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation and @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation and", this->depth, exp );
 
   return exp;
 }
@@ -385,9 +757,7 @@ SgExpression*  SageTransformationWalker::visit_op_and_then(isl_ast_expr* node){
   // Construct using templated buildBinaryExpression
   SgExpression* exp = buildBinaryExpression<SgAndOp>( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation and_then @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation and_then", this->depth, exp );
 
   return exp;
 }
@@ -402,9 +772,7 @@ SgExpression* SageTransformationWalker::visit_op_or(isl_ast_expr* node){
   // Construct using templated buildBinaryExpression
   SgExpression* exp = buildBinaryExpression<SgOrOp>( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation or @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation or", this->depth, exp );
 
   return exp;
 }
@@ -419,9 +787,7 @@ SgExpression* SageTransformationWalker::visit_op_or_else(isl_ast_expr* node){
   // Construct using templated buildBinaryExpression
   SgExpression* exp = buildBinaryExpression<SgOrOp>( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation or_else @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation or_else", this->depth, exp );
 
   return exp;
 }
@@ -429,55 +795,33 @@ SgExpression* SageTransformationWalker::visit_op_or_else(isl_ast_expr* node){
 SgExpression* SageTransformationWalker::visit_op_max(isl_ast_expr* node){
   assert( isl_ast_expr_get_op_n_arg(node) >= 2 );
 
-  int last = isl_ast_expr_get_op_n_arg(node)-1;
-
-  SgName name( "max" );
-
-  vector<SgExpression*> parameter_expressions;
-  SgExpression* head = this->visit_op_operand( node, last );
-
-  for( int i = last-1; i >= 0; i -= 1 ){
-    parameter_expressions.clear();
-    parameter_expressions.push_back( head );
-    parameter_expressions.push_back( this->visit_op_operand(node, i) );
-
-    SgExprListExp* parameters = buildExprListExp( parameter_expressions );
+  vector<SgExpression*> operands;
+  for( int i = 0; i < isl_ast_expr_get_op_n_arg(node); i += 1 ){
+    operands.push_back( this->visit_op_operand( node, i ) );
+  }
 
-    head = buildFunctionCallExp( name, buildIntType(), parameters, this->get_global() );
+  // Balanced tree of pairs, without dominated literals or repeats
+  SgExpression* exp = this->arith.max( operands, width_analysis::operation_type( this->widths.get(), operands, this->get_global() ) );
 
-    if( this->verbose ){
-      cout << string(this->depth*2, ' ') << "max @ " << static_cast<void*>(head) << endl;
-    }
-  }
+  this->trace.record( "max", this->depth, exp );
 
-  return head;
+  return exp;
 }
 
 SgExpression* SageTransformationWalker::visit_op_min(isl_ast_expr* node){
   assert( isl_ast_expr_get_op_n_arg(node) >= 2 );
 
-  int last = isl_ast_expr_get_op_n_arg(node)-1;
-
-  SgName name( "min" );
-
-  vector<SgExpression*> parameter_expressions;
-  SgExpression* head = this->visit_op_operand( node, last );
-
-  for( int i = last-1; i >= 0; i -= 1 ){
-    parameter_expressions.clear();
-    parameter_expressions.push_back( head );
-    parameter_expressions.push_back( this->visit_op_operand(node, i) );
+  vector<SgExpression*> operands;
+  for( int i = 0; i < isl_ast_expr_get_op_n_arg(node); i += 1 ){
+    operands.push_back( this->visit_op_operand( node, i ) );
+  }
 
-    SgExprListExp* parameters = buildExprListExp( parameter_expressions );
+  // Balanced tree of pairs, without dominated literals or repeats
+  SgExpression* exp = this->arith.min( operands, width_analysis::operation_type( this->widths.get(), operands, this->get_global() ) );
 
-    head = buildFunctionCallExp( name, buildIntType(), parameters, this->get_global() );
+  this->trace.record( "min", this->depth, exp );
 
-    if( this->verbose ){
-      cout << string(this->depth*2, ' ') << "min @ " << static_cast<void*>(head) << endl;
-    }
-  }
-
-  return head;
+  return exp;
 }
 
 // Unary minus
@@ -487,12 +831,10 @@ SgExpression* SageTransformationWalker::visit_op_minus(isl_ast_expr* node){
   // Get child node
   SgExpression* arg = this->visit_op_unary_operand( node );
 
-  // Construct using templated buildBinaryExpression
-  SgExpression* exp = buildUnaryExpression<SgMinusOp>( arg );
+  // Operator, or the folded affine form with options.fold_affine
+  SgExpression* exp = this->affine.minus( arg );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation minus @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation minus", this->depth, exp );
 
   return exp;
 }
@@ -504,12 +846,10 @@ SgExpression* SageTransformationWalker::visit_op_add(isl_ast_expr* node){
   SgExpression* lhs = this->visit_op_lhs( node );
   SgExpression* rhs = this->visit_op_rhs( node );
 
-  // Construct using templated buildBinaryExpression
-  SgExpression* exp = buildBinaryExpression<SgAddOp>( lhs, rhs );
+  // Operator, or the folded affine form with options.fold_affine
+  SgExpression* exp = this->affine.add( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation add @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation add", this->depth, exp );
 
   return exp;
 }
@@ -521,12 +861,10 @@ SgExpression* SageTransformationWalker::visit_op_sub(isl_ast_expr* node){
   SgExpression* lhs = this->visit_op_lhs( node );
   SgExpression* rhs = this->visit_op_rhs( node );
 
-  // Construct using templated buildBinaryExpression
-  SgExpression* exp = buildBinaryExpression<SgSubtractOp>( lhs, rhs );
+  // Operator, or the folded affine form with options.fold_affine
+  SgExpression* exp = this->affine.sub( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation sub @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation sub", this->depth, exp );
 
   return exp;
 }
@@ -538,12 +876,10 @@ SgExpression* SageTransformationWalker::visit_op_mul(isl_ast_expr* node){
   SgExpression* lhs = this->visit_op_lhs( node );
   SgExpression* rhs = this->visit_op_rhs( node );
 
-  // Construct using templated buildBinaryExpression
-  SgExpression* exp = buildBinaryExpression<SgMultiplyOp>( lhs, rhs );
+  // Operator, or the folded affine form with options.fold_affine
+  SgExpression* exp = this->affine.mul( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation mul @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation mul", this->depth, exp );
 
   return exp;
 }
@@ -558,9 +894,7 @@ SgExpression* SageTransformationWalker::visit_op_div(isl_ast_expr* node){
   // Construct using templated buildBinaryExpression
   SgExpression* exp = buildBinaryExpression<SgDivideOp>( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation div @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation div", this->depth, exp );
 
   return exp;
 }
@@ -568,22 +902,14 @@ SgExpression* SageTransformationWalker::visit_op_div(isl_ast_expr* node){
 SgExpression* SageTransformationWalker::visit_op_fdiv_q(isl_ast_expr* node){
   assert( isl_ast_expr_get_op_n_arg(node) == 2 );
 
-  // Get function name
-  SgName name( "floord" );
-
-  // Build parameters list
-  vector<SgExpression*> parameter_expressions;
-  parameter_expressions.push_back( this->visit_op_lhs( node ) );
-  parameter_expressions.push_back( this->visit_op_rhs( node ) );
-
-  SgExprListExp* parameters = buildExprListExp( parameter_expressions );
+  SgExpression* lhs = this->visit_op_lhs( node );
+  SgExpression* rhs = this->visit_op_rhs( node );
 
-  // Build call
-  SgExpression* call = buildFunctionCallExp( name, buildIntType(), parameters, this->get_global() );
+  // floord call, definition or expression, as options.intrinsics asks
+  SgType* type = width_analysis::operation_type( this->widths.get(), { lhs, rhs }, this->get_global() );
+  SgExpression* call = this->arith.floord( lhs, rhs, type );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "fdiv_q @ " << static_cast<void*>(call) << endl;
-  }
+  this->trace.record( "fdiv_q", this->depth, call );
 
   return call;
 }
@@ -595,12 +921,10 @@ SgExpression* SageTransformationWalker::visit_op_pdiv_q(isl_ast_expr* node){
   SgExpression* lhs = this->visit_op_lhs( node );
   SgExpression* rhs = this->visit_op_rhs( node );
 
-  // Construct using templated buildBinaryExpression
-  SgExpression* exp = buildBinaryExpression<SgDivideOp>( lhs, rhs );
+  // Operator, or shift or mask with options.strength_reduce
+  SgExpression* exp = this->arith.pdiv_q( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation pdiv_q @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation pdiv_q", this->depth, exp );
 
   return exp;
 }
@@ -612,12 +936,10 @@ SgExpression* SageTransformationWalker::visit_op_pdiv_r(isl_ast_expr* node){
   SgExpression* lhs = this->visit_op_lhs( node );
   SgExpression* rhs = this->visit_op_rhs( node );
 
-  // Construct using templated buildBinaryExpression
-  SgExpression* exp = buildBinaryExpression<SgModOp>( lhs, rhs );
+  // Operator, or shift or mask with options.strength_reduce
+  SgExpression* exp = this->arith.pdiv_r( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation pdiv_r @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation pdiv_r", this->depth, exp );
 
   return exp;
 }
@@ -629,12 +951,10 @@ SgExpression* SageTransformationWalker::visit_op_zdiv_r(isl_ast_expr* node){
   SgExpression* lhs = this->visit_op_lhs( node );
   SgExpression* rhs = this->visit_op_rhs( node );
 
-  // Construct using templated buildBinaryExpression
-  SgExpression* exp = buildBinaryExpression<SgModOp>( lhs, rhs );
+  // Operator, or shift or mask with options.strength_reduce
+  SgExpression* exp = this->arith.zdiv_r( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation zdiv_r @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation zdiv_r", this->depth, exp );
 
   return exp;
 }
@@ -648,9 +968,7 @@ SgExpression* SageTransformationWalker::visit_op_cond(isl_ast_expr* node){
 
   SgExpression* exp = buildConditionalExp( condition, then_exp, else_exp );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation cond @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation cond", this->depth, exp );
 
   return exp;
 }
@@ -664,9 +982,7 @@ SgExpression* SageTransformationWalker::visit_op_select(isl_ast_expr* node){
 
   SgExpression* exp = buildConditionalExp( condition, then_exp, else_exp );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation select @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation select", this->depth, exp );
 
   return exp;
 }
@@ -681,9 +997,7 @@ SgExpression* SageTransformationWalker::visit_op_eq(isl_ast_expr* node){
   // Construct using templated buildBinaryExpression
   SgExpression* exp = buildBinaryExpression<SgEqualityOp>( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation eq @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation eq", this->depth, exp );
 
   return exp;
 }
@@ -698,9 +1012,7 @@ SgExpression* SageTransformationWalker::visit_op_le(isl_ast_expr* node){
   // Construct using templated buildBinaryExpression
   SgExpression* exp = buildBinaryExpression<SgLessOrEqualOp>( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation le @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation le", this->depth, exp );
 
   return exp;
 }
@@ -715,9 +1027,7 @@ SgExpression* SageTransformationWalker::visit_op_lt(isl_ast_expr* node){
   // Construct using templated buildBinaryExpression
   SgExpression* exp = buildBinaryExpression<SgLessThanOp>( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation lt @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation lt", this->depth, exp );
 
   return exp;
 }
@@ -732,9 +1042,7 @@ SgExpression* SageTransformationWalker::visit_op_ge(isl_ast_expr* node){
   // Construct using templated buildBinaryExpression
   SgExpression* exp = buildBinaryExpression<SgGreaterOrEqualOp>( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation ge @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation ge", this->depth, exp );
 
   return exp;
 }
@@ -749,9 +1057,7 @@ SgExpression* SageTransformationWalker::visit_op_gt(isl_ast_expr* node){
   // Construct using templated buildBinaryExpression
   SgExpression* exp = buildBinaryExpression<SgGreaterThanOp>( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation gt @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation gt", this->depth, exp );
 
   return exp;
 }
@@ -759,16 +1065,17 @@ SgExpression* SageTransformationWalker::visit_op_gt(isl_ast_expr* node){
 SgExprStatement* SageTransformationWalker::visit_op_call(isl_ast_expr* node){
   assert( isl_ast_expr_get_op_n_arg(node) >= 1 );
   // Get function name
-  SgName name( isl_id_get_name( isl_ast_expr_get_id( isl_ast_expr_get_op_arg( node, 0 ) ) ) );
+  isl_ast_expr_handle name_expr( isl_ast_expr_get_op_arg( node, 0 ) );
+  isl_id_handle name_id( isl_ast_expr_get_id( name_expr.get() ) );
+  SgName name( isl_id_get_name( name_id.get() ) );
 
   // Build parameters list
   vector<SgExpression*> parameter_expressions;
+  parameter_expressions.reserve( isl_ast_expr_get_op_n_arg(node) - 1 );
   for( int i = 1; i < isl_ast_expr_get_op_n_arg(node); i += 1 ){
     SgExpression* as_exp = this->visit_op_operand(node, i);
 
-    if( this->verbose ){
-      cout << string(this->depth*2, ' ') << "exp @ " << static_cast<void*>(as_exp) << endl;
-    }
+    this->trace.record( "exp", this->depth, as_exp );
 
     parameter_expressions.push_back( as_exp );
   }
@@ -777,12 +1084,9 @@ SgExprStatement* SageTransformationWalker::visit_op_call(isl_ast_expr* node){
 
   // Build call
   SgExprStatement* call = buildFunctionCallStmt( name, buildVoidType(), parameters, this->get_global() );
-  function_call_info* info = new function_call_info( call, name, parameter_expressions);
-  statement_macros.push_back( info );
+  statement_macros.push_back( function_call_info( call, name, parameter_expressions ) );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Call @ " << static_cast<void*>(call) << endl;
-  }
+  this->trace.record( "Call", this->depth, call );
 
   return call;
 }
@@ -800,9 +1104,7 @@ SgExpression* SageTransformationWalker::visit_op_access(isl_ast_expr* node){
     // Replace head with the new access expression
     head = buildBinaryExpression<SgPntrArrRefExp>( head, this->visit_op_operand(node, i) );
 
-    if( this->verbose ){
-      cout << string(this->depth*2, ' ') << "access @ " << static_cast<void*>(head) << endl;
-    }
+    this->trace.record( "access", this->depth, head );
   }
 
   return head;
@@ -818,9 +1120,7 @@ SgExpression* SageTransformationWalker::visit_op_member(isl_ast_expr* node){
   // Construct using templated buildBinaryExpression
   SgExpression* exp = buildBinaryExpression<SgDotExp>( lhs, rhs );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation gt @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation gt", this->depth, exp );
 
   return exp;
 }
@@ -834,9 +1134,7 @@ SgExpression* SageTransformationWalker::visit_op_address_of(isl_ast_expr* node){
   // Construct using templated buildBinaryExpression
   SgExpression* exp = buildUnaryExpression<SgAddressOfOp>( arg );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Operation address_of @ " << static_cast<void*>(exp) << endl;
-  }
+  this->trace.record( "Operation address_of", this->depth, exp );
 
   return exp;
 }
@@ -848,42 +1146,53 @@ SgExpression* SageTransformationWalker::visit_op_unknown(isl_ast_expr* node){
 
 
 SgVarRefExp* SageTransformationWalker::visit_expr_id(isl_ast_expr* node){
-  SgName name( isl_id_get_name( isl_ast_expr_get_id(node) ) );
-  SgVariableSymbol* symbol = get_symbol( name.getString() );
+  isl_id_handle id( isl_ast_expr_get_id(node) );
+  SgVariableSymbol* symbol = get_symbol( id.get() );
 
   // Get symbol from parent scope
   if( symbol == NULL ){
-    symbol = lookupVariableSymbolInParentScopes( name, this->injection_site ) ;
+    symbol = lookupVariableSymbolInParentScopes( SgName( isl_id_get_name( id.get() ) ), this->injection_site ) ;
     assert( symbol != NULL );
-    this->set_symbol( name.getString(), symbol );
+    this->cache_symbol( id.get(), symbol );
+    this->stats.symbol_misses += 1;
+  } else {
+    this->stats.symbol_hits += 1;
   }
 
   SgVarRefExp* var_ref = buildVarRefExp( symbol );
 
-  if( this->verbose ){
-    cout << string((this->depth+1)*2, ' ') << "var symbol @ " << static_cast<void*>(symbol) << endl;
-    cout << string((this->depth+1)*2, ' ') << "var symbol name: " << symbol->get_name().getString() << endl;
-    cout << string(this->depth*2, ' ') << "id: " << name.getString() << " @ " << var_ref << endl;
-  }
+  this->trace.record_id( "var symbol", this->depth+1, symbol, id.get() );
+  this->trace.record_id( "id", this->depth, var_ref, id.get() );
 
   return var_ref;
 }
 
-SgIntVal* SageTransformationWalker::visit_expr_int(isl_ast_expr* node){
-  isl_val* isl_value = isl_ast_expr_get_val( node );
-  long num = isl_val_get_num_si( isl_value );
-  long den = isl_val_get_den_si( isl_value );
-  assert( den == 1 );
-
-  int int_value = (int) num;
-  assert( ((long) int_value) == num );
+SgValueExp* SageTransformationWalker::visit_expr_int(isl_ast_expr* node){
+  isl_val_handle isl_value( isl_ast_expr_get_val( node ) );
+  assert( isl_val_is_int( isl_value.get() ) == isl_bool_true );
 
-  SgIntVal* value = buildIntVal( int_value );
+  // No C type holds a literal beyond 64 bits, for which isl_val_get_num_si
+  // would return 0
+  bool fits = isl_val_cmp_si( isl_value.get(), LONG_MAX ) <= 0 && isl_val_cmp_si( isl_value.get(), LONG_MIN ) >= 0;
+  if( ! fits ){
+    char* text = isl_val_to_str( isl_value.get() );
+    cerr << "ISL literal " << text << " does not fit in 64 bits" << endl;
+    free( text );
+  }
+  assert( fits );
+  long num = isl_val_get_num_si( isl_value.get() );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "int: " << int_value << " @ " << static_cast<void*>(value) << endl;
+  // Literals outside 32 bits are long long
+  int int_value = (int) num;
+  SgValueExp* value = NULL;
+  if( ((long) int_value) == num ){
+    value = buildIntVal( int_value );
+  } else {
+    value = buildLongLongIntVal( num );
   }
 
+  this->trace.record_value( "int", this->depth, value, num );
+
   return value;
 }
 
@@ -904,113 +1213,138 @@ SgNode* SageTransformationWalker::visit_node_error(isl_ast_node* node){
 }
 
 SgNode* SageTransformationWalker::visit_node_for(isl_ast_node* node){
+  SgForStatement* for_stmt = this->enter_node_for( node );
+  isl_ast_node_handle isl_body( isl_ast_node_for_get_body( node ) );
+  SgStatement* sg_stmt = isSgStatement( this->visit( isl_body.get() ) );
+  return this->leave_node_for( node, for_stmt, sg_stmt );
+}
+
+SgForStatement* SageTransformationWalker::enter_node_for(isl_ast_node* node){
   this->depth += 1;
+  // The iterator binding belongs to the loop's scope, pushed below
+  vector<symbol_binding>::size_type loop_bindings = this->symbols_mark();
+
   // Build inititialization statement
   SgStatement* initialization = NULL;
-  SgName* name = NULL;
+  SgVariableSymbol* symbol = NULL;
   {
     // Get iterator symbol
-    string isl_name = string( isl_id_get_name( isl_ast_expr_get_id( isl_ast_node_for_get_iterator(node) ) ) );
-    name = new SgName( isl_name );
+    isl_ast_expr_handle iterator( isl_ast_node_for_get_iterator(node) );
+    isl_id_handle iterator_id( isl_ast_expr_get_id( iterator.get() ) );
+    SgName name( isl_id_get_name( iterator_id.get() ) );
 
     // Get initialization expression
-    SgExpression* init_exp = isSgExpression( this->visit( isl_ast_node_for_get_init( node ) ) );
+    isl_ast_expr_handle isl_init( isl_ast_node_for_get_init( node ) );
+    SgExpression* init_exp = this->visit_memoized( isl_init.get() );
 
     assert( init_exp != NULL );
 
     // Build variable declaration
-    SgAssignInitializer* initalizer = buildAssignInitializer( init_exp, buildIntType() );
-    SgVariableDeclaration* var_decl = buildVariableDeclaration( *name, buildIntType(), initalizer, this->top() );
+    SgType* type = this->widths ? this->widths->type( name.getString(), this->get_global() ) : buildIntType();
+    SgAssignInitializer* initalizer = buildAssignInitializer( init_exp, type );
+    SgVariableDeclaration* var_decl = buildVariableDeclaration( name, type, initalizer, this->top() );
 
-    SgVariableSymbol* symbol = SageInterface::getFirstVarSym(var_decl);
-    this->set_symbol( isl_name,  symbol );
+    symbol = SageInterface::getFirstVarSym(var_decl);
+    this->set_symbol( iterator_id.get(), symbol );
 
     // Building the variable decl seems sufficient.
     initialization = var_decl;
-    if( this->verbose ){
-      cout << string((this->depth+2)*2, ' ') << "initalizer @ " << static_cast<void*>(initalizer) << endl;
-      cout << string((this->depth+1)*2, ' ') << "var_decl: " << name->getString() << " @ " << static_cast<void*>(var_decl) << endl;
-      cout << string((this->depth+2)*2, ' ') << "var symbol @ " << static_cast<void*>(symbol) << endl;
-      cout << string((this->depth+2)*2, ' ') << "var symbol name: " << symbol->get_name().getString() << endl;
-      cout << string(this->depth*2, ' ') << "init @ " << static_cast<void*>(initialization) << endl;
-    }
+    this->trace.record( "initalizer", this->depth+2, initalizer );
+    this->trace.record_id( "var_decl", this->depth+1, var_decl, iterator_id.get() );
+    this->trace.record_id( "var symbol", this->depth+2, symbol, iterator_id.get() );
+    this->trace.record( "init", this->depth, initialization );
   }
 
-  // Get condition expression statment
-  SgExprStatement* condition = NULL;
+  // Get condition expression
+  SgExpression* condition_exp = NULL;
   {
-    SgExpression* as_exp = isSgExpression( this->visit( isl_ast_node_for_get_cond( node) ) );
+    isl_ast_expr_handle isl_cond( isl_ast_node_for_get_cond( node) );
+    condition_exp = this->visit_memoized( isl_cond.get() );
 
-    assert( as_exp != NULL );
+    assert( condition_exp != NULL );
 
-    condition = buildExprStatement( as_exp );
-    if( this->verbose ){
-      cout << string(this->depth*2, ' ') << "cond @ " << static_cast<void*>(condition) << endl;
-    }
+    this->trace.record( "cond", this->depth, condition_exp );
   }
 
-  // Get increment expression statement
-  SgExpression* increment = NULL;
+  // Get increment expression
+  SgExpression* increment_exp = NULL;
   {
-
-    SgVarRefExp* var_ref = buildVarRefExp( buildInitializedName( *name, buildIntType() ), this->top() );
-
-    // string tab((this->depth+1)*2, ' ');
-    // if( this->verbose ) cout << string(this->depth*2, ' ') << "var_ref @ " << static_cast<void*>(var_ref) << endl;
-    SgExpression* increment_exp = isSgExpression( this->visit( isl_ast_node_for_get_inc( node ) ) );
+    isl_ast_expr_handle isl_inc( isl_ast_node_for_get_inc( node ) );
+    increment_exp = this->visit_memoized( isl_inc.get() );
 
     assert( increment_exp != NULL );
 
-    if( this->verbose ){
-      cout << string(this->depth*2, ' ') << "exp @ " << static_cast<void*>(increment_exp) << endl;
-    }
+    this->trace.record( "exp", this->depth, increment_exp );
+  }
 
-    // Create increment expression: iterator = iterator + (increment_exp)
-    increment = buildBinaryExpression<SgAssignOp>( copyExpression(var_ref), buildBinaryExpression<SgAddOp>( var_ref, increment_exp ) );
+  // Construct for loop node, in isl's form or the canonical one; the
+  // iterator's symbol is the same either way
+  SgForStatement* for_stmt = this->loops.build( isSgVariableDeclaration( initialization ), condition_exp, increment_exp, this->top() );
+  this->trace.record( "increment", this->depth, for_stmt->get_increment() );
 
-    if( this->verbose ){
-      cout << string(this->depth*2, ' ') << "increment @ " << static_cast<void*>(increment) << endl;
-    }
+  // The outermost loop of a nest annotated parallel runs on OpenMP threads
+  if( this->options.omp_parallel && this->parallel_loop == NULL && parallel_loops::is_parallel( node ) && ! this->loops.unrolls( for_stmt ) ){
+    this->parallel_loop = for_stmt;
   }
 
-  SgBasicBlock* body = buildBasicBlock ();
+  // Body is visited inside the loop's scopes
+  this->push( for_stmt, loop_bindings );
+  this->push( isSgScopeStatement( getLoopBody( for_stmt ) ) );
 
-  // Construct for loop node
-  SgForStatement* for_stmt = buildForStatement( initialization, condition, increment, body );
-  {
-    this->push( for_stmt );
-    this->push( isSgScopeStatement( getLoopBody( for_stmt ) ) );
-    SgStatement* sg_stmt = isSgStatement( this->visit( isl_ast_node_for_get_body( node ) ) );
-    this->pop();
-    this->pop();
+  return for_stmt;
+}
 
-    assert( sg_stmt != NULL );
+SgNode* SageTransformationWalker::leave_node_for(isl_ast_node* node, SgForStatement* for_stmt, SgStatement* sg_stmt){
+  this->pop();
+  this->pop();
 
-    if( isSgBasicBlock(sg_stmt) ){
-      body = isSgBasicBlock( sg_stmt );
-    } else {
-      body = isSgBasicBlock( getLoopBody( for_stmt ) );
+  // After the recomputed iterator of a normalized loop, if any
+  loop_builder::set_body( for_stmt, sg_stmt );
 
-      assert( body != NULL );
+  this->depth -= 1;
+  this->trace.record( "for", this->depth, for_stmt );
 
-      appendStatement( sg_stmt, body );
-    }
-    setLoopBody( for_stmt, body );
+  if( for_stmt == this->parallel_loop ){
+    this->parallel_loop = NULL;
+    return loop_builder::parallelize( for_stmt );
   }
 
-  this->depth -= 1;
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "for @ " << static_cast<void*>(for_stmt) << endl;
+  if( ! this->loops.unrolls( for_stmt ) ){
+    return for_stmt;
   }
 
-  return for_stmt;
+  // The statement macros of the loop, the last ones recorded, are those of
+  // the copies of its body now
+  vector<function_call_info>::size_type first = this->statement_macros.size();
+  while( first > 0 && isAncestor( for_stmt, this->statement_macros[first - 1].expr_node ) ){
+    first -= 1;
+  }
+  this->statement_macros.erase( this->statement_macros.begin() + first, this->statement_macros.end() );
+  // Unrolling deletes the iterator's symbol, which memo keys may name
+  this->memo.clear();
+  SgStatement* unrolled = this->loops.unroll( for_stmt );
+  function_call_info::collect( unrolled, this->statement_macros );
+  return unrolled;
 }
 
 SgNode* SageTransformationWalker::visit_node_if(isl_ast_node* node){
-  SgExpression* condition_node = isSgExpression( this->visit( isl_ast_node_if_get_cond(node) ) );
-  assert( condition_node != NULL );
+  isl_ast_expr_handle isl_cond( isl_ast_node_if_get_cond(node) );
+  SgExpression* condition_node = this->visit_memoized( isl_cond.get() );
+
+  isl_ast_node_handle isl_then( isl_ast_node_if_get_then(node) );
+  SgStatement* then_node = isSgStatement( this->visit( isl_then.get() ) );
+
+  SgStatement* else_node = NULL;
+  if( isl_ast_node_if_has_else( node ) ){
+    isl_ast_node_handle isl_else( isl_ast_node_if_get_else(node) );
+    else_node = isSgStatement( this->visit( isl_else.get() ) );
+  }
 
-  SgStatement* then_node = isSgStatement( this->visit( isl_ast_node_if_get_then(node) ) );
+  return this->leave_node_if( node, condition_node, then_node, else_node );
+}
+
+SgNode* SageTransformationWalker::leave_node_if(isl_ast_node* node, SgExpression* condition_node, SgStatement* then_node, SgStatement* else_node){
+  assert( condition_node != NULL );
   assert( then_node != NULL );
 
   // Always wrap statements as blocks
@@ -1019,9 +1353,7 @@ SgNode* SageTransformationWalker::visit_node_if(isl_ast_node* node){
     then_node = block;
   }
 
-  SgStatement* else_node = NULL;
   if( isl_ast_node_if_has_else( node ) ){
-    else_node = isSgStatement( this->visit( isl_ast_node_if_get_else(node) ) );
     assert( else_node != NULL );
 
     if( isSgBasicBlock( else_node) ){
@@ -1036,35 +1368,59 @@ SgNode* SageTransformationWalker::visit_node_if(isl_ast_node* node){
 }
 
 SgNode* SageTransformationWalker::visit_node_block(isl_ast_node* node){
+  SgBasicBlock* block = this->enter_node_block( node );
+
+  isl_ast_node_list_handle list( isl_ast_node_block_get_children(node) );
+  for( int i = 0; i < isl_ast_node_list_n_ast_node(list.get()); i += 1 ){
+    isl_ast_node_handle child( isl_ast_node_list_get_ast_node(list.get(), i) );
+    this->visited_block_child( block, isSgStatement( this->visit( child.get() ) ) );
+  }
+
+  return this->leave_node_block( node, block );
+}
+
+SgBasicBlock* SageTransformationWalker::enter_node_block(isl_ast_node* node){
   SgBasicBlock* block = buildBasicBlock();
 
   this->push( block );
 
-  if( this->verbose ){
-    cout << string(this->depth*2, ' ') << "Block @ "<< static_cast<void*>(block) << endl;
-  }
+  this->trace.record( "Block", this->depth, block );
+
+  return block;
+}
 
-  isl_ast_node_list* list = isl_ast_node_block_get_children(node);
-  for( int i = 0; i < isl_ast_node_list_n_ast_node(list); i += 1 ){
-    isl_ast_node* node = isl_ast_node_list_get_ast_node(list, i);
-    SgStatement* sg_stmt = isSgStatement( this->visit( node ) );
-    assert( sg_stmt != NULL );
+void SageTransformationWalker::visited_block_child(SgBasicBlock* block, SgStatement* sg_stmt){
+  assert( sg_stmt != NULL );
 
-    appendStatement( sg_stmt, block );
-  }
+  appendStatement( sg_stmt, block );
+}
 
+SgNode* SageTransformationWalker::leave_node_block(isl_ast_node* node, SgBasicBlock* block){
   this->pop();
 
   return block;
 }
 
 SgNode* SageTransformationWalker::visit_node_mark(isl_ast_node* node){
-  assert( this->VISIT_TO_NODE_NOT_IMPLEMENTED );
-  return NULL;
+  isl_ast_node_handle marked( isl_ast_node_mark_get_node(node) );
+  return this->leave_node_mark( node, isSgStatement( this->visit( marked.get() ) ) );
+}
+
+SgNode* SageTransformationWalker::leave_node_mark(isl_ast_node* node, SgStatement* sg_stmt){
+  assert( sg_stmt != NULL );
+
+  isl_id_handle mark( isl_ast_node_mark_get_id(node) );
+  const mark_registry& marks = ( this->options.marks != NULL ) ? *this->options.marks : mark_registry::defaults();
+  SgStatement* result = marks.apply( isl_id_get_name( mark.get() ), sg_stmt );
+
+  this->trace.record( "Mark", this->depth, result );
+
+  return result;
 }
 
 SgNode* SageTransformationWalker::visit_node_user(isl_ast_node* node){
-  return this->visit( isl_ast_node_user_get_expr(node) );
+  isl_ast_expr_handle expr( isl_ast_node_user_get_expr(node) );
+  return this->visit( expr.get() );
 }
 
 SgNode* SageTransformationWalker::visit_node_unknown(isl_ast_node* node){
@@ -0,0 +1,212 @@
+#include <cassert>
+#include <climits>
+
+#include "affine_builder.hpp"
+#include "invariant_hoister.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+affine_builder::affine_builder( bool fold ): fold( fold )
+{}
+
+bool affine_builder::constant( SgExpression* expression, long long& value ){
+  if( SgIntVal* int_val = isSgIntVal( expression ) ){
+    value = int_val->get_value();
+    return true;
+  }
+  if( SgLongLongIntVal* long_val = isSgLongLongIntVal( expression ) ){
+    value = long_val->get_value();
+    return true;
+  }
+  return false;
+}
+
+SgExpression* affine_builder::literal( long long value ){
+  if( value >= INT_MIN && value <= INT_MAX ){
+    return buildIntVal( (int) value );
+  }
+  return buildLongLongIntVal( value );
+}
+
+void affine_builder::collect( SgExpression* expression, long long scale, affine_form& form ){
+  long long value = 0;
+  if( constant( expression, value ) ){
+    form.constant += scale * value;
+    return;
+  }
+
+  switch( expression->variantT() ){
+    case V_SgAddOp:
+      collect( isSgBinaryOp( expression )->get_lhs_operand(), scale, form );
+      collect( isSgBinaryOp( expression )->get_rhs_operand(), scale, form );
+      return;
+
+    case V_SgSubtractOp:
+      collect( isSgBinaryOp( expression )->get_lhs_operand(), scale, form );
+      collect( isSgBinaryOp( expression )->get_rhs_operand(), -scale, form );
+      return;
+
+    case V_SgMinusOp:
+      collect( isSgMinusOp( expression )->get_operand(), -scale, form );
+      return;
+
+    case V_SgMultiplyOp: {
+      SgBinaryOp* op = isSgBinaryOp( expression );
+      if( constant( op->get_lhs_operand(), value ) ){
+        collect( op->get_rhs_operand(), scale * value, form );
+        return;
+      }
+      if( constant( op->get_rhs_operand(), value ) ){
+        collect( op->get_lhs_operand(), scale * value, form );
+        return;
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+
+  for( vector<term>::iterator it = form.terms.begin(); it != form.terms.end(); ++it ){
+    if( sage_equal( it->expression, expression ) ){
+      it->coefficient += scale;
+      return;
+    }
+  }
+  form.terms.push_back( term{ scale, copyExpression( expression ) } );
+}
+
+SgExpression* affine_builder::sum( const vector<SgExpression*>& expressions, size_t first, size_t last, bool balanced ){
+  assert( first < last );
+  if( last - first == 1 ){
+    return expressions[first];
+  }
+
+  if( balanced ){
+    size_t middle = first + (last - first) / 2;
+    return buildBinaryExpression<SgAddOp>( sum( expressions, first, middle, true ), sum( expressions, middle, last, true ) );
+  }
+
+  SgExpression* head = expressions[first];
+  for( size_t i = first + 1; i < last; i += 1 ){
+    head = buildBinaryExpression<SgAddOp>( head, expressions[i] );
+  }
+  return head;
+}
+
+SgExpression* affine_builder::build( affine_form& form, SgExpression* lhs, SgExpression* rhs ){
+  deleteAST( lhs );
+  if( rhs != NULL ){
+    deleteAST( rhs );
+  }
+
+  // Terms, with the magnitude of their coefficient
+  vector<SgExpression*> positive;
+  vector<SgExpression*> negative;
+  for( vector<term>::iterator it = form.terms.begin(); it != form.terms.end(); ++it ){
+    long long magnitude = it->coefficient < 0 ? -it->coefficient : it->coefficient;
+    if( magnitude == 0 ){
+      deleteAST( it->expression );
+      continue;
+    }
+
+    SgExpression* scaled = it->expression;
+    if( magnitude != 1 ){
+      scaled = buildBinaryExpression<SgMultiplyOp>( literal( magnitude ), it->expression );
+    }
+    ( it->coefficient > 0 ? positive : negative ).push_back( scaled );
+  }
+
+  long long offset = form.constant;
+  bool balanced = positive.size() + negative.size() + (offset != 0 ? 1 : 0) > 4;
+
+  SgExpression* result = NULL;
+  size_t subtracted = 0;
+  if( ! positive.empty() ){
+    result = sum( positive, 0, positive.size(), balanced );
+  } else if( offset > 0 ){
+    result = literal( offset );
+    offset = 0;
+  } else if( ! negative.empty() ){
+    // -k * t, or -t
+    SgBinaryOp* scaled = isSgMultiplyOp( negative[0] );
+    long long magnitude = 0;
+    if( scaled != NULL && constant( scaled->get_lhs_operand(), magnitude ) ){
+      SgExpression* negated = literal( -magnitude );
+      deleteAST( scaled->get_lhs_operand() );
+      scaled->set_lhs_operand( negated );
+      negated->set_parent( scaled );
+      result = scaled;
+    } else {
+      result = buildUnaryExpression<SgMinusOp>( negative[0] );
+    }
+    subtracted = 1;
+  }
+
+  if( subtracted < negative.size() ){
+    if( balanced ){
+      result = buildBinaryExpression<SgSubtractOp>( result, sum( negative, subtracted, negative.size(), true ) );
+    } else {
+      for( size_t i = subtracted; i < negative.size(); i += 1 ){
+        result = buildBinaryExpression<SgSubtractOp>( result, negative[i] );
+      }
+    }
+  }
+
+  if( result == NULL ){
+    return literal( offset );
+  }
+  if( offset > 0 ){
+    result = buildBinaryExpression<SgAddOp>( result, literal( offset ) );
+  } else if( offset < 0 ){
+    result = buildBinaryExpression<SgSubtractOp>( result, literal( -offset ) );
+  }
+  return result;
+}
+
+SgExpression* affine_builder::add( SgExpression* lhs, SgExpression* rhs ){
+  if( ! this->fold ){
+    return buildBinaryExpression<SgAddOp>( lhs, rhs );
+  }
+
+  affine_form form{ 0, vector<term>() };
+  collect( lhs, 1, form );
+  collect( rhs, 1, form );
+  return build( form, lhs, rhs );
+}
+
+SgExpression* affine_builder::sub( SgExpression* lhs, SgExpression* rhs ){
+  if( ! this->fold ){
+    return buildBinaryExpression<SgSubtractOp>( lhs, rhs );
+  }
+
+  affine_form form{ 0, vector<term>() };
+  collect( lhs, 1, form );
+  collect( rhs, -1, form );
+  return build( form, lhs, rhs );
+}
+
+SgExpression* affine_builder::mul( SgExpression* lhs, SgExpression* rhs ){
+  long long value = 0;
+  if( ! this->fold || ( ! constant( lhs, value ) && ! constant( rhs, value ) ) ){
+    return buildBinaryExpression<SgMultiplyOp>( lhs, rhs );
+  }
+
+  // A product by a literal is affine
+  SgExpression* product = buildBinaryExpression<SgMultiplyOp>( lhs, rhs );
+  affine_form form{ 0, vector<term>() };
+  collect( product, 1, form );
+  return build( form, product, NULL );
+}
+
+SgExpression* affine_builder::minus( SgExpression* operand ){
+  if( ! this->fold ){
+    return buildUnaryExpression<SgMinusOp>( operand );
+  }
+
+  affine_form form{ 0, vector<term>() };
+  collect( operand, -1, form );
+  return build( form, operand, NULL );
+}
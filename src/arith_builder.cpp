@@ -0,0 +1,228 @@
+#include <cassert>
+
+#include "arith_builder.hpp"
+#include "invariant_hoister.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+arith_builder::arith_builder( intrinsic_style style, bool strength_reduce ): style( style ), strength_reduce( strength_reduce ), global( NULL )
+{}
+
+void arith_builder::set_global( SgGlobal* global ){
+  this->global = global;
+}
+
+SgType* arith_builder::builtin( SgType* type ){
+  string name = type->unparseToString();
+  if( name == "int64_t" ){
+    return buildLongLongType();
+  }
+  if( name == "int32_t" ){
+    return buildIntType();
+  }
+  return type;
+}
+
+string arith_builder::inline_name( const string& name, SgType* type ){
+  string suffix = type->unparseToString();
+  for( string::size_type i = 0; i < suffix.size(); i += 1 ){
+    if( suffix[i] == ' ' ){
+      suffix[i] = '_';
+    }
+  }
+  return "isl_sage_" + name + "_" + suffix;
+}
+
+SgExpression* arith_builder::expand( const string& name, SgExpression* lhs, SgExpression* rhs ){
+  if( name == "max" ){
+    return buildConditionalExp( buildBinaryExpression<SgGreaterThanOp>( lhs, rhs ), copyExpression( lhs ), copyExpression( rhs ) );
+  }
+  if( name == "min" ){
+    return buildConditionalExp( buildBinaryExpression<SgLessThanOp>( lhs, rhs ), copyExpression( lhs ), copyExpression( rhs ) );
+  }
+
+  assert( name == "floord" );
+  // (lhs - (lhs < 0) * (rhs - 1)) / rhs
+  SgExpression* negative = buildBinaryExpression<SgLessThanOp>( copyExpression( lhs ), buildIntVal( 0 ) );
+  SgExpression* adjust = buildBinaryExpression<SgMultiplyOp>( negative, buildBinaryExpression<SgSubtractOp>( copyExpression( rhs ), buildIntVal( 1 ) ) );
+  return buildBinaryExpression<SgDivideOp>( buildBinaryExpression<SgSubtractOp>( lhs, adjust ), rhs );
+}
+
+int arith_builder::power_of_two( SgExpression* expression, long& divisor ){
+  SgIntVal* literal = isSgIntVal( expression );
+  divisor = (literal != NULL && literal->get_value() > 0) ? literal->get_value() : 0;
+  if( divisor == 0 || (divisor & (divisor - 1)) != 0 ){
+    return -1;
+  }
+
+  int k = 0;
+  while( (1L << k) != divisor ){
+    k += 1;
+  }
+  return k;
+}
+
+SgFunctionDeclaration* arith_builder::define( const string& name, SgType* type ){
+  SgFunctionParameterList* parameters = buildFunctionParameterList( buildInitializedName( SgName( "a" ), type ),
+                                                                    buildInitializedName( SgName( "b" ), type ) );
+  SgFunctionDeclaration* definition = buildDefiningFunctionDeclaration( SgName( inline_name( name, type ) ), type, parameters, this->global );
+  definition->get_declarationModifier().get_storageModifier().setStatic();
+  definition->get_functionModifier().setInline();
+
+  SgBasicBlock* body = definition->get_definition()->get_body();
+  SgInitializedNamePtrList& arguments = parameters->get_args();
+  SgExpression* result = expand( name, buildVarRefExp( arguments[0], body ), buildVarRefExp( arguments[1], body ) );
+  appendStatement( buildReturnStmt( result ), body );
+
+  // Ahead of everything, so it is declared wherever the code is put; only
+  // builtin types are used, so no header needs to come first
+  prependStatement( definition, this->global );
+
+  return definition;
+}
+
+SgExpression* arith_builder::call( const string& name, SgExpression* lhs, SgExpression* rhs, SgType* type ){
+  assert( this->global != NULL );
+  type = builtin( type );
+
+  switch( this->style ){
+    case intrinsic_calls:
+      return buildFunctionCallExp( SgName( name ), type, buildExprListExp( lhs, rhs ), this->global );
+
+    case intrinsic_expressions:
+      return expand( name, lhs, rhs );
+
+    case intrinsic_inline:
+    default:
+      break;
+  }
+
+  SgName defined( inline_name( name, type ) );
+  SgFunctionSymbol* symbol = this->global->lookup_function_symbol( defined );
+  if( symbol == NULL ){
+    this->define( name, type );
+    symbol = this->global->lookup_function_symbol( defined );
+  }
+  assert( symbol != NULL );
+
+  return buildFunctionCallExp( symbol, buildExprListExp( lhs, rhs ) );
+}
+
+SgExpression* arith_builder::max( SgExpression* lhs, SgExpression* rhs, SgType* type ){
+  return this->call( "max", lhs, rhs, type );
+}
+
+SgExpression* arith_builder::min( SgExpression* lhs, SgExpression* rhs, SgType* type ){
+  return this->call( "min", lhs, rhs, type );
+}
+
+SgExpression* arith_builder::max( const vector<SgExpression*>& operands, SgType* type ){
+  return this->reduce( "max", operands, type );
+}
+
+SgExpression* arith_builder::min( const vector<SgExpression*>& operands, SgType* type ){
+  return this->reduce( "min", operands, type );
+}
+
+SgExpression* arith_builder::tree( const string& name, const vector<SgExpression*>& operands, size_t first, size_t last, SgType* type ){
+  if( last - first == 1 ){
+    return operands[first];
+  }
+  size_t middle = first + (last - first) / 2;
+  return this->call( name, this->tree( name, operands, first, middle, type ), this->tree( name, operands, middle, last, type ), type );
+}
+
+SgExpression* arith_builder::reduce( const string& name, const vector<SgExpression*>& operands, SgType* type ){
+  assert( ! operands.empty() );
+  bool is_max = name == "max";
+
+  // The literal that dominates the others takes the place of the first
+  vector<SgExpression*> kept;
+  SgIntVal* bound = NULL;
+  for( vector<SgExpression*>::const_iterator it = operands.begin(); it != operands.end(); ++it ){
+    SgIntVal* literal = isSgIntVal( *it );
+    if( literal != NULL && bound != NULL ){
+      if( is_max ? literal->get_value() > bound->get_value() : literal->get_value() < bound->get_value() ){
+        bound->set_value( literal->get_value() );
+      }
+      deleteAST( literal );
+      continue;
+    }
+    if( literal != NULL ){
+      bound = literal;
+      kept.push_back( literal );
+      continue;
+    }
+
+    bool repeated = false;
+    for( vector<SgExpression*>::iterator k = kept.begin(); k != kept.end() && ! repeated; ++k ){
+      repeated = sage_equal( *k, *it );
+    }
+    if( repeated ){
+      deleteAST( *it );
+    } else {
+      kept.push_back( *it );
+    }
+  }
+
+  return this->tree( name, kept, 0, kept.size(), type );
+}
+
+SgExpression* arith_builder::floord( SgExpression* lhs, SgExpression* rhs, SgType* type ){
+  long divisor = 0;
+  int k = this->strength_reduce ? power_of_two( rhs, divisor ) : -1;
+
+  if( k == 0 ){
+    deleteAST( rhs );
+    return lhs;
+  }
+  if( k > 0 ){
+    deleteAST( rhs );
+    return buildBinaryExpression<SgRshiftOp>( lhs, buildIntVal( k ) );
+  }
+  if( divisor > 0 ){
+    return expand( "floord", lhs, rhs );
+  }
+
+  return this->call( "floord", lhs, rhs, type );
+}
+
+SgExpression* arith_builder::pdiv_q( SgExpression* lhs, SgExpression* rhs ){
+  long divisor = 0;
+  int k = this->strength_reduce ? power_of_two( rhs, divisor ) : -1;
+
+  if( k == 0 ){
+    deleteAST( rhs );
+    return lhs;
+  }
+  if( k > 0 ){
+    deleteAST( rhs );
+    return buildBinaryExpression<SgRshiftOp>( lhs, buildIntVal( k ) );
+  }
+
+  return buildBinaryExpression<SgDivideOp>( lhs, rhs );
+}
+
+SgExpression* arith_builder::pdiv_r( SgExpression* lhs, SgExpression* rhs ){
+  long divisor = 0;
+  int k = this->strength_reduce ? power_of_two( rhs, divisor ) : -1;
+
+  if( k == 0 ){
+    deleteAST( lhs );
+    deleteAST( rhs );
+    return buildIntVal( 0 );
+  }
+  if( k > 0 ){
+    deleteAST( rhs );
+    return buildBinaryExpression<SgBitAndOp>( lhs, buildIntVal( divisor - 1 ) );
+  }
+
+  return buildBinaryExpression<SgModOp>( lhs, rhs );
+}
+
+SgExpression* arith_builder::zdiv_r( SgExpression* lhs, SgExpression* rhs ){
+  // Zero exactly when pdiv_r's forms are
+  return this->pdiv_r( lhs, rhs );
+}
@@ -0,0 +1,120 @@
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include "isl_handle.hpp"
+#include "expr_memo.hpp"
+
+using namespace std;
+using namespace SageInterface;
+
+// Tags starting each part of a key
+static const char tag_op = 'o';
+static const char tag_int = 'i';
+static const char tag_long_int = 'l';
+static const char tag_symbol = 's';
+static const char tag_id = 'd';
+
+template<typename T>
+static void append_bytes( string& key, T value ){
+  key.append( reinterpret_cast<const char*>( &value ), sizeof( value ) );
+}
+
+expr_memo::expr_memo(): translations()
+{}
+
+expr_memo::~expr_memo(){
+  this->clear();
+}
+
+void expr_memo::append( string& key, isl_ast_expr* expr, isl_id_map<SgVariableSymbol*>& symbols ){
+  switch( isl_ast_expr_get_type( expr ) ){
+    case isl_ast_expr_id: {
+      isl_id_handle id( isl_ast_expr_get_id( expr ) );
+      SgVariableSymbol** bound = symbols.find( id.get() );
+      if( bound != NULL && *bound != NULL ){
+        key.push_back( tag_symbol );
+        append_bytes( key, reinterpret_cast<uintptr_t>( *bound ) );
+      } else {
+        key.push_back( tag_id );
+        append_bytes( key, reinterpret_cast<uintptr_t>( id.get() ) );
+      }
+      break;
+    }
+
+    case isl_ast_expr_int: {
+      isl_val_handle value( isl_ast_expr_get_val( expr ) );
+      if( isl_val_is_int( value.get() ) == isl_bool_true && isl_val_cmp_si( value.get(), LONG_MAX ) <= 0
+          && isl_val_cmp_si( value.get(), LONG_MIN ) >= 0 ){
+        key.push_back( tag_int );
+        append_bytes( key, isl_val_get_num_si( value.get() ) );
+      } else {
+        // Written out, with its length so the key stays unambiguous
+        char* text = isl_val_to_str( value.get() );
+        string written( text );
+        free( text );
+        key.push_back( tag_long_int );
+        append_bytes( key, written.size() );
+        key += written;
+      }
+      break;
+    }
+
+    case isl_ast_expr_op:
+      // The operands follow, appended by key()
+      key.push_back( tag_op );
+      append_bytes( key, (int) isl_ast_expr_get_op_type( expr ) );
+      append_bytes( key, isl_ast_expr_get_op_n_arg( expr ) );
+      break;
+
+    default:
+      assert( false );
+  }
+}
+
+void expr_memo::key( isl_ast_expr* expr, isl_id_map<SgVariableSymbol*>& symbols, string& key ){
+  key.clear();
+
+  // Prefix order on an explicit stack, so deep expressions are keyed in one
+  // pass without recursing
+  vector<isl_ast_expr_handle> stack;
+  stack.push_back( isl_ast_expr_handle( isl_ast_expr_copy( expr ) ) );
+  while( ! stack.empty() ){
+    isl_ast_expr_handle current = std::move( stack.back() );
+    stack.pop_back();
+    append( key, current.get(), symbols );
+
+    if( isl_ast_expr_get_type( current.get() ) == isl_ast_expr_op ){
+      // Pushed in reverse, so appended in order
+      for( int i = isl_ast_expr_get_op_n_arg( current.get() ) - 1; i >= 0; i -= 1 ){
+        stack.push_back( isl_ast_expr_handle( isl_ast_expr_get_op_arg( current.get(), i ) ) );
+      }
+    }
+  }
+}
+
+SgExpression* expr_memo::find( const string& key ) const {
+  unordered_map<string, SgExpression*>::const_iterator it = this->translations.find( key );
+  return it == this->translations.end() ? NULL : copyExpression( it->second );
+}
+
+void expr_memo::record( const string& key, SgExpression* translation ){
+  assert( translation != NULL );
+  SgExpression*& kept = this->translations[key];
+  assert( kept == NULL );
+  kept = copyExpression( translation );
+}
+
+size_t expr_memo::size() const {
+  return this->translations.size();
+}
+
+void expr_memo::clear(){
+  for( unordered_map<string, SgExpression*>::iterator it = this->translations.begin(); it != this->translations.end(); ++it ){
+    deleteAST( it->second );
+  }
+  this->translations.clear();
+}
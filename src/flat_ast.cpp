@@ -0,0 +1,385 @@
+#include <cassert>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+
+#include "phase_profiler.hpp"
+#include "work_pool.hpp"
+#include "parallel_loops.hpp"
+#include "flat_ast.hpp"
+
+/*
+Lowering reads isl's nodes and expressions in place, through the private
+header from the isl source tree the Makefile builds (third-party/build/isl),
+rather than through accessors that return copies. Besides saving a reference
+count update per node, this leaves the isl AST untouched, so threads can
+lower disjoint subtrees of one AST at the same time; isl's reference counts
+are not atomic.
+*/
+extern "C" {
+#include "isl_ast_private.h"
+}
+
+using namespace std;
+
+static const size_t chunk_bytes = 64 * 1024;
+
+const uint32_t flat_ast::none;
+
+flat_arena::flat_arena(): chunks(), next( NULL ), limit( NULL ), reserved( 0 )
+{}
+
+flat_arena::~flat_arena(){
+  this->clear();
+}
+
+void* flat_arena::allocate( size_t bytes, size_t alignment ){
+  uintptr_t aligned = ( reinterpret_cast<uintptr_t>( this->next ) + alignment - 1 ) & ~( uintptr_t( alignment ) - 1 );
+  if( this->next != NULL && aligned + bytes <= reinterpret_cast<uintptr_t>( this->limit ) ){
+    this->next = reinterpret_cast<char*>( aligned + bytes );
+    return reinterpret_cast<void*>( aligned );
+  }
+
+  // malloc's alignment covers every type stored here
+  if( bytes > chunk_bytes / 4 ){
+    // Large blocks get a chunk of their own, leaving the current one in use
+    char* chunk = static_cast<char*>( malloc( bytes ) );
+    assert( chunk != NULL );
+    this->chunks.push_back( chunk );
+    this->reserved += bytes;
+    return chunk;
+  }
+
+  char* chunk = static_cast<char*>( malloc( chunk_bytes ) );
+  assert( chunk != NULL );
+  this->chunks.push_back( chunk );
+  this->reserved += chunk_bytes;
+  this->next = chunk + bytes;
+  this->limit = chunk + chunk_bytes;
+  return chunk;
+}
+
+void flat_arena::clear(){
+  for( vector<char*>::size_type i = 0; i < this->chunks.size(); i += 1 ){
+    free( this->chunks[i] );
+  }
+  this->chunks.clear();
+  this->next = NULL;
+  this->limit = NULL;
+  this->reserved = 0;
+}
+
+flat_ast::flat_ast(): arena(), kinds(), ops(), counts(), firsts(), ends(), links(), names(), interned()
+{}
+
+void flat_ast::clear(){
+  this->kinds.reset();
+  this->ops.reset();
+  this->counts.reset();
+  this->firsts.reset();
+  this->ends.reset();
+  this->links.reset();
+  this->names.reset();
+  this->interned.clear();
+  this->arena.clear();
+}
+
+uint32_t flat_ast::append( flat_kind kind, uint32_t children ){
+  uint32_t n = this->kinds.extend( this->arena, 1 );
+  this->ops.extend( this->arena, 1 );
+  this->counts.extend( this->arena, 1 );
+  this->firsts.extend( this->arena, 1 );
+  this->ends.extend( this->arena, 1 );
+
+  this->kinds[n] = kind;
+  this->counts[n] = children;
+  this->firsts[n] = (children > 0) ? this->links.extend( this->arena, children ) : 0;
+  // Leaves end here; nodes with children are closed once their last descendant is lowered
+  this->ends[n] = n + 1;
+
+  return n;
+}
+
+uint32_t flat_ast::intern( const char* name ){
+  unordered_map<string, uint32_t>::iterator found = this->interned.find( name );
+  if( found != this->interned.end() ){
+    return found->second;
+  }
+
+  size_t length = strlen( name );
+  char* copy = static_cast<char*>( this->arena.allocate( length + 1, 1 ) );
+  memcpy( copy, name, length + 1 );
+
+  uint32_t identifier = this->names.extend( this->arena, 1 );
+  this->names[identifier] = copy;
+  this->interned[copy] = identifier;
+  return identifier;
+}
+
+/*
+Pre-order copy on an explicit stack. Children are pushed in reverse so they
+are lowered, and numbered, in order; each node with children pushes a close
+item below them that records where its subtree ends. Subtrees found in
+lowered are copied from their flat_ast instead.
+*/
+uint32_t flat_ast::lower( isl_ast_node* root, const unordered_map<isl_ast_node*, lowered_tree>* lowered ){
+  // Work item: a node or expression and the link it is the child at, or the
+  // node whose subtree is complete. Degenerate for nodes store no condition
+  // or increment; isl's accessors make them up, and so does lowering.
+  enum made_up {
+    made_up_none,
+    made_up_cond,
+    made_up_inc
+  };
+
+  struct item {
+    isl_ast_node* node;
+    isl_ast_expr* expr;
+    made_up synthetic;
+    uint32_t slot;
+    uint32_t close;
+  };
+
+  vector<item> stack;
+  uint32_t root_index = this->size();
+
+  stack.push_back( item{ root, NULL, made_up_none, none, none } );
+
+  while( ! stack.empty() ){
+    item current = stack.back();
+    stack.pop_back();
+
+    if( current.close != none ){
+      this->ends[current.close] = this->size();
+      continue;
+    }
+
+    uint32_t n = none;
+
+    if( current.synthetic == made_up_inc ){
+      // 1
+      n = this->append( flat_int, 0 );
+      this->firsts[n] = 1;
+    }
+    else if( current.synthetic == made_up_cond ){
+      // iterator <= init
+      isl_ast_node* node = current.node;
+      n = this->append( flat_op, 2 );
+      this->ops[n] = isl_ast_op_le;
+      stack.push_back( item{ NULL, NULL, made_up_none, none, n } );
+      stack.push_back( item{ NULL, node->u.f.init, made_up_none, this->firsts[n] + 1, none } );
+      stack.push_back( item{ NULL, node->u.f.iterator, made_up_none, this->firsts[n], none } );
+    }
+    else if( current.expr != NULL ){
+      isl_ast_expr* expr = current.expr;
+      switch( expr->type ){
+        case isl_ast_expr_id:
+          n = this->append( flat_id, 0 );
+          this->firsts[n] = this->intern( isl_id_get_name( expr->u.id ) );
+          break;
+
+        case isl_ast_expr_int: {
+          assert( isl_val_is_int( expr->u.v ) );
+          // isl_val_get_num_si would return 0 beyond 64 bits
+          bool fits = isl_val_cmp_si( expr->u.v, LONG_MAX ) <= 0 && isl_val_cmp_si( expr->u.v, LONG_MIN ) >= 0;
+          if( ! fits ){
+            char* text = isl_val_to_str( expr->u.v );
+            cerr << "ISL literal " << text << " does not fit in 64 bits" << endl;
+            free( text );
+          }
+          assert( fits );
+          int64_t num = isl_val_get_num_si( expr->u.v );
+          n = this->append( flat_int, 0 );
+          this->firsts[n] = static_cast<uint32_t>( static_cast<uint64_t>( num ) );
+          this->counts[n] = static_cast<uint32_t>( static_cast<uint64_t>( num ) >> 32 );
+          break;
+        }
+
+        case isl_ast_expr_op: {
+          uint32_t n_args = expr->u.op.n_arg;
+          n = this->append( flat_op, n_args );
+          this->ops[n] = expr->u.op.op;
+          stack.push_back( item{ NULL, NULL, made_up_none, none, n } );
+          for( uint32_t i = n_args; i > 0; i -= 1 ){
+            stack.push_back( item{ NULL, expr->u.op.args[i - 1], made_up_none, this->firsts[n] + i - 1, none } );
+          }
+          break;
+        }
+
+        default:
+          assert( false && "isl_ast_expr of unknown type" );
+          break;
+      }
+    }
+    else if( lowered != NULL && lowered->find( current.node ) != lowered->end() ){
+      const lowered_tree& tree = lowered->find( current.node )->second;
+      n = this->append_tree( *tree.ast, tree.root );
+    }
+    else {
+      isl_ast_node* node = current.node;
+      switch( node->type ){
+        case isl_ast_node_for: {
+          n = this->append( flat_for, 5 );
+          this->ops[n] = parallel_loops::is_parallel( node->annotation ) ? 1 : 0;
+          uint32_t first = this->firsts[n];
+          bool degenerate = node->u.f.degenerate;
+          stack.push_back( item{ NULL, NULL, made_up_none, none, n } );
+          stack.push_back( item{ node->u.f.body, NULL, made_up_none, first + 4, none } );
+          stack.push_back( item{ node, degenerate ? NULL : node->u.f.inc, degenerate ? made_up_inc : made_up_none, first + 3, none } );
+          stack.push_back( item{ node, degenerate ? NULL : node->u.f.cond, degenerate ? made_up_cond : made_up_none, first + 2, none } );
+          stack.push_back( item{ NULL, node->u.f.init, made_up_none, first + 1, none } );
+          stack.push_back( item{ NULL, node->u.f.iterator, made_up_none, first, none } );
+          break;
+        }
+
+        case isl_ast_node_if: {
+          bool has_else = node->u.i.else_node != NULL;
+          n = this->append( flat_if, has_else ? 3 : 2 );
+          uint32_t first = this->firsts[n];
+          stack.push_back( item{ NULL, NULL, made_up_none, none, n } );
+          if( has_else ){
+            stack.push_back( item{ node->u.i.else_node, NULL, made_up_none, first + 2, none } );
+          }
+          stack.push_back( item{ node->u.i.then, NULL, made_up_none, first + 1, none } );
+          stack.push_back( item{ NULL, node->u.i.guard, made_up_none, first, none } );
+          break;
+        }
+
+        case isl_ast_node_block: {
+          isl_ast_node_list* list = node->u.b.children;
+          uint32_t n_children = list->n;
+          n = this->append( flat_block, n_children );
+          stack.push_back( item{ NULL, NULL, made_up_none, none, n } );
+          for( uint32_t i = n_children; i > 0; i -= 1 ){
+            stack.push_back( item{ list->p[i - 1], NULL, made_up_none, this->firsts[n] + i - 1, none } );
+          }
+          break;
+        }
+
+        case isl_ast_node_mark: {
+          n = this->append( flat_mark, 2 );
+          stack.push_back( item{ NULL, NULL, made_up_none, none, n } );
+          stack.push_back( item{ node->u.m.node, NULL, made_up_none, this->firsts[n] + 1, none } );
+
+          // The name is the first child, so is numbered right after the mark
+          uint32_t name = this->append( flat_id, 0 );
+          this->firsts[name] = this->intern( isl_id_get_name( node->u.m.mark ) );
+          this->links[this->firsts[n]] = name;
+          break;
+        }
+
+        case isl_ast_node_user: {
+          n = this->append( flat_user, 1 );
+          stack.push_back( item{ NULL, NULL, made_up_none, none, n } );
+          stack.push_back( item{ NULL, node->u.e.expr, made_up_none, this->firsts[n], none } );
+          break;
+        }
+
+        default:
+          assert( false && "isl_ast_node of unknown type" );
+          break;
+      }
+    }
+
+    if( current.slot != none ){
+      this->links[current.slot] = n;
+    }
+  }
+
+  return root_index;
+}
+
+uint32_t flat_ast::lower( isl_ast_node* root ){
+  phase_scope phase( "flat_ast::lower" );
+
+  return this->lower( root, NULL );
+}
+
+uint32_t flat_ast::append_tree( const flat_ast& other, uint32_t root ){
+  uint32_t offset = this->size() - root;
+  vector<uint32_t> identifiers( other.identifiers(), none );
+
+  for( uint32_t j = root; j < other.end( root ); j += 1 ){
+    flat_kind kind = other.kind( j );
+    uint32_t n = this->append( kind, other.children( j ) );
+    this->ops[n] = other.ops[j];
+    this->ends[n] = other.ends[j] + offset;
+
+    if( kind == flat_int ){
+      this->firsts[n] = other.firsts[j];
+      this->counts[n] = other.counts[j];
+    }
+    else if( kind == flat_id ){
+      uint32_t& identifier = identifiers[other.identifier( j )];
+      if( identifier == none ){
+        identifier = this->intern( other.name( other.identifier( j ) ) );
+      }
+      this->firsts[n] = identifier;
+    }
+    else {
+      for( uint32_t i = 0; i < other.children( j ); i += 1 ){
+        this->links[this->firsts[n] + i] = other.child( j, i ) + offset;
+      }
+    }
+  }
+
+  return root + offset;
+}
+
+/*
+The tasks are the statements of the first block with more than one, found
+going down from root through loop bodies, marked nodes and the single
+statement of a block. Whatever is above them is lowered after the tasks,
+on the calling thread, with each task's nodes copied in where its statement
+is from the flat_ast of the worker that lowered it.
+*/
+uint32_t flat_ast::lower_parallel( isl_ast_node* root, work_pool& pool ){
+  phase_scope phase( "flat_ast::lower_parallel" );
+
+  isl_ast_node* split = root;
+  while( split != NULL ){
+    if( split->type == isl_ast_node_for ){
+      split = split->u.f.body;
+    }
+    else if( split->type == isl_ast_node_mark ){
+      split = split->u.m.node;
+    }
+    else if( split->type == isl_ast_node_block && split->u.b.children->n == 1 ){
+      split = split->u.b.children->p[0];
+    }
+    else {
+      break;
+    }
+  }
+
+  if( pool.size() < 2 || split == NULL || split->type != isl_ast_node_block ){
+    return this->lower( root, NULL );
+  }
+
+  // Each worker lowers its tasks into a flat_ast of its own
+  isl_ast_node_list* list = split->u.b.children;
+  vector<flat_ast*> lowered_by( pool.size(), NULL );
+  for( vector<flat_ast*>::size_type w = 0; w < lowered_by.size(); w += 1 ){
+    lowered_by[w] = new flat_ast();
+  }
+  vector<unsigned> task_worker( list->n, 0 );
+  vector<uint32_t> task_root( list->n, none );
+
+  pool.run( list->n, [&]( size_t i, unsigned worker ){
+    task_worker[i] = worker;
+    task_root[i] = lowered_by[worker]->lower( list->p[i], NULL );
+  } );
+
+  unordered_map<isl_ast_node*, lowered_tree> lowered;
+  for( int i = 0; i < list->n; i += 1 ){
+    lowered[list->p[i]] = lowered_tree{ lowered_by[task_worker[i]], task_root[i] };
+  }
+  uint32_t root_index = this->lower( root, &lowered );
+
+  for( vector<flat_ast*>::size_type w = 0; w < lowered_by.size(); w += 1 ){
+    delete lowered_by[w];
+  }
+
+  return root_index;
+}
@@ -0,0 +1,253 @@
+#include <cassert>
+#include <functional>
+
+#include "invariant_hoister.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+static void combine( size_t& hash, size_t value ){
+  hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+}
+
+// Expression operands, in order
+static vector<SgExpression*> operands( SgExpression* expression ){
+  vector<SgExpression*> children;
+  vector<SgNode*> successors = expression->get_traversalSuccessorContainer();
+  for( vector<SgNode*>::size_type i = 0; i < successors.size(); i += 1 ){
+    SgExpression* child = isSgExpression( successors[i] );
+    if( child != NULL ){
+      children.push_back( child );
+    }
+  }
+  return children;
+}
+
+size_t sage_hash( SgExpression* expression ){
+  size_t hash = expression->variantT();
+
+  if( SgVarRefExp* ref = isSgVarRefExp( expression ) ){
+    combine( hash, std::hash<void*>()( ref->get_symbol() ) );
+  } else if( SgFunctionRefExp* ref = isSgFunctionRefExp( expression ) ){
+    combine( hash, std::hash<void*>()( ref->get_symbol() ) );
+  } else if( SgIntVal* value = isSgIntVal( expression ) ){
+    combine( hash, std::hash<int>()( value->get_value() ) );
+  } else if( SgLongLongIntVal* value = isSgLongLongIntVal( expression ) ){
+    combine( hash, std::hash<long long>()( value->get_value() ) );
+  } else if( SgCastExp* cast = isSgCastExp( expression ) ){
+    combine( hash, std::hash<void*>()( cast->get_type() ) );
+  }
+
+  vector<SgExpression*> children = operands( expression );
+  for( vector<SgExpression*>::size_type i = 0; i < children.size(); i += 1 ){
+    combine( hash, sage_hash( children[i] ) );
+  }
+  return hash;
+}
+
+bool sage_equal( SgExpression* a, SgExpression* b ){
+  if( a->variantT() != b->variantT() ){
+    return false;
+  }
+
+  if( isSgVarRefExp( a ) ){
+    if( isSgVarRefExp( a )->get_symbol() != isSgVarRefExp( b )->get_symbol() ){
+      return false;
+    }
+  } else if( isSgFunctionRefExp( a ) ){
+    if( isSgFunctionRefExp( a )->get_symbol() != isSgFunctionRefExp( b )->get_symbol() ){
+      return false;
+    }
+  } else if( isSgIntVal( a ) ){
+    if( isSgIntVal( a )->get_value() != isSgIntVal( b )->get_value() ){
+      return false;
+    }
+  } else if( isSgLongLongIntVal( a ) ){
+    if( isSgLongLongIntVal( a )->get_value() != isSgLongLongIntVal( b )->get_value() ){
+      return false;
+    }
+  } else if( isSgValueExp( a ) ){
+    if( a->unparseToString() != b->unparseToString() ){
+      return false;
+    }
+  } else if( isSgCastExp( a ) ){
+    if( a->get_type() != b->get_type() ){
+      return false;
+    }
+  }
+
+  vector<SgExpression*> a_children = operands( a );
+  vector<SgExpression*> b_children = operands( b );
+  if( a_children.size() != b_children.size() ){
+    return false;
+  }
+  for( vector<SgExpression*>::size_type i = 0; i < a_children.size(); i += 1 ){
+    if( ! sage_equal( a_children[i], b_children[i] ) ){
+      return false;
+    }
+  }
+  return true;
+}
+
+invariant_hoister::invariant_hoister(): locals(), declarations(), next_local( 0 ), loop_variables( NULL ), occurrences(), repeated(), block( NULL ), widths( NULL ), prefix()
+{}
+
+bool invariant_hoister::candidate( SgExpression* expression ){
+  if( isSgVarRefExp( expression ) || isSgValueExp( expression ) || isSgExprListExp( expression ) || isSgFunctionRefExp( expression ) ){
+    return false;
+  }
+  SgUnaryOp* unary = isSgUnaryOp( expression );
+  if( unary != NULL && ( isSgVarRefExp( unary->get_operand() ) || isSgValueExp( unary->get_operand() ) ) ){
+    return false;
+  }
+
+  Rose_STL_Container<SgNode*> refs = NodeQuery::querySubTree( expression, V_SgVarRefExp );
+  for( Rose_STL_Container<SgNode*>::iterator it = refs.begin(); it != refs.end(); ++it ){
+    SgVariableSymbol* symbol = isSgVarRefExp( *it )->get_symbol();
+    for( vector<SgVariableSymbol*>::size_type i = 0; i < this->loop_variables->size(); i += 1 ){
+      if( (*this->loop_variables)[i] == symbol ){
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void invariant_hoister::count( SgExpression* expression ){
+  if( this->candidate( expression ) ){
+    this->occurrences[sage_hash( expression )].push_back( expression );
+  }
+
+  vector<SgExpression*> children = operands( expression );
+  for( vector<SgExpression*>::size_type i = 0; i < children.size(); i += 1 ){
+    this->count( children[i] );
+  }
+}
+
+void invariant_hoister::find_repeated(){
+  for( unordered_map<size_t, vector<SgExpression*> >::iterator it = this->occurrences.begin(); it != this->occurrences.end(); ++it ){
+    vector<SgExpression*>& same_hash = it->second;
+    for( vector<SgExpression*>::size_type i = 0; i < same_hash.size(); i += 1 ){
+      for( vector<SgExpression*>::size_type j = i + 1; j < same_hash.size(); j += 1 ){
+        if( sage_equal( same_hash[i], same_hash[j] ) ){
+          this->repeated.insert( same_hash[i] );
+          this->repeated.insert( same_hash[j] );
+        }
+      }
+    }
+  }
+  this->occurrences.clear();
+}
+
+SgVariableSymbol* invariant_hoister::find( SgExpression* expression, size_t hash ){
+  pair<unordered_multimap<size_t, hoisted>::iterator, unordered_multimap<size_t, hoisted>::iterator> range = this->locals.equal_range( hash );
+  for( unordered_multimap<size_t, hoisted>::iterator it = range.first; it != range.second; ++it ){
+    if( sage_equal( it->second.value, expression ) ){
+      return it->second.local;
+    }
+  }
+  return NULL;
+}
+
+void invariant_hoister::replace( SgExpression* expression, size_t hash ){
+  SgVariableSymbol* local = this->find( expression, hash );
+
+  if( local == NULL ){
+    SgName name;
+    do {
+      name = SgName( this->prefix + "_h" + to_string( this->next_local ) );
+      this->next_local += 1;
+    } while( this->block->lookup_variable_symbol( name ) != NULL );
+
+    SgType* type = width_analysis::operation_type( this->widths, { expression }, getGlobalScope( this->block ) );
+    SgAssignInitializer* initializer = buildAssignInitializer( copyExpression( expression ), type );
+    SgVariableDeclaration* declaration = buildVariableDeclaration( name, buildConstType( type ), initializer, this->block );
+    appendStatement( declaration, this->block );
+
+    local = getFirstVarSym( declaration );
+    this->locals.insert( make_pair( hash, hoisted{ initializer->get_operand(), local } ) );
+    this->declarations.push_back( declared{ hash, local, this->block } );
+  }
+
+  // The nodes replaced are freed, and their addresses may be reused
+  Rose_STL_Container<SgNode*> freed = NodeQuery::querySubTree( expression, V_SgExpression );
+  for( Rose_STL_Container<SgNode*>::iterator it = freed.begin(); it != freed.end(); ++it ){
+    this->repeated.erase( isSgExpression( *it ) );
+  }
+  replaceExpression( expression, buildVarRefExp( local ) );
+}
+
+void invariant_hoister::share( SgExpression* expression ){
+  if( this->candidate( expression ) ){
+    size_t hash = sage_hash( expression );
+    if( this->repeated.count( expression ) != 0 || this->find( expression, hash ) != NULL ){
+      this->replace( expression, hash );
+      return;
+    }
+  }
+
+  vector<SgExpression*> children = operands( expression );
+  for( vector<SgExpression*>::size_type i = 0; i < children.size(); i += 1 ){
+    this->share( children[i] );
+  }
+}
+
+void invariant_hoister::lift( SgExpression* expression ){
+  if( this->candidate( expression ) ){
+    this->replace( expression, sage_hash( expression ) );
+    return;
+  }
+
+  vector<SgExpression*> children = operands( expression );
+  for( vector<SgExpression*>::size_type i = 0; i < children.size(); i += 1 ){
+    this->lift( children[i] );
+  }
+}
+
+void invariant_hoister::hoist( SgExprStatement* test, SgExpression* init, const vector<SgVariableSymbol*>& loop_variables,
+                               SgBasicBlock* block, const width_analysis* widths, const string& iterator ){
+  assert( test->get_expression()->get_parent() == test );
+  assert( init->get_parent() != NULL );
+
+  this->loop_variables = &loop_variables;
+  this->block = block;
+  this->widths = widths;
+  this->prefix = iterator;
+
+  this->count( test->get_expression() );
+  this->count( init );
+  this->find_repeated();
+
+  this->share( test->get_expression() );
+  this->share( init );
+  this->repeated.clear();
+
+  this->lift( test->get_expression() );
+
+  this->loop_variables = NULL;
+  this->block = NULL;
+  this->widths = NULL;
+}
+
+void invariant_hoister::close_scope( SgScopeStatement* scope ){
+  while( ! this->declarations.empty() && this->declarations.back().scope == scope ){
+    declared& last = this->declarations.back();
+    pair<unordered_multimap<size_t, hoisted>::iterator, unordered_multimap<size_t, hoisted>::iterator> range = this->locals.equal_range( last.hash );
+    for( unordered_multimap<size_t, hoisted>::iterator it = range.first; it != range.second; ++it ){
+      if( it->second.local == last.local ){
+        this->locals.erase( it );
+        break;
+      }
+    }
+    this->declarations.pop_back();
+  }
+}
+
+void invariant_hoister::clear(){
+  this->locals.clear();
+  this->declarations.clear();
+  this->occurrences.clear();
+  this->repeated.clear();
+  this->next_local = 0;
+}
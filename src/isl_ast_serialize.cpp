@@ -0,0 +1,550 @@
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "isl_ast_serialize.hpp"
+#include "isl_handle.hpp"
+#include "isl_id_map.hpp"
+#include "phase_profiler.hpp"
+
+/*
+isl has no public constructors for for, if and block nodes, or for operations
+other than through isl_ast_build, so the reader rebuilds trees with isl's
+internal allocators and fills for nodes in directly. This needs the private
+header from the isl source tree the Makefile builds (third-party/build/isl).
+*/
+extern "C" {
+#include "isl_ast_private.h"
+}
+
+using namespace std;
+
+namespace {
+
+const char magic[] = { 'I', 'S', 'L', 'A', 'S', 'T' };
+const unsigned char format_version = 1;
+
+enum ast_tag {
+  ast_for = 1,
+  ast_if,
+  ast_block,
+  ast_mark,
+  ast_user,
+  ast_id,
+  ast_int,
+  ast_int_text,
+  ast_op
+};
+
+void write_varint( string& out, unsigned long value ){
+  while( value >= 0x80 ){
+    out.push_back( (char) ((value & 0x7f) | 0x80) );
+    value >>= 7;
+  }
+  out.push_back( (char) value );
+}
+
+void write_signed( string& out, long value ){
+  write_varint( out, ((unsigned long) value << 1) ^ (unsigned long) (value >> (sizeof(long) * CHAR_BIT - 1)) );
+}
+
+class ast_writer {
+  public:
+    // Tree is encoded before the string table, which is only complete at the end
+    string tree;
+    vector<string> strings;
+    isl_id_map<unsigned long> string_index;
+
+    bool write_string( isl_id* id );
+    bool write_string( const char* text );
+    bool write_expr( isl_ast_expr* expr );
+    bool write_node( isl_ast_node* node );
+};
+
+bool ast_writer::write_string( isl_id* id ){
+  if( id == NULL ){
+    return false;
+  }
+
+  unsigned long* index = this->string_index.find( id );
+  if( index == NULL ){
+    const char* name = isl_id_get_name( id );
+    index = &this->string_index[id];
+    *index = this->strings.size();
+    this->strings.push_back( name == NULL ? "" : name );
+  }
+  write_varint( this->tree, *index );
+  return true;
+}
+
+bool ast_writer::write_string( const char* text ){
+  if( text == NULL ){
+    return false;
+  }
+  write_varint( this->tree, this->strings.size() );
+  this->strings.push_back( text );
+  return true;
+}
+
+bool ast_writer::write_expr( isl_ast_expr* expr ){
+  switch( isl_ast_expr_get_type( expr ) ){
+    case isl_ast_expr_id: {
+      isl_id_handle id( isl_ast_expr_get_id( expr ) );
+      this->tree.push_back( ast_id );
+      return this->write_string( id.get() );
+    }
+
+    case isl_ast_expr_int: {
+      isl_val_handle value( isl_ast_expr_get_val( expr ) );
+      if( isl_val_cmp_si( value.get(), LONG_MAX ) <= 0 && isl_val_cmp_si( value.get(), LONG_MIN ) >= 0 ){
+        this->tree.push_back( ast_int );
+        write_signed( this->tree, isl_val_get_num_si( value.get() ) );
+        return true;
+      }
+      char* text = isl_val_to_str( value.get() );
+      this->tree.push_back( ast_int_text );
+      bool written = this->write_string( text );
+      free( text );
+      return written;
+    }
+
+    case isl_ast_expr_op: {
+      int n_arg = isl_ast_expr_get_op_n_arg( expr );
+      this->tree.push_back( ast_op );
+      write_varint( this->tree, isl_ast_expr_get_op_type( expr ) );
+      write_varint( this->tree, n_arg );
+      for( int i = 0; i < n_arg; i += 1 ){
+        isl_ast_expr_handle arg( isl_ast_expr_get_op_arg( expr, i ) );
+        if( ! this->write_expr( arg.get() ) ){
+          return false;
+        }
+      }
+      return true;
+    }
+
+    default:
+      return false;
+  }
+}
+
+bool ast_writer::write_node( isl_ast_node* node ){
+  switch( isl_ast_node_get_type( node ) ){
+    case isl_ast_node_for: {
+      isl_ast_expr_handle iterator( isl_ast_node_for_get_iterator( node ) );
+      isl_id_handle id( isl_ast_expr_get_id( iterator.get() ) );
+      bool degenerate = isl_ast_node_for_is_degenerate( node ) == isl_bool_true;
+
+      this->tree.push_back( ast_for );
+      if( ! this->write_string( id.get() ) ){
+        return false;
+      }
+      this->tree.push_back( degenerate ? 1 : 0 );
+      if( ! this->write_expr( isl_ast_expr_handle( isl_ast_node_for_get_init( node ) ).get() ) ){
+        return false;
+      }
+      if( ! degenerate ){
+        if( ! this->write_expr( isl_ast_expr_handle( isl_ast_node_for_get_cond( node ) ).get() )
+         || ! this->write_expr( isl_ast_expr_handle( isl_ast_node_for_get_inc( node ) ).get() ) ){
+          return false;
+        }
+      }
+      return this->write_node( isl_ast_node_handle( isl_ast_node_for_get_body( node ) ).get() );
+    }
+
+    case isl_ast_node_if: {
+      this->tree.push_back( ast_if );
+      if( ! this->write_expr( isl_ast_expr_handle( isl_ast_node_if_get_cond( node ) ).get() )
+       || ! this->write_node( isl_ast_node_handle( isl_ast_node_if_get_then( node ) ).get() ) ){
+        return false;
+      }
+      bool has_else = isl_ast_node_if_has_else( node ) == isl_bool_true;
+      this->tree.push_back( has_else ? 1 : 0 );
+      return ! has_else || this->write_node( isl_ast_node_handle( isl_ast_node_if_get_else( node ) ).get() );
+    }
+
+    case isl_ast_node_block: {
+      isl_ast_node_list_handle list( isl_ast_node_block_get_children( node ) );
+      int n = isl_ast_node_list_n_ast_node( list.get() );
+      this->tree.push_back( ast_block );
+      write_varint( this->tree, n );
+      for( int i = 0; i < n; i += 1 ){
+        isl_ast_node_handle child( isl_ast_node_list_get_ast_node( list.get(), i ) );
+        if( ! this->write_node( child.get() ) ){
+          return false;
+        }
+      }
+      return true;
+    }
+
+    case isl_ast_node_mark: {
+      isl_id_handle mark( isl_ast_node_mark_get_id( node ) );
+      this->tree.push_back( ast_mark );
+      return this->write_string( mark.get() )
+          && this->write_node( isl_ast_node_handle( isl_ast_node_mark_get_node( node ) ).get() );
+    }
+
+    case isl_ast_node_user:
+      this->tree.push_back( ast_user );
+      return this->write_expr( isl_ast_expr_handle( isl_ast_node_user_get_expr( node ) ).get() );
+
+    default:
+      return false;
+  }
+}
+
+// Bounds checked cursor over an encoding; every read fails once the data is
+// exhausted or malformed
+class ast_reader {
+  public:
+    isl_ctx* ctx;
+    const unsigned char* position;
+    const unsigned char* end;
+    const char* string_base;
+    // Offset and length of each string in the data
+    vector< pair<size_t, size_t> > strings;
+    // Id named by each string, allocated on first use
+    vector<isl_id*> ids;
+
+    ast_reader( isl_ctx* ctx, const char* data, size_t size );
+    ~ast_reader();
+
+    bool read_byte( unsigned char& value );
+    bool read_varint( unsigned long& value );
+    bool read_signed( long& value );
+    bool read_header();
+    isl_id* read_id();
+    isl_ast_expr* read_expr();
+    isl_ast_node* read_node();
+};
+
+ast_reader::ast_reader( isl_ctx* ctx, const char* data, size_t size ):
+  ctx( ctx ),
+  position( (const unsigned char*) data ),
+  end( (const unsigned char*) data + size ),
+  string_base( data ),
+  strings(),
+  ids()
+{ }
+
+ast_reader::~ast_reader(){
+  for( vector<isl_id*>::size_type i = 0; i < this->ids.size(); i += 1 ){
+    isl_id_free( this->ids[i] );
+  }
+}
+
+bool ast_reader::read_byte( unsigned char& value ){
+  if( this->position == this->end ){
+    return false;
+  }
+  value = *this->position++;
+  return true;
+}
+
+bool ast_reader::read_varint( unsigned long& value ){
+  value = 0;
+  for( unsigned shift = 0; shift < sizeof(unsigned long) * CHAR_BIT; shift += 7 ){
+    unsigned char byte;
+    if( ! this->read_byte( byte ) ){
+      return false;
+    }
+    value |= (unsigned long) (byte & 0x7f) << shift;
+    if( (byte & 0x80) == 0 ){
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ast_reader::read_signed( long& value ){
+  unsigned long zigzag;
+  if( ! this->read_varint( zigzag ) ){
+    return false;
+  }
+  value = (long) (zigzag >> 1) ^ -(long) (zigzag & 1);
+  return true;
+}
+
+bool ast_reader::read_header(){
+  if( (size_t) (this->end - this->position) < sizeof(magic) + 1
+   || memcmp( this->position, magic, sizeof(magic) ) != 0
+   || this->position[sizeof(magic)] != format_version ){
+    return false;
+  }
+  this->position += sizeof(magic) + 1;
+
+  unsigned long count;
+  if( ! this->read_varint( count ) || count > (unsigned long) (this->end - this->position) ){
+    return false;
+  }
+  this->strings.reserve( count );
+  this->ids.assign( count, (isl_id*) NULL );
+  for( unsigned long i = 0; i < count; i += 1 ){
+    unsigned long length;
+    if( ! this->read_varint( length ) || length > (unsigned long) (this->end - this->position) ){
+      return false;
+    }
+    this->strings.push_back( make_pair( (size_t) ((const char*) this->position - this->string_base), (size_t) length ) );
+    this->position += length;
+  }
+  return true;
+}
+
+isl_id* ast_reader::read_id(){
+  unsigned long index;
+  if( ! this->read_varint( index ) || index >= this->strings.size() ){
+    return NULL;
+  }
+  if( this->ids[index] == NULL ){
+    string name( this->string_base + this->strings[index].first, this->strings[index].second );
+    this->ids[index] = isl_id_alloc( this->ctx, name.c_str(), NULL );
+  }
+  return isl_id_copy( this->ids[index] );
+}
+
+isl_ast_expr* ast_reader::read_expr(){
+  unsigned char tag;
+  if( ! this->read_byte( tag ) ){
+    return NULL;
+  }
+
+  switch( tag ){
+    case ast_id: {
+      isl_id* id = this->read_id();
+      return id == NULL ? NULL : isl_ast_expr_from_id( id );
+    }
+
+    case ast_int: {
+      long value;
+      if( ! this->read_signed( value ) ){
+        return NULL;
+      }
+      return isl_ast_expr_from_val( isl_val_int_from_si( this->ctx, value ) );
+    }
+
+    case ast_int_text: {
+      unsigned long index;
+      if( ! this->read_varint( index ) || index >= this->strings.size() ){
+        return NULL;
+      }
+      string text( this->string_base + this->strings[index].first, this->strings[index].second );
+      isl_val* value = isl_val_read_from_str( this->ctx, text.c_str() );
+      return value == NULL ? NULL : isl_ast_expr_from_val( value );
+    }
+
+    case ast_op: {
+      unsigned long op;
+      unsigned long n_arg;
+      // Every argument takes at least two bytes
+      if( ! this->read_varint( op ) || op > isl_ast_op_address_of
+       || ! this->read_varint( n_arg ) || n_arg > (unsigned long) (this->end - this->position) / 2 ){
+        return NULL;
+      }
+      isl_ast_expr* expr = isl_ast_expr_alloc_op( this->ctx, (isl_ast_op_type) op, (int) n_arg );
+      if( expr == NULL ){
+        return NULL;
+      }
+      for( unsigned long i = 0; i < n_arg; i += 1 ){
+        expr->u.op.args[i] = this->read_expr();
+        if( expr->u.op.args[i] == NULL ){
+          return isl_ast_expr_free( expr );
+        }
+      }
+      return expr;
+    }
+
+    default:
+      return NULL;
+  }
+}
+
+isl_ast_node* ast_reader::read_node(){
+  unsigned char tag;
+  if( ! this->read_byte( tag ) ){
+    return NULL;
+  }
+
+  switch( tag ){
+    case ast_for: {
+      isl_id* iterator = this->read_id();
+      unsigned char degenerate;
+      if( iterator == NULL || ! this->read_byte( degenerate ) ){
+        isl_id_free( iterator );
+        return NULL;
+      }
+      isl_ast_node* node = isl_ast_node_alloc_for( iterator );
+      if( node == NULL ){
+        return NULL;
+      }
+      node->u.f.degenerate = degenerate != 0;
+      node->u.f.init = this->read_expr();
+      if( node->u.f.init == NULL ){
+        return isl_ast_node_free( node );
+      }
+      if( ! degenerate ){
+        node->u.f.cond = this->read_expr();
+        node->u.f.inc = node->u.f.cond == NULL ? NULL : this->read_expr();
+        if( node->u.f.inc == NULL ){
+          return isl_ast_node_free( node );
+        }
+      }
+      node->u.f.body = this->read_node();
+      return node->u.f.body == NULL ? isl_ast_node_free( node ) : node;
+    }
+
+    case ast_if: {
+      isl_ast_expr* guard = this->read_expr();
+      if( guard == NULL ){
+        return NULL;
+      }
+      isl_ast_node* node = isl_ast_node_alloc_if( guard );
+      if( node == NULL ){
+        return NULL;
+      }
+      unsigned char has_else;
+      node->u.i.then = this->read_node();
+      if( node->u.i.then == NULL || ! this->read_byte( has_else ) ){
+        return isl_ast_node_free( node );
+      }
+      if( has_else ){
+        node->u.i.else_node = this->read_node();
+        if( node->u.i.else_node == NULL ){
+          return isl_ast_node_free( node );
+        }
+      }
+      return node;
+    }
+
+    case ast_block: {
+      unsigned long n;
+      // Every child takes at least two bytes
+      if( ! this->read_varint( n ) || n > (unsigned long) (this->end - this->position) / 2 ){
+        return NULL;
+      }
+      isl_ast_node_list* list = isl_ast_node_list_alloc( this->ctx, (int) n );
+      for( unsigned long i = 0; i < n && list != NULL; i += 1 ){
+        isl_ast_node* child = this->read_node();
+        if( child == NULL ){
+          isl_ast_node_list_free( list );
+          return NULL;
+        }
+        list = isl_ast_node_list_add( list, child );
+      }
+      return list == NULL ? NULL : isl_ast_node_alloc_block( list );
+    }
+
+    case ast_mark: {
+      isl_id* mark = this->read_id();
+      if( mark == NULL ){
+        return NULL;
+      }
+      isl_ast_node* marked = this->read_node();
+      if( marked == NULL ){
+        isl_id_free( mark );
+        return NULL;
+      }
+      return isl_ast_node_alloc_mark( mark, marked );
+    }
+
+    case ast_user: {
+      isl_ast_expr* expr = this->read_expr();
+      return expr == NULL ? NULL : isl_ast_node_alloc_user( expr );
+    }
+
+    default:
+      return NULL;
+  }
+}
+
+}
+
+bool isl_ast_serialize( isl_ast_node* root, string& out ){
+  phase_scope phase( "isl_ast_serialize" );
+
+  if( root == NULL ){
+    return false;
+  }
+
+  ast_writer writer;
+  if( ! writer.write_node( root ) ){
+    return false;
+  }
+
+  out.append( magic, sizeof(magic) );
+  out.push_back( (char) format_version );
+  write_varint( out, writer.strings.size() );
+  for( vector<string>::size_type i = 0; i < writer.strings.size(); i += 1 ){
+    write_varint( out, writer.strings[i].size() );
+    out.append( writer.strings[i] );
+  }
+  out.append( writer.tree );
+  return true;
+}
+
+bool isl_ast_serialize_file( isl_ast_node* root, const string& path ){
+  string encoded;
+  if( ! isl_ast_serialize( root, encoded ) ){
+    return false;
+  }
+
+  ofstream file( path.c_str(), ios::out | ios::trunc | ios::binary );
+  file.write( encoded.data(), encoded.size() );
+  return file.good();
+}
+
+isl_ast_node* isl_ast_deserialize( isl_ctx* ctx, const char* data, size_t size ){
+  phase_scope phase( "isl_ast_deserialize" );
+
+  if( ctx == NULL || data == NULL ){
+    return NULL;
+  }
+
+  ast_reader reader( ctx, data, size );
+  if( ! reader.read_header() ){
+    return NULL;
+  }
+
+  isl_ast_node* root = reader.read_node();
+  // Trailing bytes mean the data is not what was written
+  if( root != NULL && reader.position != reader.end ){
+    return isl_ast_node_free( root );
+  }
+  return root;
+}
+
+isl_ast_node* isl_ast_deserialize_file( isl_ctx* ctx, const string& path ){
+  mapped_file file( path );
+  if( ! file.is_open() ){
+    return NULL;
+  }
+  return isl_ast_deserialize( ctx, file.data(), file.size() );
+}
+
+mapped_file::mapped_file( const string& path ): bytes( NULL ), length( 0 ) {
+  int descriptor = open( path.c_str(), O_RDONLY );
+  if( descriptor < 0 ){
+    return;
+  }
+
+  struct stat status;
+  if( fstat( descriptor, &status ) == 0 && status.st_size > 0 ){
+    void* mapping = mmap( NULL, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0 );
+    if( mapping != MAP_FAILED ){
+      this->bytes = (const char*) mapping;
+      this->length = status.st_size;
+    }
+  }
+  close( descriptor );
+}
+
+mapped_file::~mapped_file(){
+  if( this->bytes != NULL ){
+    munmap( (void*) this->bytes, this->length );
+  }
+}
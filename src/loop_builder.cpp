@@ -0,0 +1,412 @@
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <string>
+#include <vector>
+
+#include "affine_builder.hpp"
+#include "loop_builder.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+loop_builder::loop_builder( arith_builder& arith, bool canonical, bool hoist, unsigned unroll_limit ): arith( arith ), canonical( canonical ), hoist( hoist ), unroll_limit( unroll_limit ), hoister(), widths( NULL ), unrollings()
+{}
+
+void loop_builder::set_widths( const width_analysis* widths ){
+  this->widths = widths;
+}
+
+static bool is_iterator( SgExpression* expression, SgVariableSymbol* iterator ){
+  SgVarRefExp* ref = isSgVarRefExp( expression );
+  return ref != NULL && ref->get_symbol() == iterator;
+}
+
+static bool refers_to( SgExpression* expression, SgVariableSymbol* iterator ){
+  Rose_STL_Container<SgNode*> refs = NodeQuery::querySubTree( expression, V_SgVarRefExp );
+  for( Rose_STL_Container<SgNode*>::iterator it = refs.begin(); it != refs.end(); ++it ){
+    if( isSgVarRefExp( *it )->get_symbol() == iterator ){
+      return true;
+    }
+  }
+  return false;
+}
+
+// Whether cond is a comparison, or conjunction of comparisons, putting an
+// upper bound on iterator
+static bool bounds( SgExpression* cond, SgVariableSymbol* iterator ){
+  SgBinaryOp* op = isSgBinaryOp( cond );
+  if( op == NULL ){
+    return false;
+  }
+
+  switch( cond->variantT() ){
+    case V_SgAndOp:
+      return bounds( op->get_lhs_operand(), iterator ) && bounds( op->get_rhs_operand(), iterator );
+
+    case V_SgLessOrEqualOp:
+    case V_SgLessThanOp:
+      return is_iterator( op->get_lhs_operand(), iterator ) && ! refers_to( op->get_rhs_operand(), iterator );
+
+    case V_SgGreaterOrEqualOp:
+    case V_SgGreaterThanOp:
+      return is_iterator( op->get_rhs_operand(), iterator ) && ! refers_to( op->get_lhs_operand(), iterator );
+
+    default:
+      return false;
+  }
+}
+
+// Takes the operands out of op and frees it
+static void dismantle( SgBinaryOp* op, SgExpression*& lhs, SgExpression*& rhs ){
+  lhs = op->get_lhs_operand();
+  rhs = op->get_rhs_operand();
+  op->set_lhs_operand( NULL );
+  op->set_rhs_operand( NULL );
+  deleteAST( op );
+}
+
+static SgExpression* minus_one( SgExpression* bound ){
+  SgIntVal* literal = isSgIntVal( bound );
+  if( literal != NULL && literal->get_value() > INT_MIN ){
+    int value = literal->get_value();
+    deleteAST( literal );
+    return buildIntVal( value - 1 );
+  }
+  return buildBinaryExpression<SgSubtractOp>( bound, buildIntVal( 1 ) );
+}
+
+// Narrows value, computed in 128 bits, to long long if it fits
+static bool narrow( __int128 wide, long long& value ){
+  if( wide < LLONG_MIN || wide > LLONG_MAX ){
+    return false;
+  }
+  value = (long long) wide;
+  return true;
+}
+
+// Value of expression, if it is an integer constant that, with every
+// intermediate result, fits in long long
+static bool evaluate( SgExpression* expression, long long& value ){
+  long long lhs = 0;
+  long long rhs = 0;
+  switch( expression->variantT() ){
+    case V_SgIntVal:
+      value = isSgIntVal( expression )->get_value();
+      return true;
+
+    case V_SgLongLongIntVal:
+      value = isSgLongLongIntVal( expression )->get_value();
+      return true;
+
+    case V_SgMinusOp:
+      if( ! evaluate( isSgMinusOp( expression )->get_operand(), lhs ) ){
+        return false;
+      }
+      return narrow( -(__int128) lhs, value );
+
+    case V_SgAddOp:
+    case V_SgSubtractOp:
+    case V_SgMultiplyOp:
+      if( ! evaluate( isSgBinaryOp( expression )->get_lhs_operand(), lhs ) || ! evaluate( isSgBinaryOp( expression )->get_rhs_operand(), rhs ) ){
+        return false;
+      }
+      if( isSgAddOp( expression ) ){
+        return narrow( (__int128) lhs + rhs, value );
+      }
+      if( isSgSubtractOp( expression ) ){
+        return narrow( (__int128) lhs - rhs, value );
+      }
+      return narrow( (__int128) lhs * rhs, value );
+
+    default:
+      return false;
+  }
+}
+
+// Inclusive upper bound cond puts on iterator, if it is constant
+static bool constant_bound( SgExpression* cond, SgVariableSymbol* iterator, long long& bound ){
+  if( ! bounds( cond, iterator ) ){
+    return false;
+  }
+
+  SgBinaryOp* op = isSgBinaryOp( cond );
+  switch( cond->variantT() ){
+    case V_SgAndOp: {
+      long long second = 0;
+      if( ! constant_bound( op->get_lhs_operand(), iterator, bound ) || ! constant_bound( op->get_rhs_operand(), iterator, second ) ){
+        return false;
+      }
+      bound = min( bound, second );
+      return true;
+    }
+
+    case V_SgLessOrEqualOp:
+      return evaluate( op->get_rhs_operand(), bound );
+
+    case V_SgLessThanOp:
+      return evaluate( op->get_rhs_operand(), bound ) && narrow( (__int128) bound - 1, bound );
+
+    case V_SgGreaterOrEqualOp:
+      return evaluate( op->get_lhs_operand(), bound );
+
+    default:
+      assert( cond->variantT() == V_SgGreaterThanOp );
+      return evaluate( op->get_lhs_operand(), bound ) && narrow( (__int128) bound - 1, bound );
+  }
+}
+
+// Replaces the references to iterator under root by value, a long long
+// literal outside int
+static void substitute( SgNode* root, SgVariableSymbol* iterator, long long value ){
+  Rose_STL_Container<SgNode*> refs = NodeQuery::querySubTree( root, V_SgVarRefExp );
+  for( Rose_STL_Container<SgNode*>::iterator it = refs.begin(); it != refs.end(); ++it ){
+    if( isSgVarRefExp( *it )->get_symbol() == iterator ){
+      replaceExpression( isSgVarRefExp( *it ), affine_builder::literal( value ) );
+    }
+  }
+}
+
+SgExpression* loop_builder::upper_bound( SgExpression* cond, SgVariableSymbol* iterator ){
+  if( ! bounds( cond, iterator ) ){
+    return NULL;
+  }
+
+  VariantT variant = cond->variantT();
+  SgExpression* lhs = NULL;
+  SgExpression* rhs = NULL;
+  dismantle( isSgBinaryOp( cond ), lhs, rhs );
+
+  switch( variant ){
+    case V_SgAndOp: {
+      SgExpression* first = this->upper_bound( lhs, iterator );
+      SgExpression* second = this->upper_bound( rhs, iterator );
+      return this->arith.min( first, second, iterator->get_type() );
+    }
+
+    case V_SgLessOrEqualOp:
+      deleteAST( lhs );
+      return rhs;
+
+    case V_SgLessThanOp:
+      deleteAST( lhs );
+      return minus_one( rhs );
+
+    case V_SgGreaterOrEqualOp:
+      deleteAST( rhs );
+      return lhs;
+
+    default:
+      assert( variant == V_SgGreaterThanOp );
+      deleteAST( rhs );
+      return minus_one( lhs );
+  }
+}
+
+SgForStatement* loop_builder::build( SgVariableDeclaration* iterator, SgExpression* cond, SgExpression* inc, SgScopeStatement* scope ){
+  SgVariableSymbol* symbol = getFirstVarSym( iterator );
+  assert( symbol != NULL );
+
+  SgInitializedName* name = getFirstInitializedName( iterator );
+  SgType* type = name->get_type();
+  SgAssignInitializer* initializer = isSgAssignInitializer( name->get_initializer() );
+  assert( initializer != NULL );
+
+  vector<SgVariableSymbol*> loop_variables( 1, symbol );
+  SgStatement* init_statement = iterator;
+  SgExprStatement* test = NULL;
+  SgExpression* increment = NULL;
+  SgBasicBlock* body = buildBasicBlock();
+
+  // A loop of few constant iterations is built in isl's form, to be replaced
+  // by copies of its body in unroll()
+  unrolling trips = { symbol, 0, 0, 0 };
+  long long last = 0;
+  bool unrolled = this->unroll_limit > 0 && evaluate( initializer->get_operand(), trips.first ) && evaluate( inc, trips.step )
+                  && trips.step > 0 && constant_bound( cond, symbol, last );
+  if( unrolled ){
+    // In 128 bits, as last - first overflows long long for bounds near its
+    // limits; such a loop is not unrolled
+    unrolled = narrow( last < trips.first ? 0 : ((__int128) last - trips.first) / trips.step + 1, trips.count )
+               && trips.count <= (long long) this->unroll_limit;
+  }
+
+  SgIntVal* stride = isSgIntVal( inc );
+  SgExpression* bound = this->canonical && ! unrolled ? this->upper_bound( cond, symbol ) : NULL;
+
+  if( ! this->canonical || unrolled ){
+    // iterator = iterator + (increment)
+    SgVarRefExp* var_ref = buildVarRefExp( symbol );
+    increment = buildBinaryExpression<SgAssignOp>( copyExpression( var_ref ), buildBinaryExpression<SgAddOp>( var_ref, inc ) );
+    test = buildExprStatement( cond );
+  } else if( bound != NULL && stride != NULL && stride->get_value() > 1 ){
+    int step = stride->get_value();
+    deleteAST( stride );
+
+    SgExpression* start = initializer->get_operand();
+
+    SgVariableDeclaration* counter = buildVariableDeclaration( SgName( name->get_name().getString() + "_n" ), type,
+                                                               buildAssignInitializer( buildIntVal( 0 ), type ), scope );
+    SgVariableSymbol* counter_symbol = getFirstVarSym( counter );
+    loop_variables.push_back( counter_symbol );
+
+    // counter <= floord( bound - init, step )
+    SgExpression* trips = this->arith.floord( buildBinaryExpression<SgSubtractOp>( bound, copyExpression( start ) ), buildIntVal( step ), type );
+    test = buildExprStatement( buildBinaryExpression<SgLessOrEqualOp>( buildVarRefExp( counter_symbol ), trips ) );
+    increment = buildPlusPlusOp( buildVarRefExp( counter_symbol ), SgUnaryOp::prefix );
+
+    // iterator = init + step * counter, at the top of the body
+    SgExpression* position = buildBinaryExpression<SgAddOp>( start, buildBinaryExpression<SgMultiplyOp>( buildIntVal( step ), buildVarRefExp( counter_symbol ) ) );
+    initializer->set_operand( position );
+    position->set_parent( initializer );
+
+    init_statement = counter;
+    appendStatement( iterator, body );
+  } else {
+    SgExpression* condition = cond;
+    if( bound != NULL ){
+      condition = buildBinaryExpression<SgLessOrEqualOp>( buildVarRefExp( symbol ), bound );
+    }
+    test = buildExprStatement( condition );
+
+    if( stride != NULL && stride->get_value() == 1 ){
+      deleteAST( stride );
+      increment = buildPlusPlusOp( buildVarRefExp( symbol ), SgUnaryOp::prefix );
+    } else {
+      increment = buildPlusAssignOp( buildVarRefExp( symbol ), inc );
+    }
+  }
+
+  SgBasicBlock* block = isSgBasicBlock( scope );
+  if( this->hoist && block != NULL && ! unrolled ){
+    this->hoister.hoist( test, initializer->get_operand(), loop_variables, block, this->widths, name->get_name().getString() );
+  }
+
+  SgForStatement* loop = buildForStatement( init_statement, test, increment, body );
+  if( unrolled ){
+    this->unrollings[loop] = trips;
+  }
+  return loop;
+}
+
+bool loop_builder::unrolls( SgForStatement* loop ) const {
+  return this->unrollings.find( loop ) != this->unrollings.end();
+}
+
+SgStatement* loop_builder::unroll( SgForStatement* loop ){
+  unordered_map<SgForStatement*, unrolling>::iterator it = this->unrollings.find( loop );
+  if( it == this->unrollings.end() ){
+    return loop;
+  }
+  unrolling trips = it->second;
+  this->unrollings.erase( it );
+
+  // The body is taken out of the loop, for the last iteration
+  SgBasicBlock* body = isSgBasicBlock( getLoopBody( loop ) );
+  assert( body != NULL );
+  setLoopBody( loop, buildBasicBlock() );
+
+  // A single iteration collapses into its body
+  if( trips.count == 1 ){
+    substitute( body, trips.iterator, trips.first );
+    deleteAST( loop );
+    return body;
+  }
+
+  // Copies declaring nothing are spliced into one block; others are blocks
+  // of their own, which keep the declarations of each iteration apart
+  bool declares = false;
+  SgStatementPtrList& statements = body->get_statements();
+  for( SgStatementPtrList::iterator st = statements.begin(); st != statements.end(); ++st ){
+    declares = declares || isSgDeclarationStatement( *st ) != NULL;
+  }
+
+  SgBasicBlock* block = buildBasicBlock();
+  for( long long k = 0; k < trips.count; k += 1 ){
+    SgBasicBlock* copy = k + 1 < trips.count ? isSgBasicBlock( copyStatement( body ) ) : body;
+    substitute( copy, trips.iterator, trips.first + k * trips.step );
+    if( declares ){
+      appendStatement( copy, block );
+    } else {
+      moveStatementsBetweenBlocks( copy, block );
+      deleteAST( copy );
+    }
+  }
+  if( trips.count == 0 ){
+    deleteAST( body );
+  }
+
+  deleteAST( loop );
+  return block;
+}
+
+void loop_builder::close_scope( SgScopeStatement* scope ){
+  if( this->hoist ){
+    this->hoister.close_scope( scope );
+  }
+}
+
+void loop_builder::clear(){
+  this->hoister.clear();
+  this->unrollings.clear();
+}
+
+void loop_builder::set_body( SgForStatement* loop, SgStatement* statement ){
+  assert( statement != NULL );
+
+  SgBasicBlock* body = isSgBasicBlock( getLoopBody( loop ) );
+  assert( body != NULL );
+
+  SgBasicBlock* block = isSgBasicBlock( statement );
+  if( block != NULL && body->get_statements().empty() ){
+    body = block;
+  } else if( block != NULL ){
+    moveStatementsBetweenBlocks( block, body );
+  } else {
+    appendStatement( statement, body );
+  }
+  setLoopBody( loop, body );
+}
+
+// The variable expression assigns to, if any
+static SgVarRefExp* assigned( SgExpression* expression ){
+  if( isSgAssignOp( expression ) || isSgCompoundAssignOp( expression ) ){
+    return isSgVarRefExp( isSgBinaryOp( expression )->get_lhs_operand() );
+  }
+  if( isSgPlusPlusOp( expression ) || isSgMinusMinusOp( expression ) ){
+    return isSgVarRefExp( isSgUnaryOp( expression )->get_operand() );
+  }
+  return NULL;
+}
+
+SgStatement* loop_builder::parallelize( SgForStatement* loop ){
+  // Variables assigned in the loop but declared outside it; everything
+  // declared inside, iterators and hoisted locals included, is private
+  // already
+  vector<SgVariableSymbol*> privates;
+  Rose_STL_Container<SgNode*> expressions = NodeQuery::querySubTree( loop, V_SgExpression );
+  for( Rose_STL_Container<SgNode*>::iterator it = expressions.begin(); it != expressions.end(); ++it ){
+    SgVarRefExp* ref = assigned( isSgExpression( *it ) );
+    if( ref == NULL ){
+      continue;
+    }
+    SgVariableSymbol* symbol = ref->get_symbol();
+    if( ! isAncestor( loop, symbol->get_declaration() ) && find( privates.begin(), privates.end(), symbol ) == privates.end() ){
+      privates.push_back( symbol );
+    }
+  }
+
+  string pragma = "omp parallel for";
+  for( vector<SgVariableSymbol*>::size_type i = 0; i < privates.size(); i += 1 ){
+    pragma += (i == 0 ? " private(" : ", ") + privates[i]->get_name().getString();
+  }
+  if( ! privates.empty() ){
+    pragma += ")";
+  }
+
+  SgBasicBlock* block = buildBasicBlock();
+  appendStatement( buildPragmaDeclaration( pragma, block ), block );
+  appendStatement( loop, block );
+  return block;
+}
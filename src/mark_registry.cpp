@@ -0,0 +1,93 @@
+#include <cassert>
+
+#include "mark_registry.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+mark_registry::mark_registry(): actions()
+{
+  this->set( "simd", pragma( "omp simd" ) );
+  this->set( "parallel", pragma( "omp parallel for" ) );
+  this->set( "unroll", pragma( "GCC unroll" ) );
+  this->set( "ivdep", pragma( "GCC ivdep" ) );
+}
+
+void mark_registry::set( const string& name, const mark_action& action ){
+  this->actions[name] = action;
+}
+
+void mark_registry::remove( const string& name ){
+  this->actions.erase( name );
+}
+
+SgStatement* mark_registry::apply( const string& mark, SgStatement* marked ) const {
+  assert( marked != NULL );
+
+  string::size_type colon = mark.find( ':' );
+  map<string, mark_action>::const_iterator it = this->actions.find( mark.substr( 0, colon ) );
+  if( it == this->actions.end() ){
+    return marked;
+  }
+
+  SgStatement* result = it->second( marked, colon == string::npos ? string() : mark.substr( colon + 1 ) );
+  assert( result != NULL );
+  return result;
+}
+
+// The OpenMP loop directive right before loop, as loop_builder::parallelize
+// puts it, or NULL
+static SgPragma* omp_directive( SgForStatement* loop ){
+  SgPragmaDeclaration* previous = isSgPragmaDeclaration( getPreviousStatement( loop ) );
+  if( previous == NULL ){
+    return NULL;
+  }
+  SgPragma* pragma = previous->get_pragma();
+  return pragma->get_pragma().compare( 0, 4, "omp " ) == 0 ? pragma : NULL;
+}
+
+mark_action mark_registry::pragma( const string& text ){
+  return [text]( SgStatement* marked, const string& argument ) -> SgStatement* {
+    // The outermost loop comes first in pre-order
+    Rose_STL_Container<SgNode*> loops = NodeQuery::querySubTree( marked, V_SgForStatement );
+    if( loops.empty() ){
+      return marked;
+    }
+    SgForStatement* loop = isSgForStatement( loops.front() );
+    string line = argument.empty() ? text : text + " " + argument;
+
+    SgBasicBlock* parent = isSgBasicBlock( loop->get_parent() );
+    SgPragma* directive = parent != NULL ? omp_directive( loop ) : NULL;
+    if( directive != NULL ){
+      // Nothing may come between the directive and the loop; simd combines
+      // with a parallel for
+      const string parallel_for( "omp parallel for" );
+      string existing = directive->get_pragma();
+      if( line == "omp simd" && existing.compare( 0, parallel_for.size(), parallel_for ) == 0
+          && existing.compare( parallel_for.size(), 5, " simd" ) != 0 ){
+        directive->set_pragma( parallel_for + " simd" + existing.substr( parallel_for.size() ) );
+      }
+      return marked;
+    }
+
+    if( loop != marked && parent != NULL ){
+      insertStatementBefore( loop, buildPragmaDeclaration( line, parent ) );
+      return marked;
+    }
+
+    // A block holding the pragma and the loop takes the loop's place
+    SgBasicBlock* block = buildBasicBlock();
+    if( loop != marked ){
+      replaceStatement( loop, block );
+    }
+    appendStatement( buildPragmaDeclaration( line, block ), block );
+    appendStatement( loop, block );
+    return loop == marked ? block : marked;
+  };
+}
+
+const mark_registry& mark_registry::defaults(){
+  static const mark_registry registry;
+  return registry;
+}
@@ -0,0 +1,72 @@
+#include <cassert>
+#include <cstring>
+
+#include "parallel_loops.hpp"
+
+parallel_loops::parallel_loops( isl_union_map* dependences ): dependences( dependences )
+{
+  assert( dependences != NULL );
+}
+
+parallel_loops::~parallel_loops(){
+  isl_union_map_free( this->dependences );
+}
+
+// Sets *user to false if the set of distances holds one that is 0 in every
+// dimension but the last, and not 0 in the last
+static isl_stat carried( isl_set* distances, void* user ){
+  unsigned n = isl_set_dim( distances, isl_dim_set );
+  if( n == 0 ){
+    isl_set_free( distances );
+    return isl_stat_ok;
+  }
+
+  for( unsigned i = 0; i + 1 < n; i += 1 ){
+    distances = isl_set_fix_si( distances, isl_dim_set, i, 0 );
+  }
+  isl_set* forward = isl_set_lower_bound_si( isl_set_copy( distances ), isl_dim_set, n - 1, 1 );
+  isl_set* backward = isl_set_upper_bound_si( distances, isl_dim_set, n - 1, -1 );
+
+  // Errors count as dependences carried
+  if( isl_set_is_empty( forward ) != isl_bool_true || isl_set_is_empty( backward ) != isl_bool_true ){
+    *static_cast<bool*>( user ) = false;
+  }
+  isl_set_free( forward );
+  isl_set_free( backward );
+  return isl_stat_ok;
+}
+
+bool parallel_loops::parallel( isl_ast_build* build ){
+  // Dependences between the iterations of the loops down to this one
+  isl_union_map* schedule = isl_ast_build_get_schedule( build );
+  isl_union_map* between = isl_union_map_apply_domain( isl_union_map_copy( this->dependences ), isl_union_map_copy( schedule ) );
+  between = isl_union_map_apply_range( between, schedule );
+
+  isl_union_set* distances = isl_union_map_deltas( between );
+  bool parallel = true;
+  isl_union_set_foreach_set( distances, carried, &parallel );
+  isl_union_set_free( distances );
+
+  return parallel;
+}
+
+isl_id* parallel_loops::before_each_for( isl_ast_build* build, void* user ){
+  parallel_loops* loops = static_cast<parallel_loops*>( user );
+  const char* name = loops->parallel( build ) ? "parallel" : "serial";
+  return isl_id_alloc( isl_ast_build_get_ctx( build ), name, NULL );
+}
+
+isl_ast_build* parallel_loops::annotate( isl_ast_build* build ){
+  return isl_ast_build_set_before_each_for( build, &parallel_loops::before_each_for, this );
+}
+
+bool parallel_loops::is_parallel( isl_id* annotation ){
+  return annotation != NULL && isl_id_get_name( annotation ) != NULL && std::strcmp( isl_id_get_name( annotation ), "parallel" ) == 0;
+}
+
+bool parallel_loops::is_parallel( isl_ast_node* node ){
+  isl_id* annotation = isl_ast_node_get_annotation( node );
+  bool parallel = is_parallel( annotation );
+  isl_id_free( annotation );
+  return parallel;
+}
@@ -0,0 +1,177 @@
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "phase_profiler.hpp"
+
+using namespace std;
+
+static uint64_t now_ns(){
+  return chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+static void write_json_string( ostream& out, const string& text ){
+  out << '"';
+  for( string::size_type i = 0; i < text.size(); i += 1 ){
+    if( text[i] == '"' || text[i] == '\\' ){
+      out << '\\';
+    }
+    out << text[i];
+  }
+  out << '"';
+}
+
+phase_profiler::phase_profiler(): active( false ), origin( now_ns() ), records(), open(), open_cpu()
+{}
+
+phase_profiler& phase_profiler::global(){
+  static phase_profiler profiler;
+  return profiler;
+}
+
+void phase_profiler::start(){
+  this->active = true;
+}
+
+void phase_profiler::stop(){
+  this->active = false;
+}
+
+void phase_profiler::clear(){
+  this->records.clear();
+  this->open.clear();
+  this->open_cpu.clear();
+}
+
+bool phase_profiler::begin( const char* name ){
+  if( ! this->active ){
+    return false;
+  }
+
+  phase_record record;
+  record.name = name;
+  record.depth = this->open.size();
+  record.wall_ns = 0;
+  record.cpu_ns = 0;
+  record.rss_start_kb = resident_kb();
+  record.rss_end_kb = record.rss_start_kb;
+  record.start_ns = now_ns() - this->origin;
+
+  this->open.push_back( this->records.size() );
+  this->open_cpu.push_back( cpu_ns() );
+  this->records.push_back( record );
+  return true;
+}
+
+void phase_profiler::end(){
+  // Phases opened before stop() are still closed
+  if( this->open.empty() ){
+    return;
+  }
+
+  phase_record& record = this->records[this->open.back()];
+  record.wall_ns = now_ns() - this->origin - record.start_ns;
+  record.cpu_ns = cpu_ns() - this->open_cpu.back();
+  record.rss_end_kb = resident_kb();
+
+  this->open.pop_back();
+  this->open_cpu.pop_back();
+}
+
+const vector<phase_record>& phase_profiler::phases() const {
+  return this->records;
+}
+
+bool phase_profiler::write_chrome_trace( ostream& out ) const {
+  bool first = true;
+
+  out << "{\"traceEvents\":[" << endl;
+  for( vector<phase_record>::size_type i = 0; i < this->records.size(); i += 1 ){
+    const phase_record& record = this->records[i];
+    // Phases still open have no duration yet
+    bool is_open = false;
+    for( vector< vector<phase_record>::size_type >::size_type j = 0; j < this->open.size(); j += 1 ){
+      is_open = is_open || this->open[j] == i;
+    }
+    if( is_open ){
+      continue;
+    }
+
+    out << (first ? "" : ",\n") << "{\"name\":";
+    write_json_string( out, record.name );
+    out << ",\"cat\":\"phase\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+        << ",\"ts\":" << record.start_ns / 1000.0
+        << ",\"dur\":" << record.wall_ns / 1000.0
+        << ",\"args\":{\"cpu_ms\":" << record.cpu_ns / 1e6
+        << ",\"rss_kb\":" << record.rss_end_kb
+        << ",\"rss_delta_kb\":" << record.rss_end_kb - record.rss_start_kb << "}}";
+    out << ",\n{\"name\":\"rss\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":" << record.start_ns / 1000.0
+        << ",\"args\":{\"kb\":" << record.rss_start_kb << "}}";
+    out << ",\n{\"name\":\"rss\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":" << (record.start_ns + record.wall_ns) / 1000.0
+        << ",\"args\":{\"kb\":" << record.rss_end_kb << "}}";
+    first = false;
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}" << endl;
+
+  return out.good();
+}
+
+bool phase_profiler::write_chrome_trace( const string& path ) const {
+  ofstream out( path.c_str(), ios::out | ios::trunc );
+  return out.is_open() && this->write_chrome_trace( out );
+}
+
+void phase_profiler::write_summary( ostream& out ) const {
+  char line[64];
+  out << "wall ms     cpu ms      rss delta KiB  phase" << endl;
+  for( vector<phase_record>::size_type i = 0; i < this->records.size(); i += 1 ){
+    const phase_record& record = this->records[i];
+    snprintf( line, sizeof(line), "%-11.3f %-11.3f %-14ld ", record.wall_ns / 1e6, record.cpu_ns / 1e6, record.rss_end_kb - record.rss_start_kb );
+    out << line << string( record.depth * 2, ' ' ) << record.name << endl;
+  }
+}
+
+long phase_profiler::resident_kb(){
+  // Second field of statm is the resident set, in pages
+  FILE* statm = fopen( "/proc/self/statm", "r" );
+  if( statm != NULL ){
+    long size = 0;
+    long resident = 0;
+    int fields = fscanf( statm, "%ld %ld", &size, &resident );
+    fclose( statm );
+    if( fields == 2 ){
+      return resident * ( sysconf( _SC_PAGESIZE ) / 1024 );
+    }
+  }
+
+  // Peak rather than current, but better than nothing
+  struct rusage usage;
+  if( getrusage( RUSAGE_SELF, &usage ) == 0 ){
+    return usage.ru_maxrss;
+  }
+  return 0;
+}
+
+uint64_t phase_profiler::cpu_ns(){
+  struct timespec time;
+  if( clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &time ) != 0 ){
+    return 0;
+  }
+  return (uint64_t) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+phase_scope::phase_scope( const char* name, phase_profiler& profiler ): profiler( NULL ) {
+  if( profiler.enabled() && profiler.begin( name ) ){
+    this->profiler = &profiler;
+  }
+}
+
+phase_scope::~phase_scope(){
+  if( this->profiler != NULL ){
+    this->profiler->end();
+  }
+}
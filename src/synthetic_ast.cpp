@@ -0,0 +1,119 @@
+#include "phase_profiler.hpp"
+#include "synthetic_ast.hpp"
+
+using namespace std;
+
+synthetic_options::synthetic_options():
+  nest_depth( 2 ),
+  statements( 1 ),
+  fan_in( 1 ),
+  modulo( 1 ),
+  tile_size( 0 ),
+  fused( false ),
+  parametric( true ),
+  constant_bound( 1024 )
+{ }
+
+namespace {
+
+string iterator_name( int dimension ){
+  return string( "i" ) + to_string( dimension );
+}
+
+string iterator_list( const synthetic_options& options ){
+  string iterators;
+  for( int d = 0; d < options.nest_depth; d += 1 ){
+    iterators += (d == 0 ? "" : ",") + iterator_name( d );
+  }
+  return iterators;
+}
+
+string lower_parameter( int bound, int dimension ){
+  return string( "L" ) + to_string( bound ) + "_" + to_string( dimension );
+}
+
+string upper_parameter( int bound, int dimension ){
+  return string( "U" ) + to_string( bound ) + "_" + to_string( dimension );
+}
+
+}
+
+vector<string> synthetic_parameters( const synthetic_options& options ){
+  vector<string> parameters;
+  // Without parametric bounds the first bound of each side is a constant
+  int first = options.parametric ? 0 : 1;
+  for( int d = 0; d < options.nest_depth; d += 1 ){
+    for( int j = first; j < options.fan_in; j += 1 ){
+      parameters.push_back( lower_parameter( j, d ) );
+      parameters.push_back( upper_parameter( j, d ) );
+    }
+  }
+  return parameters;
+}
+
+string synthetic_domain( const synthetic_options& options ){
+  vector<string> parameters = synthetic_parameters( options );
+  string iterators = iterator_list( options );
+
+  string constraints;
+  for( int d = 0; d < options.nest_depth; d += 1 ){
+    string iterator = iterator_name( d );
+    if( ! options.parametric ){
+      constraints += (d == 0 ? "" : " and ") + string( "0 <= " ) + iterator + " < " + to_string( options.constant_bound );
+    }
+    for( int j = options.parametric ? 0 : 1; j < options.fan_in; j += 1 ){
+      constraints += (constraints.empty() ? "" : " and ") + lower_parameter( j, d ) + " <= " + iterator
+                   + " < " + upper_parameter( j, d );
+    }
+  }
+
+  string domain( "[" );
+  for( vector<string>::size_type i = 0; i < parameters.size(); i += 1 ){
+    domain += (i == 0 ? "" : ",") + parameters[i];
+  }
+  domain += "]->{ ";
+
+  for( int k = 0; k < options.statements; k += 1 ){
+    domain += (k == 0 ? "" : "; ") + string( "S" ) + to_string( k ) + "[" + iterators + "] : " + constraints;
+    if( options.modulo > 1 && k % 2 == 1 ){
+      domain += " and " + iterator_name( options.nest_depth - 1 ) + " mod " + to_string( options.modulo ) + " = 0";
+    }
+  }
+
+  return domain + " }";
+}
+
+string synthetic_schedule( const synthetic_options& options ){
+  string iterators = iterator_list( options );
+
+  string dimensions;
+  if( options.tile_size > 0 ){
+    for( int d = 0; d < options.nest_depth; d += 1 ){
+      dimensions += "floor(" + iterator_name( d ) + "/" + to_string( options.tile_size ) + "),";
+    }
+  }
+  dimensions += iterators;
+
+  string schedule( "{ " );
+  for( int k = 0; k < options.statements; k += 1 ){
+    string statement = to_string( k );
+    schedule += (k == 0 ? "" : "; ") + string( "S" ) + statement + "[" + iterators + "] -> ["
+              + (options.fused ? dimensions + "," + statement : statement + "," + dimensions) + "]";
+  }
+
+  return schedule + " }";
+}
+
+isl_ast_node* synthetic_ast( isl_ctx* ctx, const synthetic_options& options ){
+  phase_scope phase( "synthetic_ast" );
+
+  isl_union_set* domain = isl_union_set_read_from_str( ctx, synthetic_domain( options ).c_str() );
+  isl_union_map* schedule = isl_union_map_read_from_str( ctx, synthetic_schedule( options ).c_str() );
+  schedule = isl_union_map_intersect_domain( schedule, domain );
+
+  isl_ast_build* build = isl_ast_build_alloc( ctx );
+  isl_ast_node* isl_ast = isl_ast_build_node_from_schedule_map( build, schedule );
+  isl_ast_build_free( build );
+
+  return isl_ast;
+}
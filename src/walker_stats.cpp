@@ -0,0 +1,201 @@
+#include <chrono>
+#include <sstream>
+
+#include "walker_stats.hpp"
+
+using namespace std;
+
+static uint64_t now_ns(){
+  return chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+static const char* const method_names[visit_methods] = {
+  "visit_node_for",
+  "visit_node_if",
+  "visit_node_block",
+  "visit_node_mark",
+  "visit_node_user",
+  "visit_node_error",
+  "visit_node_unknown",
+
+  "visit_expr_id",
+  "visit_expr_int",
+  "visit_expr_error",
+  "visit_expr_unknown",
+
+  "visit_op_and",
+  "visit_op_and_then",
+  "visit_op_or",
+  "visit_op_or_else",
+  "visit_op_max",
+  "visit_op_min",
+  "visit_op_minus",
+  "visit_op_add",
+  "visit_op_sub",
+  "visit_op_mul",
+  "visit_op_div",
+  "visit_op_fdiv_q",
+  "visit_op_pdiv_q",
+  "visit_op_pdiv_r",
+  "visit_op_zdiv_r",
+  "visit_op_cond",
+  "visit_op_select",
+  "visit_op_eq",
+  "visit_op_le",
+  "visit_op_lt",
+  "visit_op_ge",
+  "visit_op_gt",
+  "visit_op_call",
+  "visit_op_access",
+  "visit_op_member",
+  "visit_op_address_of",
+  "visit_op_error",
+  "visit_op_unknown"
+};
+
+visit_counter::visit_counter(): calls( 0 ), inclusive_ns( 0 ), exclusive_ns( 0 ), sage_nodes( 0 )
+{}
+
+walker_stats::walker_stats(): frames(), nested_results(), count_stack(), count_nested(), symbol_hits( 0 ), symbol_misses( 0 ), memo_hits( 0 ), memo_misses( 0 )
+{}
+
+visit_method walker_stats::method_of( isl_ast_node* node ){
+  switch( isl_ast_node_get_type( node ) ){
+    case isl_ast_node_for:   return stats_node_for;
+    case isl_ast_node_if:    return stats_node_if;
+    case isl_ast_node_block: return stats_node_block;
+    case isl_ast_node_mark:  return stats_node_mark;
+    case isl_ast_node_user:  return stats_node_user;
+    case isl_ast_node_error: return stats_node_error;
+    default:                 return stats_node_unknown;
+  }
+}
+
+visit_method walker_stats::method_of( isl_ast_expr* expr ){
+  switch( isl_ast_expr_get_type( expr ) ){
+    case isl_ast_expr_id:    return stats_expr_id;
+    case isl_ast_expr_int:   return stats_expr_int;
+    case isl_ast_expr_error: return stats_expr_error;
+    case isl_ast_expr_op:    break;
+    default:                 return stats_expr_unknown;
+  }
+
+  // Operations are listed in isl_ast_op_type order
+  isl_ast_op_type op = isl_ast_expr_get_op_type( expr );
+  if( op == isl_ast_op_error ){
+    return stats_op_error;
+  }
+  if( op < isl_ast_op_and || op > isl_ast_op_address_of ){
+    return stats_op_unknown;
+  }
+  return (visit_method) (stats_op_and + (op - isl_ast_op_and));
+}
+
+const char* walker_stats::name( visit_method method ){
+  return (method >= 0 && method < visit_methods) ? method_names[method] : "visit_unknown";
+}
+
+void walker_stats::enter( visit_method method ){
+  frame entered = { method, now_ns(), 0, this->nested_results.size() };
+  this->frames.push_back( entered );
+}
+
+void walker_stats::leave( SgNode* result ){
+  uint64_t elapsed = now_ns() - this->frames.back().start;
+  frame left = this->frames.back();
+  this->frames.pop_back();
+
+  visit_counter& counter = this->counters[left.method];
+  counter.calls += 1;
+  counter.inclusive_ns += elapsed;
+  counter.exclusive_ns += elapsed - left.nested_ns;
+  counter.sage_nodes += this->count_built( result, left.results_base );
+
+  // The caller sees this visit as nested, and its result as built by it
+  this->nested_results.resize( left.results_base );
+  if( ! this->frames.empty() ){
+    this->frames.back().nested_ns += elapsed;
+    this->nested_results.push_back( result );
+  }
+}
+
+/*
+Counts the nodes reachable from result, stopping at the results of nested
+visits, which were counted when those visits left.
+*/
+unsigned long walker_stats::count_built( SgNode* result, vector<SgNode*>::size_type results_base ){
+  unsigned long count = 0;
+  unordered_set<SgNode*>& nested = this->count_nested;
+  nested.clear();
+  nested.insert( this->nested_results.begin() + results_base, this->nested_results.end() );
+
+  vector<SgNode*>& stack = this->count_stack;
+  stack.clear();
+  if( result != NULL ){
+    stack.push_back( result );
+  }
+
+  while( ! stack.empty() ){
+    SgNode* node = stack.back();
+    stack.pop_back();
+
+    if( nested.count( node ) != 0 ){
+      continue;
+    }
+
+    count += 1;
+    for( size_t i = 0; i < node->get_numberOfTraversalSuccessors(); i += 1 ){
+      SgNode* successor = node->get_traversalSuccessorByIndex( i );
+      if( successor != NULL ){
+        stack.push_back( successor );
+      }
+    }
+  }
+
+  return count;
+}
+
+double walker_stats::memo_hit_rate() const {
+  unsigned long lookups = this->memo_hits + this->memo_misses;
+  return lookups == 0 ? 0.0 : (double) this->memo_hits / lookups;
+}
+
+void walker_stats::clear(){
+  for( int i = 0; i < visit_methods; i += 1 ){
+    this->counters[i] = visit_counter();
+  }
+  this->symbol_hits = 0;
+  this->symbol_misses = 0;
+  this->memo_hits = 0;
+  this->memo_misses = 0;
+  this->frames.clear();
+  this->nested_results.clear();
+}
+
+void walker_stats::dump_json( ostream& out ) const {
+  out << "{\"visits\":{";
+  bool first = true;
+  for( int i = 0; i < visit_methods; i += 1 ){
+    const visit_counter& counter = this->counters[i];
+    if( counter.calls == 0 ){
+      continue;
+    }
+    out << (first ? "" : ",") << "\"" << method_names[i] << "\":{"
+        << "\"calls\":" << counter.calls
+        << ",\"inclusive_ns\":" << counter.inclusive_ns
+        << ",\"exclusive_ns\":" << counter.exclusive_ns
+        << ",\"sage_nodes\":" << counter.sage_nodes << "}";
+    first = false;
+  }
+  out << "},\"symbol_cache\":{\"hits\":" << this->symbol_hits
+      << ",\"misses\":" << this->symbol_misses
+      << "},\"expr_memo\":{\"hits\":" << this->memo_hits
+      << ",\"misses\":" << this->memo_misses
+      << ",\"hit_rate\":" << this->memo_hit_rate() << "}}" << endl;
+}
+
+string walker_stats::to_json() const {
+  ostringstream out;
+  this->dump_json( out );
+  return out.str();
+}
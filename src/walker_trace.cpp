@@ -0,0 +1,157 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "walker_trace.hpp"
+
+using namespace std;
+
+static uint64_t now_ns(){
+  return chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+void null_trace::start(){
+  static atomic<bool> noted( false );
+  if( ! noted.exchange( true ) ){
+    cerr << "Walker tracing is compiled out; rebuild with make TRACE=1 to trace" << endl;
+  }
+}
+
+ring_trace::ring_trace( size_t capacity ): events(), capacity( capacity == 0 ? 1 : capacity ), head( 0 ), count( 0 ), lost( 0 ), active( false ), origin( now_ns() )
+{}
+
+void ring_trace::start(){
+  // Buffer is allocated once, by the first start, so walkers that never
+  // trace do not pay for it
+  if( this->events.empty() ){
+    this->events.resize( this->capacity );
+  }
+  this->active = true;
+}
+
+void ring_trace::stop(){
+  this->active = false;
+}
+
+void ring_trace::clear(){
+  this->head = 0;
+  this->count = 0;
+  this->lost = 0;
+}
+
+trace_event* ring_trace::next( const char* kind, int depth, const void* sage ){
+  trace_event* event = &this->events[this->head];
+  this->head = (this->head + 1) % this->events.size();
+  if( this->count < this->events.size() ){
+    this->count += 1;
+  } else {
+    this->lost += 1;
+  }
+
+  event->kind = kind;
+  event->depth = depth;
+  event->sage = sage;
+  event->value = 0;
+  event->has_value = false;
+  event->time = now_ns() - this->origin;
+  event->detail[0] = '\0';
+  return event;
+}
+
+void ring_trace::record_id( const char* kind, int depth, const void* sage, isl_id* id ){
+  if( this->active ){
+    trace_event* event = this->next( kind, depth, sage );
+    const char* name = (id == NULL) ? NULL : isl_id_get_name( id );
+    if( name != NULL ){
+      strncpy( event->detail, name, sizeof(event->detail) - 1 );
+      event->detail[sizeof(event->detail) - 1] = '\0';
+    }
+  }
+}
+
+size_t ring_trace::size() const {
+  return this->count;
+}
+
+size_t ring_trace::dropped() const {
+  return this->lost;
+}
+
+// Minimal JSON string escaping; kinds and isl names are plain identifiers
+static void write_json_string( ostringstream& out, const char* str ){
+  out << '"';
+  for( const char* c = str; *c != '\0'; ++c ){
+    if( *c == '"' || *c == '\\' ){
+      out << '\\';
+    }
+    out << *c;
+  }
+  out << '"';
+}
+
+bool ring_trace::drain( ostream& out, trace_format format ){
+  ostringstream buffer;
+  size_t first = (this->count == 0) ? 0 : (this->head + this->events.size() - this->count) % this->events.size();
+
+  if( format == trace_chrome ){
+    buffer << "{\"traceEvents\":[";
+  }
+  else if( this->lost != 0 ){
+    buffer << "(" << this->lost << " earlier events dropped)\n";
+  }
+
+  char time_us[32];
+  for( size_t i = 0; i < this->count; i += 1 ){
+    const trace_event& event = this->events[ (first + i) % this->events.size() ];
+    int indent = event.depth < 0 ? 0 : event.depth * 2;
+
+    if( format == trace_chrome ){
+      snprintf( time_us, sizeof(time_us), "%.3f", event.time / 1000.0 );
+      buffer << (i == 0 ? "\n" : ",\n") << "{\"name\":";
+      write_json_string( buffer, event.kind );
+      buffer << ",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":0,\"ts\":" << time_us
+             << ",\"args\":{\"depth\":" << event.depth
+             << ",\"sage\":\"" << event.sage << "\"";
+      if( event.has_value ){
+        buffer << ",\"value\":" << event.value;
+      }
+      if( event.detail[0] != '\0' ){
+        buffer << ",\"symbol\":";
+        write_json_string( buffer, event.detail );
+      }
+      buffer << "}}";
+    }
+    else {
+      buffer << string( indent, ' ' ) << event.kind;
+      if( event.detail[0] != '\0' ){
+        buffer << ": " << event.detail;
+      }
+      if( event.has_value ){
+        buffer << ": " << event.value;
+      }
+      buffer << " @ " << event.sage << '\n';
+    }
+  }
+
+  if( format == trace_chrome ){
+    buffer << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":" << this->lost << "}}\n";
+  }
+
+  const string& text = buffer.str();
+  out.write( text.data(), text.size() );
+  out.flush();
+  this->clear();
+  return out.good();
+}
+
+bool ring_trace::drain( const string& path, trace_format format ){
+  ofstream out( path.c_str(), ios::out | ios::trunc );
+  if( ! out.is_open() ){
+    return false;
+  }
+  return this->drain( out, format );
+}
@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+#include "isl_handle.hpp"
+#include "width_analysis.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+
+// Value clamped to the interval bounds, which stand for no bound
+static long long clamp( __int128 value ){
+  return value < LLONG_MIN ? LLONG_MIN : ( value > LLONG_MAX ? LLONG_MAX : (long long) value );
+}
+
+static long long magnitude( long long low, long long high ){
+  return max( clamp( -(__int128) low ), high );
+}
+
+// value / divisor rounded down
+static long long floor_div( long long value, long long divisor ){
+  long long quotient = value / divisor;
+  return ( value % divisor != 0 && ( (value < 0) != (divisor < 0) ) ) ? quotient - 1 : quotient;
+}
+
+static long long to_bound( isl_val* value, long long unbounded ){
+  if( value == NULL || isl_val_is_nan( value ) == isl_bool_true || isl_val_is_infty( value ) == isl_bool_true
+      || isl_val_is_neginfty( value ) == isl_bool_true || isl_val_cmp_si( value, LONG_MAX ) > 0 || isl_val_cmp_si( value, LONG_MIN ) < 0 ){
+    return unbounded;
+  }
+  return isl_val_get_num_si( value );
+}
+
+width_analysis::width_analysis( isl_ast_node* root, const string& context ): parameters(), iterators(), wide_iterators()
+{
+  if( ! context.empty() ){
+    isl_set* set = isl_set_read_from_str( isl_ast_node_get_ctx( root ), context.c_str() );
+    assert( set != NULL );
+    this->bound_parameters( set );
+    isl_set_free( set );
+  }
+
+  // Iterators are only referenced inside their loop, and a nested loop never
+  // has the name of one around it, so each name's range is the range of the
+  // loop last entered under that name
+  vector<isl_ast_node_handle> stack;
+  stack.push_back( isl_ast_node_handle( isl_ast_node_copy( root ) ) );
+  while( ! stack.empty() ){
+    isl_ast_node_handle current = std::move( stack.back() );
+    stack.pop_back();
+    isl_ast_node* node = current.get();
+
+    switch( isl_ast_node_get_type( node ) ){
+      case isl_ast_node_for: {
+        isl_ast_expr_handle iterator( isl_ast_node_for_get_iterator( node ) );
+        isl_id_handle id( isl_ast_expr_get_id( iterator.get() ) );
+        const char* name = isl_id_get_name( id.get() );
+
+        isl_ast_expr_handle init( isl_ast_node_for_get_init( node ) );
+        isl_ast_expr_handle cond( isl_ast_node_for_get_cond( node ) );
+        isl_ast_expr_handle inc( isl_ast_node_for_get_inc( node ) );
+        // The iterator holds its initial value even when the loop does not
+        // run, so the whole interval of init is in its range
+        interval start = this->evaluate( init.get() );
+        interval range = { start.low, LLONG_MAX };
+        range.high = max( start.high, this->upper_bound( cond.get(), name ) );
+        this->iterators[name] = range;
+
+        // The condition and increment compute with the iterator
+        this->evaluate( cond.get() );
+        this->evaluate( inc.get() );
+        if( ! narrow( range ) ){
+          this->wide_iterators.insert( name );
+        }
+
+        stack.push_back( isl_ast_node_handle( isl_ast_node_for_get_body( node ) ) );
+        break;
+      }
+
+      case isl_ast_node_if: {
+        isl_ast_expr_handle cond( isl_ast_node_if_get_cond( node ) );
+        this->evaluate( cond.get() );
+        if( isl_ast_node_if_has_else( node ) ){
+          stack.push_back( isl_ast_node_handle( isl_ast_node_if_get_else( node ) ) );
+        }
+        stack.push_back( isl_ast_node_handle( isl_ast_node_if_get_then( node ) ) );
+        break;
+      }
+
+      case isl_ast_node_block: {
+        isl_ast_node_list_handle children( isl_ast_node_block_get_children( node ) );
+        for( int i = isl_ast_node_list_n_ast_node( children.get() ) - 1; i >= 0; i -= 1 ){
+          stack.push_back( isl_ast_node_handle( isl_ast_node_list_get_ast_node( children.get(), i ) ) );
+        }
+        break;
+      }
+
+      case isl_ast_node_mark:
+        stack.push_back( isl_ast_node_handle( isl_ast_node_mark_get_node( node ) ) );
+        break;
+
+      case isl_ast_node_user: {
+        isl_ast_expr_handle expr( isl_ast_node_user_get_expr( node ) );
+        this->evaluate( expr.get() );
+        break;
+      }
+
+      default:
+        break;
+    }
+  }
+}
+
+void width_analysis::bound_parameters( isl_set* context ){
+  isl_space* space = isl_set_get_space( context );
+  for( unsigned i = 0; i < isl_set_dim( context, isl_dim_param ); i += 1 ){
+    isl_aff* parameter = isl_aff_var_on_domain( isl_local_space_from_space( isl_space_copy( space ) ), isl_dim_param, i );
+    isl_val_handle low( isl_set_min_val( context, parameter ) );
+    isl_val_handle high( isl_set_max_val( context, parameter ) );
+    isl_aff_free( parameter );
+
+    interval range = { to_bound( low.get(), LLONG_MIN ), to_bound( high.get(), LLONG_MAX ) };
+    this->parameters[isl_set_get_dim_name( context, isl_dim_param, i )] = range;
+  }
+  isl_space_free( space );
+}
+
+bool width_analysis::narrow( const interval& range ){
+  return range.low >= INT32_MIN && range.high <= INT32_MAX;
+}
+
+void width_analysis::widen( isl_ast_expr* expr ){
+  if( isl_ast_expr_get_type( expr ) == isl_ast_expr_id ){
+    isl_id_handle id( isl_ast_expr_get_id( expr ) );
+    const char* name = isl_id_get_name( id.get() );
+    if( this->iterators.find( name ) != this->iterators.end() ){
+      this->wide_iterators.insert( name );
+    }
+  }
+  else if( isl_ast_expr_get_type( expr ) == isl_ast_expr_op ){
+    for( int i = 0; i < isl_ast_expr_get_op_n_arg( expr ); i += 1 ){
+      isl_ast_expr_handle arg( isl_ast_expr_get_op_arg( expr, i ) );
+      this->widen( arg.get() );
+    }
+  }
+}
+
+width_analysis::interval width_analysis::evaluate( isl_ast_expr* expr ){
+  const interval unbounded = { LLONG_MIN, LLONG_MAX };
+
+  switch( isl_ast_expr_get_type( expr ) ){
+    case isl_ast_expr_int: {
+      isl_val_handle value( isl_ast_expr_get_val( expr ) );
+      interval range = { to_bound( value.get(), LLONG_MIN ), to_bound( value.get(), LLONG_MAX ) };
+      return range;
+    }
+
+    case isl_ast_expr_id: {
+      isl_id_handle id( isl_ast_expr_get_id( expr ) );
+      const char* name = isl_id_get_name( id.get() );
+      map<string, interval>::const_iterator it = this->iterators.find( name );
+      if( it != this->iterators.end() ){
+        return it->second;
+      }
+      it = this->parameters.find( name );
+      return it != this->parameters.end() ? it->second : unbounded;
+    }
+
+    case isl_ast_expr_op:
+      break;
+
+    default:
+      return unbounded;
+  }
+
+  int n = isl_ast_expr_get_op_n_arg( expr );
+  vector<interval> args;
+  args.reserve( n );
+  for( int i = 0; i < n; i += 1 ){
+    isl_ast_expr_handle arg( isl_ast_expr_get_op_arg( expr, i ) );
+    args.push_back( this->evaluate( arg.get() ) );
+  }
+
+  interval range = unbounded;
+  switch( isl_ast_expr_get_op_type( expr ) ){
+    case isl_ast_op_add:
+      range.low = clamp( (__int128) args[0].low + args[1].low );
+      range.high = clamp( (__int128) args[0].high + args[1].high );
+      break;
+
+    case isl_ast_op_sub:
+      range.low = clamp( (__int128) args[0].low - args[1].high );
+      range.high = clamp( (__int128) args[0].high - args[1].low );
+      break;
+
+    case isl_ast_op_minus:
+      range.low = clamp( -(__int128) args[0].high );
+      range.high = clamp( -(__int128) args[0].low );
+      break;
+
+    case isl_ast_op_mul: {
+      long long products[] = { clamp( (__int128) args[0].low * args[1].low ), clamp( (__int128) args[0].low * args[1].high ),
+                               clamp( (__int128) args[0].high * args[1].low ), clamp( (__int128) args[0].high * args[1].high ) };
+      range.low = *min_element( products, products + 4 );
+      range.high = *max_element( products, products + 4 );
+      break;
+    }
+
+    case isl_ast_op_max:
+    case isl_ast_op_min: {
+      bool is_max = isl_ast_expr_get_op_type( expr ) == isl_ast_op_max;
+      range = args[0];
+      for( int i = 1; i < n; i += 1 ){
+        range.low = is_max ? max( range.low, args[i].low ) : min( range.low, args[i].low );
+        range.high = is_max ? max( range.high, args[i].high ) : min( range.high, args[i].high );
+      }
+      break;
+    }
+
+    case isl_ast_op_div:
+    case isl_ast_op_fdiv_q:
+    case isl_ast_op_pdiv_q:
+      if( args[1].low == args[1].high && args[1].low > 0 && args[1].low != LLONG_MAX ){
+        // Rounding down by a positive constant keeps the order
+        range.low = floor_div( args[0].low, args[1].low );
+        range.high = floor_div( args[0].high, args[1].low );
+      } else {
+        // An integer quotient is no larger than its dividend
+        long long bound = magnitude( args[0].low, args[0].high );
+        range.low = clamp( -(__int128) bound );
+        range.high = bound;
+      }
+      break;
+
+    case isl_ast_op_pdiv_r:
+    case isl_ast_op_zdiv_r: {
+      long long bound = magnitude( args[1].low, args[1].high );
+      range.low = isl_ast_expr_get_op_type( expr ) == isl_ast_op_pdiv_r ? 0 : clamp( 1 - (__int128) bound );
+      range.high = clamp( (__int128) bound - 1 );
+      break;
+    }
+
+    case isl_ast_op_cond:
+    case isl_ast_op_select:
+      range.low = min( args[1].low, args[2].low );
+      range.high = max( args[1].high, args[2].high );
+      break;
+
+    case isl_ast_op_and:
+    case isl_ast_op_and_then:
+    case isl_ast_op_or:
+    case isl_ast_op_or_else:
+    case isl_ast_op_eq:
+    case isl_ast_op_le:
+    case isl_ast_op_lt:
+    case isl_ast_op_ge:
+    case isl_ast_op_gt:
+      range.low = 0;
+      range.high = 1;
+      break;
+
+    default:
+      // Calls and accesses are not integers computed with the iterators
+      range.low = 0;
+      range.high = 0;
+      break;
+  }
+
+  if( ! narrow( range ) ){
+    this->widen( expr );
+  }
+  return range;
+}
+
+long long width_analysis::upper_bound( isl_ast_expr* cond, const char* iterator ){
+  if( isl_ast_expr_get_type( cond ) != isl_ast_expr_op || isl_ast_expr_get_op_n_arg( cond ) != 2 ){
+    return LLONG_MAX;
+  }
+
+  isl_ast_expr_handle lhs( isl_ast_expr_get_op_arg( cond, 0 ) );
+  isl_ast_expr_handle rhs( isl_ast_expr_get_op_arg( cond, 1 ) );
+  isl_ast_op_type type = isl_ast_expr_get_op_type( cond );
+  if( type == isl_ast_op_and || type == isl_ast_op_and_then ){
+    return min( this->upper_bound( lhs.get(), iterator ), this->upper_bound( rhs.get(), iterator ) );
+  }
+
+  // iterator <= bound, iterator < bound, or the same turned around
+  bool on_left = type == isl_ast_op_le || type == isl_ast_op_lt;
+  bool on_right = type == isl_ast_op_ge || type == isl_ast_op_gt;
+  isl_ast_expr* side = on_left ? lhs.get() : rhs.get();
+  if( ( ! on_left && ! on_right ) || isl_ast_expr_get_type( side ) != isl_ast_expr_id ){
+    return LLONG_MAX;
+  }
+  isl_id_handle id( isl_ast_expr_get_id( side ) );
+  if( string( isl_id_get_name( id.get() ) ) != iterator ){
+    return LLONG_MAX;
+  }
+
+  long long bound = this->evaluate( on_left ? rhs.get() : lhs.get() ).high;
+  bool strict = type == isl_ast_op_lt || type == isl_ast_op_gt;
+  return strict && bound != LLONG_MAX ? bound - 1 : bound;
+}
+
+bool width_analysis::wide( const string& iterator ) const {
+  return this->wide_iterators.find( iterator ) != this->wide_iterators.end();
+}
+
+SgType* width_analysis::type( const string& iterator, SgScopeStatement* scope ) const {
+  return buildOpaqueType( this->wide( iterator ) ? "int64_t" : "int32_t", scope );
+}
+
+SgType* width_analysis::operation_type( const width_analysis* widths, const vector<SgExpression*>& operands, SgScopeStatement* scope ){
+  if( widths == NULL ){
+    return buildIntType();
+  }
+
+  for( vector<SgExpression*>::const_iterator it = operands.begin(); it != operands.end(); ++it ){
+    if( ! NodeQuery::querySubTree( *it, V_SgLongLongIntVal ).empty() ){
+      return buildOpaqueType( "int64_t", scope );
+    }
+    Rose_STL_Container<SgNode*> references = NodeQuery::querySubTree( *it, V_SgVarRefExp );
+    for( Rose_STL_Container<SgNode*>::iterator ref = references.begin(); ref != references.end(); ++ref ){
+      if( widths->wide( isSgVarRefExp( *ref )->get_symbol()->get_name().getString() ) ){
+        return buildOpaqueType( "int64_t", scope );
+      }
+    }
+  }
+  return buildIntType();
+}
@@ -0,0 +1,124 @@
+#include "work_pool.hpp"
+
+using namespace std;
+
+work_pool::work_pool( unsigned threads ): threads(), queues(), lock(), wake(), finished(), body( NULL ), generation( 0 ), working( 0 ), stopping( false ) {
+  if( threads == 0 ){
+    threads = thread::hardware_concurrency();
+  }
+  if( threads == 0 ){
+    threads = 1;
+  }
+
+  for( unsigned w = 0; w < threads; w += 1 ){
+    this->queues.push_back( new task_queue() );
+  }
+  for( unsigned w = 1; w < threads; w += 1 ){
+    this->threads.push_back( thread( &work_pool::worker_main, this, w ) );
+  }
+}
+
+work_pool::~work_pool(){
+  {
+    unique_lock<mutex> guard( this->lock );
+    this->stopping = true;
+  }
+  this->wake.notify_all();
+
+  for( vector<thread>::size_type i = 0; i < this->threads.size(); i += 1 ){
+    this->threads[i].join();
+  }
+  for( vector<task_queue*>::size_type i = 0; i < this->queues.size(); i += 1 ){
+    delete this->queues[i];
+  }
+}
+
+bool work_pool::take( unsigned worker, size_t& task ){
+  // Own queue first, front to back
+  {
+    task_queue& own = *this->queues[worker];
+    lock_guard<mutex> guard( own.lock );
+    if( ! own.tasks.empty() ){
+      task = own.tasks.front();
+      own.tasks.pop_front();
+      return true;
+    }
+  }
+
+  // Then steal from the back of the others'
+  unsigned workers = this->queues.size();
+  for( unsigned k = 1; k < workers; k += 1 ){
+    task_queue& victim = *this->queues[(worker + k) % workers];
+    lock_guard<mutex> guard( victim.lock );
+    if( ! victim.tasks.empty() ){
+      task = victim.tasks.back();
+      victim.tasks.pop_back();
+      return true;
+    }
+  }
+
+  // No tasks are added during a run, so none are left
+  return false;
+}
+
+void work_pool::work( unsigned worker ){
+  size_t task = 0;
+  while( this->take( worker, task ) ){
+    (*this->body)( task, worker );
+  }
+}
+
+void work_pool::worker_main( unsigned worker ){
+  unsigned long seen = 0;
+
+  while( true ){
+    {
+      unique_lock<mutex> guard( this->lock );
+      while( ! this->stopping && this->generation == seen ){
+        this->wake.wait( guard );
+      }
+      if( this->stopping ){
+        return;
+      }
+      seen = this->generation;
+    }
+
+    this->work( worker );
+
+    {
+      unique_lock<mutex> guard( this->lock );
+      this->working -= 1;
+    }
+    this->finished.notify_one();
+  }
+}
+
+void work_pool::run( size_t tasks, const function<void(size_t, unsigned)>& body ){
+  unsigned workers = this->queues.size();
+
+  // Contiguous shares, so neighbouring tasks tend to run on the same thread
+  for( unsigned w = 0; w < workers; w += 1 ){
+    task_queue& queue = *this->queues[w];
+    lock_guard<mutex> guard( queue.lock );
+    for( size_t i = tasks * w / workers; i < tasks * (w + 1) / workers; i += 1 ){
+      queue.tasks.push_back( i );
+    }
+  }
+
+  {
+    unique_lock<mutex> guard( this->lock );
+    this->body = &body;
+    this->working = workers - 1;
+    this->generation += 1;
+  }
+  this->wake.notify_all();
+
+  this->work( 0 );
+
+  // body must outlive every worker's last call
+  unique_lock<mutex> guard( this->lock );
+  while( this->working > 0 ){
+    this->finished.wait( guard );
+  }
+  this->body = NULL;
+}
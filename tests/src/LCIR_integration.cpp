@@ -11,6 +11,8 @@
 
 #include "SageTransformationWalker.hpp"
 #include "PrintNodeWalker.hpp"
+#include "phase_profiler.hpp"
+#include "test_util.hpp"
 
 #include "FusionTransformation.hpp"
 #include "ShiftTransformation.hpp"
@@ -25,7 +27,14 @@ using namespace LoopChainIR;
 int main( int argc, char** argv ){
   bool verbose = true;
   Schedule* schedule = NULL;
+  isl_ast_node* isl_root = NULL;
+
+  // Break the run down into phases; written out as phases.json at the end
+  phase_profiler::global().start();
+
   {
+    phase_scope loop_chain_phase( "LoopChainIR" );
+
     // Create loop chain
     LoopChain chain;
 
@@ -51,22 +60,31 @@ int main( int argc, char** argv ){
     // Create an ordered list of Transformations
     vector<Transformation*> transformations;
 
-        // Create schedule from loop cahin
-    schedule = new Schedule( chain );
-    // Apply transformations
-    schedule->apply( transformations );
+    {
+      phase_scope phase( "schedule" );
+      // Create schedule from loop cahin
+      schedule = new Schedule( chain );
+      // Apply transformations
+      schedule->apply( transformations );
+    }
 
     // print domains and Transformations
     cout << *schedule << endl;
 
     // print codegen from ISL's perspective
-    cout << "ISL's codegen:\n" << schedule->codegen() << endl;
+    {
+      phase_scope phase( "codegen" );
+      cout << "ISL's codegen:\n" << schedule->codegen() << endl;
+    }
+
+    phase_scope phase( "codegenToIslAst" );
+    isl_root = schedule->codegenToIslAst()->root;
   }
 
   if( verbose ){
     PrintNodeWalker walker;
     cout << "PrintNodeWalker:" << endl;
-    cout << walker.visit( schedule->codegenToIslAst()->root ) << endl;
+    cout << walker.visit( isl_root ) << endl;
   }
 
   {
@@ -75,27 +93,16 @@ int main( int argc, char** argv ){
     // Template file source
     //string template_code( "#include <iostream>\nusing namespace std;\nint main(){\n int A,B,C,D,E,F,G,H,I,J,K,L,M,N,O,P,Q,R,S,T,U,V,W,X,Y,Z,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,q,r,s,t,u,v,w,x,y,z;\nA = (B = (C = (D = (E = (F = (G = (H = (I = (J = (K = (L = (M = (N = (O = (P = (Q = (R = (S = (T = (U = (V = (W = (X = (Y = (Z = (a = (b = (c = (d = (e = (f = (g = (h = (i = (j = (k = (l = (m = (n = (o = (p = (q = (r = (s = (t = (u = (v = (w = (x = (y = (z = 1234)))))))))))))))))))))))))))))))))))))))))))))))))));\n }");
     string template_code( "#include <iostream>\nusing namespace std;\nint main(){ }");
-    std::string template_file_name( "__template_file__.cpp" );
-
-    // Write out template file.
-    ofstream template_file;
-    template_file.open( template_file_name.c_str(), ios::trunc | ios::out );
-    assert( template_file.is_open() );
-    template_file << template_code << endl;
-    template_file.close();
-
-    // Create arguments to frontend to parse template file
-    vector<string> project_argv;
-    // Apparently it is necessary to have the executable name in the arguments.
-    project_argv.push_back( string(argv[0]) );
-    project_argv.push_back( template_file_name );
-
     if( verbose ) cout << "Calling Frontend" << endl;
-    SgProject* project = frontend( project_argv );
+    SgProject* project = NULL;
+    {
+      phase_scope phase( "frontend" );
+      project = template_project( argv[0], template_code );
+    }
 
     // Find the existing main() definition node in the tree.
     if( verbose ) cout << "Finding target function definition" << endl;
-    SgFunctionDefinition* target_defn = findFunctionDeclaration( project, "main", NULL, true)->get_definition();
+    SgFunctionDefinition* target_defn = template_main( project )->get_definition();
 
     if( verbose ) cout << "Synthesizing symbol definitions" << endl;
     LoopChain chain = schedule->getChain();
@@ -119,14 +126,20 @@ int main( int argc, char** argv ){
 
     // Run ISL -> Sage walker over ISL tree, rendering it into Sage,
     if( verbose ) cout << "Calling SageTransformationWalker" << endl;
-    SageTransformationWalker walker(schedule->codegenToIslAst()->root, injection_site, verbose);
+    SageTransformationWalker walker(isl_root, injection_site, verbose);
 
     if( verbose ) cout << "Unparsing" << endl;
-    project->unparse();
+    {
+      phase_scope phase( "unparse" );
+      project->unparse();
+    }
 
     // Write AST to dot file
     if( verbose ) cout << "Writing to dot file" << endl;
-    generateDOT( *project );
+    {
+      phase_scope phase( "generateDOT" );
+      generateDOT( *project );
+    }
 
     // Print generated code
     cout << "Generated Code:" << endl;
@@ -139,4 +152,11 @@ int main( int argc, char** argv ){
       rose_output.close();
     }
   }
+
+  phase_profiler::global().stop();
+  cout << "Phases:" << endl;
+  phase_profiler::global().write_summary( cout );
+  if( ! phase_profiler::global().write_chrome_trace( "phases.json" ) ){
+    cerr << "Could not write phases.json" << endl;
+  }
 }
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "affine_builder.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Builds the forms isl produces, -1 + c, 1 * x, 0 + e, (e) - (-k), nested sums
+and a sum of eight variables, with affine_builder, folding and not, and checks
+that:
+  - the folded forms are the expected ones, and the sum of eight is a
+    balanced tree of depth 3
+  - compiled with $CXX (default g++), every folded form gives the same value
+    as the unfolded one over a grid of variable values
+  - a tiled nest translated with walker_options::fold_affine builds the same
+    code directly and through flat_ir, with no more Sage nodes than without
+*/
+
+class affine_case {
+  public:
+    // Expected folded form, empty to only check values
+    string expected;
+    string folded;
+    string plain;
+};
+
+const int variables = 8;
+
+// Reference to parameter i of function
+SgExpression* var( SgFunctionDeclaration* function, int i ){
+  return buildVarRefExp( function->get_parameterList()->get_args()[i], function->get_definition()->get_body() );
+}
+
+// Case which built with builder, over a..h, the parameters of function
+SgExpression* build_case( int which, affine_builder& b, SgFunctionDeclaration* f ){
+  switch( which ){
+    case 0:  return b.add( buildIntVal( -1 ), var( f, 2 ) );
+    case 1:  return b.mul( buildIntVal( 1 ), var( f, 0 ) );
+    case 2:  return b.add( buildIntVal( 0 ), var( f, 4 ) );
+    case 3:  return b.sub( var( f, 4 ), b.minus( buildIntVal( 3 ) ) );
+    case 4:  return b.add( b.add( var( f, 0 ), buildIntVal( 2 ) ), b.sub( var( f, 1 ), buildIntVal( 2 ) ) );
+    case 5:  return b.sub( var( f, 0 ), var( f, 0 ) );
+    case 6:  return b.mul( buildIntVal( 2 ), b.add( var( f, 0 ), buildIntVal( 3 ) ) );
+    case 7:  return b.add( b.mul( buildIntVal( 2 ), var( f, 0 ) ), b.minus( var( f, 0 ) ) );
+    case 8:  return b.minus( b.sub( var( f, 0 ), var( f, 1 ) ) );
+    case 9:  return b.sub( b.minus( var( f, 0 ) ), b.mul( buildIntVal( 3 ), var( f, 1 ) ) );
+    case 10: return b.add( b.mul( var( f, 0 ), var( f, 1 ) ), b.add( buildIntVal( -32 ), b.mul( buildIntVal( 32 ), var( f, 2 ) ) ) );
+    default: {
+      SgExpression* head = var( f, 0 );
+      for( int i = 1; i < variables; i += 1 ){
+        head = b.add( head, var( f, i ) );
+      }
+      return head;
+    }
+  }
+}
+
+const char* expectations[] = { "c - 1", "a", "e", "e + 3", "a + b", "0", "2 * a + 6", "a", "b - a", "-a - 3 * b", "a * b + 32 * c - 32", "" };
+const int cases = 12;
+
+// Depth of the additions and subtractions at the top of expression
+int depth( SgExpression* expression ){
+  if( ! isSgAddOp( expression ) && ! isSgSubtractOp( expression ) ){
+    return 0;
+  }
+  SgBinaryOp* op = isSgBinaryOp( expression );
+  return 1 + max( depth( op->get_lhs_operand() ), depth( op->get_rhs_operand() ) );
+}
+
+string build( affine_builder& b, SgGlobal* global, const string& name, int which, int& sum_depth ){
+  SgFunctionParameterList* parameters = buildFunctionParameterList();
+  for( int i = 0; i < variables; i += 1 ){
+    appendArg( parameters, buildInitializedName( SgName( string( 1, (char) ('a' + i) ) ), buildIntType() ) );
+  }
+  SgFunctionDeclaration* function = buildDefiningFunctionDeclaration( SgName( name ), buildIntType(), parameters, global );
+
+  SgExpression* result = build_case( which, b, function );
+  appendStatement( buildReturnStmt( result ), function->get_definition()->get_body() );
+
+  sum_depth = depth( result );
+  return result->unparseToString();
+}
+
+string render( isl_ast_node* isl_ast, SgFunctionDefinition* target_defn, bool fold, bool flat_ir, size_t& nodes ){
+  SgBasicBlock* injection_site = buildBasicBlock();
+  target_defn->append_statement( injection_site );
+
+  walker_options options;
+  options.fold_affine = fold;
+  options.flat_ir = flat_ir;
+  SageTransformationWalker walker( isl_ast, injection_site, options );
+
+  nodes = NodeQuery::querySubTree( injection_site, V_SgNode ).size();
+  string code = injection_site->unparseToString();
+  removeStatement( injection_site );
+  deleteAST( injection_site );
+  return code;
+}
+
+int main( int argc, char** argv ){
+  SgProject* project = template_project( argv[0], "int main(){ }" );
+  SgFunctionDeclaration* target_decl = template_main( project );
+  SgFunctionDefinition* target_defn = target_decl->get_definition();
+  SgGlobal* global = getGlobalScope( target_decl );
+
+  affine_builder folding( true );
+  affine_builder plain( false );
+
+  int failures = 0;
+  vector<affine_case> built;
+  for( int i = 0; i < cases; i += 1 ){
+    int sum_depth = 0;
+    int unused = 0;
+    affine_case c;
+    c.expected = expectations[i];
+    c.folded = build( folding, global, "folded_" + to_string( i ), i, sum_depth );
+    c.plain = build( plain, global, "plain_" + to_string( i ), i, unused );
+
+    bool expected = c.expected.empty() ? sum_depth == 3 : c.folded == c.expected;
+    if( ! expected ){
+      failures += 1;
+      cout << "case " << i << ": " << c.plain << " folded to " << c.folded << " (depth " << sum_depth << ")" << endl;
+    }
+    built.push_back( c );
+  }
+
+  // Check the values in a program of their own
+  string check_name( "__affine_check__.cpp" );
+  ofstream check( check_name.c_str(), ios::trunc | ios::out );
+  assert( check.is_open() );
+  check << "#include <cstdio>" << endl;
+  for( vector<affine_case>::size_type i = 0; i < built.size(); i += 1 ){
+    string parameters = "int a, int b, int c, int d, int e, int f, int g, int h";
+    check << "static int folded_" << i << "( " << parameters << " ){ return " << built[i].folded << "; }" << endl
+          << "static int plain_" << i << "( " << parameters << " ){ return " << built[i].plain << "; }" << endl;
+  }
+  check << "int main(){" << endl << "  int wrong = 0;" << endl
+        << "  for( int a = -20; a <= 20; a += 3 ) for( int b = -20; b <= 20; b += 7 ) for( int c = -20; c <= 20; c += 5 ){" << endl
+        << "    int d = a - b, e = b + c, f = 3 * a, g = -c, h = a * b;" << endl;
+  for( vector<affine_case>::size_type i = 0; i < built.size(); i += 1 ){
+    check << "    if( folded_" << i << "( a, b, c, d, e, f, g, h ) != plain_" << i << "( a, b, c, d, e, f, g, h ) ){ std::printf( \"case " << i << " wrong\\n\" ); wrong += 1; }" << endl;
+  }
+  check << "  }" << endl << "  return wrong;" << endl << "}" << endl;
+  check.close();
+
+  const char* cxx = getenv( "CXX" );
+  string compile = string( cxx != NULL ? cxx : "g++" ) + " -O2 -o __affine_check__ " + check_name;
+  bool compiled = system( compile.c_str() ) == 0;
+  bool values = compiled && system( "./__affine_check__" ) == 0;
+  failures += values ? 0 : 1;
+
+  // A translation, both ways
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), "[N]->{ S[i,j] : 0 <= i < N and 0 <= j < N }",
+                                                 "{ S[i,j] -> [floor(i/32), floor(j/32), i - 1, j + 1] }" ) );
+  size_t folded_nodes = 0, flat_nodes = 0, plain_nodes = 0;
+  string folded = render( isl_ast.get(), target_defn, true, false, folded_nodes );
+  string flattened = render( isl_ast.get(), target_defn, true, true, flat_nodes );
+  string unfolded = render( isl_ast.get(), target_defn, false, false, plain_nodes );
+  bool same = folded == flattened;
+  bool smaller = folded_nodes <= plain_nodes;
+  failures += (same ? 0 : 1) + (smaller ? 0 : 1);
+
+  cout << built.size() << " expressions, values " << (compiled ? (values ? "identical" : "MISMATCH") : "NOT COMPILED")
+       << "; tiled nest: flat_ir " << (same ? "identical" : "MISMATCH")
+       << ", " << folded_nodes << " nodes folded, " << plain_nodes << " unfolded" << endl;
+  if( ! smaller ){
+    cout << folded << endl << unfolded << endl;
+  }
+
+  return failures;
+}
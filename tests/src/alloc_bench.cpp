@@ -0,0 +1,231 @@
+#include <cassert>
+#include <cstdlib>
+#include <list>
+#include <new>
+#include <utility>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "ISLWalker.hpp"
+#include "SageTransformationWalker.hpp"
+#include "PrintNodeWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Reports how many C++ heap allocations each ISL AST node costs when walked by
+PrintNodeWalker and SageTransformationWalker, now and before the per-node
+allocations listed at RemovedAllocationWalker were cut.
+Counts every operator new made during the walk, so includes allocations made
+by SageBuilder on the walker's behalf. isl allocates through malloc, and its
+accessors only bump reference counts, so it is not counted.
+*/
+
+static unsigned long allocation_count = 0;
+
+void* operator new( size_t size ){
+  allocation_count += 1;
+  void* ptr = malloc( size == 0 ? 1 : size );
+  if( ptr == NULL ){
+    throw bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete( void* ptr ) noexcept {
+  free( ptr );
+}
+
+void operator delete( void* ptr, size_t ) noexcept {
+  free( ptr );
+}
+
+// Counts the nodes and expressions of an ISL AST
+class NodeCountWalker : public ISLWalker<NodeCountWalker, int> {
+  public:
+    int visit_expr_op( isl_ast_expr* node ){
+      int count = 1;
+      for( int i = 0; i < isl_ast_expr_get_op_n_arg(node); i += 1 ){
+        count += this->visit_op_operand( node, i );
+      }
+      return count;
+    }
+
+    int visit_expr_id( isl_ast_expr* node ){ return 1; }
+    int visit_expr_int( isl_ast_expr* node ){ return 1; }
+
+    int visit_node_for( isl_ast_node* node ){
+      return 1 + this->visit( isl_ast_expr_handle( isl_ast_node_for_get_init( node ) ).get() )
+               + this->visit( isl_ast_expr_handle( isl_ast_node_for_get_cond( node ) ).get() )
+               + this->visit( isl_ast_expr_handle( isl_ast_node_for_get_inc( node ) ).get() )
+               + this->visit( isl_ast_node_handle( isl_ast_node_for_get_body( node ) ).get() );
+    }
+
+    int visit_node_if( isl_ast_node* node ){
+      int count = 1 + this->visit( isl_ast_expr_handle( isl_ast_node_if_get_cond( node ) ).get() )
+                    + this->visit( isl_ast_node_handle( isl_ast_node_if_get_then( node ) ).get() );
+      if( isl_ast_node_if_has_else( node ) ){
+        count += this->visit( isl_ast_node_handle( isl_ast_node_if_get_else( node ) ).get() );
+      }
+      return count;
+    }
+
+    int visit_node_block( isl_ast_node* node ){
+      int count = 1;
+      isl_ast_node_list_handle list( isl_ast_node_block_get_children( node ) );
+      for( int i = 0; i < isl_ast_node_list_n_ast_node( list.get() ); i += 1 ){
+        count += this->visit( isl_ast_node_handle( isl_ast_node_list_get_ast_node( list.get(), i ) ).get() );
+      }
+      return count;
+    }
+
+    int visit_node_user( isl_ast_node* node ){
+      return 1 + this->visit( isl_ast_expr_handle( isl_ast_node_user_get_expr( node ) ).get() );
+    }
+};
+
+/*
+Makes, on each node of an ISL AST, the allocations a walker used to make
+there and no longer does, with the calls it made them with, and counts them,
+so the count now plus the count here is the count before:
+  - PrintNodeWalker collected each operation's operands in a std::list, one
+    allocation per operand, where a reserved std::vector takes one
+  - SageTransformationWalker allocated a function_call_info per statement
+    call on the heap and grew its argument vector without reserving, kept
+    each loop iterator's SgName on the heap and built an orphan
+    SgInitializedName for the increment to reference, and passed the
+    arguments of max, min and floord calls through a temporary vector
+*/
+class RemovedAllocationWalker : public ISLWalker<RemovedAllocationWalker, int> {
+  protected:
+    bool sage;
+
+  public:
+    unsigned long removed;
+
+    explicit RemovedAllocationWalker( bool sage ): ISLWalker(), sage( sage ), removed( 0 ) {}
+
+    bool enter( isl_ast_node* node ){
+      if( ! this->sage || isl_ast_node_get_type( node ) != isl_ast_node_for ){
+        return true;
+      }
+
+      isl_ast_expr_handle iterator( isl_ast_node_for_get_iterator( node ) );
+      isl_id_handle iterator_id( isl_ast_expr_get_id( iterator.get() ) );
+      unsigned long before = allocation_count;
+      SgName* name = new SgName( isl_id_get_name( iterator_id.get() ) );
+      // The orphan is leaked, as it was
+      buildInitializedName( *name, buildIntType() );
+      delete name;
+      this->removed += allocation_count - before;
+      return true;
+    }
+
+    bool enter( isl_ast_expr* node ){
+      if( isl_ast_expr_get_type( node ) != isl_ast_expr_op ){
+        return true;
+      }
+      int n_arg = isl_ast_expr_get_op_n_arg( node );
+      isl_ast_op_type type = isl_ast_expr_get_op_type( node );
+
+      unsigned long before = allocation_count;
+      if( ! this->sage ){
+        list<string> operands( n_arg );
+      }
+      else if( type == isl_ast_op_call ){
+        vector<SgExpression*> arguments;
+        for( int i = 1; i < n_arg; i += 1 ){
+          arguments.push_back( NULL );
+        }
+        delete new function_call_info( NULL, SgName( "S" ), arguments );
+      }
+      else if( type == isl_ast_op_max || type == isl_ast_op_min || type == isl_ast_op_fdiv_q ){
+        vector<SgExpression*> parameter_expressions;
+        for( int i = 1; i < n_arg; i += 1 ){
+          parameter_expressions.clear();
+          parameter_expressions.push_back( NULL );
+          parameter_expressions.push_back( NULL );
+        }
+      }
+      unsigned long made = allocation_count - before;
+
+      // Less those of what replaced them
+      before = allocation_count;
+      if( ! this->sage ){
+        vector<string> operands;
+        operands.reserve( n_arg );
+      }
+      else if( type == isl_ast_op_call ){
+        vector<SgExpression*> arguments;
+        arguments.reserve( n_arg - 1 );
+      }
+      this->removed += made - (allocation_count - before);
+      return true;
+    }
+};
+
+int main( int argc, char** argv ){
+  vector<string> names = { "fused", "tiled", "tiled x2", "guarded" };
+  vector< pair<string,string> > tests;
+  tests.push_back( make_pair( string("[N,M]->{ S1[i,j] : 0 <= i < N and 0 <= j < M; S2[i,j] : 0 <= i < N and 0 <= j < M }"),
+                              string("{ S1[i,j] -> [0,i,j,0]; S2[i,j] -> [1,i,j,0] }") ) );
+  tests.push_back( make_pair( string("[N,M]->{ S[i,j] : 0 <= i < N and 0 <= j < M }"),
+                              string("{ S[i,j] -> [floor(i/32), floor(j/32), i, j] }") ) );
+  tests.push_back( make_pair( string("[N,M]->{ S[i,j] : 0 <= i < N and 0 <= j < M }"),
+                              string("{ S[i,j] -> [floor(i/32), floor(j/32), floor(i/4), floor(j/4), i, j] }") ) );
+  tests.push_back( make_pair( string("[N]->{ S[i] : 0 <= i < N; T[i] : 0 <= i < N and i mod 3 = 0 }"),
+                              string("{ S[i] -> [i,0]; T[i] -> [i,1] }") ) );
+
+  SgProject* project = template_project( argv[0], "#include <iostream>\nusing namespace std;\nint main(){ }" );
+  SgFunctionDefinition* target_defn = template_main( project )->get_definition();
+
+  // Symbolic constants used by the bounds
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+  target_defn->append_statement( buildVariableDeclaration( SgName( "M" ), buildIntType(), NULL, target_defn ) );
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+
+  cout << "case\tnodes\tprint allocs/node before\tafter\tsage allocs/node before\tafter" << endl;
+  for( vector<string>::size_type i = 0; i < tests.size(); i += 1 ){
+    isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), tests[i].first, tests[i].second ) );
+
+    NodeCountWalker counter;
+    int nodes = counter.visit( isl_ast.get() );
+
+    unsigned long before = allocation_count;
+    {
+      PrintNodeWalker walker;
+      walker.visit( isl_ast.get() );
+    }
+    unsigned long print_allocs = allocation_count - before;
+
+    SgBasicBlock* injection_site = buildBasicBlock();
+    target_defn->append_statement( injection_site );
+
+    before = allocation_count;
+    {
+      SageTransformationWalker walker( isl_ast.get(), injection_site );
+    }
+    unsigned long sage_allocs = allocation_count - before;
+
+    RemovedAllocationWalker print_removed( false );
+    print_removed.traverse( isl_ast.get() );
+    RemovedAllocationWalker sage_removed( true );
+    sage_removed.traverse( isl_ast.get() );
+
+    cout << names[i] << "\t" << nodes << "\t"
+         << double( print_allocs + print_removed.removed ) / nodes << "\t"
+         << double( print_allocs ) / nodes << "\t"
+         << double( sage_allocs + sage_removed.removed ) / nodes << "\t"
+         << double( sage_allocs ) / nodes << endl;
+  }
+
+  return 0;
+}
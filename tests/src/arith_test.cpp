@@ -0,0 +1,130 @@
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "arith_builder.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Builds fdiv_q, pdiv_q, pdiv_r and zdiv_r of a variable by the literals
+1, 2, 4, 32, 3, 7 and 12 with arith_builder, with and without strength
+reduction, and checks that:
+  - divisions by powers of two are reduced to shifts and masks, and floord by
+    the others to arithmetic with no call
+  - compiled with $CXX (default g++), every reduced form gives the same value
+    as the unreduced one for every e in [-1000, 1000] (pdiv: [0, 1000]; zdiv_r:
+    the same comparison to 0)
+*/
+
+class division {
+  public:
+    string op;
+    long divisor;
+    bool reduced_form;
+    string reduced;
+    string plain;
+};
+
+// Expression of op( e, divisor ) built by arith, where e is the parameter of
+// a function called name in global
+string build( arith_builder& arith, SgGlobal* global, const string& name, const string& op, long divisor, bool& reduced_form ){
+  SgFunctionParameterList* parameters = buildFunctionParameterList( buildInitializedName( SgName( "e" ), buildIntType() ) );
+  SgFunctionDeclaration* function = buildDefiningFunctionDeclaration( SgName( name ), buildIntType(), parameters, global );
+  SgBasicBlock* body = function->get_definition()->get_body();
+
+  SgExpression* e = buildVarRefExp( parameters->get_args()[0], body );
+  SgExpression* d = buildIntVal( divisor );
+  SgExpression* result = NULL;
+  if( op == "fdiv_q" ){
+    result = arith.floord( e, d, buildIntType() );
+  } else if( op == "pdiv_q" ){
+    result = arith.pdiv_q( e, d );
+  } else if( op == "pdiv_r" ){
+    result = arith.pdiv_r( e, d );
+  } else {
+    result = arith.zdiv_r( e, d );
+  }
+  appendStatement( buildReturnStmt( result ), body );
+
+  reduced_form = NodeQuery::querySubTree( result, V_SgFunctionCallExp ).empty()
+              && NodeQuery::querySubTree( result, V_SgModOp ).empty()
+              && ( (divisor & (divisor - 1)) != 0 || NodeQuery::querySubTree( result, V_SgDivideOp ).empty() );
+
+  return result->unparseToString();
+}
+
+int main( int argc, char** argv ){
+  SgProject* project = template_project( argv[0], "int main(){ }" );
+  SgGlobal* global = getGlobalScope( template_main( project ) );
+
+  arith_builder reducing( intrinsic_expressions, true );
+  arith_builder plain( intrinsic_expressions, false );
+  reducing.set_global( global );
+  plain.set_global( global );
+
+  vector<string> ops = { "fdiv_q", "pdiv_q", "pdiv_r", "zdiv_r" };
+  long divisors[] = { 1, 2, 4, 32, 3, 7, 12 };
+
+  int failures = 0;
+  vector<division> divisions;
+  for( vector<string>::size_type o = 0; o < ops.size(); o += 1 ){
+    for( int d = 0; d < 7; d += 1 ){
+      bool unused = false;
+      division div;
+      div.op = ops[o];
+      div.divisor = divisors[d];
+      string name = ops[o] + "_" + to_string( divisors[d] );
+      div.reduced = build( reducing, global, "reduced_" + name, ops[o], divisors[d], div.reduced_form );
+      div.plain = build( plain, global, "plain_" + name, ops[o], divisors[d], unused );
+
+      // Only floord has a reduction for divisors that are not powers of two
+      bool power = (divisors[d] & (divisors[d] - 1)) == 0;
+      bool expected = power || ops[o] == "fdiv_q";
+      if( expected && ! div.reduced_form ){
+        failures += 1;
+        cout << ops[o] << " by " << divisors[d] << " not reduced: " << div.reduced << endl;
+      }
+      divisions.push_back( div );
+    }
+  }
+
+  // Check the values in a program of their own
+  string check_name( "__arith_check__.cpp" );
+  ofstream check( check_name.c_str(), ios::trunc | ios::out );
+  assert( check.is_open() );
+  check << "#include <cstdio>" << endl;
+  for( vector<division>::size_type i = 0; i < divisions.size(); i += 1 ){
+    check << "static int reduced_" << i << "( int e ){ return " << divisions[i].reduced << "; }" << endl
+          << "static int plain_" << i << "( int e ){ return " << divisions[i].plain << "; }" << endl;
+  }
+  check << "int main(){" << endl << "  int wrong = 0;" << endl;
+  for( vector<division>::size_type i = 0; i < divisions.size(); i += 1 ){
+    const division& div = divisions[i];
+    string low = (div.op == "pdiv_q" || div.op == "pdiv_r") ? "0" : "-1000";
+    string compare = (div.op == "zdiv_r") ? "(reduced_" + to_string( i ) + "( e ) == 0) != (plain_" + to_string( i ) + "( e ) == 0)"
+                                           : "reduced_" + to_string( i ) + "( e ) != plain_" + to_string( i ) + "( e )";
+    check << "  for( int e = " << low << "; e <= 1000; e += 1 ){" << endl
+          << "    if( " << compare << " ){ std::printf( \"" << div.op << " by " << div.divisor << " wrong at %d\\n\", e ); wrong += 1; break; }" << endl
+          << "  }" << endl;
+  }
+  check << "  return wrong;" << endl << "}" << endl;
+  check.close();
+
+  const char* cxx = getenv( "CXX" );
+  string compile = string( cxx != NULL ? cxx : "g++" ) + " -O2 -o __arith_check__ " + check_name;
+  bool compiled = system( compile.c_str() ) == 0;
+  bool values = compiled && system( "./__arith_check__" ) == 0;
+
+  failures += values ? 0 : 1;
+  cout << divisions.size() << " divisions, values " << (compiled ? (values ? "identical" : "MISMATCH") : "NOT COMPILED") << endl;
+
+  return failures;
+}
@@ -0,0 +1,196 @@
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <utility>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "flat_ast.hpp"
+#include "work_pool.hpp"
+#include "synthetic_ast.hpp"
+#include "SageMaterializer.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Lowers ISL ASTs into a flat_ast and checks that:
+  - nodes are numbered in pre-order: children follow their parent, in order,
+    and their subtrees partition the parent's [n, end(n)) range
+  - every identifier name is interned once
+  - lowering two ASTs into one flat_ast keeps the first intact
+  - lowering on 4 threads gives the same nodes as lowering serially
+  - SageMaterializer builds the same code and statement macros as
+    SageTransformationWalker, directly and through walker_options::flat_ir,
+    on one thread and on 4
+*/
+
+// Checks the numbering below n, returns the number of nodes that break it
+int check_numbering( const flat_ast& ast, uint32_t n ){
+  int broken = 0;
+  uint32_t next = n + 1;
+  for( uint32_t i = 0; i < ast.children( n ); i += 1 ){
+    uint32_t child = ast.child( n, i );
+    broken += (child == next) ? 0 : 1;
+    broken += check_numbering( ast, child );
+    next = ast.end( child );
+  }
+  broken += (next == ast.end( n )) ? 0 : 1;
+  return broken;
+}
+
+int check_identifiers( const flat_ast& ast ){
+  set<string> names;
+  for( uint32_t i = 0; i < ast.identifiers(); i += 1 ){
+    names.insert( ast.name( i ) );
+  }
+  return (names.size() == ast.identifiers()) ? 0 : 1;
+}
+
+bool same_nodes( const flat_ast& a, const flat_ast& b ){
+  if( a.size() != b.size() ){
+    return false;
+  }
+  for( uint32_t n = 0; n < a.size(); n += 1 ){
+    bool same = a.kind( n ) == b.kind( n ) && a.children( n ) == b.children( n ) && a.end( n ) == b.end( n )
+             && (a.kind( n ) != flat_op || a.op( n ) == b.op( n ))
+             && (a.kind( n ) != flat_int || a.value( n ) == b.value( n ))
+             && (a.kind( n ) != flat_id || string( a.name( a.identifier( n ) ) ) == b.name( b.identifier( n ) ));
+    for( uint32_t i = 0; same && i < a.children( n ); i += 1 ){
+      same = a.child( n, i ) == b.child( n, i );
+    }
+    if( ! same ){
+      return false;
+    }
+  }
+  return true;
+}
+
+string render( isl_ast_node* isl_ast, SgFunctionDefinition* target_defn, bool flat_ir, unsigned threads, vector<function_call_info>& macros ){
+  SgBasicBlock* injection_site = buildBasicBlock();
+  target_defn->append_statement( injection_site );
+
+  walker_options options;
+  options.flat_ir = flat_ir;
+  options.lowering_threads = threads;
+  SageTransformationWalker walker( isl_ast, injection_site, options );
+  macros = *walker.getStatementMacroNodes();
+
+  string code = injection_site->unparseToString();
+  removeStatement( injection_site );
+  deleteAST( injection_site );
+  return code;
+}
+
+int main( int argc, char** argv ){
+  vector<string> names = { "fused", "tiled", "guarded", "min/max bounds", "strided", "deep" };
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  vector<isl_ast_node_handle> asts;
+  asts.push_back( isl_ast_node_handle( ast_from_strings( ctx.get(),
+                  "[N,M]->{ S1[i,j] : 0 <= i < N and 0 <= j < M; S2[i,j] : 0 <= i < N and 0 <= j < M }",
+                  "{ S1[i,j] -> [0,i,j,0]; S2[i,j] -> [1,i,j,0] }" ) ) );
+  asts.push_back( isl_ast_node_handle( ast_from_strings( ctx.get(),
+                  "[N,M]->{ S[i,j] : 0 <= i < N and 0 <= j < M }",
+                  "{ S[i,j] -> [floor(i/32), floor(j/32), floor(i/4), floor(j/4), i, j] }" ) ) );
+  asts.push_back( isl_ast_node_handle( ast_from_strings( ctx.get(),
+                  "[N]->{ S[i] : 0 <= i < N; T[i] : 0 <= i < N and i mod 3 = 0 }",
+                  "{ S[i] -> [i,0]; T[i] -> [i,1] }" ) ) );
+
+  synthetic_options bounds;
+  bounds.fan_in = 3;
+  bounds.statements = 2;
+  asts.push_back( isl_ast_node_handle( synthetic_ast( ctx.get(), bounds ) ) );
+
+  synthetic_options strided;
+  strided.parametric = false;
+  strided.statements = 2;
+  strided.modulo = 4;
+  strided.fused = true;
+  asts.push_back( isl_ast_node_handle( synthetic_ast( ctx.get(), strided ) ) );
+
+  synthetic_options deep;
+  deep.nest_depth = 12;
+  deep.parametric = false;
+  asts.push_back( isl_ast_node_handle( synthetic_ast( ctx.get(), deep ) ) );
+
+  SgProject* project = template_project( argv[0], "#include <iostream>\nusing namespace std;\nint main(){ }" );
+  SgFunctionDefinition* target_defn = template_main( project )->get_definition();
+
+  // Symbolic constants used by the bounds
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+  target_defn->append_statement( buildVariableDeclaration( SgName( "M" ), buildIntType(), NULL, target_defn ) );
+  vector<string> parameters = synthetic_parameters( bounds );
+  for( vector<string>::size_type i = 0; i < parameters.size(); i += 1 ){
+    target_defn->append_statement( buildVariableDeclaration( SgName( parameters[i] ), buildIntType(), NULL, target_defn ) );
+  }
+
+  int failures = 0;
+  work_pool pool( 4 );
+
+  for( vector<isl_ast_node_handle>::size_type i = 0; i < asts.size(); i += 1 ){
+    flat_ast ir;
+    uint32_t root = ir.lower( asts[i].get() );
+
+    int numbering = (root == 0 && ir.end( root ) == ir.size()) ? check_numbering( ir, root ) : 1;
+    int identifiers = check_identifiers( ir );
+
+    // A second copy after the first shares its identifiers
+    uint32_t identifiers_once = ir.identifiers();
+    uint32_t second = ir.lower( asts[i].get() );
+    int appended = (second == ir.end( root ) && ir.end( second ) == ir.size() && ir.identifiers() == identifiers_once
+                    && check_numbering( ir, root ) == 0 && check_numbering( ir, second ) == 0) ? 0 : 1;
+
+    flat_ast serial;
+    serial.lower( asts[i].get() );
+    flat_ast parallel;
+    parallel.lower_parallel( asts[i].get(), pool );
+    bool threaded = same_nodes( serial, parallel );
+
+    // Materialize the second copy directly
+    SgBasicBlock* injection_site = buildBasicBlock();
+    target_defn->append_statement( injection_site );
+    SageMaterializer materializer;
+    materializer.materialize( ir, second, injection_site );
+    string materialized = injection_site->unparseToString();
+    vector<function_call_info>::size_type materialized_macros = materializer.getStatementMacroNodes()->size();
+    removeStatement( injection_site );
+    deleteAST( injection_site );
+
+    vector<function_call_info> walker_macros;
+    vector<function_call_info> flat_macros;
+    vector<function_call_info> threaded_macros;
+    string walked = render( asts[i].get(), target_defn, false, 1, walker_macros );
+    string flattened = render( asts[i].get(), target_defn, true, 1, flat_macros );
+    string threaded_code = render( asts[i].get(), target_defn, true, 4, threaded_macros );
+
+    bool same = walked == materialized && walked == flattened && walked == threaded_code;
+    bool macros = walker_macros.size() == materialized_macros && walker_macros.size() == flat_macros.size()
+               && walker_macros.size() == threaded_macros.size();
+    for( vector<function_call_info>::size_type m = 0; macros && m < walker_macros.size(); m += 1 ){
+      macros = walker_macros[m].name == flat_macros[m].name
+            && walker_macros[m].parameter_expressions.size() == flat_macros[m].parameter_expressions.size();
+    }
+
+    failures += numbering + identifiers + appended + (threaded ? 0 : 1) + (same ? 0 : 1) + (macros ? 0 : 1);
+
+    cout << names[i] << ": " << ir.end( root ) << " nodes, " << identifiers_once << " identifiers, "
+         << ir.bytes() << " bytes for both copies" << endl
+         << "  numbering " << (numbering == 0 ? "ok" : "BROKEN")
+         << ", identifiers " << (identifiers == 0 ? "ok" : "DUPLICATED")
+         << ", append " << (appended == 0 ? "ok" : "BROKEN")
+         << ", threads " << (threaded ? "identical" : "MISMATCH")
+         << ", code " << (same ? "identical" : "MISMATCH")
+         << ", macros " << (macros ? "identical" : "MISMATCH") << endl;
+  }
+
+  return failures;
+}
@@ -0,0 +1,155 @@
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "invariant_hoister.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Translates a tiled nest and two sibling loops with the same bound, with
+walker_options::hoist_invariants, in isl's loop form and the canonical one,
+directly and through flat_ir, and checks that:
+  - both paths build the same code
+  - every loop's condition compares against a variable or a literal
+  - no two locals hoisted into the same block hold equal expressions, and the
+    sibling loops share one local
+  - compiled with $CXX (default g++), each hoisted translation computes the
+    same array as the translation without hoisting
+The statements S and T are macros updating A from B.
+*/
+
+class hoist_case {
+  public:
+    string name;
+    string domain;
+    string schedule;
+    // Definitions of the statement macros
+    string statements;
+    // Locals expected to be hoisted, -1 for any number
+    int locals;
+};
+
+// Returns the number of loops under root whose bound is not a variable or a
+// literal
+int check_bounds( SgNode* root ){
+  int broken = 0;
+  Rose_STL_Container<SgNode*> loops = NodeQuery::querySubTree( root, V_SgForStatement );
+  for( Rose_STL_Container<SgNode*>::iterator it = loops.begin(); it != loops.end(); ++it ){
+    SgExprStatement* test = isSgExprStatement( isSgForStatement( *it )->get_test() );
+    SgBinaryOp* compare = isSgBinaryOp( test == NULL ? NULL : test->get_expression() );
+    bool hoisted = compare != NULL && ( isSgVarRefExp( compare->get_rhs_operand() ) || isSgValueExp( compare->get_rhs_operand() ) );
+    broken += hoisted ? 0 : 1;
+  }
+  return broken;
+}
+
+// Counts the hoisted locals under root in hoisted, returns the number of
+// pairs in one block holding equal expressions
+int check_sharing( SgNode* root, int& hoisted ){
+  int duplicates = 0;
+  Rose_STL_Container<SgNode*> blocks = NodeQuery::querySubTree( root, V_SgBasicBlock );
+  for( Rose_STL_Container<SgNode*>::iterator it = blocks.begin(); it != blocks.end(); ++it ){
+    vector<SgExpression*> values;
+    SgStatementPtrList& statements = isSgBasicBlock( *it )->get_statements();
+    for( SgStatementPtrList::iterator st = statements.begin(); st != statements.end(); ++st ){
+      SgVariableDeclaration* declaration = isSgVariableDeclaration( *st );
+      if( declaration == NULL || getFirstInitializedName( declaration )->get_name().getString().find( "_h" ) == string::npos ){
+        continue;
+      }
+      SgAssignInitializer* initializer = isSgAssignInitializer( getFirstInitializedName( declaration )->get_initializer() );
+      assert( initializer != NULL );
+      for( vector<SgExpression*>::size_type i = 0; i < values.size(); i += 1 ){
+        duplicates += sage_equal( values[i], initializer->get_operand() ) ? 1 : 0;
+      }
+      values.push_back( initializer->get_operand() );
+      hoisted += 1;
+    }
+  }
+  return duplicates;
+}
+
+string render( isl_ast_node* isl_ast, SgFunctionDefinition* target_defn, bool hoist, bool canonical, bool flat_ir, int& broken, int& duplicates, int& hoisted ){
+  SgBasicBlock* injection_site = buildBasicBlock();
+  target_defn->append_statement( injection_site );
+
+  walker_options options;
+  options.hoist_invariants = hoist;
+  options.canonical_loops = canonical;
+  options.flat_ir = flat_ir;
+  options.intrinsics = intrinsic_inline;
+  SageTransformationWalker walker( isl_ast, injection_site, options );
+
+  broken = check_bounds( injection_site );
+  hoisted = 0;
+  duplicates = check_sharing( injection_site, hoisted );
+  string code = injection_site->unparseToString();
+  removeStatement( injection_site );
+  deleteAST( injection_site );
+  return code;
+}
+
+int main( int argc, char** argv ){
+  SgProject* project = template_project( argv[0], "int main(){ }" );
+  SgFunctionDeclaration* target_decl = template_main( project );
+  SgFunctionDefinition* target_defn = target_decl->get_definition();
+  SgGlobal* global = getGlobalScope( target_decl );
+
+  // Symbolic constant used by the bounds
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+
+  vector<hoist_case> cases;
+  cases.push_back( hoist_case{ "tiled", "[N]->{ S[i,j] : 0 <= i < N and 0 <= j < N }",
+                               "{ S[i,j] -> [floor(i/32), floor(j/32), i, j] }",
+                               "#define S(i,j) A[(i) * 100 + (j)] = A[(i) * 100 + (j)] + B[(j) * 100 + (i)]\n", -1 } );
+  cases.push_back( hoist_case{ "siblings", "[N]->{ S[i] : 0 <= i < N; T[i] : 0 <= i < N }",
+                               "{ S[i] -> [0, i]; T[i] -> [1, i] }",
+                               "#define S(i) A[(i)] = 2.0f * B[(i)]\n#define T(i) A[(i)] = A[(i)] + B[(i)]\n", 1 } );
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  int failures = 0;
+
+  for( vector<hoist_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    const hoist_case& test = cases[i];
+    isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), test.domain, test.schedule ) );
+
+    for( int canonical = 0; canonical < 2; canonical += 1 ){
+      int broken = 0, duplicates = 0, hoisted = 0;
+      int flat_broken = 0, flat_duplicates = 0, flat_hoisted = 0;
+      int unused = 0;
+      string code = render( isl_ast.get(), target_defn, true, canonical, false, broken, duplicates, hoisted );
+      string flattened = render( isl_ast.get(), target_defn, true, canonical, true, flat_broken, flat_duplicates, flat_hoisted );
+      string plain = render( isl_ast.get(), target_defn, false, canonical, false, unused, unused, unused );
+
+      bool same = code == flattened && broken == flat_broken && duplicates == flat_duplicates && hoisted == flat_hoisted;
+      bool counted = test.locals < 0 || hoisted == test.locals;
+
+      // Same results as without hoisting
+      string base = "__hoist_" + test.name + (canonical ? "_canonical" : "");
+      kernel_comparison comparison( base, definitions( global ) + test.statements );
+      comparison.parameters = "int N, float* __restrict__ A, const float* __restrict__ B";
+      bool values = comparison.same_results( code, plain );
+
+      failures += (same ? 0 : 1) + broken + duplicates + (counted ? 0 : 1) + (values ? 0 : 1);
+      cout << test.name << (canonical ? " (canonical)" : "") << ": flat_ir " << (same ? "identical" : "MISMATCH")
+           << ", bounds " << (broken == 0 ? "hoisted" : "NOT HOISTED")
+           << ", " << hoisted << " locals, " << duplicates << " duplicated" << (counted ? "" : " (UNEXPECTED)")
+           << ", values " << (values ? "identical" : "MISMATCH") << endl;
+      if( broken != 0 || duplicates != 0 || ! counted ){
+        cout << code << endl;
+      }
+    }
+  }
+
+  return failures;
+}
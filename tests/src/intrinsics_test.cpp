@@ -0,0 +1,111 @@
+#include <cassert>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "arith_builder.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Translates a tiled nest, whose bounds use max, min and floord, with every
+walker_options::intrinsics style, directly and through flat_ir, and checks
+that:
+  - both paths build the same code
+  - intrinsic_calls keeps the calls to max, min and floord
+  - intrinsic_inline calls isl_sage_*_int, and the global scope holds exactly
+    one static inline definition of each after several translations
+  - intrinsic_expressions builds no calls at all
+*/
+
+string render( isl_ast_node* isl_ast, SgFunctionDefinition* target_defn, intrinsic_style style, bool flat_ir, int& calls ){
+  SgBasicBlock* injection_site = buildBasicBlock();
+  target_defn->append_statement( injection_site );
+
+  walker_options options;
+  options.intrinsics = style;
+  options.flat_ir = flat_ir;
+  SageTransformationWalker walker( isl_ast, injection_site, options );
+
+  calls = NodeQuery::querySubTree( injection_site, V_SgFunctionCallExp ).size();
+  string code = injection_site->unparseToString();
+  removeStatement( injection_site );
+  deleteAST( injection_site );
+  return code;
+}
+
+// Defining declarations named name in global
+int definitions( SgGlobal* global, const string& name ){
+  int found = 0;
+  SgDeclarationStatementPtrList& declarations = global->get_declarations();
+  for( SgDeclarationStatementPtrList::iterator it = declarations.begin(); it != declarations.end(); ++it ){
+    SgFunctionDeclaration* function = isSgFunctionDeclaration( *it );
+    if( function != NULL && function->get_definition() != NULL && function->get_name().getString() == name
+        && function->get_declarationModifier().get_storageModifier().isStatic() && function->get_functionModifier().isInline() ){
+      found += 1;
+    }
+  }
+  return found;
+}
+
+int main( int argc, char** argv ){
+  SgProject* project = template_project( argv[0], "#include <iostream>\nusing namespace std;\nint main(){ }" );
+  SgFunctionDeclaration* target_decl = template_main( project );
+  SgFunctionDefinition* target_defn = target_decl->get_definition();
+  SgGlobal* global = getGlobalScope( target_decl );
+
+  // Symbolic constants used by the bounds
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+  target_defn->append_statement( buildVariableDeclaration( SgName( "M" ), buildIntType(), NULL, target_defn ) );
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), "[N,M]->{ S[i,j] : 0 <= i < N and 0 <= j < M and j <= i + 40 }",
+                                                 "{ S[i,j] -> [floor(i/32), floor(j/32), i, j] }" ) );
+
+  int failures = 0;
+  vector<string> names = { "calls", "inline", "expressions" };
+  intrinsic_style styles[] = { intrinsic_calls, intrinsic_inline, intrinsic_expressions };
+
+  for( int s = 0; s < 3; s += 1 ){
+    int walked_calls = 0;
+    int flat_calls = 0;
+    string walked = render( isl_ast.get(), target_defn, styles[s], false, walked_calls );
+    string flattened = render( isl_ast.get(), target_defn, styles[s], true, flat_calls );
+    // Once more, to check nothing is defined twice
+    render( isl_ast.get(), target_defn, styles[s], false, walked_calls );
+
+    bool same = walked == flattened && walked_calls == flat_calls;
+    bool form = true;
+    switch( styles[s] ){
+      case intrinsic_calls:
+        form = walked.find( "floord(" ) != string::npos && walked.find( "isl_sage_" ) == string::npos;
+        break;
+      case intrinsic_inline:
+        form = walked_calls > 0 && walked.find( "isl_sage_floord_int(" ) != string::npos
+               && definitions( global, "isl_sage_max_int" ) == 1 && definitions( global, "isl_sage_min_int" ) == 1
+               && definitions( global, "isl_sage_floord_int" ) == 1;
+        break;
+      case intrinsic_expressions:
+        form = walked_calls == 0;
+        break;
+    }
+
+    failures += (same ? 0 : 1) + (form ? 0 : 1);
+    cout << names[s] << ": " << walked_calls << " calls"
+         << ", flat_ir " << (same ? "identical" : "MISMATCH")
+         << ", form " << (form ? "ok" : "WRONG") << endl;
+    if( ! form ){
+      cout << walked << endl;
+    }
+  }
+
+  return failures;
+}
@@ -40,9 +40,9 @@ isl_union_map* map_from_maps( isl_ctx* ctx, vector<string> maps ){
 
 void example( vector<string> domains, vector<string> maps ){
   // Produce ISL AST
+  isl_ctx* ctx = isl_ctx_alloc();
   isl_ast_node* isl_ast;
   {
-    isl_ctx* ctx = isl_ctx_alloc();
     isl_union_set* domain = domain_from_domains(ctx, domains );
     isl_union_map* schedule = map_from_maps(ctx, maps );
     isl_ast_build* build;
@@ -60,9 +60,6 @@ void example( vector<string> domains, vector<string> maps ){
     p = isl_printer_print_ast_node(p, isl_ast);
     cout << endl;
     isl_printer_free(p);
-
-    // isl_ast_node_free(tree);
-    // isl_ctx_free(ctx);
   }
 
   {
@@ -71,6 +68,8 @@ void example( vector<string> domains, vector<string> maps ){
     cout << walker.visit( isl_ast ) << endl;
   }
 
+  isl_ast_node_free( isl_ast );
+  isl_ctx_free( ctx );
 }
 
 
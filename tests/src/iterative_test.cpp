@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <chrono>
+#include <utility>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Renders the same ISL ASTs with the recursive and the iterative (explicit work
+stack) SageTransformationWalker, checks that both produce the same code and
+that the iterative walker is not clearly slower on the shallow ASTs (at most
+twice the recursive walker's time plus 0.1 ms, best of 5 each), and reports
+how long each took.
+The deep cases are loop nests as deep as the first argument (default 64).
+*/
+
+// [N]->{ S[i0,...,iD-1] : 0 <= ik < N } scheduled in order, i.e. a D deep nest
+pair<string,string> deep_nest( int nest_depth ){
+  string iterators;
+  string constraints;
+  for( int i = 0; i < nest_depth; i += 1 ){
+    string iterator = string("i") + to_string(i);
+    iterators += (i == 0 ? "" : ",") + iterator;
+    constraints += (i == 0 ? "" : " and ") + string("0 <= ") + iterator + " < N";
+  }
+
+  return make_pair( string("[N]->{ S[") + iterators + "] : " + constraints + " }",
+                    string("{ S[") + iterators + "] -> [" + iterators + "] }" );
+}
+
+// Renders isl_ast into a fresh injection site in main(), returns (code, seconds)
+pair<string,double> render( isl_ast_node* isl_ast, SgFunctionDefinition* target_defn, bool iterative ){
+  SgBasicBlock* injection_site = buildBasicBlock();
+  target_defn->append_statement( injection_site );
+
+  walker_options options;
+  options.iterative = iterative;
+
+  auto start = chrono::steady_clock::now();
+  SageTransformationWalker walker( isl_ast, injection_site, options );
+  auto stop = chrono::steady_clock::now();
+
+  return make_pair( injection_site->unparseToString(), chrono::duration<double>( stop - start ).count() );
+}
+
+// Best of repeats renders, so a run slowed by something else does not count
+pair<string,double> best_render( isl_ast_node* isl_ast, SgFunctionDefinition* target_defn, bool iterative, int repeats ){
+  pair<string,double> best = render( isl_ast, target_defn, iterative );
+  for( int i = 1; i < repeats; i += 1 ){
+    best.second = min( best.second, render( isl_ast, target_defn, iterative ).second );
+  }
+  return best;
+}
+
+int main( int argc, char** argv ){
+  int nest_depth = (argc > 1) ? atoi( argv[1] ) : 64;
+
+  vector<string> names = { "shallow", "tiled", string("deep ") + to_string(nest_depth) };
+  vector< pair<string,string> > tests;
+  // Shallow
+  tests.push_back( make_pair( string("[N,M]->{ S1[i,j] : 0 <= i < N and 0 <= j < M; S2[i,j] : 0 <= i < N and 0 <= j < M }"),
+                              string("{ S1[i,j] -> [0,i,j,0]; S2[i,j] -> [1,i,j,0] }") ) );
+  // Tiled, min/max/floord bounds
+  tests.push_back( make_pair( string("[N,M]->{ S[i,j] : 0 <= i < N and 0 <= j < M }"),
+                              string("{ S[i,j] -> [floor(i/32), floor(j/32), floor(i/4), floor(j/4), i, j] }") ) );
+  // Deep
+  tests.push_back( deep_nest( nest_depth ) );
+
+  SgProject* project = template_project( argv[0], "#include <iostream>\nusing namespace std;\nint main(){ }" );
+  SgFunctionDefinition* target_defn = template_main( project )->get_definition();
+
+  // Symbolic constants used by the bounds
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+  target_defn->append_statement( buildVariableDeclaration( SgName( "M" ), buildIntType(), NULL, target_defn ) );
+
+  isl_ctx* ctx = isl_ctx_alloc();
+  int failures = 0;
+
+  for( vector<string>::size_type i = 0; i < tests.size(); i += 1 ){
+    isl_ast_node* isl_ast = ast_from_strings( ctx, tests[i].first, tests[i].second );
+
+    pair<string,double> recursive = best_render( isl_ast, target_defn, false, 5 );
+    pair<string,double> iterative = best_render( isl_ast, target_defn, true, 5 );
+
+    bool same = recursive.first == iterative.first;
+    // Only the deep case may trade time for stack
+    bool deep = i + 1 == tests.size();
+    bool fast = deep || iterative.second <= 2 * recursive.second + 1e-4;
+    failures += (same ? 0 : 1) + (fast ? 0 : 1);
+
+    cout << names[i] << endl
+         << "  recursive: " << recursive.second << "s" << endl
+         << "  iterative: " << iterative.second << "s" << (fast ? "" : " (SLOWER)") << endl
+         << "  " << (same ? "identical" : "MISMATCH") << endl;
+
+    isl_ast_node_free( isl_ast );
+  }
+
+  isl_ctx_free( ctx );
+
+  return failures;
+}
@@ -0,0 +1,108 @@
+#include <cassert>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "SageTransformationWalker.hpp"
+#include "PrintNodeWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Translates the same handful of schedules thousands of times (first argument,
+default 5000), each with its own isl_ctx, through both PrintNodeWalker and
+SageTransformationWalker, and samples resident set size as it goes.
+Every isl object must be released by the walkers, so RSS should stay flat and
+the isl_ctx should free without complaint.
+
+Best run under valgrind or an ASan build with a smaller count, e.g.
+  valgrind --leak-check=full tests/bin/leak_test 200
+*/
+
+long resident_kb(){
+  long pages = 0;
+  long resident = 0;
+  FILE* statm = fopen( "/proc/self/statm", "r" );
+  if( statm != NULL ){
+    if( fscanf( statm, "%ld %ld", &pages, &resident ) != 2 ){
+      resident = 0;
+    }
+    fclose( statm );
+  }
+  return resident * ( sysconf( _SC_PAGESIZE ) / 1024 );
+}
+
+int main( int argc, char** argv ){
+  int iterations = (argc > 1) ? atoi( argv[1] ) : 5000;
+
+  vector< pair<string,string> > tests;
+  tests.push_back( make_pair( string("[N,M]->{ S1[i,j] : 0 <= i < N and 0 <= j < M; S2[i,j] : 0 <= i < N and 0 <= j < M }"),
+                              string("{ S1[i,j] -> [0,i,j,0]; S2[i,j] -> [1,i,j,0] }") ) );
+  tests.push_back( make_pair( string("[N,M]->{ S[i,j] : 0 <= i < N and 0 <= j < M }"),
+                              string("{ S[i,j] -> [floor(i/32), floor(j/32), i, j] }") ) );
+  tests.push_back( make_pair( string("[N]->{ S[i] : 0 <= i < N; T[i] : 0 <= i < N and i mod 3 = 0 }"),
+                              string("{ S[i] -> [i,0]; T[i] -> [i,1] }") ) );
+
+  SgProject* project = template_project( argv[0], "#include <iostream>\nusing namespace std;\nint main(){ }" );
+  SgFunctionDefinition* target_defn = template_main( project )->get_definition();
+
+  // Symbolic constants used by the bounds
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+  target_defn->append_statement( buildVariableDeclaration( SgName( "M" ), buildIntType(), NULL, target_defn ) );
+
+  int sample_every = ( iterations >= 10 ) ? iterations / 10 : 1;
+  long baseline_kb = 0;
+  long last_kb = 0;
+
+  for( int i = 0; i < iterations; i += 1 ){
+    isl_ctx_handle ctx( isl_ctx_alloc() );
+    pair<string,string>& test = tests[ i % tests.size() ];
+
+    isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), test.first, test.second ) );
+
+    {
+      PrintNodeWalker walker;
+      string dump = walker.visit( isl_ast.get() );
+      assert( !dump.empty() );
+    }
+
+    {
+      SgBasicBlock* injection_site = buildBasicBlock();
+      target_defn->append_statement( injection_site );
+
+      SageTransformationWalker walker( isl_ast.get(), injection_site );
+
+      removeStatement( injection_site );
+      deleteAST( injection_site );
+    }
+
+    // Handles release the AST before the context
+    isl_ast.reset();
+    ctx.reset();
+
+    if( (i + 1) % sample_every == 0 ){
+      last_kb = resident_kb();
+      // First sample is taken after allocators have warmed up
+      if( baseline_kb == 0 ){
+        baseline_kb = last_kb;
+      }
+      cout << "iteration " << (i + 1) << ": " << last_kb << " KB resident" << endl;
+    }
+  }
+
+  // Allow 10% slack over the warmed up baseline
+  bool flat = last_kb <= baseline_kb + baseline_kb / 10;
+  cout << ( flat ? "RSS flat" : "RSS GREW" ) << ": " << baseline_kb << " KB -> " << last_kb << " KB" << endl;
+
+  return flat ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Translates a unit stride loop, a stride 4 loop and a loop bounded by N and M
+with walker_options::canonical_loops, directly and through flat_ir, and checks
+that:
+  - both paths build the same code
+  - every loop's condition is iterator <= bound or iterator < bound, and its
+    increment ++iterator or iterator += k
+  - the stride 4 loop is normalized: its counter starts at 0 and goes up by
+    1, and the isl iterator is declared at the top of its body
+  - compiled with $CXX (default g++) -O3 -fopt-info-vec, each canonical loop
+    is reported vectorized
+  - each canonical loop computes the same array as isl's form of it
+The statement S( i ) is a macro updating A from B around index i.
+*/
+
+class loop_case {
+  public:
+    string name;
+    string domain;
+    string schedule;
+    // Body of the macro S( i )
+    string statement;
+    bool strided;
+};
+
+// Checks the form of every loop under root, returns the number that break it
+int check_form( SgNode* root, bool strided ){
+  int broken = 0;
+  Rose_STL_Container<SgNode*> loops = NodeQuery::querySubTree( root, V_SgForStatement );
+  for( Rose_STL_Container<SgNode*>::iterator it = loops.begin(); it != loops.end(); ++it ){
+    SgForStatement* loop = isSgForStatement( *it );
+    SgExprStatement* test = isSgExprStatement( loop->get_test() );
+    SgBinaryOp* compare = isSgBinaryOp( test == NULL ? NULL : test->get_expression() );
+    bool simple = compare != NULL && ( isSgLessOrEqualOp( compare ) || isSgLessThanOp( compare ) ) && isSgVarRefExp( compare->get_lhs_operand() );
+    bool increment = isSgPlusPlusOp( loop->get_increment() ) || isSgPlusAssignOp( loop->get_increment() );
+
+    bool normalized = true;
+    if( strided ){
+      SgStatementPtrList& body = isSgBasicBlock( loop->get_loop_body() )->get_statements();
+      normalized = isSgPlusPlusOp( loop->get_increment() ) && ! body.empty() && isSgVariableDeclaration( body.front() ) != NULL;
+    }
+
+    broken += (simple && increment && normalized) ? 0 : 1;
+  }
+  return broken;
+}
+
+string render( isl_ast_node* isl_ast, SgFunctionDefinition* target_defn, bool canonical, bool flat_ir, int& broken, bool strided ){
+  SgBasicBlock* injection_site = buildBasicBlock();
+  target_defn->append_statement( injection_site );
+
+  walker_options options;
+  options.canonical_loops = canonical;
+  options.flat_ir = flat_ir;
+  options.intrinsics = intrinsic_inline;
+  options.strength_reduce = true;
+  SageTransformationWalker walker( isl_ast, injection_site, options );
+
+  broken = check_form( injection_site, strided );
+  string code = injection_site->unparseToString();
+  removeStatement( injection_site );
+  deleteAST( injection_site );
+  return code;
+}
+
+int main( int argc, char** argv ){
+  SgProject* project = template_project( argv[0], "int main(){ }" );
+  SgFunctionDeclaration* target_decl = template_main( project );
+  SgFunctionDefinition* target_defn = target_decl->get_definition();
+  SgGlobal* global = getGlobalScope( target_decl );
+
+  // Symbolic constants used by the bounds
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+  target_defn->append_statement( buildVariableDeclaration( SgName( "M" ), buildIntType(), NULL, target_defn ) );
+
+  vector<loop_case> cases;
+  cases.push_back( loop_case{ "unit", "[N]->{ S[i] : 0 <= i < N }", "{ S[i] -> [i] }",
+                              "A[(i)] = 2.0f * B[(i)] + A[(i)]", false } );
+  cases.push_back( loop_case{ "strided", "[N]->{ S[i] : 0 <= i < N and i mod 4 = 0 }", "{ S[i] -> [i] }",
+                              "A[(i) / 4] = 2.0f * B[(i) / 4] + A[(i) / 4]", true } );
+  cases.push_back( loop_case{ "bounded", "[N,M]->{ S[i] : 0 <= i < N and i < M }", "{ S[i] -> [i] }",
+                              "A[(i)] = 2.0f * B[(i)] + A[(i)]", false } );
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  int failures = 0;
+
+  for( vector<loop_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    const loop_case& test = cases[i];
+    isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), test.domain, test.schedule ) );
+
+    int broken = 0;
+    int flat_broken = 0;
+    int unused = 0;
+    string canonical = render( isl_ast.get(), target_defn, true, false, broken, test.strided );
+    string flattened = render( isl_ast.get(), target_defn, true, true, flat_broken, test.strided );
+    string original = render( isl_ast.get(), target_defn, false, false, unused, false );
+
+    bool same = canonical == flattened && broken == flat_broken;
+    string prelude = definitions( global ) + "#define S(i) " + test.statement + "\n";
+    const string parameters( "int N, int M, float* __restrict__ A, const float* __restrict__ B" );
+
+    // Vectorization report of the canonical loop alone
+    string base = "__loop_form_" + test.name;
+    ofstream source( (base + ".cpp").c_str(), ios::trunc | ios::out );
+    source << prelude << kernel( "canonical", parameters, canonical );
+    source.close();
+    bool compiled = run( cxx() + " -O3 -fopt-info-vec-optimized=" + base + ".vec -c " + base + ".cpp -o " + base + ".o" ) == 0;
+    bool vectorized = compiled && run( "grep -q 'loop vectorized' " + base + ".vec" ) == 0;
+
+    // Same results as isl's form
+    kernel_comparison comparison( base, prelude );
+    comparison.parameters = parameters;
+    comparison.arguments = "1000, 700";
+    comparison.size = 1024;
+    bool values = comparison.same_results( canonical, original );
+
+    failures += (same ? 0 : 1) + broken + (vectorized ? 0 : 1) + (values ? 0 : 1);
+    cout << test.name << ": flat_ir " << (same ? "identical" : "MISMATCH")
+         << ", form " << (broken == 0 ? "canonical" : "NOT CANONICAL")
+         << ", " << (compiled ? (vectorized ? "vectorized" : "NOT VECTORIZED") : "NOT COMPILED")
+         << ", values " << (values ? "identical" : "MISMATCH") << endl;
+    if( broken != 0 || ! vectorized ){
+      cout << canonical << endl;
+    }
+  }
+
+  return failures;
+}
@@ -0,0 +1,237 @@
+#include <cassert>
+#include <cstdlib>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "flat_ast.hpp"
+#include "work_pool.hpp"
+#include "synthetic_ast.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Times lowering synthetic ISL ASTs with hundreds of top level loop nests to a
+flat_ast, serially and with flat_ast::lower_parallel on 1, 2, 4, ... threads
+up to the number of hardware threads (or the third argument), and the whole
+flat_ir translation with the same thread counts. Every parallel lowering is
+checked to give the same nodes as the serial one, and every translation the
+same code. Each timing is the best of repetitions runs (second argument,
+default 5). Results are written as JSON to the first argument, or stdout.
+
+make bench runs this and writes lower_bench.json.
+*/
+
+class bench_case {
+  public:
+    string name;
+    synthetic_options options;
+
+    bench_case( const string& name, int nest_depth, int statements, int fan_in ): name( name ), options() {
+      this->options.nest_depth = nest_depth;
+      this->options.statements = statements;
+      this->options.fan_in = fan_in;
+    }
+};
+
+class thread_result {
+  public:
+    unsigned threads;
+    double lower;
+    double translate;
+    bool same;
+};
+
+class bench_result {
+  public:
+    unsigned nodes;
+    double serial_lower;
+    double serial_translate;
+    vector<thread_result> parallel;
+};
+
+double seconds_since( chrono::steady_clock::time_point start ){
+  return chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+}
+
+bool same_nodes( const flat_ast& a, const flat_ast& b ){
+  if( a.size() != b.size() ){
+    return false;
+  }
+  for( uint32_t n = 0; n < a.size(); n += 1 ){
+    if( a.kind( n ) != b.kind( n ) || a.children( n ) != b.children( n ) || a.end( n ) != b.end( n ) ){
+      return false;
+    }
+    if( a.kind( n ) == flat_op && a.op( n ) != b.op( n ) ){
+      return false;
+    }
+    if( a.kind( n ) == flat_int && a.value( n ) != b.value( n ) ){
+      return false;
+    }
+    if( a.kind( n ) == flat_id && string( a.name( a.identifier( n ) ) ) != b.name( b.identifier( n ) ) ){
+      return false;
+    }
+    for( uint32_t i = 0; i < a.children( n ); i += 1 ){
+      if( a.child( n, i ) != b.child( n, i ) ){
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Translates isl_ast with flat_ir, returns the code and the time taken
+string translate( isl_ast_node* isl_ast, SgBasicBlock* parameter_block, unsigned threads, double& seconds ){
+  SgBasicBlock* injection_site = buildBasicBlock();
+  parameter_block->append_statement( injection_site );
+
+  walker_options options;
+  options.flat_ir = true;
+  options.lowering_threads = threads;
+  SageTransformationWalker walker( options );
+
+  auto start = chrono::steady_clock::now();
+  walker.translate( isl_ast, injection_site );
+  seconds = min( seconds, seconds_since( start ) );
+
+  string code = injection_site->unparseToString();
+  removeStatement( injection_site );
+  deleteAST( injection_site );
+  return code;
+}
+
+bench_result run_case( const bench_case& test, const vector<unsigned>& thread_counts, int repetitions, isl_ctx* ctx, SgFunctionDefinition* target_defn ){
+  bench_result result;
+  result.serial_lower = result.serial_translate = 1e30;
+
+  isl_ast_node_handle isl_ast( synthetic_ast( ctx, test.options ) );
+
+  SgBasicBlock* parameter_block = buildBasicBlock();
+  target_defn->append_statement( parameter_block );
+  vector<string> parameters = synthetic_parameters( test.options );
+  for( vector<string>::size_type i = 0; i < parameters.size(); i += 1 ){
+    parameter_block->append_statement( buildVariableDeclaration( SgName( parameters[i] ), buildIntType(), NULL, parameter_block ) );
+  }
+
+  flat_ast serial;
+  for( int r = 0; r < repetitions; r += 1 ){
+    serial.clear();
+    auto start = chrono::steady_clock::now();
+    serial.lower( isl_ast.get() );
+    result.serial_lower = min( result.serial_lower, seconds_since( start ) );
+  }
+  result.nodes = serial.size();
+
+  string serial_code;
+  for( int r = 0; r < repetitions; r += 1 ){
+    serial_code = translate( isl_ast.get(), parameter_block, 1, result.serial_translate );
+  }
+
+  for( vector<unsigned>::size_type t = 0; t < thread_counts.size(); t += 1 ){
+    thread_result parallel;
+    parallel.threads = thread_counts[t];
+    parallel.lower = parallel.translate = 1e30;
+    parallel.same = true;
+
+    work_pool pool( thread_counts[t] );
+    for( int r = 0; r < repetitions; r += 1 ){
+      flat_ast ir;
+      auto start = chrono::steady_clock::now();
+      ir.lower_parallel( isl_ast.get(), pool );
+      parallel.lower = min( parallel.lower, seconds_since( start ) );
+      parallel.same = parallel.same && same_nodes( serial, ir );
+    }
+
+    for( int r = 0; r < repetitions; r += 1 ){
+      parallel.same = parallel.same && translate( isl_ast.get(), parameter_block, thread_counts[t], parallel.translate ) == serial_code;
+    }
+
+    result.parallel.push_back( parallel );
+  }
+
+  removeStatement( parameter_block );
+  deleteAST( parameter_block );
+
+  return result;
+}
+
+void write_json( ostream& out, unsigned hardware_threads, const vector<bench_case>& cases, const vector<bench_result>& results ){
+  out << "{\"hardware_threads\":" << hardware_threads << ",\"benchmarks\":[" << endl;
+  for( vector<bench_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    const synthetic_options& options = cases[i].options;
+    const bench_result& result = results[i];
+    out << "  {\"name\":\"" << cases[i].name << "\""
+        << ",\"nest_depth\":" << options.nest_depth
+        << ",\"statements\":" << options.statements
+        << ",\"fan_in\":" << options.fan_in
+        << ",\"flat_nodes\":" << result.nodes
+        << ",\"serial\":{\"lower\":" << result.serial_lower << ",\"translate\":" << result.serial_translate << "}"
+        << ",\"parallel\":[";
+    for( vector<thread_result>::size_type t = 0; t < result.parallel.size(); t += 1 ){
+      const thread_result& parallel = result.parallel[t];
+      out << (t == 0 ? "" : ",")
+          << "{\"threads\":" << parallel.threads
+          << ",\"lower\":" << parallel.lower
+          << ",\"lower_speedup\":" << result.serial_lower / parallel.lower
+          << ",\"translate\":" << parallel.translate
+          << ",\"translate_speedup\":" << result.serial_translate / parallel.translate
+          << ",\"identical\":" << (parallel.same ? "true" : "false") << "}";
+    }
+    out << "]}" << (i + 1 < cases.size() ? "," : "") << endl;
+  }
+  out << "]}" << endl;
+}
+
+int main( int argc, char** argv ){
+  string output_path = (argc > 1) ? argv[1] : "";
+  int repetitions = (argc > 2) ? atoi( argv[2] ) : 5;
+  unsigned hardware_threads = thread::hardware_concurrency();
+  unsigned max_threads = (argc > 3) ? atoi( argv[3] ) : hardware_threads;
+
+  vector<unsigned> thread_counts;
+  for( unsigned threads = 1; threads <= max( max_threads, 1u ); threads *= 2 ){
+    thread_counts.push_back( threads );
+  }
+  if( thread_counts.back() != max( max_threads, 1u ) ){
+    thread_counts.push_back( max_threads );
+  }
+
+  vector<bench_case> cases;
+  cases.push_back( bench_case( "nests-128", 2, 128, 1 ) );
+  cases.push_back( bench_case( "nests-512", 2, 512, 1 ) );
+  cases.push_back( bench_case( "fan-in-256", 3, 256, 2 ) );
+
+  SgProject* project = template_project( argv[0], "#include <iostream>\nusing namespace std;\nint main(){ }" );
+  SgFunctionDefinition* target_defn = template_main( project )->get_definition();
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+
+  int failures = 0;
+  vector<bench_result> results;
+  for( vector<bench_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    results.push_back( run_case( cases[i], thread_counts, repetitions, ctx.get(), target_defn ) );
+    for( vector<thread_result>::size_type t = 0; t < results.back().parallel.size(); t += 1 ){
+      failures += results.back().parallel[t].same ? 0 : 1;
+    }
+    cerr << cases[i].name << ": " << results.back().nodes << " nodes" << endl;
+  }
+
+  if( output_path.empty() ){
+    write_json( cout, hardware_threads, cases, results );
+    return failures;
+  }
+
+  ofstream output( output_path.c_str(), ios::trunc | ios::out );
+  write_json( output, hardware_threads, cases, results );
+  return output.good() ? failures : failures + 1;
+}
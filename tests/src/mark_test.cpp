@@ -0,0 +1,181 @@
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "mark_registry.hpp"
+#include "parallel_loops.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Translates schedule trees whose bands are marked parallel, unroll:4, ivdep
+over unroll:2, simd under a mark nothing is registered for, and a mark
+handled by a user hook, and with walker_options::omp_parallel, a band marked
+parallel and one marked simd, recursively, iteratively and through flat_ir,
+and checks that:
+  - the three build the same code
+  - each pragma expected is built, right before the loop of the band marked,
+    and no other; a loop omp_parallel parallelized gets no second omp
+    parallel for, and simd joins its directive
+  - the hook is called once per translation, with the marked loop
+  - compiled with $CXX (default g++) and -fopenmp, each translation computes
+    the same array as the translation of the unmarked schedule
+The statement S is a macro updating A from B.
+*/
+
+class mark_case {
+  public:
+    string name;
+    // Schedule tree, in isl's YAML-like notation
+    string schedule;
+    // Pragmas expected, each as text@iterator of the loop after it
+    string pragmas;
+    // Whether walker_options::omp_parallel is set, every loop being parallel
+    bool omp_parallel;
+};
+
+const string domain( "[N]->{ S[i,j] : 0 <= i < N and 0 <= j < N }" );
+const string outer( "schedule: \"[{ S[i,j] -> [(i)] }]\"" );
+const string inner( "schedule: \"[{ S[i,j] -> [(j)] }]\"" );
+
+// The tree of domain with children, each one the parent of the next
+string tree( const vector<string>& children ){
+  string text = "{ domain: \"" + domain + "\"";
+  for( vector<string>::size_type i = 0; i < children.size(); i += 1 ){
+    text += ", child: { " + children[i];
+  }
+  text += string( children.size(), '}' ) + " }";
+  return text;
+}
+
+// AST of the schedule tree, its loops annotated parallel if parallel
+isl_ast_node* ast_from_schedule( isl_ctx* ctx, string schedule_str, bool parallel ){
+  isl_schedule* schedule = isl_schedule_read_from_str( ctx, schedule_str.c_str() );
+  assert( schedule != NULL );
+
+  parallel_loops loops( isl_union_map_read_from_str( ctx, "[N]->{ }" ) );
+  isl_ast_build* build = isl_ast_build_alloc( ctx );
+  if( parallel ){
+    build = loops.annotate( build );
+  }
+  isl_ast_node* isl_ast = isl_ast_build_node_from_schedule( build, schedule );
+  isl_ast_build_free( build );
+
+  return isl_ast;
+}
+
+// The pragmas under root, each as text@iterator of the loop after it
+string pragmas( SgNode* root ){
+  string found;
+  Rose_STL_Container<SgNode*> declarations = NodeQuery::querySubTree( root, V_SgPragmaDeclaration );
+  for( Rose_STL_Container<SgNode*>::iterator it = declarations.begin(); it != declarations.end(); ++it ){
+    SgStatement* next = getNextStatement( isSgStatement( *it ) );
+    while( isSgPragmaDeclaration( next ) ){
+      next = getNextStatement( next );
+    }
+    SgForStatement* loop = isSgForStatement( next );
+    SgVariableDeclaration* iterator = loop == NULL || loop->get_init_stmt().empty() ? NULL : isSgVariableDeclaration( loop->get_init_stmt().front() );
+
+    found += found.empty() ? "" : " ";
+    found += isSgPragmaDeclaration( *it )->get_pragma()->get_pragma() + "@";
+    found += iterator == NULL ? "?" : getFirstInitializedName( iterator )->get_name().getString();
+  }
+  return found;
+}
+
+string render( isl_ast_node* isl_ast, SgFunctionDefinition* target_defn, const mark_registry* marks, bool omp_parallel, bool iterative, bool flat_ir, string& found ){
+  SgBasicBlock* injection_site = buildBasicBlock();
+  target_defn->append_statement( injection_site );
+
+  walker_options options;
+  options.marks = marks;
+  options.omp_parallel = omp_parallel;
+  options.iterative = iterative;
+  options.flat_ir = flat_ir;
+  options.intrinsics = intrinsic_inline;
+  SageTransformationWalker walker( isl_ast, injection_site, options );
+
+  found = pragmas( injection_site );
+  string code = injection_site->unparseToString();
+  removeStatement( injection_site );
+  deleteAST( injection_site );
+  return code;
+}
+
+int main( int argc, char** argv ){
+  SgProject* project = template_project( argv[0], "int main(){ }" );
+  SgFunctionDeclaration* target_decl = template_main( project );
+  SgFunctionDefinition* target_defn = target_decl->get_definition();
+  SgGlobal* global = getGlobalScope( target_decl );
+
+  // Symbolic constant used by the bounds
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+
+  // The defaults, and a hook counting the loops it is given
+  int hooked = 0, hooked_loops = 0;
+  mark_registry marks;
+  marks.set( "hook", [&hooked, &hooked_loops]( SgStatement* marked, const string& argument ) -> SgStatement* {
+    hooked += 1;
+    hooked_loops += isSgForStatement( marked ) != NULL ? 1 : 0;
+    return marked;
+  } );
+
+  vector<mark_case> cases;
+  cases.push_back( mark_case{ "nest", tree( { "mark: \"parallel\"", outer, "mark: \"unroll:4\"", inner } ),
+                              "omp parallel for@c0 GCC unroll 4@c1", false } );
+  cases.push_back( mark_case{ "stacked", tree( { outer, "mark: \"ivdep\"", "mark: \"unroll:2\"", inner } ),
+                              "GCC unroll 2@c1 GCC ivdep@c1", false } );
+  cases.push_back( mark_case{ "unknown", tree( { "mark: \"note\"", outer, "mark: \"simd\"", inner } ),
+                              "omp simd@c1", false } );
+  cases.push_back( mark_case{ "hook", tree( { outer, "mark: \"hook\"", inner } ), "", false } );
+  cases.push_back( mark_case{ "parallelized", tree( { "mark: \"parallel\"", outer, inner } ), "omp parallel for@c0", true } );
+  cases.push_back( mark_case{ "parallel_simd", tree( { "mark: \"simd\"", outer, inner } ), "omp parallel for simd@c0", true } );
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  isl_ast_node_handle unmarked_ast( ast_from_schedule( ctx.get(), tree( { outer, inner } ), false ) );
+  string none;
+  string unmarked = render( unmarked_ast.get(), target_defn, &marks, false, false, false, none );
+
+  int failures = 0;
+  for( vector<mark_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    const mark_case& test = cases[i];
+    isl_ast_node_handle isl_ast( ast_from_schedule( ctx.get(), test.schedule, test.omp_parallel ) );
+
+    string found, iterative_found, flat_found;
+    hooked = hooked_loops = 0;
+    string code = render( isl_ast.get(), target_defn, &marks, test.omp_parallel, false, false, found );
+    string iterated = render( isl_ast.get(), target_defn, &marks, test.omp_parallel, true, false, iterative_found );
+    string flattened = render( isl_ast.get(), target_defn, &marks, test.omp_parallel, false, true, flat_found );
+
+    bool same = code == iterated && code == flattened && found == iterative_found && found == flat_found;
+    bool placed = found == test.pragmas;
+    bool hooks = test.name != "hook" || ( hooked == 3 && hooked_loops == 3 );
+
+    // Same results as the unmarked schedule
+    string base = "__mark_" + test.name;
+    kernel_comparison comparison( base, definitions( global ) + "#define S(i,j) A[(i) * N + (j)] = A[(i) * N + (j)] * 0.5f + B[(j) * N + (i)]\n" );
+    comparison.flags = "-O2 -fopenmp";
+    bool values = comparison.same_results( code, unmarked );
+
+    failures += (same ? 0 : 1) + (placed ? 0 : 1) + (hooks ? 0 : 1) + (values ? 0 : 1);
+    cout << test.name << ": iterative and flat_ir " << (same ? "identical" : "MISMATCH")
+         << ", pragmas \"" << found << "\"" << (placed ? "" : " (UNEXPECTED)")
+         << ", " << hooked << " hooked" << (hooks ? "" : " (UNEXPECTED)")
+         << ", values " << (values ? "identical" : "MISMATCH") << endl;
+    if( ! placed ){
+      cout << code << endl;
+    }
+  }
+
+  return failures;
+}
@@ -0,0 +1,183 @@
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "walker_stats.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Translates fused stencils, tiled and guarded chains, and a tiled chain whose
+register loops are unrolled, with walker_options::memoize_exprs, recursively
+and iteratively, and checks that:
+  - both build the same code as the translation without memoize_exprs
+  - every variable reference names the symbol its name resolves to where it
+    is, so copies never point into another loop's scope
+  - both drivers count the same memo hits and misses, and there are hits
+    exactly where whole loop bounds or guards repeat
+Then prints the hit rates and the time of each translation with and without
+memoize_exprs.
+Last, translates a loop bounded by a sum of 256 parameters, an expression as
+deep, with memoize_exprs and fold_affine, which keeps the Sage tree of the
+sum shallow, and checks that the iterative translation takes no more stack
+than that of a sum of 2, while the recursive one takes more.
+*/
+
+class memo_case {
+  public:
+    string name;
+    string domain;
+    string schedule;
+    unsigned unroll_limit;
+    // Whether whole loop bounds or guards repeat, so lookups hit
+    bool repeats;
+};
+
+// Number of variable references under root whose name resolves to another
+// symbol where they are
+int misbound( SgNode* root ){
+  int wrong = 0;
+  Rose_STL_Container<SgNode*> references = NodeQuery::querySubTree( root, V_SgVarRefExp );
+  for( Rose_STL_Container<SgNode*>::iterator it = references.begin(); it != references.end(); ++it ){
+    SgVarRefExp* reference = isSgVarRefExp( *it );
+    SgVariableSymbol* symbol = reference->get_symbol();
+    SgVariableSymbol* resolved = lookupVariableSymbolInParentScopes( symbol->get_name(), getEnclosingScope( reference ) );
+    wrong += resolved == symbol ? 0 : 1;
+  }
+  return wrong;
+}
+
+string render( isl_ast_node* isl_ast, SgFunctionDefinition* target_defn, const memo_case& test, bool memoize, bool iterative, walker_stats& stats, double& ms, int& wrong ){
+  SgBasicBlock* injection_site = buildBasicBlock();
+  target_defn->append_statement( injection_site );
+
+  walker_options options;
+  options.memoize_exprs = memoize;
+  options.iterative = iterative;
+  options.unroll_limit = test.unroll_limit;
+  options.canonical_loops = test.unroll_limit != 0;
+  SageTransformationWalker walker( options );
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  walker.translate( isl_ast, injection_site );
+  ms = chrono::duration<double, milli>( chrono::steady_clock::now() - start ).count();
+
+  stats = walker.getStats();
+  wrong = misbound( injection_site );
+  string code = injection_site->unparseToString();
+  removeStatement( injection_site );
+  deleteAST( injection_site );
+  return code;
+}
+
+// [p0,...]->{ S[i] : 0 <= i < p0 + ... + pn-1 }, with the parameters
+// declared in target_defn
+string sum_domain( int n, SgFunctionDefinition* target_defn ){
+  string parameters;
+  string sum;
+  for( int i = 0; i < n; i += 1 ){
+    string parameter = "p" + to_string( i );
+    parameters += (i == 0 ? "" : ",") + parameter;
+    sum += (i == 0 ? "" : " + ") + parameter;
+    if( lookupVariableSymbolInParentScopes( parameter, target_defn->get_body() ) == NULL ){
+      target_defn->append_statement( buildVariableDeclaration( SgName( parameter ), buildIntType(), NULL, target_defn ) );
+    }
+  }
+  return "[" + parameters + "]->{ S[i] : 0 <= i < " + sum + " }";
+}
+
+// Stack translating a loop bounded by a sum of n parameters takes
+size_t sum_stack_use( isl_ctx* ctx, SgFunctionDefinition* target_defn, int n, bool iterative, string& code ){
+  isl_ast_node_handle isl_ast( ast_from_strings( ctx, sum_domain( n, target_defn ), "{ S[i] -> [i] }" ) );
+  SgBasicBlock* injection_site = buildBasicBlock();
+  target_defn->append_statement( injection_site );
+
+  walker_options options;
+  options.memoize_exprs = true;
+  options.fold_affine = true;
+  options.iterative = iterative;
+  SageTransformationWalker walker( options );
+  size_t use = stack_use( [&](){ walker.translate( isl_ast.get(), injection_site ); } );
+
+  code = injection_site->unparseToString();
+  removeStatement( injection_site );
+  deleteAST( injection_site );
+  return use;
+}
+
+int main( int argc, char** argv ){
+  SgProject* project = template_project( argv[0], "int main(){ }" );
+  SgFunctionDefinition* target_defn = template_main( project )->get_definition();
+
+  // Symbolic constants used by the bounds
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+  target_defn->append_statement( buildVariableDeclaration( SgName( "M" ), buildIntType(), NULL, target_defn ) );
+
+  vector<memo_case> cases;
+  cases.push_back( memo_case{ "fused", "[N,M]->{ S1[i,j] : 1 <= i < N - 1 and 1 <= j < M - 1; S2[i,j] : 1 <= i < N - 1 and 1 <= j < M - 1; S3[i,j] : 1 <= i < N - 1 and 1 <= j < M - 1 }",
+                              "{ S1[i,j] -> [0,i,j]; S2[i,j] -> [1,i,j]; S3[i,j] -> [2,i,j] }", 0, false } );
+  cases.push_back( memo_case{ "tiled", "[N,M]->{ S1[i,j] : 0 <= i < N and 0 <= j < M; S2[i,j] : 0 <= i < N and 0 <= j < M }",
+                              "{ S1[i,j] -> [floor(i/32), floor(j/32), 0, i, j]; S2[i,j] -> [floor(i/32), floor(j/32), 1, i, j] }", 0, true } );
+  cases.push_back( memo_case{ "guarded", "[N]->{ S[i] : 0 <= i < N; T[i] : 0 <= i < N and i mod 3 = 0; U[i] : 0 <= i < N and i mod 3 = 0 }",
+                              "{ T[i] -> [i,0]; S[i] -> [i,1]; U[i] -> [i,2] }", 0, true } );
+  cases.push_back( memo_case{ "unrolled", "[N,M]->{ S1[i,j] : 0 <= i < N and 0 <= j < 4; S2[i,j] : 0 <= i < N and 0 <= j < 4 }",
+                              "{ S1[i,j] -> [floor(i/32), 0, i, j]; S2[i,j] -> [floor(i/32), 1, i, j] }", 4, false } );
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  int failures = 0;
+
+  for( vector<memo_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    const memo_case& test = cases[i];
+    isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), test.domain, test.schedule ) );
+
+    walker_stats stats, iterative_stats, plain_stats;
+    double ms = 0, iterative_ms = 0, plain_ms = 0;
+    int wrong = 0, iterative_wrong = 0, plain_wrong = 0;
+    string code = render( isl_ast.get(), target_defn, test, true, false, stats, ms, wrong );
+    string iterated = render( isl_ast.get(), target_defn, test, true, true, iterative_stats, iterative_ms, iterative_wrong );
+    string plain = render( isl_ast.get(), target_defn, test, false, false, plain_stats, plain_ms, plain_wrong );
+
+    bool same = code == plain && iterated == plain;
+    bool bound = wrong + iterative_wrong + plain_wrong == 0;
+    bool counted = stats.memo_hits == iterative_stats.memo_hits && stats.memo_misses == iterative_stats.memo_misses
+                   && (stats.memo_hits > 0) == test.repeats && plain_stats.memo_hits + plain_stats.memo_misses == 0;
+
+    failures += (same ? 0 : 1) + (bound ? 0 : 1) + (counted ? 0 : 1);
+    cout << test.name << ": code " << (same ? "identical" : "MISMATCH")
+         << ", " << wrong + iterative_wrong << " references misbound"
+         << ", " << stats.memo_hits << " hits, " << stats.memo_misses << " misses"
+         << (counted ? "" : " (UNEXPECTED)")
+         << ", hit rate " << stats.memo_hit_rate() << endl
+         << "  " << ms << " ms memoized, " << iterative_ms << " ms iterative, " << plain_ms << " ms without" << endl;
+    if( ! same ){
+      cout << code << endl << plain << endl;
+    }
+  }
+
+  // Iterative translation takes the same stack however deep the sum is
+  string shallow_code, deep_code, recursive_code, unused;
+  size_t shallow = sum_stack_use( ctx.get(), target_defn, 2, true, shallow_code );
+  size_t deep = sum_stack_use( ctx.get(), target_defn, 256, true, deep_code );
+  size_t recursive_shallow = sum_stack_use( ctx.get(), target_defn, 2, false, unused );
+  size_t recursive = sum_stack_use( ctx.get(), target_defn, 256, false, recursive_code );
+  const size_t slack = 16 << 10;
+  bool same = deep_code == recursive_code;
+  bool flat = deep <= shallow + slack && recursive > recursive_shallow + slack;
+  failures += (same ? 0 : 1) + (flat ? 0 : 1);
+  cout << "sum of 256: code " << (same ? "identical" : "MISMATCH")
+       << ", " << deep << " bytes of stack iterative (" << shallow << " for 2), "
+       << recursive << " recursive (" << recursive_shallow << " for 2)" << (flat ? "" : " (UNEXPECTED)") << endl;
+
+  return failures;
+}
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "arith_builder.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Builds n-ary max and min with arith_builder and checks that:
+  - max and min of eight variables are balanced trees of calls, 3 deep
+  - of max( a, 3, b, 7, a, -2 ) only a, 7 and b are kept, and of the same min
+    a, -2 and b
+  - compiled with $CXX (default g++), the intrinsic_expressions forms give the
+    values of std::max and std::min over a grid of variable values
+  - a nest bounded by N, M and K translates to the same code directly and
+    through flat_ir
+*/
+
+const int variables = 8;
+
+class minmax_case {
+  public:
+    string name;
+    vector<string> operands;
+    // Operands expected to be kept
+    int kept;
+};
+
+// Depth of the calls nested at the top of expression
+int depth( SgExpression* expression ){
+  SgFunctionCallExp* call = isSgFunctionCallExp( expression );
+  if( call == NULL ){
+    return 0;
+  }
+  int deepest = 0;
+  SgExpressionPtrList& args = call->get_args()->get_expressions();
+  for( SgExpressionPtrList::iterator it = args.begin(); it != args.end(); ++it ){
+    deepest = max( deepest, depth( *it ) );
+  }
+  return 1 + deepest;
+}
+
+// name of the case's operands, the parameters of function being a..h
+SgExpression* build_case( arith_builder& arith, const minmax_case& c, SgFunctionDeclaration* function ){
+  SgInitializedNamePtrList& params = function->get_parameterList()->get_args();
+  SgScopeStatement* body = function->get_definition()->get_body();
+
+  vector<SgExpression*> operands;
+  for( vector<string>::size_type i = 0; i < c.operands.size(); i += 1 ){
+    const string& operand = c.operands[i];
+    if( operand[0] >= 'a' && operand[0] <= 'h' ){
+      operands.push_back( buildVarRefExp( params[operand[0] - 'a'], body ) );
+    } else {
+      operands.push_back( buildIntVal( atoi( operand.c_str() ) ) );
+    }
+  }
+  return c.name == "max" ? arith.max( operands, buildIntType() ) : arith.min( operands, buildIntType() );
+}
+
+SgFunctionDeclaration* function( SgGlobal* global, const string& name ){
+  SgFunctionParameterList* parameters = buildFunctionParameterList();
+  for( int i = 0; i < variables; i += 1 ){
+    appendArg( parameters, buildInitializedName( SgName( string( 1, (char) ('a' + i) ) ), buildIntType() ) );
+  }
+  return buildDefiningFunctionDeclaration( SgName( name ), buildIntType(), parameters, global );
+}
+
+string render( isl_ast_node* isl_ast, SgFunctionDefinition* target_defn, bool flat_ir, int& calls ){
+  SgBasicBlock* injection_site = buildBasicBlock();
+  target_defn->append_statement( injection_site );
+
+  walker_options options;
+  options.flat_ir = flat_ir;
+  SageTransformationWalker walker( isl_ast, injection_site, options );
+
+  calls = NodeQuery::querySubTree( injection_site, V_SgFunctionCallExp ).size();
+  string code = injection_site->unparseToString();
+  removeStatement( injection_site );
+  deleteAST( injection_site );
+  return code;
+}
+
+int main( int argc, char** argv ){
+  SgProject* project = template_project( argv[0], "int main(){ }" );
+  SgFunctionDeclaration* target_decl = template_main( project );
+  SgFunctionDefinition* target_defn = target_decl->get_definition();
+  SgGlobal* global = getGlobalScope( target_decl );
+
+  vector<minmax_case> cases;
+  cases.push_back( minmax_case{ "max", { "a", "b", "c", "d", "e", "f", "g", "h" }, 8 } );
+  cases.push_back( minmax_case{ "min", { "a", "b", "c", "d", "e", "f", "g", "h" }, 8 } );
+  cases.push_back( minmax_case{ "max", { "a", "3", "b", "7", "a", "-2" }, 3 } );
+  cases.push_back( minmax_case{ "min", { "a", "3", "b", "7", "a", "-2" }, 3 } );
+
+  arith_builder calls( intrinsic_calls, false );
+  arith_builder expressions( intrinsic_expressions, false );
+  calls.set_global( global );
+  expressions.set_global( global );
+
+  int failures = 0;
+  vector<string> forms;
+  for( vector<minmax_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    const minmax_case& c = cases[i];
+    SgFunctionDeclaration* called = function( global, "called_" + to_string( i ) );
+    SgExpression* tree = build_case( calls, c, called );
+    appendStatement( buildReturnStmt( tree ), called->get_definition()->get_body() );
+
+    int expected_depth = 0;
+    while( (1 << expected_depth) < c.kept ){
+      expected_depth += 1;
+    }
+    int count = NodeQuery::querySubTree( tree, V_SgFunctionCallExp ).size();
+    bool form = depth( tree ) == expected_depth && count == c.kept - 1;
+    failures += form ? 0 : 1;
+    cout << c.name << " of " << c.operands.size() << ": " << count << " calls, depth " << depth( tree )
+         << (form ? "" : " (WRONG)") << ": " << tree->unparseToString() << endl;
+
+    SgFunctionDeclaration* expanded = function( global, "expanded_" + to_string( i ) );
+    SgExpression* expression = build_case( expressions, c, expanded );
+    appendStatement( buildReturnStmt( expression ), expanded->get_definition()->get_body() );
+    forms.push_back( expression->unparseToString() );
+  }
+
+  // Check the values in a program of their own
+  string check_name( "__minmax_check__.cpp" );
+  ofstream check( check_name.c_str(), ios::trunc | ios::out );
+  assert( check.is_open() );
+  check << "#include <algorithm>" << endl << "#include <cstdio>" << endl;
+  string parameters = "int a, int b, int c, int d, int e, int f, int g, int h";
+  for( vector<minmax_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    string reference = cases[i].operands[0];
+    for( vector<string>::size_type k = 1; k < cases[i].operands.size(); k += 1 ){
+      reference = "std::" + cases[i].name + "( " + reference + ", " + cases[i].operands[k] + " )";
+    }
+    check << "static int expanded_" << i << "( " << parameters << " ){ return " << forms[i] << "; }" << endl
+          << "static int reference_" << i << "( " << parameters << " ){ return " << reference << "; }" << endl;
+  }
+  check << "int main(){" << endl << "  int wrong = 0;" << endl
+        << "  for( int a = -9; a <= 9; a += 2 ) for( int b = -9; b <= 9; b += 3 ) for( int c = -9; c <= 9; c += 4 ){" << endl
+        << "    int d = a - b, e = b + c, f = 3 * a, g = -c, h = a * b;" << endl;
+  for( vector<minmax_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    check << "    if( expanded_" << i << "( a, b, c, d, e, f, g, h ) != reference_" << i << "( a, b, c, d, e, f, g, h ) ){ std::printf( \"case " << i << " wrong\\n\" ); wrong += 1; }" << endl;
+  }
+  check << "  }" << endl << "  return wrong;" << endl << "}" << endl;
+  check.close();
+
+  const char* cxx = getenv( "CXX" );
+  string compile = string( cxx != NULL ? cxx : "g++" ) + " -O2 -o __minmax_check__ " + check_name;
+  bool compiled = system( compile.c_str() ) == 0;
+  bool values = compiled && system( "./__minmax_check__" ) == 0;
+  failures += values ? 0 : 1;
+
+  // A nest whose bound is the min of N, M and K
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+  target_defn->append_statement( buildVariableDeclaration( SgName( "M" ), buildIntType(), NULL, target_defn ) );
+  target_defn->append_statement( buildVariableDeclaration( SgName( "K" ), buildIntType(), NULL, target_defn ) );
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), "[N,M,K]->{ S[i] : 0 <= i < N and i < M and i < K }", "{ S[i] -> [i] }" ) );
+  int walked_calls = 0, flat_calls = 0;
+  string walked = render( isl_ast.get(), target_defn, false, walked_calls );
+  string flattened = render( isl_ast.get(), target_defn, true, flat_calls );
+  bool same = walked == flattened && walked_calls == flat_calls;
+  failures += same ? 0 : 1;
+
+  cout << "values " << (compiled ? (values ? "identical" : "MISMATCH") : "NOT COMPILED")
+       << ", nest: flat_ir " << (same ? "identical" : "MISMATCH") << ", " << walked_calls << " calls" << endl;
+
+  return failures;
+}
@@ -0,0 +1,162 @@
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "parallel_loops.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Translates nests whose dependences leave the outer loop, the inner loop, or
+the inner tile loop parallel, with walker_options::omp_parallel, directly and
+through flat_ir, and checks that:
+  - both paths build the same code
+  - exactly one #pragma omp parallel for is built, right before the expected
+    loop
+  - compiled with $CXX (default g++) and -fopenmp, each translation computes
+    the same array as the serial one
+The runner also times each kernel on one thread and on all of them and prints
+the speedup; how well it scales depends on the machine, so it is not checked.
+The statement S is a macro updating A from B and from the element before it
+along the dependence.
+*/
+
+class omp_case {
+  public:
+    string name;
+    string schedule;
+    string dependences;
+    // Definition of the statement macro
+    string statement;
+    // Iterator of the loop expected to be parallelized
+    string parallel;
+};
+
+isl_ast_node* ast_from_strings( isl_ctx* ctx, string domain_str, string schedule_str, string dependences_str ){
+  parallel_loops loops( isl_union_map_read_from_str( ctx, dependences_str.c_str() ) );
+  return ast_from_strings( ctx, domain_str, schedule_str, loops.annotate( isl_ast_build_alloc( ctx ) ) );
+}
+
+// Returns the number of pragmas under root, and in loop the iterator of the
+// loop following the last one
+int check_pragmas( SgNode* root, string& loop ){
+  Rose_STL_Container<SgNode*> pragmas = NodeQuery::querySubTree( root, V_SgPragmaDeclaration );
+  for( Rose_STL_Container<SgNode*>::iterator it = pragmas.begin(); it != pragmas.end(); ++it ){
+    loop = "";
+    SgForStatement* next = isSgForStatement( getNextStatement( isSgStatement( *it ) ) );
+    if( next == NULL || next->get_init_stmt().empty() ){
+      continue;
+    }
+    SgVariableDeclaration* iterator = isSgVariableDeclaration( next->get_init_stmt().front() );
+    if( iterator != NULL ){
+      loop = getFirstInitializedName( iterator )->get_name().getString();
+    }
+  }
+  return pragmas.size();
+}
+
+string render( isl_ast_node* isl_ast, SgFunctionDefinition* target_defn, bool omp, bool flat_ir, int& pragmas, string& loop ){
+  SgBasicBlock* injection_site = buildBasicBlock();
+  target_defn->append_statement( injection_site );
+
+  walker_options options;
+  options.omp_parallel = omp;
+  options.canonical_loops = true;
+  options.hoist_invariants = true;
+  options.flat_ir = flat_ir;
+  options.intrinsics = intrinsic_inline;
+  SageTransformationWalker walker( isl_ast, injection_site, options );
+
+  pragmas = check_pragmas( injection_site, loop );
+  string code = injection_site->unparseToString();
+  removeStatement( injection_site );
+  deleteAST( injection_site );
+  return code;
+}
+
+int main( int argc, char** argv ){
+  SgProject* project = template_project( argv[0], "int main(){ }" );
+  SgFunctionDeclaration* target_decl = template_main( project );
+  SgFunctionDefinition* target_defn = target_decl->get_definition();
+  SgGlobal* global = getGlobalScope( target_decl );
+
+  // Symbolic constant used by the bounds
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+
+  string domain( "[N]->{ S[i,j] : 0 <= i < N and 0 <= j < N }" );
+  vector<omp_case> cases;
+  cases.push_back( omp_case{ "rows", "{ S[i,j] -> [i, j] }", "[N]->{ S[i,j] -> S[i,j+1] }",
+                             "#define S(i,j) A[(i) * N + (j)] = ((j) > 0 ? A[(i) * N + (j) - 1] : 0.0f) * 0.5f + B[(i) * N + (j)]\n", "c0" } );
+  cases.push_back( omp_case{ "columns", "{ S[i,j] -> [i, j] }", "[N]->{ S[i,j] -> S[i+1,j] }",
+                             "#define S(i,j) A[(i) * N + (j)] = ((i) > 0 ? A[((i) - 1) * N + (j)] : 0.0f) * 0.5f + B[(i) * N + (j)]\n", "c1" } );
+  cases.push_back( omp_case{ "tiled", "{ S[i,j] -> [floor(i/32), floor(j/32), i, j] }", "[N]->{ S[i,j] -> S[i+1,j] }",
+                             "#define S(i,j) A[(i) * N + (j)] = ((i) > 0 ? A[((i) - 1) * N + (j)] : 0.0f) * 0.5f + B[(i) * N + (j)]\n", "c1" } );
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  int failures = 0;
+
+  for( vector<omp_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    const omp_case& test = cases[i];
+    isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), domain, test.schedule, test.dependences ) );
+
+    int pragmas = 0, flat_pragmas = 0, unused = 0;
+    string loop, flat_loop, none;
+    string code = render( isl_ast.get(), target_defn, true, false, pragmas, loop );
+    string flattened = render( isl_ast.get(), target_defn, true, true, flat_pragmas, flat_loop );
+    string serial = render( isl_ast.get(), target_defn, false, false, unused, none );
+
+    bool same = code == flattened && pragmas == flat_pragmas && loop == flat_loop;
+    bool placed = pragmas == 1 && loop.compare( 0, test.parallel.size(), test.parallel ) == 0;
+
+    // Same results as the serial translation, and the speedup over one thread
+    string base = "__omp_" + test.name;
+    const string parameters( "int N, float* A, const float* B" );
+    ofstream runner( (base + "_run.cpp").c_str(), ios::trunc | ios::out );
+    runner << "#include <cstdio>" << endl << "#include <vector>" << endl << "#include <omp.h>" << endl
+           << definitions( global ) << test.statement
+           << kernel( "parallel", parameters, code ) << kernel( "serial", parameters, serial )
+           << "static double timed( int N, float* A, const float* B, int threads ){" << endl
+           << "  omp_set_num_threads( threads );" << endl
+           << "  double start = omp_get_wtime();" << endl
+           << "  for( int k = 0; k < 10; k += 1 ){ parallel( N, A, B ); }" << endl
+           << "  return omp_get_wtime() - start;" << endl
+           << "}" << endl
+           << "int main(){" << endl
+           << "  const int N = 2000;" << endl
+           << "  std::vector<float> A( N * N ), S( N * N ), B( N * N );" << endl
+           << "  for( int i = 0; i < N * N; i += 1 ){ B[i] = i % 5; }" << endl
+           << "  for( int n = 97; n <= N; n += N - 97 ){" << endl
+           << "    parallel( n, A.data(), B.data() );" << endl
+           << "    serial( n, S.data(), B.data() );" << endl
+           << "    for( int i = 0; i < n * n; i += 1 ){ if( A[i] != S[i] ){ std::printf( \"differs at %d of %d\\n\", i, n ); return 1; } }" << endl
+           << "  }" << endl
+           << "  int threads = omp_get_max_threads();" << endl
+           << "  double one = timed( N, A.data(), B.data(), 1 );" << endl
+           << "  double all = timed( N, A.data(), B.data(), threads );" << endl
+           << "  std::printf( \"  %.3fs on 1 thread, %.3fs on %d: %.2fx\\n\", one, all, threads, one / all );" << endl
+           << "  return 0;" << endl
+           << "}" << endl;
+    runner.close();
+    bool values = run( cxx() + " -O2 -fopenmp -o " + base + "_run " + base + "_run.cpp" ) == 0 && run( "./" + base + "_run" ) == 0;
+
+    failures += (same ? 0 : 1) + (placed ? 0 : 1) + (values ? 0 : 1);
+    cout << test.name << ": flat_ir " << (same ? "identical" : "MISMATCH")
+         << ", " << pragmas << " pragmas, on " << (loop.empty() ? "no loop" : loop) << (placed ? "" : " (UNEXPECTED)")
+         << ", values " << (values ? "identical" : "MISMATCH") << endl;
+    if( ! placed ){
+      cout << code << endl;
+    }
+  }
+
+  return failures;
+}
@@ -0,0 +1,147 @@
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "phase_profiler.hpp"
+#include "synthetic_ast.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Opens phases with phase_scope and checks that:
+  - nothing is recorded before start()
+  - nested phases record their depth, in the order they were opened
+  - a phase that spins records CPU time and no more CPU than wall time
+  - a phase that touches a large allocation records an RSS increase
+  - the library's own markers (synthetic_ast, translate) are recorded
+  - the Chrome trace holds one complete event per phase
+Then prints the summary table.
+*/
+
+volatile unsigned long sink = 0;
+
+void spin( unsigned long iterations ){
+  for( unsigned long i = 0; i < iterations; i += 1 ){
+    sink = sink + i;
+  }
+}
+
+int count_named( const vector<phase_record>& phases, const string& name ){
+  int count = 0;
+  for( vector<phase_record>::size_type i = 0; i < phases.size(); i += 1 ){
+    count += phases[i].name == name ? 1 : 0;
+  }
+  return count;
+}
+
+const phase_record* find_named( const vector<phase_record>& phases, const string& name ){
+  for( vector<phase_record>::size_type i = 0; i < phases.size(); i += 1 ){
+    if( phases[i].name == name ){
+      return &phases[i];
+    }
+  }
+  return NULL;
+}
+
+int check( bool passed, const string& what ){
+  cout << what << ": " << (passed ? "ok" : "FAILED") << endl;
+  return passed ? 0 : 1;
+}
+
+int main( int argc, char** argv ){
+  phase_profiler& profiler = phase_profiler::global();
+  int failures = 0;
+
+  {
+    phase_scope phase( "before start" );
+  }
+  failures += check( profiler.phases().empty(), "disabled profiler records nothing" );
+
+  profiler.start();
+
+  {
+    phase_scope outer( "outer" );
+    {
+      phase_scope phase( "spin" );
+      spin( 20000000 );
+    }
+    {
+      phase_scope phase( "allocate" );
+      // 64 MiB, written so the pages are resident
+      vector<char> buffer( 64 * 1024 * 1024 );
+      for( vector<char>::size_type i = 0; i < buffer.size(); i += 4096 ){
+        buffer[i] = (char) i;
+      }
+      sink = sink + buffer[4096];
+      phase_scope inner( "allocated" );
+    }
+  }
+
+  const vector<phase_record>& phases = profiler.phases();
+  failures += check( phases.size() == 4
+                     && phases[0].name == "outer" && phases[0].depth == 0
+                     && phases[1].name == "spin" && phases[1].depth == 1
+                     && phases[2].name == "allocate" && phases[2].depth == 1
+                     && phases[3].name == "allocated" && phases[3].depth == 2,
+                     "phases nest in order" );
+
+  const phase_record* spinning = find_named( phases, "spin" );
+  failures += check( spinning != NULL && spinning->cpu_ns > 0 && spinning->wall_ns > 0, "spin records CPU time" );
+  // Allow for clocks of different resolution
+  failures += check( spinning != NULL && spinning->cpu_ns <= spinning->wall_ns + 10000000, "CPU time within wall time" );
+  failures += check( phases[0].wall_ns >= phases[1].wall_ns + phases[2].wall_ns, "outer phase spans the inner ones" );
+
+  const phase_record* allocating = find_named( phases, "allocate" );
+  failures += check( phase_profiler::resident_kb() == 0
+                     || (allocating != NULL && phases[3].rss_start_kb - allocating->rss_start_kb >= 32 * 1024),
+                     "allocation shows in RSS" );
+
+  // The library's markers
+  {
+    SgProject* project = template_project( argv[0], "#include <iostream>\nusing namespace std;\nint main(){ }" );
+    SgFunctionDefinition* target_defn = template_main( project )->get_definition();
+
+    synthetic_options options;
+    options.parametric = false;
+    isl_ctx_handle ctx( isl_ctx_alloc() );
+
+    phase_scope phase( "translate" );
+    isl_ast_node_handle isl_ast( synthetic_ast( ctx.get(), options ) );
+    SgBasicBlock* injection_site = buildBasicBlock();
+    target_defn->append_statement( injection_site );
+    SageTransformationWalker walker( (walker_options()) );
+    walker.translate( isl_ast.get(), injection_site );
+  }
+
+  failures += check( count_named( phases, "synthetic_ast" ) == 1
+                     && count_named( phases, "SageTransformationWalker::translate" ) == 1
+                     && find_named( phases, "SageTransformationWalker::translate" )->depth == 1,
+                     "library phases recorded" );
+
+  profiler.stop();
+
+  ostringstream trace;
+  failures += check( profiler.write_chrome_trace( trace ), "trace written" );
+  string json = trace.str();
+  int events = 0;
+  for( string::size_type at = json.find( "\"ph\":\"X\"" ); at != string::npos; at = json.find( "\"ph\":\"X\"", at + 1 ) ){
+    events += 1;
+  }
+  failures += check( json.compare( 0, strlen( "{\"traceEvents\":[" ), "{\"traceEvents\":[" ) == 0
+                     && events == (int) phases.size(),
+                     "one trace event per phase" );
+
+  profiler.write_summary( cout );
+  return failures;
+}
@@ -0,0 +1,161 @@
+#include <cassert>
+#include <cstdlib>
+#include <chrono>
+#include <utility>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "PrintNodeWalker.hpp"
+#include "PrintNodeStreamWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+/*
+Dumps the same ISL ASTs with PrintNodeWalker and PrintNodeStreamWalker, checks
+that the text dumps are identical and that the JSON dump is balanced, that
+both walkers dump the same in iterative mode, and reports how long each took.
+The deep case is a loop nest as deep as the first argument (default 64).
+Last, dumps a loop bounded by a sum of 256 parameters, an expression as deep,
+and checks that iterative mode takes no more stack than for a sum of 2, while
+the recursive dumps take more.
+*/
+
+// [N]->{ S[i0,...,iD-1] : 0 <= ik < N } scheduled in order, i.e. a D deep nest
+pair<string,string> deep_nest( int nest_depth ){
+  string iterators;
+  string constraints;
+  for( int i = 0; i < nest_depth; i += 1 ){
+    string iterator = string("i") + to_string(i);
+    iterators += (i == 0 ? "" : ",") + iterator;
+    constraints += (i == 0 ? "" : " and ") + string("0 <= ") + iterator + " < N";
+  }
+
+  return make_pair( string("[N]->{ S[") + iterators + "] : " + constraints + " }",
+                    string("{ S[") + iterators + "] -> [" + iterators + "] }" );
+}
+
+// Brackets and braces outside of strings close in order
+bool balanced( const string& json ){
+  vector<char> open;
+  bool in_string = false;
+  for( string::size_type i = 0; i < json.size(); i += 1 ){
+    char c = json[i];
+    if( in_string ){
+      if( c == '\\' ){
+        i += 1;
+      } else if( c == '"' ){
+        in_string = false;
+      }
+    }
+    else if( c == '"' ){
+      in_string = true;
+    }
+    else if( c == '{' || c == '[' ){
+      open.push_back( c );
+    }
+    else if( c == '}' || c == ']' ){
+      if( open.empty() || open.back() != (c == '}' ? '{' : '[') ){
+        return false;
+      }
+      open.pop_back();
+    }
+  }
+  return open.empty() && !in_string;
+}
+
+// Loop bounded by p0 + ... + pn-1
+isl_ast_node* sum_loop( isl_ctx* ctx, int n ){
+  string parameters;
+  string sum;
+  for( int i = 0; i < n; i += 1 ){
+    string parameter = "p" + to_string( i );
+    parameters += (i == 0 ? "" : ",") + parameter;
+    sum += (i == 0 ? "" : " + ") + parameter;
+  }
+  return ast_from_strings( ctx, "[" + parameters + "]->{ S[i] : 0 <= i < " + sum + " }", "{ S[i] -> [i] }" );
+}
+
+// Stack the text dumps of both walkers and the JSON dump of isl_ast take
+size_t dump_stack_use( isl_ast_node* isl_ast, bool iterative, string& dump ){
+  return stack_use( [&](){
+    PrintNodeWalker walker( iterative );
+    dump = walker.visit( isl_ast );
+    string streamed;
+    PrintNodeStreamWalker stream_walker( streamed, print_text, iterative );
+    stream_walker.visit( isl_ast );
+    PrintNodeStreamWalker json_walker( streamed, print_json, iterative );
+    json_walker.visit( isl_ast );
+  } );
+}
+
+int main( int argc, char** argv ){
+  int nest_depth = (argc > 1) ? atoi( argv[1] ) : 64;
+
+  vector<string> names = { "shallow", "tiled", string("deep ") + to_string(nest_depth) };
+  vector< pair<string,string> > tests;
+  tests.push_back( make_pair( string("[N]->{ S[i] : 0 <= i < N; T[i] : 0 <= i < N and i mod 3 = 0 }"),
+                              string("{ S[i] -> [i,0]; T[i] -> [i,1] }") ) );
+  tests.push_back( make_pair( string("[N,M]->{ S[i,j] : 0 <= i < N and 0 <= j < M }"),
+                              string("{ S[i,j] -> [floor(i/32), floor(j/32), floor(i/4), floor(j/4), i, j] }") ) );
+  tests.push_back( deep_nest( nest_depth ) );
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  int failures = 0;
+
+  for( vector<string>::size_type i = 0; i < tests.size(); i += 1 ){
+    isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), tests[i].first, tests[i].second ) );
+
+    auto start = chrono::steady_clock::now();
+    PrintNodeWalker walker;
+    string concatenated = walker.visit( isl_ast.get() );
+    auto middle = chrono::steady_clock::now();
+    string streamed;
+    PrintNodeStreamWalker stream_walker( streamed );
+    int count = stream_walker.visit( isl_ast.get() );
+    auto stop = chrono::steady_clock::now();
+
+    string json;
+    PrintNodeStreamWalker json_walker( json, print_json );
+    json_walker.visit( isl_ast.get() );
+
+    PrintNodeWalker iterative_walker( true );
+    string iterated = iterative_walker.visit( isl_ast.get() );
+    string iterated_stream, iterated_json;
+    PrintNodeStreamWalker iterative_stream_walker( iterated_stream, print_text, true );
+    PrintNodeStreamWalker iterative_json_walker( iterated_json, print_json, true );
+    bool counted = iterative_stream_walker.visit( isl_ast.get() ) == count && iterative_json_walker.visit( isl_ast.get() ) == count;
+
+    bool same = concatenated == streamed;
+    bool json_ok = balanced( json );
+    bool iterative = iterated == concatenated && iterated_stream == streamed && iterated_json == json && counted;
+    failures += (same ? 0 : 1) + (json_ok ? 0 : 1) + (iterative ? 0 : 1);
+
+    cout << names[i] << " (" << streamed.size() << " bytes)" << endl
+         << "  PrintNodeWalker:       " << chrono::duration<double>( middle - start ).count() << "s" << endl
+         << "  PrintNodeStreamWalker: " << chrono::duration<double>( stop - middle ).count() << "s" << endl
+         << "  text " << (same ? "identical" : "MISMATCH") << ", json " << (json_ok ? "balanced" : "UNBALANCED")
+         << ", iterative " << (iterative ? "identical" : "MISMATCH") << endl;
+  }
+
+  // Iterative dumps take the same stack however deep the sum is
+  isl_ast_node_handle shallow_sum( sum_loop( ctx.get(), 2 ) );
+  isl_ast_node_handle deep_sum( sum_loop( ctx.get(), 256 ) );
+  string shallow_dump, deep_dump, recursive_dump;
+  size_t shallow = dump_stack_use( shallow_sum.get(), true, shallow_dump );
+  size_t deep = dump_stack_use( deep_sum.get(), true, deep_dump );
+  size_t recursive_shallow = dump_stack_use( shallow_sum.get(), false, shallow_dump );
+  size_t recursive = dump_stack_use( deep_sum.get(), false, recursive_dump );
+  const size_t slack = 16 << 10;
+  bool same = deep_dump == recursive_dump;
+  bool flat = deep <= shallow + slack && recursive > recursive_shallow + slack;
+  failures += (same ? 0 : 1) + (flat ? 0 : 1);
+  cout << "sum of 256: text " << (same ? "identical" : "MISMATCH")
+       << ", " << deep << " bytes of stack iterative (" << shallow << " for 2), "
+       << recursive << " recursive (" << recursive_shallow << " for 2)" << (flat ? "" : " (UNEXPECTED)") << endl;
+
+  return failures;
+}
@@ -9,6 +9,7 @@
 #include "all_isl.hpp"
 #include "SageTransformationWalker.hpp"
 #include "PrintNodeWalker.hpp"
+#include "test_util.hpp"
 
 using namespace std;
 using namespace SageBuilder;
@@ -44,9 +45,9 @@ isl_union_map* map_from_maps( isl_ctx* ctx, vector<string> maps ){
 
 void example( char** argv, vector<string> domains, vector<string> maps ){
   // Produce ISL AST
+  isl_ctx* ctx = isl_ctx_alloc();
   isl_ast_node* isl_ast;
   {
-    isl_ctx* ctx = isl_ctx_alloc();
     isl_union_set* domain = domain_from_domains(ctx, domains );
     isl_union_map* schedule = map_from_maps(ctx, maps );
     isl_ast_build* build;
@@ -64,9 +65,6 @@ void example( char** argv, vector<string> domains, vector<string> maps ){
     p = isl_printer_print_ast_node(p, isl_ast);
     cout << endl;
     isl_printer_free(p);
-
-    // isl_ast_node_free(tree);
-    // isl_ctx_free(ctx);
   }
 
   {
@@ -82,27 +80,12 @@ void example( char** argv, vector<string> domains, vector<string> maps ){
     // Template file source
     //string template_code( "#include <iostream>\nusing namespace std;\nint main(){\n int A,B,C,D,E,F,G,H,I,J,K,L,M,N,O,P,Q,R,S,T,U,V,W,X,Y,Z,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,q,r,s,t,u,v,w,x,y,z;\nA = (B = (C = (D = (E = (F = (G = (H = (I = (J = (K = (L = (M = (N = (O = (P = (Q = (R = (S = (T = (U = (V = (W = (X = (Y = (Z = (a = (b = (c = (d = (e = (f = (g = (h = (i = (j = (k = (l = (m = (n = (o = (p = (q = (r = (s = (t = (u = (v = (w = (x = (y = (z = 1234)))))))))))))))))))))))))))))))))))))))))))))))))));\n }");
     string template_code( "#include <iostream>\nusing namespace std;\nint main(){ }");
-    std::string template_file_name( "__template_file__.cpp" );
-
-    // Write out template file.
-    ofstream template_file;
-    template_file.open( template_file_name.c_str(), ios::trunc | ios::out );
-    assert( template_file.is_open() );
-    template_file << template_code << endl;
-    template_file.close();
-
-    // Create arguments to frontend to parse template file
-    vector<string> project_argv;
-    // Apparently it is necessary to have the executable name in the arguments.
-    project_argv.push_back( string(argv[0]) );
-    project_argv.push_back( template_file_name );
-
     if( verbose ) cout << "Calling Frontend" << endl;
-    SgProject* project = frontend( project_argv );
+    SgProject* project = template_project( argv[0], template_code );
 
     // Find the existing main() definition node in the tree.
     if( verbose ) cout << "Finding target function definition" << endl;
-    SgFunctionDefinition* target_defn = findFunctionDeclaration( project, "main", NULL, true)->get_definition();
+    SgFunctionDefinition* target_defn = template_main( project )->get_definition();
 
     // Run ISL -> Sage walker over ISL tree, rendering it into Sage,
     if( verbose ) cout << "Calling SageTransformationWalker" << endl;
@@ -137,6 +120,8 @@ void example( char** argv, vector<string> domains, vector<string> maps ){
     }
   }
 
+  isl_ast_node_free( isl_ast );
+  isl_ctx_free( ctx );
 }
 
 
@@ -7,6 +7,7 @@
 #include <iostream>
 
 #include "rose.h"
+#include "test_util.hpp"
 
 using namespace std;
 using namespace SageBuilder;
@@ -16,27 +17,13 @@ string AST_To_File( char* argv[], SgStatement* ( *producer )( ) ) {
   cout << "Writing template file" << endl;
   // Template file source
   string template_code( "#include <iostream>\nusing namespace std;\nint main(){ }" );
-  std::string template_file_name( "__template_file__.cpp" );
-
-  // Write out template file.
-  ofstream template_file;
-  template_file.open( template_file_name.c_str( ), ios::trunc | ios::out );
-  assert( template_file.is_open( ) );
-  template_file << template_code << endl;
-  template_file.close( );
-
-  // Create arguments to frontend to parse template file
-  vector< string > project_argv;
-  // Apparently it is necessary to have the executable name in the arguments.
-  project_argv.push_back( string( argv[0] ) );
-  project_argv.push_back( template_file_name );
 
   cout << "Calling Frontend" << endl;
-  SgProject* project = frontend( project_argv );
+  SgProject* project = template_project( argv[0], template_code );
 
   // Find the existing main() definition node in the tree.
   cout << "Finding target function definition" << endl;
-  SgFunctionDefinition* target_defn = findFunctionDeclaration( project, "main", NULL, true )->get_definition( );
+  SgFunctionDefinition* target_defn = template_main( project )->get_definition( );
 
   // Build AST
   cout << "Calling producer" << endl;
@@ -0,0 +1,117 @@
+#include <cassert>
+#include <cstdlib>
+#include <cstdio>
+#include <chrono>
+#include <utility>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "isl_ast_serialize.hpp"
+#include "PrintNodeStreamWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+/*
+Round trips ISL ASTs through isl_ast_serialize and isl_ast_deserialize, from a
+string and from a memory mapped file, and checks that the reloaded tree dumps
+and prints as C exactly like the original. Every truncation of an encoding
+must be rejected. Reports the encoded size and how long codegen took against
+loading the encoding.
+The deep case is a loop nest as deep as the first argument (default 16).
+*/
+
+// [N]->{ S[i0,...,iD-1] : 0 <= ik < N } scheduled in order, i.e. a D deep nest
+pair<string,string> deep_nest( int nest_depth ){
+  string iterators;
+  string constraints;
+  for( int i = 0; i < nest_depth; i += 1 ){
+    string iterator = string("i") + to_string(i);
+    iterators += (i == 0 ? "" : ",") + iterator;
+    constraints += (i == 0 ? "" : " and ") + string("0 <= ") + iterator + " < N";
+  }
+
+  return make_pair( string("[N]->{ S[") + iterators + "] : " + constraints + " }",
+                    string("{ S[") + iterators + "] -> [" + iterators + "] }" );
+}
+
+string dump( isl_ast_node* isl_ast ){
+  string text;
+  PrintNodeStreamWalker walker( text );
+  walker.visit( isl_ast );
+  return text;
+}
+
+string print_c( isl_ast_node* isl_ast ){
+  isl_printer* printer = isl_printer_to_str( isl_ast_node_get_ctx( isl_ast ) );
+  printer = isl_printer_set_output_format( printer, ISL_FORMAT_C );
+  printer = isl_printer_print_ast_node( printer, isl_ast );
+  char* c_str = isl_printer_get_str( printer );
+  string code( c_str );
+  free( c_str );
+  isl_printer_free( printer );
+  return code;
+}
+
+int main( int argc, char** argv ){
+  int nest_depth = (argc > 1) ? atoi( argv[1] ) : 16;
+
+  vector<string> names = { "shallow", "tiled", "degenerate", "huge bound", string("deep ") + to_string(nest_depth) };
+  vector< pair<string,string> > tests;
+  tests.push_back( make_pair( string("[N]->{ S[i] : 0 <= i < N; T[i] : 0 <= i < N and i mod 3 = 0 }"),
+                              string("{ S[i] -> [i,0]; T[i] -> [i,1] }") ) );
+  tests.push_back( make_pair( string("[N,M]->{ S[i,j] : 0 <= i < N and 0 <= j < M }"),
+                              string("{ S[i,j] -> [floor(i/32), floor(j/32), floor(i/4), floor(j/4), i, j] }") ) );
+  tests.push_back( make_pair( string("[N]->{ S[i,j] : 0 <= i < N and j = 7; T[i] : i = -3 }"),
+                              string("{ S[i,j] -> [0,i,j]; T[i] -> [1,i,0] }") ) );
+  tests.push_back( make_pair( string("{ S[i] : -100000000000000000000 <= i < 100000000000000000000 }"),
+                              string("{ S[i] -> [i] }") ) );
+  tests.push_back( deep_nest( nest_depth ) );
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  int failures = 0;
+  string file_name( "__serialize_test__.islast" );
+
+  for( vector<string>::size_type i = 0; i < tests.size(); i += 1 ){
+    auto start = chrono::steady_clock::now();
+    isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), tests[i].first, tests[i].second ) );
+    auto generated = chrono::steady_clock::now();
+
+    string encoded;
+    bool written = isl_ast_serialize( isl_ast.get(), encoded );
+    auto serialized = chrono::steady_clock::now();
+    isl_ast_node_handle loaded( isl_ast_deserialize( ctx.get(), encoded.data(), encoded.size() ) );
+    auto stop = chrono::steady_clock::now();
+
+    bool same = written && loaded.get() != NULL
+             && dump( isl_ast.get() ) == dump( loaded.get() )
+             && print_c( isl_ast.get() ) == print_c( loaded.get() );
+
+    bool mapped = isl_ast_serialize_file( isl_ast.get(), file_name );
+    isl_ast_node_handle from_file( isl_ast_deserialize_file( ctx.get(), file_name ) );
+    mapped = mapped && from_file.get() != NULL && print_c( from_file.get() ) == print_c( isl_ast.get() );
+
+    bool rejected = true;
+    for( string::size_type length = 0; length < encoded.size() && rejected; length += 1 ){
+      isl_ast_node* truncated = isl_ast_deserialize( ctx.get(), encoded.data(), length );
+      rejected = truncated == NULL;
+      isl_ast_node_free( truncated );
+    }
+
+    failures += (same ? 0 : 1) + (mapped ? 0 : 1) + (rejected ? 0 : 1);
+
+    cout << names[i] << " (" << encoded.size() << " bytes)" << endl
+         << "  codegen:     " << chrono::duration<double>( generated - start ).count() << "s" << endl
+         << "  serialize:   " << chrono::duration<double>( serialized - generated ).count() << "s" << endl
+         << "  deserialize: " << chrono::duration<double>( stop - serialized ).count() << "s" << endl
+         << "  round trip " << (same ? "identical" : "MISMATCH")
+         << ", file " << (mapped ? "identical" : "MISMATCH")
+         << ", truncations " << (rejected ? "rejected" : "ACCEPTED") << endl;
+  }
+
+  remove( file_name.c_str() );
+  return failures;
+}
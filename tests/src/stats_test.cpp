@@ -0,0 +1,113 @@
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <utility>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "walker_stats.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Translates ISL ASTs with walker_options::collect_stats, recursively and
+iteratively, and checks that:
+  - both drivers count the same calls and Sage nodes per visit method
+  - every Sage node of the translation is counted exactly once
+  - exclusive time never exceeds inclusive time
+  - identifier references are either symbol cache hits or misses
+Then prints the JSON dump of the last translation.
+*/
+
+unsigned long sage_subtree_size( SgNode* node ){
+  unsigned long size = 1;
+  for( size_t i = 0; i < node->get_numberOfTraversalSuccessors(); i += 1 ){
+    SgNode* successor = node->get_traversalSuccessorByIndex( i );
+    if( successor != NULL ){
+      size += sage_subtree_size( successor );
+    }
+  }
+  return size;
+}
+
+int main( int argc, char** argv ){
+  vector<string> names = { "fused", "tiled", "guarded" };
+  vector< pair<string,string> > tests;
+  tests.push_back( make_pair( string("[N,M]->{ S1[i,j] : 0 <= i < N and 0 <= j < M; S2[i,j] : 0 <= i < N and 0 <= j < M }"),
+                              string("{ S1[i,j] -> [0,i,j,0]; S2[i,j] -> [1,i,j,0] }") ) );
+  tests.push_back( make_pair( string("[N,M]->{ S[i,j] : 0 <= i < N and 0 <= j < M }"),
+                              string("{ S[i,j] -> [floor(i/32), floor(j/32), floor(i/4), floor(j/4), i, j] }") ) );
+  tests.push_back( make_pair( string("[N]->{ S[i] : 0 <= i < N; T[i] : 0 <= i < N and i mod 3 = 0 }"),
+                              string("{ S[i] -> [i,0]; T[i] -> [i,1] }") ) );
+
+  SgProject* project = template_project( argv[0], "#include <iostream>\nusing namespace std;\nint main(){ }" );
+  SgFunctionDefinition* target_defn = template_main( project )->get_definition();
+
+  // Symbolic constants used by the bounds
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+  target_defn->append_statement( buildVariableDeclaration( SgName( "M" ), buildIntType(), NULL, target_defn ) );
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  int failures = 0;
+  string last_json;
+
+  for( vector<string>::size_type i = 0; i < tests.size(); i += 1 ){
+    isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), tests[i].first, tests[i].second ) );
+
+    walker_options recursive_options;
+    recursive_options.collect_stats = true;
+    walker_options iterative_options = recursive_options;
+    iterative_options.iterative = true;
+
+    SageTransformationWalker recursive( recursive_options );
+    SageTransformationWalker iterative( iterative_options );
+
+    SgBasicBlock* injection_site = buildBasicBlock();
+    target_defn->append_statement( injection_site );
+    SgStatement* translated = recursive.translate( isl_ast.get(), injection_site );
+    iterative.translate( isl_ast.get(), injection_site );
+
+    const walker_stats& stats = recursive.getStats();
+    const walker_stats& iterative_stats = iterative.getStats();
+
+    bool same = true;
+    bool times_ok = true;
+    unsigned long counted = 0;
+    for( int m = 0; m < visit_methods; m += 1 ){
+      const visit_counter& counter = stats.counters[m];
+      const visit_counter& other = iterative_stats.counters[m];
+      same = same && counter.calls == other.calls && counter.sage_nodes == other.sage_nodes;
+      times_ok = times_ok && counter.exclusive_ns <= counter.inclusive_ns;
+      counted += counter.sage_nodes;
+    }
+
+    unsigned long references = stats.counters[stats_expr_id].calls;
+    bool symbols_ok = stats.symbol_hits + stats.symbol_misses == references
+                   && iterative_stats.symbol_hits == stats.symbol_hits;
+    bool nodes_ok = counted == sage_subtree_size( translated );
+
+    failures += (same ? 0 : 1) + (times_ok ? 0 : 1) + (symbols_ok ? 0 : 1) + (nodes_ok ? 0 : 1);
+
+    cout << names[i] << ": " << counted << " Sage nodes, "
+         << stats.symbol_hits << " symbol hits, " << stats.symbol_misses << " misses" << endl
+         << "  drivers " << (same ? "agree" : "DISAGREE")
+         << ", times " << (times_ok ? "ok" : "INCONSISTENT")
+         << ", symbols " << (symbols_ok ? "ok" : "MISCOUNTED")
+         << ", nodes " << (nodes_ok ? "ok" : "MISCOUNTED") << endl;
+
+    last_json = stats.to_json();
+    removeStatement( injection_site );
+    deleteAST( injection_site );
+  }
+
+  cout << last_json;
+  return failures;
+}
@@ -0,0 +1,166 @@
+#include <cassert>
+#include <cstdlib>
+#include <map>
+#include <utility>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "isl_id_map.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Checks isl_id_map against std::map under a random mix of inserts, lookups and
+erases, checks that SageTransformationWalker finds the free identifiers of an
+ISL AST (parameters, but not loop iterators), and that translating with the
+free identifier pre-pass produces the same code as without it.
+Then reuses one walker across many roots, including sibling loops that share
+iterator names, checking that its output matches a fresh walker's and that
+its symbol table is empty after every translation.
+*/
+
+// Exposes the walker's free identifier collection and symbol table size
+class SymbolProbe : public SageTransformationWalker {
+  public:
+    using SageTransformationWalker::collect_free_ids;
+
+    SymbolProbe( const walker_options& options ): SageTransformationWalker( options ) {}
+
+    size_t symbols_held(){
+      return this->symbol_cache.size() + this->symbol_undo.size() + this->symbol_frames.size();
+    }
+};
+
+int check_id_map( isl_ctx* ctx ){
+  vector<isl_id_handle> ids;
+  for( int i = 0; i < 500; i += 1 ){
+    ids.push_back( isl_id_handle( isl_id_alloc( ctx, (string("id") + to_string(i)).c_str(), NULL ) ) );
+  }
+
+  // Interned: same name, same object
+  isl_id_handle again( isl_id_alloc( ctx, "id7", NULL ) );
+  if( again.get() != ids[7].get() ){
+    cout << "isl_id not interned" << endl;
+    return 1;
+  }
+
+  isl_id_map<int> map;
+  std::map<isl_id*,int> reference;
+  srand( 1 );
+  for( int step = 0; step < 100000; step += 1 ){
+    isl_id* key = ids[ rand() % ids.size() ].get();
+    switch( rand() % 3 ){
+      case 0:
+        map[key] = step;
+        reference[key] = step;
+        break;
+      case 1:
+        if( map.erase( key ) != (reference.erase( key ) == 1) ){
+          cout << "erase mismatch at step " << step << endl;
+          return 1;
+        }
+        break;
+      default: {
+        int* found = map.find( key );
+        std::map<isl_id*,int>::iterator expected = reference.find( key );
+        if( (found == NULL) != (expected == reference.end()) || (found != NULL && *found != expected->second) ){
+          cout << "find mismatch at step " << step << endl;
+          return 1;
+        }
+      }
+    }
+    if( map.size() != reference.size() ){
+      cout << "size mismatch at step " << step << endl;
+      return 1;
+    }
+  }
+
+  cout << "isl_id_map: ok" << endl;
+  return 0;
+}
+
+int main( int argc, char** argv ){
+  SgProject* project = template_project( argv[0], "#include <iostream>\nusing namespace std;\nint main(){ }" );
+  SgFunctionDefinition* target_defn = template_main( project )->get_definition();
+
+  // Symbolic constants used by the bounds
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+  target_defn->append_statement( buildVariableDeclaration( SgName( "M" ), buildIntType(), NULL, target_defn ) );
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  int failures = check_id_map( ctx.get() );
+
+  // Tiled nest: iterators c0..c3 are bound, N and M are free
+  isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), "[N,M]->{ S[i,j] : 0 <= i < N and 0 <= j < M }",
+                                                 "{ S[i,j] -> [floor(i/32), floor(j/32), i, j] }" ) );
+
+  vector<isl_id*> free_ids;
+  SymbolProbe::collect_free_ids( isl_ast.get(), free_ids );
+  string names;
+  for( vector<isl_id*>::iterator it = free_ids.begin(); it != free_ids.end(); ++it ){
+    names += string( names.empty() ? "" : " " ) + isl_id_get_name( *it );
+  }
+  bool free_ok = names == "N M";
+  failures += free_ok ? 0 : 1;
+  cout << "free identifiers: " << names << (free_ok ? "" : " (expected N M)") << endl;
+
+  SgBasicBlock* plain_site = buildBasicBlock();
+  target_defn->append_statement( plain_site );
+  SageTransformationWalker plain( isl_ast.get(), plain_site );
+
+  walker_options options;
+  options.resolve_free_ids = true;
+  SgBasicBlock* resolved_site = buildBasicBlock();
+  target_defn->append_statement( resolved_site );
+  SageTransformationWalker resolved( isl_ast.get(), resolved_site, options );
+
+  bool same = plain_site->unparseToString() == resolved_site->unparseToString();
+  failures += same ? 0 : 1;
+  cout << "pre-resolved translation: " << (same ? "identical" : "MISMATCH") << endl;
+
+  // One walker, many roots
+  vector< pair<string,string> > roots;
+  roots.push_back( make_pair( string("[N,M]->{ S1[i,j] : 0 <= i < N and 0 <= j < M; S2[i,j] : 0 <= i < N and 0 <= j < M }"),
+                              string("{ S1[i,j] -> [0,i,j,0]; S2[i,j] -> [1,i,j,0] }") ) );
+  roots.push_back( make_pair( string("[N]->{ S[i] : 0 <= i < N; T[i] : 0 <= i < N and i mod 3 = 0 }"),
+                              string("{ S[i] -> [i,0]; T[i] -> [i,1] }") ) );
+  roots.push_back( make_pair( string("[N,M]->{ S[i,j] : 0 <= i < N and 0 <= j < M }"),
+                              string("{ S[i,j] -> [floor(i/32), floor(j/32), i, j] }") ) );
+
+  walker_options reused_options;
+  SymbolProbe reused( reused_options );
+  int reuse_failures = 0;
+  for( int round = 0; round < 100; round += 1 ){
+    pair<string,string>& root = roots[ round % roots.size() ];
+    isl_ast_node_handle ast( ast_from_strings( ctx.get(), root.first, root.second ) );
+
+    SgBasicBlock* fresh_site = buildBasicBlock();
+    target_defn->append_statement( fresh_site );
+    SageTransformationWalker fresh( ast.get(), fresh_site );
+
+    SgBasicBlock* reused_site = buildBasicBlock();
+    target_defn->append_statement( reused_site );
+    reused.translate( ast.get(), reused_site );
+
+    if( fresh_site->unparseToString() != reused_site->unparseToString() || reused.symbols_held() != 0 ){
+      reuse_failures += 1;
+    }
+
+    removeStatement( fresh_site );
+    deleteAST( fresh_site );
+    removeStatement( reused_site );
+    deleteAST( reused_site );
+  }
+  failures += reuse_failures;
+  cout << "reused walker: " << (reuse_failures == 0 ? "ok" : "FAILED") << endl;
+
+  return failures;
+}
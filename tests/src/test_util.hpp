@@ -0,0 +1,183 @@
+/*! ****************************************************************************
+\file test_util.hpp
+
+\brief
+Scaffolding shared by the tests: ISL ASTs built from domain and schedule
+strings, the Sage project of a template file whose main() the translations
+are put in, the programs that compile translations with $CXX (default g++)
+and check they compute what a reference translation does, and the stack a
+walk takes.
+*******************************************************************************/
+
+#ifndef TEST_UTIL_HPP
+#define TEST_UTIL_HPP
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#include "rose.h"
+#include "all_isl.hpp"
+
+// The file template_project() writes and parses
+const std::string template_file_name( "__template_file__.cpp" );
+
+// AST of schedule_str over domain_str, built with build, which is freed
+inline isl_ast_node* ast_from_strings( isl_ctx* ctx, const std::string& domain_str, const std::string& schedule_str, isl_ast_build* build ){
+  isl_union_set* domain = isl_union_set_read_from_str( ctx, domain_str.c_str() );
+  isl_union_map* schedule = isl_union_map_read_from_str( ctx, schedule_str.c_str() );
+  schedule = isl_union_map_intersect_domain( schedule, domain );
+
+  isl_ast_node* isl_ast = isl_ast_build_node_from_schedule_map( build, schedule );
+  isl_ast_build_free( build );
+
+  return isl_ast;
+}
+
+inline isl_ast_node* ast_from_strings( isl_ctx* ctx, const std::string& domain_str, const std::string& schedule_str ){
+  return ast_from_strings( ctx, domain_str, schedule_str, isl_ast_build_alloc( ctx ) );
+}
+
+// Writes template_code out as template_file_name and parses it; argv0 is
+// the test's executable name
+inline SgProject* template_project( const char* argv0, const std::string& template_code ){
+  // Write out template file.
+  std::ofstream template_file;
+  template_file.open( template_file_name.c_str(), std::ios::trunc | std::ios::out );
+  assert( template_file.is_open() );
+  template_file << template_code << std::endl;
+  template_file.close();
+
+  // Create arguments to frontend to parse template file
+  std::vector<std::string> project_argv;
+  // Apparently it is necessary to have the executable name in the arguments.
+  project_argv.push_back( std::string( argv0 ) );
+  project_argv.push_back( template_file_name );
+
+  return frontend( project_argv );
+}
+
+// main() of a template project
+inline SgFunctionDeclaration* template_main( SgProject* project ){
+  SgFunctionDeclaration* main_decl = SageInterface::findFunctionDeclaration( project, "main", NULL, true );
+  assert( main_decl != NULL );
+  return main_decl;
+}
+
+// Runs command in the shell, echoing it first, and returns its status
+inline int run( const std::string& command ){
+  std::cout << "  " << command << std::endl;
+  return std::system( command.c_str() );
+}
+
+// The compiler the tests build programs with
+inline std::string cxx(){
+  const char* cxx_env = std::getenv( "CXX" );
+  return (cxx_env != NULL) ? cxx_env : "g++";
+}
+
+// The isl_sage_* definitions added to global
+inline std::string definitions( SgGlobal* global ){
+  std::string code;
+  SgDeclarationStatementPtrList& declarations = global->get_declarations();
+  for( SgDeclarationStatementPtrList::iterator it = declarations.begin(); it != declarations.end(); ++it ){
+    SgFunctionDeclaration* function = isSgFunctionDeclaration( *it );
+    if( function != NULL && function->get_name().getString().compare( 0, 9, "isl_sage_" ) == 0 ){
+      code += function->unparseToString() + "\n";
+    }
+  }
+  return code;
+}
+
+// A function name( parameters ) whose body is the translation code
+inline std::string kernel( const std::string& name, const std::string& parameters, const std::string& code ){
+  return "void " + name + "( " + parameters + " )\n" + code + "\n";
+}
+
+// Start routine of stack_use()'s thread: calls the std::function body is
+inline void* call_function( void* body ){
+  (*static_cast<std::function<void()>*>( body ))();
+  return NULL;
+}
+
+// Bytes of stack body takes: it runs in a thread whose stack is filled with
+// a pattern first, and the bytes no longer holding it are counted from the
+// low end, as the stack grows down
+inline std::size_t stack_use( std::function<void()> body ){
+  const std::size_t size = 16 << 20;
+  const unsigned char pattern = 0xa5;
+  void* stack = NULL;
+  int status = posix_memalign( &stack, 4096, size );
+  assert( status == 0 );
+  std::memset( stack, pattern, size );
+
+  pthread_attr_t attributes;
+  pthread_attr_init( &attributes );
+  pthread_attr_setstack( &attributes, stack, size );
+  pthread_t thread;
+  status = pthread_create( &thread, &attributes, call_function, &body );
+  assert( status == 0 );
+  pthread_join( thread, NULL );
+  pthread_attr_destroy( &attributes );
+
+  std::size_t untouched = 0;
+  while( untouched < size && static_cast<unsigned char*>( stack )[untouched] == pattern ){
+    untouched += 1;
+  }
+  std::free( stack );
+  return size - untouched;
+}
+
+/*
+A program that runs a translation and a reference translation of the same
+statements, each as a kernel over its own copy of an array of floats A, with
+B read by both, and fails if they leave their copies of A different.
+*/
+class kernel_comparison {
+  public:
+    // Stem of the files written, <base>_run.cpp and <base>_run
+    std::string base;
+    // Code ahead of the kernels: the isl_sage_* definitions and the macros
+    // the statements expand to
+    std::string prelude;
+    // Parameters of the kernels, among them float arrays A and B
+    std::string parameters;
+    // Arguments of the kernels ahead of A and B
+    std::string arguments;
+    // Floats in A and B
+    int size;
+    // Compiler flags
+    std::string flags;
+
+    // Kernels of N, A and B, called for N = 97 on arrays of 10000 floats
+    kernel_comparison( const std::string& base, const std::string& prelude ):
+      base( base ), prelude( prelude ), parameters( "int N, float* A, const float* B" ), arguments( "97" ), size( 10000 ), flags( "-O2" )
+    { }
+
+    // Writes, builds and runs the program; true if code computes what
+    // reference does
+    bool same_results( const std::string& code, const std::string& reference ) const {
+      std::string size_text = std::to_string( this->size );
+      std::ofstream runner( (this->base + "_run.cpp").c_str(), std::ios::trunc | std::ios::out );
+      runner << "#include <cstdio>" << std::endl << this->prelude
+             << kernel( "translated", this->parameters, code ) << kernel( "reference", this->parameters, reference )
+             << "int main(){" << std::endl
+             << "  static float A[2][" << size_text << "], B[" << size_text << "];" << std::endl
+             << "  for( int i = 0; i < " << size_text << "; i += 1 ){ A[0][i] = A[1][i] = i % 7; B[i] = i % 5; }" << std::endl
+             << "  translated( " << this->arguments << ", A[0], B );" << std::endl
+             << "  reference( " << this->arguments << ", A[1], B );" << std::endl
+             << "  for( int i = 0; i < " << size_text << "; i += 1 ){ if( A[0][i] != A[1][i] ){ std::printf( \"differs at %d\\n\", i ); return 1; } }" << std::endl
+             << "  return 0;" << std::endl
+             << "}" << std::endl;
+      runner.close();
+      return run( cxx() + " " + this->flags + " -o " + this->base + "_run " + this->base + "_run.cpp" ) == 0 && run( "./" + this->base + "_run" ) == 0;
+    }
+};
+
+#endif
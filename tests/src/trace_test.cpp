@@ -0,0 +1,123 @@
+#include <cassert>
+#include <cstdlib>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "walker_trace.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Checks ring_trace on its own: events are kept oldest first, wrap around once
+the buffer is full, and drain as text and as Chrome trace JSON.
+Then times a translation with and without verbose. In a TRACE=1 build the
+verbose run's Chrome trace is written to walker_trace.json; in a default
+build both runs should take the same time, as tracing compiles away.
+*/
+
+int check_ring(){
+  ring_trace trace( 4 );
+  int failures = 0;
+
+  // Not started, nothing recorded
+  trace.record( "ignored", 0, NULL );
+  failures += ( trace.size() == 0 ) ? 0 : 1;
+
+  trace.start();
+  for( long i = 0; i < 6; i += 1 ){
+    trace.record_value( "int", 1, NULL, i );
+  }
+  trace.stop();
+  failures += ( trace.size() == 4 && trace.dropped() == 2 ) ? 0 : 1;
+
+  ostringstream text;
+  trace.drain( text, trace_text );
+  bool text_ok = text.str().find( "(2 earlier events dropped)" ) == 0
+              && text.str().find( "int: 2" ) != string::npos
+              && text.str().find( "int: 1" ) == string::npos;
+  failures += text_ok ? 0 : 1;
+  failures += ( trace.size() == 0 ) ? 0 : 1;
+
+  trace.start();
+  trace.record( "for", 0, NULL );
+  trace.record_value( "int", 1, NULL, 0 );
+  trace.stop();
+
+  ostringstream json;
+  trace.drain( json, trace_chrome );
+  bool json_ok = json.str().find( "{\"traceEvents\":[" ) == 0
+              && json.str().find( "\"name\":\"for\"" ) != string::npos
+              && json.str().find( "\"value\":0" ) != string::npos;
+  failures += json_ok ? 0 : 1;
+
+  cout << "ring_trace: " << ( failures == 0 ? "ok" : "FAILED" ) << endl;
+  if( failures != 0 ){
+    cout << text.str() << json.str() << endl;
+  }
+  return failures;
+}
+
+double translate_seconds( isl_ast_node* isl_ast, SgFunctionDefinition* target_defn, const walker_options& options ){
+  SgBasicBlock* injection_site = buildBasicBlock();
+  target_defn->append_statement( injection_site );
+
+  auto start = chrono::steady_clock::now();
+  SageTransformationWalker walker( isl_ast, injection_site, options );
+  auto stop = chrono::steady_clock::now();
+
+  removeStatement( injection_site );
+  deleteAST( injection_site );
+
+  return chrono::duration<double>( stop - start ).count();
+}
+
+int main( int argc, char** argv ){
+  int failures = check_ring();
+
+  SgProject* project = template_project( argv[0], "#include <iostream>\nusing namespace std;\nint main(){ }" );
+  SgFunctionDefinition* target_defn = template_main( project )->get_definition();
+
+  // Symbolic constants used by the bounds
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+  target_defn->append_statement( buildVariableDeclaration( SgName( "M" ), buildIntType(), NULL, target_defn ) );
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), "[N,M]->{ S[i,j] : 0 <= i < N and 0 <= j < M }",
+                                                 "{ S[i,j] -> [floor(i/32), floor(j/32), floor(i/4), floor(j/4), i, j] }" ) );
+
+  walker_options quiet;
+  walker_options traced;
+  traced.verbose = true;
+  traced.trace_file = "walker_trace.json";
+  traced.trace_output_format = trace_chrome;
+
+  double quiet_time = translate_seconds( isl_ast.get(), target_defn, quiet );
+  double traced_time = translate_seconds( isl_ast.get(), target_defn, traced );
+
+  cout << "tracing " << ( walker_trace::enabled ? "compiled in" : "compiled out" ) << endl
+       << "  quiet:   " << quiet_time << "s" << endl
+       << "  verbose: " << traced_time << "s" << endl;
+
+  if( walker_trace::enabled ){
+    ifstream trace_file( traced.trace_file.c_str() );
+    string first_line;
+    getline( trace_file, first_line );
+    bool written = first_line == "{\"traceEvents\":[";
+    failures += written ? 0 : 1;
+    cout << "  " << traced.trace_file << ( written ? " written" : " MISSING" ) << endl;
+  }
+
+  return failures;
+}
@@ -0,0 +1,246 @@
+#include <cassert>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "loop_builder.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Translates a register-tiled nest with an inner loop of 4 iterations, a loop
+of 4 iterations of stride 4 and a loop of 16 iterations, with
+walker_options::unroll_limit 8, recursively, iteratively and through flat_ir,
+and checks that:
+  - the three build the same code
+  - the loops of at most 8 iterations are gone and the others kept
+  - the statement macros recorded are the calls in the tree, one per copy
+  - compiled with $CXX (default g++), each translation computes the same
+    array as the translation without unrolling
+and that a loop of a single iteration built by loop_builder becomes its body,
+the iterator replaced by its value, that a loop of 4 iterations from 2^31
+is unrolled into copies whose values are long long literals, and that of loops
+bounded near the limits of long long, the one of 4 iterations up to LLONG_MAX
+is unrolled and the one over all of long long, whose trip count does not fit,
+is kept.
+The statement S is a macro updating A from B.
+*/
+
+class unroll_case {
+  public:
+    string name;
+    string domain;
+    string schedule;
+    // Loops and statement macros expected once unrolled
+    int loops;
+    int macros;
+};
+
+const unsigned limit = 8;
+
+// Number of statement macros recorded that are not calls under root, or not
+// all of them
+int check_macros( SgNode* root, vector<function_call_info>& macros ){
+  vector<function_call_info> calls;
+  function_call_info::collect( root, calls );
+
+  int wrong = calls.size() == macros.size() ? 0 : 1;
+  for( vector<function_call_info>::size_type i = 0; i < macros.size() && i < calls.size(); i += 1 ){
+    wrong += macros[i].expr_node == calls[i].expr_node && macros[i].parameter_expressions == calls[i].parameter_expressions ? 0 : 1;
+  }
+  return wrong;
+}
+
+string render( isl_ast_node* isl_ast, SgFunctionDefinition* target_defn, unsigned unroll_limit, bool iterative, bool flat_ir, int& loops, int& macros, int& wrong ){
+  SgBasicBlock* injection_site = buildBasicBlock();
+  target_defn->append_statement( injection_site );
+
+  walker_options options;
+  options.unroll_limit = unroll_limit;
+  options.canonical_loops = true;
+  options.iterative = iterative;
+  options.flat_ir = flat_ir;
+  options.intrinsics = intrinsic_inline;
+  SageTransformationWalker walker( isl_ast, injection_site, options );
+
+  loops = NodeQuery::querySubTree( injection_site, V_SgForStatement ).size();
+  macros = walker.getStatementMacroNodes()->size();
+  wrong = check_macros( injection_site, *walker.getStatementMacroNodes() );
+  string code = injection_site->unparseToString();
+  removeStatement( injection_site );
+  deleteAST( injection_site );
+  return code;
+}
+
+// Whether a loop of the single iteration c = 5, built and unrolled by
+// loop_builder, becomes its body with c replaced by 5
+bool single_iteration( SgFunctionDefinition* target_defn, SgGlobal* global ){
+  arith_builder arith( intrinsic_inline, false );
+  arith.set_global( global );
+  loop_builder loops( arith, true, false, limit );
+
+  SgBasicBlock* site = buildBasicBlock();
+  target_defn->append_statement( site );
+  SgVariableDeclaration* iterator = buildVariableDeclaration( SgName( "c" ), buildIntType(), buildAssignInitializer( buildIntVal( 5 ), buildIntType() ), site );
+  SgVariableSymbol* symbol = getFirstVarSym( iterator );
+  SgExpression* cond = buildBinaryExpression<SgLessOrEqualOp>( buildVarRefExp( symbol ), buildIntVal( 5 ) );
+  SgForStatement* loop = loops.build( iterator, cond, buildIntVal( 1 ), site );
+
+  SgStatement* use = buildFunctionCallStmt( SgName( "S" ), buildVoidType(), buildExprListExp( buildVarRefExp( symbol ) ), global );
+  loop_builder::set_body( loop, use );
+  bool unrolls = loops.unrolls( loop );
+  SgStatement* unrolled = loops.unroll( loop );
+  appendStatement( unrolled, site );
+
+  string code = unrolled->unparseToString();
+  bool collapsed = unrolls && isSgBasicBlock( unrolled ) != NULL && NodeQuery::querySubTree( site, V_SgForStatement ).empty()
+                   && code.find( "S(5)" ) != string::npos;
+  cout << "single iteration: " << (collapsed ? "collapsed" : "NOT COLLAPSED") << ": " << code << endl;
+
+  removeStatement( site );
+  deleteAST( site );
+  return collapsed;
+}
+
+// Whether a loop of c = 2^31 to 2^31 + 3, built and unrolled by loop_builder,
+// becomes 4 copies of its body with c replaced by long long literals of those
+// values
+bool far_iterations( SgFunctionDefinition* target_defn, SgGlobal* global ){
+  const long long first = 2147483648LL;
+  arith_builder arith( intrinsic_inline, false );
+  arith.set_global( global );
+  loop_builder loops( arith, true, false, limit );
+
+  SgBasicBlock* site = buildBasicBlock();
+  target_defn->append_statement( site );
+  SgVariableDeclaration* iterator = buildVariableDeclaration( SgName( "c" ), buildLongLongType(), buildAssignInitializer( buildLongLongIntVal( first ), buildLongLongType() ), site );
+  SgVariableSymbol* symbol = getFirstVarSym( iterator );
+  SgExpression* cond = buildBinaryExpression<SgLessOrEqualOp>( buildVarRefExp( symbol ), buildLongLongIntVal( first + 3 ) );
+  SgForStatement* loop = loops.build( iterator, cond, buildIntVal( 1 ), site );
+
+  SgStatement* use = buildFunctionCallStmt( SgName( "S" ), buildVoidType(), buildExprListExp( buildVarRefExp( symbol ) ), global );
+  loop_builder::set_body( loop, use );
+  bool unrolls = loops.unrolls( loop );
+  SgStatement* unrolled = loops.unroll( loop );
+  appendStatement( unrolled, site );
+
+  Rose_STL_Container<SgNode*> values = NodeQuery::querySubTree( unrolled, V_SgLongLongIntVal );
+  bool exact = unrolls && values.size() == 4 && NodeQuery::querySubTree( unrolled, V_SgIntVal ).empty();
+  for( Rose_STL_Container<SgNode*>::size_type k = 0; k < values.size() && exact; k += 1 ){
+    exact = isSgLongLongIntVal( values[k] )->get_value() == first + (long long) k;
+  }
+  cout << "far iterations: " << (exact ? "exact" : "TRUNCATED") << ": " << unrolled->unparseToString() << endl;
+
+  removeStatement( site );
+  deleteAST( site );
+  return exact;
+}
+
+// Loop of c = first to last, built by loop_builder, with a call S(c) as body
+SgForStatement* bounded_loop( loop_builder& loops, long long first, long long last, SgBasicBlock* site, SgGlobal* global ){
+  SgVariableDeclaration* iterator = buildVariableDeclaration( SgName( "c" ), buildLongLongType(), buildAssignInitializer( buildLongLongIntVal( first ), buildLongLongType() ), site );
+  SgVariableSymbol* symbol = getFirstVarSym( iterator );
+  SgExpression* cond = buildBinaryExpression<SgLessOrEqualOp>( buildVarRefExp( symbol ), buildLongLongIntVal( last ) );
+  SgForStatement* loop = loops.build( iterator, cond, buildIntVal( 1 ), site );
+  loop_builder::set_body( loop, buildFunctionCallStmt( SgName( "S" ), buildVoidType(), buildExprListExp( buildVarRefExp( symbol ) ), global ) );
+  return loop;
+}
+
+// Whether, of loops bounded by the limits of long long, c = LLONG_MAX - 3 to
+// LLONG_MAX is unrolled into 4 copies and c = LLONG_MIN to LLONG_MAX, whose
+// trip count overflows long long, is not unrolled
+bool extreme_bounds( SgFunctionDefinition* target_defn, SgGlobal* global ){
+  arith_builder arith( intrinsic_inline, false );
+  arith.set_global( global );
+  loop_builder loops( arith, true, false, limit );
+
+  SgBasicBlock* site = buildBasicBlock();
+  target_defn->append_statement( site );
+
+  SgForStatement* top = bounded_loop( loops, LLONG_MAX - 3, LLONG_MAX, site, global );
+  bool top_unrolls = loops.unrolls( top );
+  SgStatement* top_unrolled = loops.unroll( top );
+  appendStatement( top_unrolled, site );
+  Rose_STL_Container<SgNode*> values = NodeQuery::querySubTree( top_unrolled, V_SgLongLongIntVal );
+  bool top_exact = top_unrolls && values.size() == 4;
+  for( Rose_STL_Container<SgNode*>::size_type k = 0; k < values.size() && top_exact; k += 1 ){
+    top_exact = isSgLongLongIntVal( values[k] )->get_value() == LLONG_MAX - 3 + (long long) k;
+  }
+
+  SgForStatement* all = bounded_loop( loops, LLONG_MIN, LLONG_MAX, site, global );
+  bool all_kept = ! loops.unrolls( all ) && loops.unroll( all ) == all;
+  appendStatement( all, site );
+
+  cout << "extreme bounds: up to LLONG_MAX " << (top_exact ? "exact" : "WRONG") << ", all of long long "
+       << (all_kept ? "kept" : "UNROLLED") << ": " << site->unparseToString() << endl;
+
+  removeStatement( site );
+  deleteAST( site );
+  return top_exact && all_kept;
+}
+
+int main( int argc, char** argv ){
+  SgProject* project = template_project( argv[0], "int main(){ }" );
+  SgFunctionDeclaration* target_decl = template_main( project );
+  SgFunctionDefinition* target_defn = target_decl->get_definition();
+  SgGlobal* global = getGlobalScope( target_decl );
+
+  // Symbolic constant used by the bounds
+  target_defn->append_statement( buildVariableDeclaration( SgName( "N" ), buildIntType(), NULL, target_defn ) );
+
+  vector<unroll_case> cases;
+  cases.push_back( unroll_case{ "register", "[N]->{ S[i,j] : 0 <= i < N and 0 <= j < 4 }", "{ S[i,j] -> [floor(i/32), i, j] }", 2, 4 } );
+  cases.push_back( unroll_case{ "strided", "[N]->{ S[i,j] : 0 <= i < N and 0 <= j <= 12 and j mod 4 = 0 }", "{ S[i,j] -> [i, j] }", 1, 4 } );
+  cases.push_back( unroll_case{ "long", "[N]->{ S[i,j] : 0 <= i < N and 0 <= j < 16 }", "{ S[i,j] -> [i, j] }", 2, 1 } );
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  int failures = 0;
+
+  for( vector<unroll_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    const unroll_case& test = cases[i];
+    isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), test.domain, test.schedule ) );
+
+    int loops = 0, macros = 0, wrong = 0;
+    int iterative_loops = 0, iterative_macros = 0, iterative_wrong = 0;
+    int flat_loops = 0, flat_macros = 0, flat_wrong = 0;
+    int unused = 0;
+    string code = render( isl_ast.get(), target_defn, limit, false, false, loops, macros, wrong );
+    string iterated = render( isl_ast.get(), target_defn, limit, true, false, iterative_loops, iterative_macros, iterative_wrong );
+    string flattened = render( isl_ast.get(), target_defn, limit, false, true, flat_loops, flat_macros, flat_wrong );
+    string plain = render( isl_ast.get(), target_defn, 0, false, false, unused, unused, unused );
+
+    bool same = code == iterated && code == flattened && macros == iterative_macros && macros == flat_macros;
+    bool unrolled = loops == test.loops && macros == test.macros;
+    wrong += iterative_wrong + flat_wrong;
+
+    // Same results as without unrolling
+    string base = "__unroll_" + test.name;
+    kernel_comparison comparison( base, definitions( global ) + "#define S(i,j) A[(i) * 16 + (j)] = A[(i) * 16 + (j)] * 0.5f + B[(j) * 100 + (i)]\n" );
+    bool values = comparison.same_results( code, plain );
+
+    failures += (same ? 0 : 1) + (unrolled ? 0 : 1) + wrong + (values ? 0 : 1);
+    cout << test.name << ": iterative and flat_ir " << (same ? "identical" : "MISMATCH")
+         << ", " << loops << " loops, " << macros << " macros" << (unrolled ? "" : " (UNEXPECTED)")
+         << ", " << wrong << " macros wrong"
+         << ", values " << (values ? "identical" : "MISMATCH") << endl;
+    if( ! unrolled ){
+      cout << code << endl;
+    }
+  }
+
+  failures += single_iteration( target_defn, global ) ? 0 : 1;
+  failures += far_iterations( target_defn, global ) ? 0 : 1;
+  failures += extreme_bounds( target_defn, global ) ? 0 : 1;
+
+  return failures;
+}
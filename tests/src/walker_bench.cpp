@@ -0,0 +1,295 @@
+#include <cassert>
+#include <cstdlib>
+#include <chrono>
+#include <fstream>
+#include <utility>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "synthetic_ast.hpp"
+#include "PrintNodeWalker.hpp"
+#include "PrintNodeStreamWalker.hpp"
+#include "flat_ast.hpp"
+#include "SageMaterializer.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Times each stage of turning a synthetic schedule into Sage code, at several
+sizes: isl AST build, PrintNodeWalker, SageTransformationWalker, lowering to a
+flat_ast and materializing Sage from it, and unparsing the result. As a
+reference for raw SageBuilder throughput, loop nests of each case's shape
+(bounds, guards, tiling and fusion) are also built by hand the way
+segfault_test's build_example does.
+Each stage is run repetitions times (second argument, default 3) and the best
+time is kept. Results are written as JSON to the first argument, or stdout.
+
+make bench runs this and writes bench.json.
+*/
+
+class bench_case {
+  public:
+    string name;
+    synthetic_options options;
+
+    bench_case( const string& name, int nest_depth, int statements ): name( name ), options() {
+      this->options.nest_depth = nest_depth;
+      this->options.statements = statements;
+    }
+};
+
+class bench_result {
+  public:
+    int nodes;
+    double isl_build;
+    double print_walker;
+    double sage_walker;
+    double flat_lower;
+    double materialize;
+    double unparse;
+    double sage_baseline;
+};
+
+double seconds_since( chrono::steady_clock::time_point start ){
+  return chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+}
+
+// Bound of dimension d of the case: the constant or parameter, or the max
+// (lower) or min (upper) of the fan_in parameters, as isl bounds it
+SgExpression* baseline_bound( const synthetic_options& options, SgScopeStatement* scope, int d, bool lower ){
+  SgExpression* bound = NULL;
+  if( ! options.parametric ){
+    bound = buildIntVal( lower ? 0 : options.constant_bound );
+  }
+  for( int j = options.parametric ? 0 : 1; j < options.fan_in; j += 1 ){
+    SgName name( string( lower ? "L" : "U" ) + to_string( j ) + "_" + to_string( d ) );
+    SgExpression* parameter = buildVarRefExp( name, scope );
+    if( bound == NULL ){
+      bound = parameter;
+    } else if( lower ){
+      bound = buildConditionalExp( buildBinaryExpression<SgGreaterThanOp>( bound, parameter ), copyExpression( bound ), copyExpression( parameter ) );
+    } else {
+      bound = buildConditionalExp( buildBinaryExpression<SgLessThanOp>( bound, parameter ), copyExpression( bound ), copyExpression( parameter ) );
+    }
+  }
+  return bound;
+}
+
+// Appends for( int name = lower; name <= upper; name = name + step ) to
+// scope, setting iterator to its symbol, and returns its body
+SgBasicBlock* baseline_loop( const string& name, SgExpression* lower, SgExpression* upper, int step, SgBasicBlock* scope, SgVariableSymbol*& iterator ){
+  SgAssignInitializer* initializer = buildAssignInitializer( lower, buildIntType() );
+  SgVariableDeclaration* var_decl = buildVariableDeclaration( SgName( name ), buildIntType(), initializer, scope );
+  iterator = getFirstVarSym( var_decl );
+
+  SgExprStatement* condition = buildExprStatement( buildBinaryExpression<SgLessOrEqualOp>( buildVarRefExp( iterator ), upper ) );
+  SgVarRefExp* var_ref = buildVarRefExp( iterator );
+  SgExpression* increment = buildBinaryExpression<SgAssignOp>( copyExpression( var_ref ), buildBinaryExpression<SgAddOp>( var_ref, buildIntVal( step ) ) );
+
+  SgBasicBlock* loop_body = buildBasicBlock();
+  appendStatement( buildForStatement( var_decl, condition, increment, loop_body ), scope );
+  return loop_body;
+}
+
+/*
+Builds, with the same SageBuilder calls the walker makes,
+  for( int i0 = lower0; i0 <= upper0 - 1; i0 = i0 + 1 )
+    ...
+      S<k>( i0, ... );
+into scope, which must see the case's parameters: once per statement, or
+once around every statement when fused. The bounds are the case's constants,
+parameters, or max and min of its parameters; odd statements are guarded by
+i<last> % modulo == 0 when modulo > 1; and when tiled, loops t<d> stepping by
+tile_size enclose the nest, each i<d> running from t<d> to at most
+t<d> + tile_size - 1.
+*/
+void build_baseline( const synthetic_options& options, SgBasicBlock* scope ){
+  int nests = options.fused ? 1 : options.statements;
+  for( int n = 0; n < nests; n += 1 ){
+    SgBasicBlock* body = scope;
+    vector<SgVariableSymbol*> tiles( options.nest_depth, (SgVariableSymbol*) NULL );
+    vector<SgVariableSymbol*> iterators( options.nest_depth, (SgVariableSymbol*) NULL );
+
+    if( options.tile_size > 0 ){
+      for( int d = 0; d < options.nest_depth; d += 1 ){
+        SgExpression* upper = buildBinaryExpression<SgSubtractOp>( baseline_bound( options, body, d, false ), buildIntVal( 1 ) );
+        body = baseline_loop( string( "t" ) + to_string( d ), baseline_bound( options, body, d, true ), upper, options.tile_size, body, tiles[d] );
+      }
+    }
+
+    for( int d = 0; d < options.nest_depth; d += 1 ){
+      SgExpression* lower = baseline_bound( options, body, d, true );
+      SgExpression* upper = buildBinaryExpression<SgSubtractOp>( baseline_bound( options, body, d, false ), buildIntVal( 1 ) );
+      if( tiles[d] != NULL ){
+        deleteAST( lower );
+        lower = buildVarRefExp( tiles[d] );
+        SgExpression* tile_end = buildBinaryExpression<SgAddOp>( buildVarRefExp( tiles[d] ), buildIntVal( options.tile_size - 1 ) );
+        upper = buildConditionalExp( buildBinaryExpression<SgLessThanOp>( upper, tile_end ), copyExpression( upper ), copyExpression( tile_end ) );
+      }
+      body = baseline_loop( string( "i" ) + to_string( d ), lower, upper, 1, body, iterators[d] );
+    }
+
+    int first = options.fused ? 0 : n;
+    int last = options.fused ? options.statements : n + 1;
+    for( int k = first; k < last; k += 1 ){
+      vector<SgExpression*> arguments;
+      arguments.reserve( options.nest_depth );
+      for( int d = 0; d < options.nest_depth; d += 1 ){
+        arguments.push_back( buildVarRefExp( iterators[d] ) );
+      }
+      SgName callee( string( "S" ) + to_string( k ) );
+      SgStatement* call = buildFunctionCallStmt( callee, buildVoidType(), buildExprListExp( arguments ), body );
+
+      if( options.modulo > 1 && k % 2 == 1 ){
+        SgExpression* remainder = buildBinaryExpression<SgModOp>( buildVarRefExp( iterators.back() ), buildIntVal( options.modulo ) );
+        SgExprStatement* guard = buildExprStatement( buildBinaryExpression<SgEqualityOp>( remainder, buildIntVal( 0 ) ) );
+        call = buildIfStmt( guard, buildBasicBlock( call ), NULL );
+      }
+      appendStatement( call, body );
+    }
+  }
+}
+
+bench_result run_case( const bench_case& test, int repetitions, isl_ctx* ctx, SgFunctionDefinition* target_defn ){
+  bench_result result;
+  result.isl_build = result.print_walker = result.sage_walker = result.flat_lower = result.materialize = result.unparse = result.sage_baseline = 1e30;
+
+  // Parameters are declared in a block of their own, which is removed after
+  // each run to keep the project from growing
+  vector<string> parameters = synthetic_parameters( test.options );
+
+  for( int r = 0; r < repetitions; r += 1 ){
+    auto start = chrono::steady_clock::now();
+    isl_ast_node_handle isl_ast( synthetic_ast( ctx, test.options ) );
+    result.isl_build = min( result.isl_build, seconds_since( start ) );
+
+    string dump;
+    PrintNodeStreamWalker counter( dump );
+    result.nodes = counter.visit( isl_ast.get() );
+
+    start = chrono::steady_clock::now();
+    {
+      PrintNodeWalker walker;
+      walker.visit( isl_ast.get() );
+    }
+    result.print_walker = min( result.print_walker, seconds_since( start ) );
+
+    SgBasicBlock* parameter_block = buildBasicBlock();
+    target_defn->append_statement( parameter_block );
+    for( vector<string>::size_type i = 0; i < parameters.size(); i += 1 ){
+      parameter_block->append_statement( buildVariableDeclaration( SgName( parameters[i] ), buildIntType(), NULL, parameter_block ) );
+    }
+    SgBasicBlock* injection_site = buildBasicBlock();
+    parameter_block->append_statement( injection_site );
+
+    start = chrono::steady_clock::now();
+    {
+      SageTransformationWalker walker( isl_ast.get(), injection_site );
+    }
+    result.sage_walker = min( result.sage_walker, seconds_since( start ) );
+
+    start = chrono::steady_clock::now();
+    string code = injection_site->unparseToString();
+    result.unparse = min( result.unparse, seconds_since( start ) );
+
+    SgBasicBlock* flat_site = buildBasicBlock();
+    parameter_block->append_statement( flat_site );
+
+    {
+      start = chrono::steady_clock::now();
+      flat_ast ir;
+      uint32_t root = ir.lower( isl_ast.get() );
+      result.flat_lower = min( result.flat_lower, seconds_since( start ) );
+
+      start = chrono::steady_clock::now();
+      SageMaterializer materializer;
+      materializer.materialize( ir, root, flat_site );
+      result.materialize = min( result.materialize, seconds_since( start ) );
+    }
+
+    SgBasicBlock* baseline_site = buildBasicBlock();
+    parameter_block->append_statement( baseline_site );
+
+    start = chrono::steady_clock::now();
+    build_baseline( test.options, baseline_site );
+    result.sage_baseline = min( result.sage_baseline, seconds_since( start ) );
+
+    removeStatement( parameter_block );
+    deleteAST( parameter_block );
+  }
+
+  return result;
+}
+
+void write_json( ostream& out, const vector<bench_case>& cases, const vector<bench_result>& results ){
+  out << "{\"benchmarks\":[" << endl;
+  for( vector<bench_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    const synthetic_options& options = cases[i].options;
+    const bench_result& result = results[i];
+    out << "  {\"name\":\"" << cases[i].name << "\""
+        << ",\"nest_depth\":" << options.nest_depth
+        << ",\"statements\":" << options.statements
+        << ",\"fan_in\":" << options.fan_in
+        << ",\"modulo\":" << options.modulo
+        << ",\"tile_size\":" << options.tile_size
+        << ",\"fused\":" << (options.fused ? "true" : "false")
+        << ",\"parametric\":" << (options.parametric ? "true" : "false")
+        << ",\"isl_nodes\":" << result.nodes
+        << ",\"seconds\":{\"isl_build\":" << result.isl_build
+        << ",\"print_walker\":" << result.print_walker
+        << ",\"sage_walker\":" << result.sage_walker
+        << ",\"flat_lower\":" << result.flat_lower
+        << ",\"materialize\":" << result.materialize
+        << ",\"unparse\":" << result.unparse
+        << ",\"sage_baseline\":" << result.sage_baseline << "}}"
+        << (i + 1 < cases.size() ? "," : "") << endl;
+  }
+  out << "]}" << endl;
+}
+
+int main( int argc, char** argv ){
+  string output_path = (argc > 1) ? argv[1] : "";
+  int repetitions = (argc > 2) ? atoi( argv[2] ) : 3;
+
+  vector<bench_case> cases;
+  cases.push_back( bench_case( "small", 2, 2 ) );
+  cases.push_back( bench_case( "constant", 3, 4 ) );
+  cases.back().options.parametric = false;
+  cases.push_back( bench_case( "fan-in", 3, 4 ) );
+  cases.back().options.fan_in = 3;
+  cases.push_back( bench_case( "modulo", 2, 8 ) );
+  cases.back().options.modulo = 3;
+  cases.back().options.fused = true;
+  cases.push_back( bench_case( "tiled", 3, 2 ) );
+  cases.back().options.tile_size = 32;
+  cases.push_back( bench_case( "wide", 2, 64 ) );
+  cases.push_back( bench_case( "deep", 12, 1 ) );
+
+  SgProject* project = template_project( argv[0], "#include <iostream>\nusing namespace std;\nint main(){ }" );
+  SgFunctionDefinition* target_defn = template_main( project )->get_definition();
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+
+  vector<bench_result> results;
+  for( vector<bench_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    results.push_back( run_case( cases[i], repetitions, ctx.get(), target_defn ) );
+    cerr << cases[i].name << ": " << results.back().nodes << " nodes" << endl;
+  }
+
+  if( output_path.empty() ){
+    write_json( cout, cases, results );
+    return 0;
+  }
+
+  ofstream output( output_path.c_str(), ios::trunc | ios::out );
+  write_json( output, cases, results );
+  return output.good() ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "rose.h"
+#include "all_isl.hpp"
+#include "isl_handle.hpp"
+#include "width_analysis.hpp"
+#include "SageTransformationWalker.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+/*
+Translates a tiled nest with N bounded by the context and without context, a
+nest with the inner iterator scaled by 100000, a nest shifted by 3000000000
+and a loop from N, only bounded below, to 10, with
+walker_options::choose_widths, recursively, iteratively and through flat_ir,
+and checks that:
+  - the three build the same code
+  - each iterator is declared int32_t or int64_t as expected
+  - a long long literal is built exactly where a literal leaves 32 bits
+  - without choose_widths, iterators are declared int
+  - the project unparsed, each translation in a kernel of its own, compiles
+    with $CXX (default g++), isl_sage_* definitions included, and each
+    kernel calls S on the same points as a loop over the domain in long
+    long, for N from 0 to 97
+The statement S is a macro adding a hash of its arguments to a sum.
+*/
+
+class width_case {
+  public:
+    string name;
+    string domain;
+    string schedule;
+    string context;
+    // name:type of each iterator, in order of first declaration
+    string types;
+    bool long_literal;
+    // Loops over the domain in long long, calling S on each point
+    string points;
+};
+
+const string square( "[N]->{ S[i,j] : 0 <= i < N and 0 <= j < N }" );
+const string square_points( "for( long long i = 0; i < N; i += 1 ){ for( long long j = 0; j < N; j += 1 ){ S(i,j); } }" );
+
+// name:type of each loop iterator declared under root, once per name
+string iterator_types( SgNode* root ){
+  string types;
+  vector<string> seen;
+  Rose_STL_Container<SgNode*> loops = NodeQuery::querySubTree( root, V_SgForStatement );
+  for( Rose_STL_Container<SgNode*>::iterator it = loops.begin(); it != loops.end(); ++it ){
+    SgForStatement* loop = isSgForStatement( *it );
+    SgVariableDeclaration* iterator = loop->get_init_stmt().empty() ? NULL : isSgVariableDeclaration( loop->get_init_stmt().front() );
+    if( iterator == NULL ){
+      continue;
+    }
+    SgInitializedName* name = getFirstInitializedName( iterator );
+    if( find( seen.begin(), seen.end(), name->get_name().getString() ) != seen.end() ){
+      continue;
+    }
+    seen.push_back( name->get_name().getString() );
+    types += types.empty() ? "" : " ";
+    types += name->get_name().getString() + ":" + name->get_type()->unparseToString();
+  }
+  return types;
+}
+
+// The template: stdint.h for the iterator types, and per case a kernel of N
+// to translate into, before its return, and the loops over its domain
+string template_code( const vector<width_case>& cases ){
+  string code = "#include <stdint.h>\n#include <stdio.h>\n"
+                "#define S(i,j) sum += (unsigned long long) (i) * 1000003u + (unsigned long long) (j) * (unsigned long long) (j)\n";
+  for( vector<width_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    code += "unsigned long long kernel_" + cases[i].name + "( int N ){\n  unsigned long long sum = 0;\n  return sum;\n}\n"
+            "unsigned long long points_" + cases[i].name + "( long long N ){\n  unsigned long long sum = 0;\n  "
+            + cases[i].points + "\n  return sum;\n}\n";
+  }
+  code += "int main(){\n  for( int N = 0; N <= 97; N += 1 ){\n";
+  for( vector<width_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    code += "    if( kernel_" + cases[i].name + "( N ) != points_" + cases[i].name + "( N ) ){ printf( \"" + cases[i].name
+            + " differs for N = %d\\n\", N ); return 1; }\n";
+  }
+  return code + "  }\n  return 0;\n}\n";
+}
+
+// The translation, put before the return of kernel; kept there if keep
+string render( isl_ast_node* isl_ast, SgFunctionDefinition* kernel, const width_case& test, bool choose_widths, bool iterative, bool flat_ir, bool keep, string& types, bool& long_literal ){
+  SgBasicBlock* injection_site = buildBasicBlock();
+  insertStatementBefore( kernel->get_body()->get_statements().back(), injection_site );
+
+  walker_options options;
+  options.choose_widths = choose_widths;
+  options.width_context = test.context;
+  options.iterative = iterative;
+  options.flat_ir = flat_ir;
+  options.intrinsics = intrinsic_inline;
+  SageTransformationWalker walker( isl_ast, injection_site, options );
+
+  types = iterator_types( injection_site );
+  long_literal = ! NodeQuery::querySubTree( injection_site, V_SgLongLongIntVal ).empty();
+  string code = injection_site->unparseToString();
+  if( ! keep ){
+    removeStatement( injection_site );
+    deleteAST( injection_site );
+  }
+  return code;
+}
+
+int main( int argc, char** argv ){
+  const string bounded( "[N] -> { : 0 <= N <= 100000 }" );
+  const string tiled( "{ S[i,j] -> [floor(i/32), floor(j/32), i, j] }" );
+
+  vector<width_case> cases;
+  cases.push_back( width_case{ "bounded", square, tiled, bounded, "c0:int32_t c1:int32_t c2:int32_t c3:int32_t", false, square_points } );
+  cases.push_back( width_case{ "unbounded", square, tiled, "", "c0:int64_t c1:int64_t c2:int64_t c3:int64_t", false, square_points } );
+  cases.push_back( width_case{ "scaled", square, "{ S[i,j] -> [i, 100000*i + j] }", bounded, "c0:int64_t c1:int64_t", false, square_points } );
+  cases.push_back( width_case{ "shifted", square, "{ S[i,j] -> [i, j + 3000000000] }", bounded, "c0:int32_t c1:int64_t", true, square_points } );
+  // c0 starts at N, which may be any size
+  cases.push_back( width_case{ "from_parameter", "[N]->{ S[i,j] : N <= i <= 10 and 0 <= j < 2 }", "{ S[i,j] -> [i, j] }",
+                               "[N] -> { : N >= 0 }", "c0:int64_t c1:int32_t", false,
+                               "for( long long i = N; i <= 10; i += 1 ){ for( long long j = 0; j < 2; j += 1 ){ S(i,j); } }" } );
+
+  SgProject* project = template_project( argv[0], template_code( cases ) );
+
+  isl_ctx_handle ctx( isl_ctx_alloc() );
+  int failures = 0;
+
+  for( vector<width_case>::size_type i = 0; i < cases.size(); i += 1 ){
+    const width_case& test = cases[i];
+    SgFunctionDeclaration* kernel = findFunctionDeclaration( project, "kernel_" + test.name, NULL, true );
+    assert( kernel != NULL );
+    isl_ast_node_handle isl_ast( ast_from_strings( ctx.get(), test.domain, test.schedule ) );
+
+    string types, iterative_types, flat_types, plain_types;
+    bool long_literal = false, iterative_long = false, flat_long = false, unused = false;
+    string iterated = render( isl_ast.get(), kernel->get_definition(), test, true, true, false, false, iterative_types, iterative_long );
+    string flattened = render( isl_ast.get(), kernel->get_definition(), test, true, false, true, false, flat_types, flat_long );
+    render( isl_ast.get(), kernel->get_definition(), test, false, false, false, false, plain_types, unused );
+    string code = render( isl_ast.get(), kernel->get_definition(), test, true, false, false, true, types, long_literal );
+
+    bool same = code == iterated && code == flattened && types == iterative_types && types == flat_types
+                && long_literal == iterative_long && long_literal == flat_long;
+    bool chosen = types == test.types && long_literal == test.long_literal;
+    bool plain = plain_types.find( "int32_t" ) == string::npos && plain_types.find( "int64_t" ) == string::npos;
+
+    failures += (same ? 0 : 1) + (chosen ? 0 : 1) + (plain ? 0 : 1);
+    cout << test.name << ": iterative and flat_ir " << (same ? "identical" : "MISMATCH")
+         << ", \"" << types << "\"" << (long_literal ? " with long long literal" : "") << (chosen ? "" : " (UNEXPECTED)")
+         << ", without widths \"" << plain_types << "\"" << (plain ? "" : " (UNEXPECTED)") << endl;
+    if( ! chosen ){
+      cout << code << endl;
+    }
+  }
+
+  // Same points as the domains, the file compiled as unparsed
+  project->unparse();
+  string unparsed = "rose_" + template_file_name;
+  bool values = run( cxx() + " -O2 -o __width_run " + unparsed ) == 0 && run( "./__width_run" ) == 0;
+  failures += values ? 0 : 1;
+  cout << "unparsed " << unparsed << ": values " << (values ? "identical" : "MISMATCH") << endl;
+
+  return failures;
+}